@@ -4,6 +4,16 @@
 #include "engine.h"
 #include "leaderboard.h"
 
+#include <map>
+
+// How many timers the timer benchmark adds to the wheel (and how far out they are spread, in milliseconds), along with how many thread timers it compares against
+#define TIMER_BENCHMARK_TIMERS 1000000
+#define TIMER_BENCHMARK_SPREAD 10000
+#define TIMER_BENCHMARK_THREAD_TIMERS 1000
+// How many balls the contact benchmark fills its table with, and how many steps it simulates
+#define CONTACT_BENCHMARK_BALLS 1024
+#define CONTACT_BENCHMARK_STEPS 300
+
 //class Leaderboard;
 
 // Class which provides engine related internals
@@ -32,6 +42,10 @@ public:
 private:
 	void KeyboardCallback(const SDL_KeyboardEvent& event);
 	void resetBall();
+	// Measures the cost of dispatching contacts with a table full of balls (printed to the console)
+	void runContactBenchmark();
+	// Measures the throughput of the timer wheel against thread timers (printed to the console)
+	void runTimerBenchmark();
 
 	Object *leftPaddle, *rightPaddle;
     Object *plunger;
@@ -41,6 +55,9 @@ private:
 
 	bool leftPaddleMoving, rightPaddleMoving;
 
+	// The timers turning off each light which was lit up by a bounce
+	std::map<Light*, TimerWheel::Handle> lightTimers;
+
 	float ballLaunchPower = 0;
 	float powerIncreaseSpeed = 900;
 	bool hasLaunched = false;
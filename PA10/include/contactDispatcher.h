@@ -0,0 +1,53 @@
+#ifndef CONTACT_DISPATCHER_H
+#define CONTACT_DISPATCHER_H
+
+#include <reactphysics3d/reactphysics3d.h>
+#include <functional>
+#include <vector>
+#include "flat_hash_map.hpp"
+
+// Routes each contact pair straight to the listeners registered for its colliders (or for the pair of them),
+// so the cost of a step is proportional to the number of contacts instead of contacts times listeners
+class ContactDispatcher {
+public:
+	using Event = std::function<void(const rp3d::CollisionCallback::ContactPair&)>;
+
+	// Which stages of a contact a listener wants to hear about (combined as flags)
+	// NOTE: Ending contacts have no contact points
+	enum Type : uint8_t {
+		Begin = 1 << 0,
+		Stay = 1 << 1,
+		End = 1 << 2,
+		Touching = Begin | Stay,
+		Any = Begin | Stay | End
+	};
+
+	// Listens to every contact involving the collider
+	void add(const rp3d::Collider& collider, Event event, uint8_t types = Touching);
+	// Listens to the contacts between the two colliders (in either order)
+	void add(const rp3d::Collider& a, const rp3d::Collider& b, Event event, uint8_t types = Touching);
+	// Removes every listener of the collider (or pair of colliders)
+	void remove(const rp3d::Collider& collider);
+	void remove(const rp3d::Collider& a, const rp3d::Collider& b);
+
+	// Calls the listeners of every contact pair
+	// NOTE: Listeners shouldn't add or remove listeners while being dispatched
+	void dispatch(const rp3d::CollisionCallback::CallbackData& callbackData) const;
+
+protected:
+	struct Listener {
+		Event event;
+		uint8_t types;
+	};
+	using Listeners = std::vector<Listener>;
+
+	// Two entity ids packed into one key (smallest first, so the order the pair is reported in doesn't matter)
+	static uint64_t pairKey(uint32_t a, uint32_t b) { return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a; }
+	static void call(const Listeners* listeners, uint8_t type, const rp3d::CollisionCallback::ContactPair& pair);
+
+protected:
+	flat_hash_map<uint32_t, Listeners> colliderListeners;
+	flat_hash_map<uint64_t, Listeners> pairListeners;
+};
+
+#endif // CONTACT_DISPATCHER_H
@@ -7,6 +7,7 @@
 
 #include "arguments.h"
 #include "nytl/callback.hpp"
+#include "timerWheel.h"
 
 // Forward declarations
 class Window;
@@ -43,6 +44,8 @@ public:
 	Physics* getPhysics() const { return m_physics; }
 	Sound* getSound() const { return m_sound; }
 	Object* getSceneRoot() const { return sceneRoot; }
+	// Timers which are advanced by the frame clock (their callbacks run on the main thread)
+	TimerWheel& getTimers() { return m_timers; }
 
 private:
 	// Window related variables
@@ -56,6 +59,7 @@ private:
 	Graphics* m_graphics;
 	Physics* m_physics;
 	Sound* m_sound;
+	TimerWheel m_timers;
 	unsigned int m_DT;
 	long long m_currentTimeMillis;
 	bool m_running;	
@@ -0,0 +1,101 @@
+#ifndef FLAT_HASH_MAP_HPP
+#define FLAT_HASH_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Open addressing hash map from integer keys to values, stored in one flat array (linear probing, so a lookup is usually a single cache line)
+// NOTE: Pointers to values are invalidated whenever an element is added
+template<typename Key, typename Value>
+class flat_hash_map {
+public:
+	// Returns the value for the key, or null if it isn't in the map
+	Value* find(Key key) {
+		if(slots.empty()) return nullptr;
+
+		for(size_t i = hash(key) & mask(); ; i = (i + 1) & mask()) {
+			if(!slots[i].used) return nullptr;
+			if(slots[i].key == key) return &slots[i].value;
+		}
+	}
+	const Value* find(Key key) const { return const_cast<flat_hash_map*>(this)->find(key); }
+
+	// Returns the value for the key, adding a default one if it isn't in the map
+	Value& operator[](Key key) {
+		if(Value* found = find(key)) return *found;
+
+		// Grow once the table is 3/4 full (keeping probes short)
+		if((count + 1) * 4 > slots.size() * 3) rehash(slots.empty() ? 16 : slots.size() * 2);
+
+		size_t i = hash(key) & mask();
+		while(slots[i].used) i = (i + 1) & mask();
+		slots[i] = {key, Value(), true};
+		count++;
+		return slots[i].value;
+	}
+
+	// Removes the key (if it is in the map), shifting back the elements which probed past it so no tombstones are needed
+	void erase(Key key) {
+		if(slots.empty()) return;
+
+		size_t i = hash(key) & mask();
+		while(slots[i].used && slots[i].key != key) i = (i + 1) & mask();
+		if(!slots[i].used) return;
+
+		for(size_t j = (i + 1) & mask(); slots[j].used; j = (j + 1) & mask()) {
+			// Elements whose home slot is (cyclically) between the hole and themselves stay where they are
+			size_t home = hash(slots[j].key) & mask();
+			if(((j - home) & mask()) < ((j - i) & mask())) continue;
+
+			slots[i] = std::move(slots[j]);
+			i = j;
+		}
+		slots[i] = Slot();
+		count--;
+	}
+
+	size_t size() const { return count; }
+
+	template<typename F>
+	void forEach(F&& f) {
+		for(auto& slot: slots)
+			if(slot.used) f(slot.key, slot.value);
+	}
+
+protected:
+	struct Slot {
+		Key key = Key();
+		Value value = Value();
+		bool used = false;
+	};
+
+	size_t mask() const { return slots.size() - 1; }
+
+	// Mixes the bits of the key (ids are often sequential, which would otherwise cluster)
+	static size_t hash(Key key) {
+		uint64_t x = (uint64_t) key;
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdull;
+		x ^= x >> 33;
+		return x;
+	}
+
+	void rehash(size_t capacity) {
+		std::vector<Slot> old(capacity);
+		std::swap(old, slots);
+		for(auto& slot: old)
+			if(slot.used) {
+				size_t i = hash(slot.key) & mask();
+				while(slots[i].used) i = (i + 1) & mask();
+				slots[i] = std::move(slot);
+			}
+	}
+
+protected:
+	std::vector<Slot> slots;
+	size_t count = 0;
+};
+
+#endif // FLAT_HASH_MAP_HPP
@@ -1,30 +1,128 @@
 #ifndef LEADERBOARD_H
 #define LEADERBOARD_H
 
-#include <map>
-#include <string>
-#include <iostream>
+#include <cstdint>
 #include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The log is compacted once it holds this many times as many records as there are players (plus some slack so small boards aren't constantly rewritten)
+#define LEADERBOARD_COMPACT_RATIO 2
+#define LEADERBOARD_COMPACT_SLACK 1024
+// How many players the leaderboard menu shows
+#define LEADERBOARD_DISPLAY_COUNT 10
+
 using namespace std;
 
 class Arguments;
 
-// Class holding the Leaderboard
+// Class holding the Leaderboard. Players are ranked in a tree which also tracks the size of every subtree, so looking up
+// a player's rank, the player at a rank, or the top players are all O(log n). Every change is appended to a log (a csv
+// of name,score lines where the last line for a name wins) which is periodically compacted to one line per player
 class Leaderboard {
+public:
+	struct Entry {
+		std::string name;
+		float score;
+	};
+
 public:
 	Leaderboard();
 	~Leaderboard();
-	bool Initialize(const Arguments& args, const string &filename);
-	bool AddPlayer(const string& userId);
-	void UpdateScore(const string& userId, float score);
+	bool Initialize(const Arguments& args, const std::string &filename);
+	bool AddPlayer(const std::string& userId);
+	void UpdateScore(const std::string& userId, float score);
+	// Compacts the log (if it has grown past its entries)
 	void Save();
 
-	map<string, float> leaderstats;
+	size_t size() const { return nodes.size(); }
+	// Returns true (and fills in the score) if the player is on the board
+	bool getScore(const std::string& userId, float& score) const;
+	// The player's rank (0 is the highest score), or -1 if they aren't on the board
+	size_t getRank(const std::string& userId) const;
+	// The player at a rank
+	Entry getEntry(size_t rank) const;
+	// The (up to) k highest scoring players, best first
+	std::vector<Entry> getTop(size_t k) const;
+
+protected:
+	static constexpr uint32_t NIL = -1;
+
+	// A node of the ranking (a treap ordered by score, best first)
+	struct Node {
+		std::string name;
+		float score;
+		uint32_t priority;
+		uint32_t hash; // Of the name (so the index can grow without hashing every name again)
+		uint32_t left = NIL, right = NIL;
+		uint32_t size = 1; // Nodes in the subtree
+	};
+
+	// Loads the log and opens it for appending
+	void open(const std::string& path);
+	// Finds a player's node (or NIL), and adds a new player's node
+	uint32_t find(std::string_view userId) const;
+	uint32_t add(std::string_view userId, float score);
+	static uint32_t hashOf(std::string_view userId) { return std::hash<std::string_view>()(userId); }
+	// Rebuilds the index with room for at least the given number of players
+	void reserve(size_t players);
+
+	// Names can't be empty, or contain commas and newlines (they would break up the log's records)
+	static bool validName(const std::string& userId) { return !userId.empty() && userId.find_first_of(",\n") == std::string::npos; }
+	// Reads the log (without appending to it)
+	void load(const std::string& path);
+	// Adds a player (or changes their score) without logging it
+	void set(const std::string& userId, float score);
+	// Appends a record to the log, compacting it if needed
+	void log(const std::string& userId, float score);
+	// Rewrites the log with one record per player
+	void compact();
+
+	// Ordering of the ranking (ties go to whoever joined the board first, the log is compacted in rank order so this survives reloading)
+	bool before(uint32_t a, uint32_t b) const { return nodes[a].score > nodes[b].score || (nodes[a].score == nodes[b].score && a < b); }
+	uint32_t sizeOf(uint32_t node) const { return node == NIL ? 0 : nodes[node].size; }
+	void update(uint32_t node) { nodes[node].size = 1 + sizeOf(nodes[node].left) + sizeOf(nodes[node].right); }
+	// Splits a subtree into the nodes ranked before the key node and the rest
+	void split(uint32_t subtree, uint32_t key, uint32_t& left, uint32_t& right);
+	// Joins two subtrees (every node in left ranked before every node in right)
+	uint32_t merge(uint32_t left, uint32_t right);
+	// Adds (or removes) a node to a subtree, returning the subtree's new root
+	uint32_t insert(uint32_t subtree, uint32_t node);
+	uint32_t erase(uint32_t subtree, uint32_t node);
+	// Calls f(node) for the first (up to) count nodes, best first
+	template<typename F>
+	void forEachInOrder(size_t count, F&& f) const {
+		std::vector<uint32_t> stack;
+		for (uint32_t current = root; count && (current != NIL || !stack.empty()); ) {
+			if (current != NIL) {
+				stack.push_back(current);
+				current = nodes[current].left;
+			} else {
+				current = stack.back();
+				stack.pop_back();
+				f(nodes[current]);
+				count--;
+				current = nodes[current].right;
+			}
+		}
+	}
+	// Builds the ranking out of every node at once (O(n) after sorting)
+	void build();
+	uint32_t updateSizes(uint32_t subtree);
 
-private:
+protected:
+	std::string filepath;
+	std::ofstream logFile;
+	size_t logRecords = 0;
 
-	void sort();
-	string filepath;
+	std::vector<Node> nodes;
+	// Open addressing table (linear probing) of nodes by name, players are never removed so it never needs tombstones
+	std::vector<uint32_t> index;
+	uint32_t root = NIL;
+	std::minstd_rand random;
 };
 
 #endif /* Leaderboard_H */
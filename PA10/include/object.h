@@ -4,6 +4,7 @@
 #include <vector>
 #include <SDL2/SDL.h>
 #include "physics.h"
+#include "mesh_blob.h"
 #include "graphics_headers.h"
 #include "arguments.h"
 
@@ -61,12 +62,22 @@ protected:
 	void FinalizeModel();
 	// Model/Texture loading
 	bool LoadModelFile(const Arguments& args, const std::string& path, glm::mat4 onImportTransformation = glm::mat4(1));
+	bool LoadCookedModel(const Arguments& args, MeshBlob::ptr blob);
+
+	// The model data (read out of the cooked model if there is one)
+	const Vertex* getVertexData() const { return meshBlob ? meshBlob->getVertices(meshBlobSubmesh) : Vertices.data(); }
+	size_t getVertexCount() const { return meshBlob ? meshBlob->getVertexCount(meshBlobSubmesh) : Vertices.size(); }
+	const unsigned int* getIndexData() const { return meshBlob ? meshBlob->getIndices(meshBlobSubmesh) : Indices.data(); }
+	size_t getIndexCount() const { return meshBlob ? meshBlob->getIndexCount(meshBlobSubmesh) : Indices.size(); }
 
 protected:
 	glm::mat4 model = glm::mat4(1);
 	glm::mat4 childModel = glm::mat4(1); // Model matrix that is used as the base of to this object's children's model matricies
 	std::vector<Vertex> Vertices;
 	std::vector<unsigned int> Indices;
+	// Cooked model (and which of its submeshes) this object's model data is read from instead, when its model has been cooked
+	MeshBlob::ptr meshBlob;
+	size_t meshBlobSubmesh = 0;
 
 	CollisionMesh collisionMesh;
 
@@ -4,8 +4,7 @@
 #include "arguments.h"
 #include <reactphysics3d/reactphysics3d.h>
 #include "graphics_headers.h"
-#include <map>
-#include <functional>
+#include "contactDispatcher.h"
 
 // Uncomment to enable physics debug rendering
 // #define PHYSICS_DEBUG
@@ -19,8 +18,7 @@ class Camera;
 // Class which provides the physics engine
 class Physics : public rp3d::EventListener {
 public:
-	//using ContactEvent = void (*)(const rp3d::CollisionCallback::ContactPair&);
-	using ContactEvent = std::function<void(const rp3d::CollisionCallback::ContactPair&)>;
+	using ContactEvent = ContactDispatcher::Event;
 
 	// Gets the singleton
 	static Physics* getSingleton();
@@ -41,7 +39,9 @@ public:
 	// Get the world
 	rp3d::PhysicsWorld& getWorld() { return *world; }
 
-	void addContactCallback(Object* obj, ContactEvent e);
+	// Calls the event for contacts involving the object (or between the two objects) at the given stages (ContactDispatcher::Type flags)
+	void addContactCallback(Object* obj, ContactEvent e, uint8_t types = ContactDispatcher::Touching);
+	void addContactCallback(Object* a, Object* b, ContactEvent e, uint8_t types = ContactDispatcher::Touching);
 
 protected:
 	// Singleton
@@ -55,7 +55,7 @@ protected:
 	// Scene's world
 	rp3d::PhysicsWorld* world;
 
-	std::map<uint32_t, ContactEvent> contactEvents;
+	ContactDispatcher contactDispatcher;
 
 #ifdef PHYSICS_DEBUG
 	// Debug rendering variables
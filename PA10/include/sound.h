@@ -2,7 +2,24 @@
 #define SOUND_H
 
 #include "../thirdparty/miniaudio.h"
+#include "spsc_queue.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
 
+// The format every sound is converted to and mixed in
+#define SOUND_CHANNELS 2
+#define SOUND_SAMPLE_RATE 48000
+// How many sounds can play at once (when every voice is busy the oldest one-shot is cut off)
+#define SOUND_VOICES 16
+// How many commands can be waiting for the mixer (commands past this are dropped rather than waiting on the audio thread)
+#define SOUND_COMMAND_QUEUE_SIZE 64
+// How many frames of the music are decoded at a time
+#define SOUND_STREAM_CHUNK 1024
+
+// Mixes the music and every effect into a single playback device. The game thread sends commands through a lock-free queue,
+// so triggering a sound (from a contact callback) never waits on the audio thread
 class Sound {
     public:
         Sound();
@@ -12,28 +29,73 @@ class Sound {
         void Bounce();
         void LoseBall();
 
+        // Milliseconds from a sound being triggered to its first samples being handed to the device (averaged), and the fraction of each callback spent mixing
+        float GetLatency() const { return averageLatency; }
+        float GetLoad() const { return load; }
+
         bool gameRunning = true;
 
     private:
-        ma_device musicDevice;
+        enum Effect : uint8_t {
+            ChargingEffect,
+            BounceEffect,
+            LoseBallEffect,
+            EffectCount
+        };
+
+        // A request from the game thread
+        struct Command {
+            enum Type : uint8_t { Start, Stop } type;
+            Effect effect;
+            bool looping;
+            std::chrono::steady_clock::time_point issued;
+        };
+
+        // An effect being played (only touched by the audio thread)
+        struct Voice {
+            int effect = -1; // -1 if the voice is free
+            uint64_t cursor = 0;
+            bool looping = false;
+            uint64_t started = 0;
+        };
+
+        void send(const Command& command);
+
+        // Audio thread
+        void mix(float* output, ma_uint32 frameCount);
+        void apply(const Command& command);
+        Voice* allocateVoice();
+        bool mixVoice(Voice& voice, float* output, ma_uint32 frameCount);
+        void mixMusic(float* output, ma_uint32 frameCount);
+
+        static void dataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+
+    private:
+        ma_device device;
+        bool deviceInitialized = false;
+
+        // The music is decoded as it plays, the short effects are decoded into memory up front
         ma_decoder musicDecoder;
-        ma_device_config musicConfig;
+        bool musicInitialized = false;
         const char* musicPath = "../sound/switch-me-on.mp3";
 
-        ma_device chargingDevice;
-        ma_decoder chargingDecoder;
-        ma_device_config chargingConfig;
-        const char* chargingPath = "../sound/mixkit-arcade-rising-231.wav";
+        std::array<std::vector<float>, EffectCount> effects;
+        const char* effectPaths[EffectCount] = {
+            "../sound/mixkit-arcade-rising-231.wav",
+            "../sound/mixkit-arcade-bonus-alert-767.wav",
+            "../sound/mixkit-retro-arcade-lose-2027.wav"
+        };
+
+        // Game thread state of the charging sound (so holding the key doesn't keep restarting it)
+        bool charging = false;
 
-        ma_device bounceDevice;
-        ma_decoder bounceDecoder;
-        ma_device_config bounceConfig;
-        const char* bouncePath = "../sound/mixkit-arcade-bonus-alert-767.wav";
+        spsc_queue<Command, SOUND_COMMAND_QUEUE_SIZE> commands;
+        std::array<Voice, SOUND_VOICES> voices;
+        uint64_t voicesStarted = 0;
+        std::array<float, SOUND_STREAM_CHUNK * SOUND_CHANNELS> streamBuffer;
 
-        ma_device loseBallDevice;
-        ma_decoder loseBallDecoder;
-        ma_device_config loseBallConfig;
-        const char* loseBallPath = "../sound/mixkit-retro-arcade-lose-2027.wav";
+        // Written by the audio thread, read by the game thread
+        std::atomic<float> averageLatency = 0, load = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,41 @@
+#ifndef SPSC_QUEUE_HPP
+#define SPSC_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Fixed size, lock-free queue with one producer thread and one consumer thread (neither side ever blocks, pushing to a full queue fails instead)
+// NOTE: One slot is always left empty to tell a full queue from an empty one, so it holds at most N - 1 elements
+template<typename T, size_t N>
+class spsc_queue {
+public:
+	// Producer: adds an element, returns false if the queue is full
+	bool push(const T& value) {
+		size_t tail = this->tail.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) % N;
+		if(next == head.load(std::memory_order_acquire)) return false;
+
+		slots[tail] = value;
+		this->tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer: removes the oldest element, returns false if the queue is empty
+	bool pop(T& out) {
+		size_t head = this->head.load(std::memory_order_relaxed);
+		if(head == tail.load(std::memory_order_acquire)) return false;
+
+		out = slots[head];
+		this->head.store((head + 1) % N, std::memory_order_release);
+		return true;
+	}
+
+protected:
+	std::array<T, N> slots;
+	// The head and tail are written by different threads, so they are kept on separate cache lines
+	alignas(64) std::atomic<size_t> head = 0;
+	alignas(64) std::atomic<size_t> tail = 0;
+};
+
+#endif // SPSC_QUEUE_HPP
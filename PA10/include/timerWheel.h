@@ -0,0 +1,85 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Each level of the wheel has 2^TIMER_WHEEL_BITS slots, and each slot of a level spans a whole turn of the level below it
+// (with 1 millisecond ticks, 4 levels of 64 slots reach ~4.6 hours, anything further out waits in the last level)
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_LEVELS 4
+
+// Hierarchical timer wheel which is advanced by the main loop's clock, so every callback runs on the main thread.
+// Timers are pooled nodes linked into their slot, so adding, cancelling, and expiring a timer are all O(1)
+class TimerWheel {
+public:
+	// Identifies a timer (stays safe to cancel after the timer has fired)
+	struct Handle {
+		uint32_t index = -1;
+		uint32_t generation = 0;
+	};
+
+	TimerWheel() { for(auto& level: slots) level.fill(NIL); }
+
+	// Calls the function once, <delay> from now
+	template<typename DurationRep, typename DurationPeriod>
+	Handle setTimeout(std::function<void()> function, std::chrono::duration<DurationRep, DurationPeriod> delay) {
+		return add(std::move(function), std::chrono::duration_cast<std::chrono::milliseconds>(delay).count(), 0);
+	}
+
+	// Calls the function every <interval> until it is cancelled
+	template<typename DurationRep, typename DurationPeriod>
+	Handle setInterval(std::function<void()> function, std::chrono::duration<DurationRep, DurationPeriod> interval) {
+		uint64_t ticks = std::max<int64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(interval).count(), 1);
+		return add(std::move(function), ticks, ticks);
+	}
+
+	// Stops a timer (returns false if it already fired or was cancelled)
+	bool cancel(Handle handle);
+	// Returns true if the timer will still fire
+	bool isPending(Handle handle) const;
+
+	// Moves the wheel forward (in milliseconds), calling every timer which expires along the way in order
+	void advance(uint64_t milliseconds);
+
+	// The number of pending timers
+	size_t size() const { return count; }
+
+protected:
+	static constexpr uint32_t NIL = -1;
+	static constexpr uint32_t SLOTS = 1 << TIMER_WHEEL_BITS;
+	static constexpr uint32_t MASK = SLOTS - 1;
+
+	struct Node {
+		std::function<void()> function;
+		uint64_t expiry = 0; // Tick the timer fires on
+		uint64_t interval = 0; // 0 if the timer only fires once
+		uint32_t previous = NIL, next = NIL; // Neighbors in the slot (or the next free node)
+		uint32_t generation = 0;
+		uint8_t level = 0, slot = 0;
+		bool linked = false; // In a slot (false while firing and once freed)
+		bool cancelled = false; // Cancelled while firing
+	};
+
+	Handle add(std::function<void()>&& function, int64_t delay, uint64_t interval);
+	// Links a node into the slot its expiry falls in (relative to the current tick)
+	void link(uint32_t index);
+	void unlink(uint32_t index);
+	void free(uint32_t index);
+	// Re-links every node in a slot of a higher level, so they spread out into the levels below
+	void cascade(uint32_t level, uint32_t slot);
+	// Fires every node in a slot of the bottom level
+	void expire(uint32_t slot);
+
+protected:
+	std::vector<Node> nodes;
+	uint32_t freeList = NIL;
+	std::array<std::array<uint32_t, SLOTS>, TIMER_WHEEL_LEVELS> slots;
+	uint64_t now = 0; // The last tick which has been processed
+	size_t count = 0;
+};
+
+#endif // TIMER_WHEEL_H
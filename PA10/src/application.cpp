@@ -7,6 +7,9 @@
 #include "camera.h"
 #include "threadTimer.h"
 
+#include <atomic>
+#include <random>
+
 Application::~Application() {
 	// Save the leaderstats when shutting down
 	if (leaderboard) {
@@ -53,8 +56,7 @@ bool Application::Initialize(const Arguments& args){
 		material.setRollingResistance(.01);
 	}
 
-	threadTimer t;
-	t.setTimeout([this]() {resetBall(); }, std::chrono::milliseconds(500));
+	getTimers().setTimeout([this]() {resetBall(); }, std::chrono::milliseconds(500));
 
 	// Lambda which bounces a ball off bumpers and increase score
 	auto bounceBallWithPoints = [ballID = ball->getCollider().getEntity().id, this](const rp3d::CollisionCallback::ContactPair& contact, Light* lightup = nullptr){
@@ -72,11 +74,11 @@ bool Application::Initialize(const Arguments& args){
 
 			getSound()->Bounce();
 
-			// Enable our light and start a timer to turn it off
+			// Enable our light and (re)start the timer which turns it off
 			if(lightup){
 				lightup->enable();
-				threadTimer t;
-				t.setTimeout([lightup](){ lightup->disable(); }, std::chrono::milliseconds(250));
+				getTimers().cancel(lightTimers[lightup]);
+				lightTimers[lightup] = getTimers().setTimeout([lightup](){ lightup->disable(); }, std::chrono::milliseconds(250));
 			}
 		}
 	};
@@ -149,7 +151,7 @@ bool Application::Initialize(const Arguments& args){
 	leftPaddle->InitializePhysics(args, *getPhysics(), true);
 	leftPaddle->addBoxCollider(glm::vec3(1.53, 1, 0.333), rp3d::Transform(rp3d::Vector3(1.125, 0, 0), rp3d::Quaternion::identity()));
 	leftPaddle->getRigidBody().setType(rp3d::BodyType::KINEMATIC);
-	getPhysics()->addContactCallback(leftPaddle, bounceBall);
+	getPhysics()->addContactCallback(ball, leftPaddle, bounceBall);
 
 	// Create right paddle
 	rightPaddle = new Object();
@@ -159,7 +161,7 @@ bool Application::Initialize(const Arguments& args){
 	rightPaddle->InitializePhysics(args, *getPhysics(), true);
 	rightPaddle->addBoxCollider(glm::vec3(1.53, 1, 0.333), rp3d::Transform(rp3d::Vector3(1.125, 0, 0), rp3d::Quaternion::identity()));
 	rightPaddle->getRigidBody().setType(rp3d::BodyType::KINEMATIC);
-	getPhysics()->addContactCallback(rightPaddle, bounceBall);
+	getPhysics()->addContactCallback(ball, rightPaddle, bounceBall);
 
 	// Create left paddle
 	plunger = new Object();
@@ -169,7 +171,7 @@ bool Application::Initialize(const Arguments& args){
 	plunger->InitializePhysics(args, *getPhysics(), true);
 	plunger->addBoxCollider(glm::vec3(1, 1, 1.3875));
 	plunger->getRigidBody().setType(rp3d::BodyType::KINEMATIC);
-	getPhysics()->addContactCallback(plunger, plungerPushReset);
+	getPhysics()->addContactCallback(ball, plunger, plungerPushReset);
 
 	leftPaddle->LoadTextureFile(args, "../textures/yellow.png");
 	rightPaddle->LoadTextureFile(args, "../textures/yellow.png");
@@ -224,7 +226,7 @@ bool Application::Initialize(const Arguments& args){
 	bottomWallCenter->setPosition(glm::vec3(1, 1, -18));
 	bottomWallCenter->InitializePhysics(args, *getPhysics(), true);
 	bottomWallCenter->addBoxCollider(glm::vec3(2, 1, 1));
-	getPhysics()->addContactCallback(bottomWallCenter, ballInDeadZone);
+	getPhysics()->addContactCallback(ball, bottomWallCenter, ballInDeadZone, ContactDispatcher::Begin);
 
 	Object* dividerWall = new Object();
 	getSceneRoot()->addChild(dividerWall);
@@ -245,49 +247,50 @@ bool Application::Initialize(const Arguments& args){
 	leftBumper->setPosition(glm::vec3(6.5, 1, -1));
 	leftBumper->InitializePhysics(args, *getPhysics(), true);
 	leftBumper->addCapsuleCollider(0.625, 2);
-	getPhysics()->addContactCallback(leftBumper, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	// Bumpers only react to the ball hitting them (not every step it stays in contact)
+	getPhysics()->addContactCallback(ball, leftBumper, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* rightBumper = new Object();
 	getSceneRoot()->addChild(rightBumper);
 	rightBumper->setPosition(glm::vec3(-4.5, 1, -1));
 	rightBumper->InitializePhysics(args, *getPhysics(), true);
 	rightBumper->addCapsuleCollider(0.625, 2);
-	getPhysics()->addContactCallback(rightBumper, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, rightBumper, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* topBumper_1 = new Object();
 	getSceneRoot()->addChild(topBumper_1);
 	topBumper_1->setPosition(glm::vec3(-4.5, 1, 5));
 	topBumper_1->InitializePhysics(args, *getPhysics(), true);
 	topBumper_1->addCapsuleCollider(0.5, 2);
-	getPhysics()->addContactCallback(topBumper_1, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, topBumper_1, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* topBumper_2 = new Object();
 	getSceneRoot()->addChild(topBumper_2);
 	topBumper_2->setPosition(glm::vec3(-5, 1, 7.084));
 	topBumper_2->InitializePhysics(args, *getPhysics(), true);
 	topBumper_2->addCapsuleCollider(0.5, 2);
-	getPhysics()->addContactCallback(topBumper_2, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, topBumper_2, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* topBumper_3 = new Object();
 	getSceneRoot()->addChild(topBumper_3);
 	topBumper_3->setPosition(glm::vec3(-4.7, 1, 9.156));
 	topBumper_3->InitializePhysics(args, *getPhysics(), true);
 	topBumper_3->addCapsuleCollider(0.5, 2);
-	getPhysics()->addContactCallback(topBumper_3, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, topBumper_3, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* topBumper_4 = new Object();
 	getSceneRoot()->addChild(topBumper_4);
 	topBumper_4->setPosition(glm::vec3(-3.598, 1, 10.91));
 	topBumper_4->InitializePhysics(args, *getPhysics(), true);
 	topBumper_4->addCapsuleCollider(0.5, 2);
-	getPhysics()->addContactCallback(topBumper_4, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, topBumper_4, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* topBumper_5 = new Object();
 	getSceneRoot()->addChild(topBumper_5);
 	topBumper_5->setPosition(glm::vec3(-1.927, 1, 12.081));
 	topBumper_5->InitializePhysics(args, *getPhysics(), true);
 	topBumper_5->addCapsuleCollider(0.5, 2);
-	getPhysics()->addContactCallback(topBumper_5, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, topBumper_5, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* wallBumper_1 = new Object();
 	getSceneRoot()->addChild(wallBumper_1);
@@ -295,7 +298,7 @@ bool Application::Initialize(const Arguments& args){
 	wallBumper_1->rotate(glm::radians(-5.21), glm::vec3(0, 1, 0));
 	wallBumper_1->InitializePhysics(args, *getPhysics(), true);
 	wallBumper_1->addBoxCollider(glm::vec3(1, 2, 0.5));
-	getPhysics()->addContactCallback(wallBumper_1, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, wallBumper_1, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* wallBumper_2 = new Object();
 	getSceneRoot()->addChild(wallBumper_2);
@@ -303,7 +306,7 @@ bool Application::Initialize(const Arguments& args){
 	wallBumper_2->rotate(glm::radians(-19.4), glm::vec3(0, 1, 0));
 	wallBumper_2->InitializePhysics(args, *getPhysics(), true);
 	wallBumper_2->addBoxCollider(glm::vec3(1, 2, 1.1));
-	getPhysics()->addContactCallback(wallBumper_2, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, wallBumper_2, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* wallBumper_3 = new Object();
 	getSceneRoot()->addChild(wallBumper_3);
@@ -311,7 +314,7 @@ bool Application::Initialize(const Arguments& args){
 	wallBumper_3->rotate(glm::radians(-32.6), glm::vec3(0, 1, 0));
 	wallBumper_3->InitializePhysics(args, *getPhysics(), true);
 	wallBumper_3->addBoxCollider(glm::vec3(1, 2, 0.5));
-	getPhysics()->addContactCallback(wallBumper_3, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, wallBumper_3, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* wallBumper_4 = new Object();
 	getSceneRoot()->addChild(wallBumper_4);
@@ -319,7 +322,7 @@ bool Application::Initialize(const Arguments& args){
 	wallBumper_4->rotate(glm::radians(-45.3), glm::vec3(0, 1, 0));
 	wallBumper_4->InitializePhysics(args, *getPhysics(), true);
 	wallBumper_4->addBoxCollider(glm::vec3(1, 2, 1.1));
-	getPhysics()->addContactCallback(wallBumper_4, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, wallBumper_4, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* wallBumper_5 = new Object();
 	getSceneRoot()->addChild(wallBumper_5);
@@ -327,7 +330,7 @@ bool Application::Initialize(const Arguments& args){
 	wallBumper_5->rotate(glm::radians(-58.1), glm::vec3(0, 1, 0));
 	wallBumper_5->InitializePhysics(args, *getPhysics(), true);
 	wallBumper_5->addBoxCollider(glm::vec3(1, 2, 0.5));
-	getPhysics()->addContactCallback(wallBumper_5, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, wallBumper_5, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* wallGuard = new Object();
 	getSceneRoot()->addChild(wallGuard);
@@ -431,13 +434,13 @@ bool Application::Initialize(const Arguments& args){
 	getSceneRoot()->addChild(guardBumperLeft);
 	guardBumperLeft->InitializePhysics(args, *getPhysics(), true);
 	guardBumperLeft->addMeshCollider(args, false, rp3d::Transform(), "guardBumperLeft.obj");
-	getPhysics()->addContactCallback(guardBumperLeft, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, guardBumperLeft, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* guardBumperRight = new Object();
 	getSceneRoot()->addChild(guardBumperRight);
 	guardBumperRight->InitializePhysics(args, *getPhysics(), true);
 	guardBumperRight->addMeshCollider(args, false, rp3d::Transform(), "guardBumperRight.obj");
-	getPhysics()->addContactCallback(guardBumperRight, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight));
+	getPhysics()->addContactCallback(ball, guardBumperRight, std::bind(bounceBallWithPoints, std::placeholders::_1, bumperLight), ContactDispatcher::Begin);
 
 	Object* topArc = new Object();
 	getSceneRoot()->addChild(topArc);
@@ -569,6 +572,136 @@ void Application::KeyboardCallback(const SDL_KeyboardEvent& event){
 		getSound()->SetCharging(true);
 	} else if(event.keysym.sym == SDLK_r && event.type == SDL_KEYUP)
 		resetBall();
+	// F11 benchmarks the contact dispatch
+	else if(event.keysym.sym == SDLK_F11 && event.type == SDL_KEYUP)
+		runContactBenchmark();
+	// F12 benchmarks the timers
+	else if(event.keysym.sym == SDLK_F12 && event.type == SDL_KEYUP)
+		runTimerBenchmark();
+}
+
+void Application::runContactBenchmark() {
+	using ContactPair = rp3d::CollisionCallback::ContactPair;
+
+	// How contacts used to be dispatched: every listener checked (and copied) for every contact pair
+	struct LinearListener : public rp3d::EventListener {
+		std::map<uint32_t, Physics::ContactEvent> contactEvents;
+		std::chrono::steady_clock::duration elapsed{};
+
+		void onContact(const rp3d::CollisionCallback::CallbackData& callbackData) override {
+			auto start = std::chrono::steady_clock::now();
+			for(uint32_t i = 0; i < callbackData.getNbContactPairs(); i++)
+				if(callbackData.getContactPair(i).getNbContactPoints() > 0)
+					for(auto idEvent: contactEvents)
+						if(callbackData.getContactPair(i).getCollider1()->getEntity().id == idEvent.first || callbackData.getContactPair(i).getCollider2()->getEntity().id == idEvent.first)
+							idEvent.second(callbackData.getContactPair(i));
+			elapsed += std::chrono::steady_clock::now() - start;
+		}
+	};
+
+	struct IndexedListener : public rp3d::EventListener {
+		ContactDispatcher contactDispatcher;
+		std::chrono::steady_clock::duration elapsed{};
+
+		void onContact(const rp3d::CollisionCallback::CallbackData& callbackData) override {
+			auto start = std::chrono::steady_clock::now();
+			contactDispatcher.dispatch(callbackData);
+			elapsed += std::chrono::steady_clock::now() - start;
+		}
+	};
+
+	// Fills a walled table with balls (each with a listener, like a multiball game) and simulates it, returning how many events were fired
+	rp3d::PhysicsCommon& factory = getPhysics()->getFactory();
+	auto simulate = [&factory](rp3d::EventListener& listener, std::function<void(rp3d::Collider&, Physics::ContactEvent)> addListener) {
+		rp3d::PhysicsWorld::WorldSettings settings;
+		settings.gravity = rp3d::Vector3(0, -2.0 / sqrt(5), -1.0 / sqrt(5)) * 9.81;
+		settings.isSleepingEnabled = false;
+		rp3d::PhysicsWorld* world = factory.createPhysicsWorld(settings);
+		world->setEventListener(&listener);
+
+		size_t side = std::ceil(std::sqrt(CONTACT_BENCHMARK_BALLS));
+		float halfWidth = side * .5f + 1;
+		rp3d::BoxShape* floorShape = factory.createBoxShape(rp3d::Vector3(halfWidth, 1, halfWidth));
+		rp3d::BoxShape* wallShape = factory.createBoxShape(rp3d::Vector3(halfWidth, 2, 1));
+		rp3d::SphereShape* ballShape = factory.createSphereShape(.5);
+
+		rp3d::RigidBody* table = world->createRigidBody(rp3d::Transform::identity());
+		table->setType(rp3d::BodyType::STATIC);
+		table->addCollider(floorShape, rp3d::Transform(rp3d::Vector3(0, -1, 0), rp3d::Quaternion::identity()));
+		for(int i = 0; i < 4; i++) {
+			rp3d::Quaternion orientation = rp3d::Quaternion::fromEulerAngles(0, i * glm::half_pi<float>(), 0);
+			table->addCollider(wallShape, rp3d::Transform(orientation * rp3d::Vector3(0, 2, halfWidth), orientation));
+		}
+
+		size_t fired = 0;
+		for(size_t i = 0; i < CONTACT_BENCHMARK_BALLS; i++) {
+			rp3d::RigidBody* ball = world->createRigidBody(rp3d::Transform(rp3d::Vector3(i % side + .5f - side * .5f, .5f + i % 3, i / side + .5f - side * .5f), rp3d::Quaternion::identity()));
+			addListener(*ball->addCollider(ballShape, rp3d::Transform::identity()), [&fired](const ContactPair&) { fired++; });
+		}
+
+		for(size_t step = 0; step < CONTACT_BENCHMARK_STEPS; step++)
+			world->update(1 / 60.0);
+
+		factory.destroyPhysicsWorld(world);
+		factory.destroyBoxShape(floorShape);
+		factory.destroyBoxShape(wallShape);
+		factory.destroySphereShape(ballShape);
+		return fired;
+	};
+	auto milliseconds = [](std::chrono::steady_clock::duration elapsed) { return std::chrono::duration<double, std::milli>(elapsed).count(); };
+
+	LinearListener linear;
+	size_t linearFired = simulate(linear, [&linear](rp3d::Collider& collider, Physics::ContactEvent event) { linear.contactEvents[collider.getEntity().id] = event; });
+	IndexedListener indexed;
+	size_t indexedFired = simulate(indexed, [&indexed](rp3d::Collider& collider, Physics::ContactEvent event) { indexed.contactDispatcher.add(collider, event); });
+	IndexedListener began;
+	size_t beganFired = simulate(began, [&began](rp3d::Collider& collider, Physics::ContactEvent event) { began.contactDispatcher.add(collider, event, ContactDispatcher::Begin); });
+
+	std::cout << "Contact dispatch (" << CONTACT_BENCHMARK_BALLS << " balls, " << CONTACT_BENCHMARK_STEPS << " steps):" << std::endl
+		<< "\tLinear: " << milliseconds(linear.elapsed) << "ms (" << linearFired << " events)" << std::endl
+		<< "\tIndexed: " << milliseconds(indexed.elapsed) << "ms (" << indexedFired << " events)" << std::endl
+		<< "\tIndexed, only when contacts begin: " << milliseconds(began.elapsed) << "ms (" << beganFired << " events)" << std::endl;
+}
+
+void Application::runTimerBenchmark() {
+	using clock = std::chrono::steady_clock;
+	auto nanosecondsPer = [](clock::duration elapsed, size_t count) { return std::chrono::duration<double, std::nano>(elapsed).count() / count; };
+	std::mt19937 random;
+
+	// Timer wheel: add timeouts spread over the next few seconds, cancel some of them, then run frames until every timer has fired
+	TimerWheel wheel;
+	std::vector<TimerWheel::Handle> handles;
+	handles.reserve(TIMER_BENCHMARK_TIMERS);
+	size_t fired = 0;
+
+	auto start = clock::now();
+	for(size_t i = 0; i < TIMER_BENCHMARK_TIMERS; i++)
+		handles.push_back(wheel.setTimeout([&fired]() { fired++; }, std::chrono::milliseconds(random() % TIMER_BENCHMARK_SPREAD)));
+	auto added = clock::now();
+	for(size_t i = 0; i < handles.size(); i += 4)
+		wheel.cancel(handles[i]);
+	auto cancelled = clock::now();
+	while(wheel.size())
+		wheel.advance(16);
+	auto expired = clock::now();
+
+	std::cout << "Timer wheel (" << TIMER_BENCHMARK_TIMERS << " timeouts): "
+		<< nanosecondsPer(added - start, TIMER_BENCHMARK_TIMERS) << "ns per add, "
+		<< nanosecondsPer(cancelled - added, (handles.size() + 3) / 4) << "ns per cancel, "
+		<< nanosecondsPer(expired - cancelled, fired) << "ns per expiry" << std::endl;
+
+	// Thread timers (what the timers used to be): every timeout starts and joins a thread of its own
+	std::atomic<size_t> threadFired = 0;
+	std::vector<threadTimer> threadTimers(TIMER_BENCHMARK_THREAD_TIMERS);
+	start = clock::now();
+	for(auto& timer: threadTimers)
+		timer.setTimeout([&threadFired]() { threadFired++; }, std::chrono::milliseconds(0));
+	for(auto& timer: threadTimers)
+		timer.wait();
+	expired = clock::now();
+
+	std::cout << "Thread timers (" << TIMER_BENCHMARK_THREAD_TIMERS << " timeouts): "
+		<< nanosecondsPer(expired - start, threadFired) << "ns per timeout" << std::endl;
 }
 
 void Application::resetBall() {
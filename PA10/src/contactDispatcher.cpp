@@ -0,0 +1,45 @@
+#include "contactDispatcher.h"
+
+void ContactDispatcher::add(const rp3d::Collider& collider, Event event, uint8_t types) {
+	colliderListeners[collider.getEntity().id].push_back({std::move(event), types});
+}
+
+void ContactDispatcher::add(const rp3d::Collider& a, const rp3d::Collider& b, Event event, uint8_t types) {
+	pairListeners[pairKey(a.getEntity().id, b.getEntity().id)].push_back({std::move(event), types});
+}
+
+void ContactDispatcher::remove(const rp3d::Collider& collider) {
+	colliderListeners.erase(collider.getEntity().id);
+}
+
+void ContactDispatcher::remove(const rp3d::Collider& a, const rp3d::Collider& b) {
+	pairListeners.erase(pairKey(a.getEntity().id, b.getEntity().id));
+}
+
+void ContactDispatcher::dispatch(const rp3d::CollisionCallback::CallbackData& callbackData) const {
+	for(uint32_t i = 0; i < callbackData.getNbContactPairs(); i++) {
+		rp3d::CollisionCallback::ContactPair pair = callbackData.getContactPair(i);
+
+		uint8_t type;
+		switch(pair.getEventType()) {
+		case rp3d::CollisionCallback::ContactPair::EventType::ContactStart: type = Begin; break;
+		case rp3d::CollisionCallback::ContactPair::EventType::ContactStay: type = Stay; break;
+		default: type = End; break;
+		}
+		// Touching contacts without any points have nothing for the listeners to use
+		if(type != End && pair.getNbContactPoints() == 0) continue;
+
+		uint32_t id1 = pair.getCollider1()->getEntity().id, id2 = pair.getCollider2()->getEntity().id;
+		call(colliderListeners.find(id1), type, pair);
+		call(colliderListeners.find(id2), type, pair);
+		call(pairListeners.find(pairKey(id1, id2)), type, pair);
+	}
+}
+
+void ContactDispatcher::call(const Listeners* listeners, uint8_t type, const rp3d::CollisionCallback::ContactPair& pair) {
+	if(!listeners) return;
+
+	for(const Listener& listener: *listeners)
+		if(listener.types & type)
+			listener.event(pair);
+}
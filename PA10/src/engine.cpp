@@ -102,6 +102,9 @@ void Engine::Run() {
 				mouseWheelEvent(m_event.wheel);
 		}
 
+		// Fire any timers which expired this frame
+		m_timers.advance(m_DT);
+
 		// Run application specific code
 		Update(getDTMilli());
 
@@ -101,18 +101,23 @@ void GUI::Render(){
 		if(ImGui::BeginMenu("Leaderboard")) {
 
 			ImGui::TextColored(ImVec4(.9,.9,1,1), "Leaderboard");
-			if (ImGui::BeginTable("", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			if (ImGui::BeginTable("", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
 				ImGui::TableNextRow();
 					ImGui::TableSetColumnIndex(0);
-					ImGui::TableHeader("Player");
+					ImGui::TableHeader("Rank");
 					ImGui::TableSetColumnIndex(1);
+					ImGui::TableHeader("Player");
+					ImGui::TableSetColumnIndex(2);
 					ImGui::TableHeader("Score");
-				for (std::pair<string, float> stat: app->leaderboard->leaderstats) {
+				size_t rank = 1;
+				for (const Leaderboard::Entry& entry: app->leaderboard->getTop(LEADERBOARD_DISPLAY_COUNT)) {
 					ImGui::TableNextRow();
 						ImGui::TableSetColumnIndex(0);
-						ImGui::Text(stat.first.c_str());
+						ImGui::Text("%zu", rank++);
 						ImGui::TableSetColumnIndex(1);
-						ImGui::Text(to_string(stat.second).c_str());
+						ImGui::TextUnformatted(entry.name.c_str());
+						ImGui::TableSetColumnIndex(2);
+						ImGui::Text("%.0f", entry.score);
 				}
 
 				ImGui::EndTable();
@@ -1,9 +1,10 @@
 #include "leaderboard.h"
 #include "arguments.h"
 
-#include <vector>
-
-#include <sstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
 
 Leaderboard::Leaderboard() {
 
@@ -13,81 +14,315 @@ Leaderboard::~Leaderboard() {
 
 }
 
-bool Leaderboard::Initialize(const Arguments& args, const string &filename) {
-    //std::cout << "Loading leaderleaderstats from " << filename << std::endl;
+bool Leaderboard::Initialize(const Arguments& args, const std::string &filename) {
     //std::string leaderboardDirectory = args.getResourcePath() + "models/";
-    filepath = filename;
-    vector<string> tokens;
-
-    // Load data from file
-    ifstream file(filename.c_str());
-    if (file.good()) { 
-        string line;
-        if (file.is_open()) {
-            while(getline(file, line)) {
-                istringstream ssLine(line);
-                string token;
-                while(getline(ssLine, token, ',')) {
-                    tokens.push_back(token);
-                }
-            }
-            file.close();
+    open(filename);
+    std::cout << "Loaded " << size() << " players from " << filename << std::endl;
+    return true;
+}
+
+bool Leaderboard::AddPlayer(const std::string& userId) {
+    // Check if the name is valid and the player doesn't already exist
+    if (!validName(userId) || find(userId) != NIL)
+        return false;
+
+    // Add player to the board
+    set(userId, 0);
+    log(userId, 0);
+    return true;
+}
+
+void Leaderboard::UpdateScore(const std::string& userId, float score) {
+    // Update the players score if its a valid name
+    if (!validName(userId))
+        return;
+
+    set(userId, score);
+    log(userId, score);
+}
+
+void Leaderboard::Save() {
+    if (logRecords > size())
+        compact();
+    else logFile.flush();
+}
+
+bool Leaderboard::getScore(const std::string& userId, float& score) const {
+    uint32_t node = find(userId);
+    if (node == NIL)
+        return false;
+
+    score = nodes[node].score;
+    return true;
+}
+
+size_t Leaderboard::getRank(const std::string& userId) const {
+    uint32_t node = find(userId);
+    if (node == NIL)
+        return -1;
+
+    // Walk down to the player, counting everyone ranked before them along the way
+    size_t rank = 0;
+    for (uint32_t current = root; current != node; )
+        if (before(node, current))
+            current = nodes[current].left;
+        else {
+            rank += sizeOf(nodes[current].left) + 1;
+            current = nodes[current].right;
+        }
+    return rank + sizeOf(nodes[node].left);
+}
+
+Leaderboard::Entry Leaderboard::getEntry(size_t rank) const {
+    uint32_t current = root;
+    while (current != NIL) {
+        size_t leftSize = sizeOf(nodes[current].left);
+        if (rank < leftSize)
+            current = nodes[current].left;
+        else if (rank == leftSize)
+            return {nodes[current].name, nodes[current].score};
+        else {
+            rank -= leftSize + 1;
+            current = nodes[current].right;
         }
     }
+    return {"", 0};
+}
+
+std::vector<Leaderboard::Entry> Leaderboard::getTop(size_t k) const {
+    std::vector<Entry> top;
+    top.reserve(std::min(k, size()));
+    forEachInOrder(k, [&](const Node& node) { top.push_back({node.name, node.score}); });
+    return top;
+}
+
+void Leaderboard::open(const std::string& path) {
+    filepath = path;
+    load(path);
+    logFile.open(path, std::ios::app);
+
+    // If the board was last closed without saving, the log might already be due for compaction
+    if (logRecords >= LEADERBOARD_COMPACT_RATIO * size() + LEADERBOARD_COMPACT_SLACK)
+        compact();
+}
+
+void Leaderboard::load(const std::string& path) {
+    nodes.clear();
+    index.clear();
+    root = NIL;
+    logRecords = 0;
+
+    // Read the whole log at once
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return;
+    std::string data((size_t) file.tellg(), '\0');
+    file.seekg(0);
+    file.read(data.data(), data.size());
+
+    // Replay every name,score record (later records replace earlier ones), the ranking is built once they have all been read
+    reserve(std::count(data.begin(), data.end(), '\n') + 1);
+    for (size_t start = 0; start < data.size(); ) {
+        size_t end = data.find('\n', start);
+        if (end == std::string::npos) end = data.size();
+
+        size_t comma = data.rfind(',', end);
+        if (comma != std::string::npos && comma > start) {
+            std::string_view name(data.data() + start, comma - start);
+            float score = std::strtof(data.c_str() + comma + 1, nullptr);
 
-    for(int i = 0; i < tokens.size(); i+=2) {
-        std::cout << tokens[i] << ", " << tokens[i+1] << endl;
-        UpdateScore(tokens[i], stof(tokens[i+1]));
+            uint32_t node = find(name);
+            if (node == NIL)
+                add(name, score);
+            else nodes[node].score = score;
+            logRecords++;
+        }
+        start = end + 1;
     }
-    return true;
+
+    build();
 }
 
-bool Leaderboard::AddPlayer(const string& userId) {
-    // Check if player already exists
-    if (leaderstats.find(userId) != leaderstats.end())
-        return false; 
-    
-    // Add player to dictionary
-    leaderstats.insert(pair<string, float>(userId, 0));
-    return true;
+void Leaderboard::set(const std::string& userId, float score) {
+    uint32_t node = find(userId);
+    if (node == NIL) {
+        node = add(userId, score);
+    } else {
+        // Take the player out of the ranking while their score changes
+        root = erase(root, node);
+        nodes[node].score = score;
+        nodes[node].left = nodes[node].right = NIL;
+        nodes[node].size = 1;
+    }
+    root = insert(root, node);
 }
 
-void Leaderboard::UpdateScore(const string& userId, float score) {
-    // Update the players score if its a valid name
-    if (userId != "") {
-        if (leaderstats.find(userId) == leaderstats.end())
-            leaderstats.insert(pair<string, float>(userId, score));
-        else
-            leaderstats[userId] = score;
+uint32_t Leaderboard::find(std::string_view userId) const {
+    if (index.empty())
+        return NIL;
+
+    size_t mask = index.size() - 1;
+    for (size_t slot = hashOf(userId) & mask; index[slot] != NIL; slot = (slot + 1) & mask)
+        if (nodes[index[slot]].name == userId)
+            return index[slot];
+    return NIL;
+}
+
+uint32_t Leaderboard::add(std::string_view userId, float score) {
+    // Keep the index at most half full
+    if ((nodes.size() + 1) * 2 > index.size())
+        reserve(nodes.size() + 1);
+
+    uint32_t node = nodes.size();
+    nodes.push_back({std::string(userId), score, (uint32_t) random(), hashOf(userId)});
+
+    size_t mask = index.size() - 1, slot = nodes[node].hash & mask;
+    while (index[slot] != NIL)
+        slot = (slot + 1) & mask;
+    index[slot] = node;
+    return node;
+}
+
+void Leaderboard::reserve(size_t players) {
+    nodes.reserve(players);
+
+    size_t capacity = 16;
+    while (capacity < players * 2)
+        capacity *= 2;
+    if (capacity <= index.size())
+        return;
+
+    index.assign(capacity, NIL);
+    size_t mask = capacity - 1;
+    for (uint32_t node = 0; node < nodes.size(); node++) {
+        size_t slot = nodes[node].hash & mask;
+        while (index[slot] != NIL)
+            slot = (slot + 1) & mask;
+        index[slot] = node;
     }
-    sort();
 }
 
-void Leaderboard::Save() {
-    ofstream file(filepath);
-    for (auto const& element : leaderstats) {
-        file << element.first << "," << to_string(element.second) << endl;
+void Leaderboard::log(const std::string& userId, float score) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", score);
+    logFile << userId << "," << buffer << "\n";
+    logFile.flush();
+
+    if (++logRecords >= LEADERBOARD_COMPACT_RATIO * size() + LEADERBOARD_COMPACT_SLACK)
+        compact();
+}
+
+void Leaderboard::compact() {
+    // Write the board (best first) next to the log, then swap it in so a crash part way through never loses the log
+    std::string temporary = filepath + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        char buffer[32];
+        forEachInOrder(size(), [&](const Node& node) {
+            std::snprintf(buffer, sizeof(buffer), "%.9g", node.score);
+            file << node.name << "," << buffer << "\n";
+        });
+        if (!file)
+            return;
+    }
+
+    logFile.close();
+    std::rename(temporary.c_str(), filepath.c_str());
+    logFile.open(filepath, std::ios::app);
+    logRecords = size();
+}
+
+void Leaderboard::split(uint32_t subtree, uint32_t key, uint32_t& left, uint32_t& right) {
+    if (subtree == NIL) {
+        left = right = NIL;
+        return;
+    }
+
+    if (before(subtree, key)) {
+        split(nodes[subtree].right, key, nodes[subtree].right, right);
+        left = subtree;
+    } else {
+        split(nodes[subtree].left, key, left, nodes[subtree].left);
+        right = subtree;
     }
-    //file << "write this to file";
-    file.close();
+    update(subtree);
 }
 
-bool compare(pair<string, float>& a, pair<string, float>& b) {
-    return a.second < b.second;
+uint32_t Leaderboard::merge(uint32_t left, uint32_t right) {
+    if (left == NIL) return right;
+    if (right == NIL) return left;
+
+    // The higher priority node becomes the root
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    update(right);
+    return right;
 }
 
-void Leaderboard::sort()
-{
-    // Sort the leaderboard
-    vector<pair<string, float>> items;
-    for (auto& it : leaderstats) {
-        items.push_back(it);
+uint32_t Leaderboard::insert(uint32_t subtree, uint32_t node) {
+    if (subtree == NIL)
+        return node;
+
+    // The node goes where its priority places it, taking the nodes around it as its children
+    if (nodes[node].priority > nodes[subtree].priority) {
+        split(subtree, node, nodes[node].left, nodes[node].right);
+        update(node);
+        return node;
     }
 
-    std::sort(items.begin(), items.end(), compare);
+    if (before(node, subtree))
+        nodes[subtree].left = insert(nodes[subtree].left, node);
+    else nodes[subtree].right = insert(nodes[subtree].right, node);
+    update(subtree);
+    return subtree;
+}
+
+uint32_t Leaderboard::erase(uint32_t subtree, uint32_t node) {
+    if (subtree == node)
+        return merge(nodes[node].left, nodes[node].right);
+
+    if (before(node, subtree))
+        nodes[subtree].left = erase(nodes[subtree].left, node);
+    else nodes[subtree].right = erase(nodes[subtree].right, node);
+    update(subtree);
+    return subtree;
+}
 
-    leaderstats.clear();
-    for (auto& it : items) {
-        leaderstats.insert(it);
+void Leaderboard::build() {
+    // Sort copies of the scores (so sorting never has to touch the nodes)
+    std::vector<std::pair<float, uint32_t>> order(nodes.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = {nodes[i].score, i};
+        nodes[i].left = nodes[i].right = NIL;
     }
-}
\ No newline at end of file
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+
+    // Add the nodes in rank order along the right edge of the tree, lower priority nodes along it become the left child of the new node
+    std::vector<uint32_t> edge;
+    for (auto [score, node] : order) {
+        uint32_t last = NIL;
+        while (!edge.empty() && nodes[edge.back()].priority < nodes[node].priority) {
+            last = edge.back();
+            edge.pop_back();
+        }
+        nodes[node].left = last;
+        if (!edge.empty())
+            nodes[edge.back()].right = node;
+        edge.push_back(node);
+    }
+
+    root = edge.empty() ? NIL : edge.front();
+    updateSizes(root);
+}
+
+uint32_t Leaderboard::updateSizes(uint32_t subtree) {
+    if (subtree == NIL)
+        return 0;
+
+    nodes[subtree].size = 1 + updateSizes(nodes[subtree].left) + updateSizes(nodes[subtree].right);
+    return nodes[subtree].size;
+}
@@ -122,8 +122,9 @@ bool Object::addMeshCollider(const Arguments& args, bool makeConvex /*= true*/,
 	if (makeConvex) {
 		// store vertex positions temporarily
 		std::vector<quickhull::Vector3<float>> positions;
-		for(Vertex& vert: Vertices) {
-			positions.push_back(quickhull::Vector3<float>(vert.vertex.x, vert.vertex.y, vert.vertex.z));
+		const Vertex* vertices = getVertexData();
+		for(size_t vert = 0; vert < getVertexCount(); vert++) {
+			positions.push_back(quickhull::Vector3<float>(vertices[vert].vertex.x, vertices[vert].vertex.y, vertices[vert].vertex.z));
 		}
 
 		// create hull concave with position data
@@ -154,74 +155,87 @@ bool Object::addMeshCollider(const Arguments& args, bool makeConvex /*= true*/,
 			std::string modelDirectory = args.getResourcePath() + "models/";
 			if(path.find(modelDirectory) == std::string::npos)
 				path = modelDirectory + path;
-			//std::cout << path << std::endl;
-			// Load the model
-			Assimp::Importer importer;
-			const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
-
-			// Error handling
-			if(scene == nullptr){
-				std::cerr << "Failed to import model `" << path << "`: ";
-				std::cerr << importer.GetErrorString() << std::endl;
-				return false;
-			}
 
-			// For each mesh...
-			for(int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++){
+			std::vector<glm::vec3> tempVertices = std::vector<glm::vec3>();
+			std::vector<int> tempIndices = std::vector<int>();
+
+			// If the model has been cooked, merge its submeshes into the collision mesh
+			if(MeshBlob::ptr blob = MeshBlob::open(args, path)) {
+				for(size_t submesh = 0; submesh < blob->getSubmeshCount(); submesh++){
+					int base = tempVertices.size();
+					const Vertex* vertices = blob->getVertices(submesh);
+					for(size_t vert = 0; vert < blob->getVertexCount(submesh); vert++)
+						tempVertices.push_back(vertices[vert].vertex);
+					const unsigned int* indices = blob->getIndices(submesh);
+					for(size_t index = 0; index < blob->getIndexCount(submesh); index++)
+						tempIndices.push_back(base + indices[index]);
+				}
+
+			// Otherwise import it
+			} else {
+				// Load the model
+				Assimp::Importer importer;
+				const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+
+				// Error handling
+				if(scene == nullptr){
+					std::cerr << "Failed to import model `" << path << "`: ";
+					std::cerr << importer.GetErrorString() << std::endl;
+					return false;
+				}
 
-				std::vector<glm::vec3> tempVertices = std::vector<glm::vec3>();
-				std::vector<int> tempIndices = std::vector<int>();
+				// For each mesh...
+				for(int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++){
+					// Extract this mesh from the scene
+					const aiMesh* mesh = scene->mMeshes[meshIndex];
+					int base = tempVertices.size();
 
-				// Extract this mesh from the scene
-				const aiMesh* mesh = scene->mMeshes[meshIndex];
+					// For each vertex...
+					for(int vert = 0; vert < mesh->mNumVertices; vert++){
 
-				// For each vertex...
-				for(int vert = 0; vert < mesh->mNumVertices; vert++){
+						// Extract the position
+						auto _pos = mesh->mVertices[vert];
 
-					// Extract the position
-					auto _pos = mesh->mVertices[vert];
+						// Add the vertex to the list of vertecies
+						tempVertices.emplace_back(/*position*/ glm::vec3(_pos.x, _pos.y, _pos.z));
+					}
 
-					// Add the vertex to the list of vertecies
-					tempVertices.emplace_back(/*position*/ glm::vec3(_pos.x, _pos.y, _pos.z));
-				}
-				
-				// For each face...
-				for(int face = 0; face < mesh->mNumFaces; face++)
-					// For each index in the face (3 in the triangles)
-					for(int index = 0; index < 3; index++)
-						// Add the index to the list of indices
-						tempIndices.push_back(mesh->mFaces[face].mIndices[index]);
-
-				// store the concave mesh using the exact model data
-				collisionMesh.numVertices = tempVertices.size();
-				collisionMesh.vertexData = new float[collisionMesh.numVertices * 3];
-				int i = 0;
-				for(glm::vec3& vert: tempVertices) {
-					collisionMesh.vertexData[i] = vert.x;
-					collisionMesh.vertexData[i + 1] = vert.y;
-					collisionMesh.vertexData[i + 2] = vert.z;
-					i += 3;
+					// For each face...
+					for(int face = 0; face < mesh->mNumFaces; face++)
+						// For each index in the face (3 in the triangles, offset past the meshes before this one)
+						for(int index = 0; index < 3; index++)
+							// Add the index to the list of indices
+							tempIndices.push_back(base + mesh->mFaces[face].mIndices[index]);
 				}
-				collisionMesh.indiceData = new int[tempIndices.size()];
-				for(int i = 0; i < tempIndices.size(); ++i)
-					collisionMesh.indiceData[i] = tempIndices[i];
-
-				//std::cout << tempVertices.size() << " " << tempIndices.size() << std::endl;
 			}
-		} else { // if not convex and mesh from file
+
 			// store the concave mesh using the exact model data
-			collisionMesh.numVertices = Vertices.size();
+			collisionMesh.numVertices = tempVertices.size();
 			collisionMesh.vertexData = new float[collisionMesh.numVertices * 3];
 			int i = 0;
-			for(Vertex& vert: Vertices) {
-				collisionMesh.vertexData[i] = vert.vertex.x;
-				collisionMesh.vertexData[i + 1] = vert.vertex.y;
-				collisionMesh.vertexData[i + 2] = vert.vertex.z;
+			for(glm::vec3& vert: tempVertices) {
+				collisionMesh.vertexData[i] = vert.x;
+				collisionMesh.vertexData[i + 1] = vert.y;
+				collisionMesh.vertexData[i + 2] = vert.z;
 				i += 3;
 			}
-			collisionMesh.indiceData = new int[Indices.size()];
-			for(int i = 0; i < Indices.size(); ++i)
-				collisionMesh.indiceData[i] = Indices[i];
+			collisionMesh.indiceData = new int[tempIndices.size()];
+			for(int i = 0; i < tempIndices.size(); ++i)
+				collisionMesh.indiceData[i] = tempIndices[i];
+		} else { // if not convex and mesh from file
+			// store the concave mesh using the exact model data
+			collisionMesh.numVertices = getVertexCount();
+			collisionMesh.vertexData = new float[collisionMesh.numVertices * 3];
+			const Vertex* vertices = getVertexData();
+			for(int i = 0; i < collisionMesh.numVertices; i++) {
+				collisionMesh.vertexData[i * 3] = vertices[i].vertex.x;
+				collisionMesh.vertexData[i * 3 + 1] = vertices[i].vertex.y;
+				collisionMesh.vertexData[i * 3 + 2] = vertices[i].vertex.z;
+			}
+			const unsigned int* indices = getIndexData();
+			collisionMesh.indiceData = new int[getIndexCount()];
+			for(int i = 0; i < getIndexCount(); ++i)
+				collisionMesh.indiceData[i] = indices[i];
 		}
 	}
 
@@ -249,6 +263,11 @@ bool Object::addMeshCollider(const Arguments& args, bool makeConvex /*= true*/,
 }
 
 bool Object::LoadModelFile(const Arguments& args, const std::string& path, glm::mat4 onImportTransformation){
+	// Use the cooked version of the model if there is one (models are always cooked untransformed)
+	if(onImportTransformation == glm::mat4(1))
+		if(MeshBlob::ptr blob = MeshBlob::open(args, path))
+			return LoadCookedModel(args, blob);
+
 	// Load the model
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
@@ -273,64 +292,49 @@ bool Object::LoadModelFile(const Arguments& args, const std::string& path, glm::
 		// Remove a previous model
 		obj->Vertices.clear();
 		obj->Indices.clear();
+		obj->meshBlob = nullptr;
 
 		// Extract this mesh from the scene
 		const aiMesh* mesh = scene->mMeshes[meshIndex];
 
-		// If the mesh has a material...
-		if(mesh->mMaterialIndex > 0){
-			// Extract the material from the scene
-			const aiMaterial* mat = scene->mMaterials[mesh->mMaterialIndex];
-			// Extract the path to the diffuse texture
-			aiString _path;
-			mat->GetTexture(aiTextureType_DIFFUSE, 0, &_path);
-
-			if(_path.length > 0)
-				if( !obj->LoadTextureFile(args, std::string(_path.C_Str())) )
-					return false;
-
-		}
+		// Load the diffuse texture of the mesh's material (if it has one)
+		std::string texture = MeshBlob::diffuseTexture(scene, mesh);
+		if(texture.length() > 0)
+			if( !obj->LoadTextureFile(args, texture) )
+				return false;
 
-		// For each vertex...
-		for(int vert = 0; vert < mesh->mNumVertices; vert++){
+		// Extract the vertices and indices
+		MeshBlob::convert(mesh, onImportTransformation, obj->Vertices, obj->Indices);
 
-			// Extract the position
-			auto _pos = mesh->mVertices[vert];
-			// Apply an input transformation (defaults to the identity matrix)
-			glm::vec4 pos(_pos.x, _pos.y, _pos.z, 1);
-			pos = onImportTransformation * pos;
+		// Upload the model to the GPU
+		obj->FinalizeModel();
+	}
 
-			// Extract the (first) vertex color if it exists
-			glm::vec3 color(1, 1, 1); // White by default
-			if(mesh->HasVertexColors(0)){
-				auto col = mesh->mColors[0][vert];
-				color = glm::vec3(col.r, col.g, col.b);
-			}
+	return true;
+}
 
-			// Extract the (first) texture coordinates if they exist
-			glm::vec2 uv(0, 0); // 0,0 by default
-			if(mesh->HasTextureCoords(0)){
-				auto tex = mesh->mTextureCoords[0][vert];
-				uv = glm::vec2(tex.x, -tex.y);
-			}
+bool Object::LoadCookedModel(const Arguments& args, MeshBlob::ptr blob){
+	// For each submesh...
+	for(size_t submesh = 0; submesh < blob->getSubmeshCount(); submesh++){
+		// First submesh is put in this object, future submeshes are added as sub-object
+		Object* obj;
+		if(submesh == 0) obj = this;
+		else{
+			obj = new Submesh(); // Submesh's model matrix are linked to their parent
+			obj->setParent(this);
+		}
 
-			// Extract the (first) texture coordinates if they exist
-			glm::vec3 normal(0, 0, 0); // 0,0,0 by default
-			if(mesh->HasNormals()){
-				auto tex = mesh->mNormals[vert];
-				normal = glm::vec3(tex.x, tex.y, tex.z);
-			}
+		// The model data is read straight out of the cooked model
+		obj->Vertices.clear();
+		obj->Indices.clear();
+		obj->meshBlob = blob;
+		obj->meshBlobSubmesh = submesh;
 
-			// Add the vertex to the list of vertecies
-			obj->Vertices.emplace_back(/*position*/ glm::vec3(pos.x, pos.y, pos.z), color, uv, normal);
-		}
-		
-		// For each face...
-		for(int face = 0; face < mesh->mNumFaces; face++)
-			// For each index in the face (3 in the triangles)
-			for(int index = 0; index < 3; index++)
-				// Add the index to the list of indices
-				obj->Indices.push_back(mesh->mFaces[face].mIndices[index]);
+		// Load the diffuse texture of the submesh's material (if it has one)
+		std::string texture = blob->getTexture(submesh);
+		if(texture.length() > 0)
+			if( !obj->LoadTextureFile(args, texture) )
+				return false;
 
 		// Upload the model to the GPU
 		obj->FinalizeModel();
@@ -343,11 +347,11 @@ bool Object::LoadModelFile(const Arguments& args, const std::string& path, glm::
 void Object::FinalizeModel() {
 	// Add the data to the vertex buffer
 	glBindBuffer(GL_ARRAY_BUFFER, VB);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * Vertices.size(), &Vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * getVertexCount(), getVertexData(), GL_STATIC_DRAW);
 
 	// Add the data to the face buffer
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * Indices.size(), &Indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * getIndexCount(), getIndexData(), GL_STATIC_DRAW);
 }
 
 bool Object::LoadTextureFile(const Arguments& args, std::string path, bool makeRelative) {
@@ -422,7 +426,7 @@ void Object::Render(Shader* boundShader) {
 	// Enable backface culling
 	glEnable(GL_CULL_FACE);
 	// Draw the triangles
-	glDrawElements(GL_TRIANGLES, Indices.size(), GL_UNSIGNED_INT, 0);
+	glDrawElements(GL_TRIANGLES, getIndexCount(), GL_UNSIGNED_INT, 0);
 
 	// Disable the attributes
 	glDisableVertexAttribArray(0);
@@ -47,15 +47,10 @@ void Physics::Update(unsigned int dt) {
 	world->update(dt * 0.001);
 }
 
-void Physics::addContactCallback(Object* obj, ContactEvent e){ contactEvents[obj->getCollider().getEntity().id] = e; }
-
-void Physics::onContact(const rp3d::CollisionCallback::CallbackData& callbackData) {
-	for(int i = 0; i < callbackData.getNbContactPairs(); i++)
-		if(callbackData.getContactPair(i).getNbContactPoints() > 0)
-			for(auto idEvent: contactEvents)
-				if(callbackData.getContactPair(i).getCollider1()->getEntity().id == idEvent.first || callbackData.getContactPair(i).getCollider2()->getEntity().id == idEvent.first)
-					idEvent.second(callbackData.getContactPair(i));		
-}
+void Physics::addContactCallback(Object* obj, ContactEvent e, uint8_t types){ contactDispatcher.add(obj->getCollider(), std::move(e), types); }
+void Physics::addContactCallback(Object* a, Object* b, ContactEvent e, uint8_t types){ contactDispatcher.add(a->getCollider(), b->getCollider(), std::move(e), types); }
+
+void Physics::onContact(const rp3d::CollisionCallback::CallbackData& callbackData) { contactDispatcher.dispatch(callbackData); }
 
 #ifdef PHYSICS_DEBUG
 
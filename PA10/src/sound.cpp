@@ -1,164 +1,172 @@
 #include "sound.h"
+#include <algorithm>
 #include <iostream>
 
 #define MINIAUDIO_IMPLEMENTATION
 #include "../thirdparty/miniaudio.h"
 
-void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+Sound::Sound() {
+    // Everything is converted to the mixer's format when it is decoded
+    ma_decoder_config decoderConfig = ma_decoder_config_init(ma_format_f32, SOUND_CHANNELS, SOUND_SAMPLE_RATE);
 
-Sound::Sound() { 
+    if (ma_decoder_init_file(musicPath, &decoderConfig, &musicDecoder) == MA_SUCCESS)
+        musicInitialized = true;
+    else std::cout << "ERROR INITIALIZING SOUND: " << musicPath << std::endl;
 
-    // ma_decoder decoder;
-    ma_result result = ma_decoder_init_file(musicPath, NULL, &musicDecoder);
-    if (result != MA_SUCCESS) {
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
+    for (size_t i = 0; i < EffectCount; i++) {
+        ma_uint64 frameCount;
+        void* frames;
+        if (ma_decode_file(effectPaths[i], &decoderConfig, &frameCount, &frames) != MA_SUCCESS) {
+            std::cout << "ERROR INITIALIZING SOUND: " << effectPaths[i] << std::endl;
+            continue;
+        }
+        effects[i].assign((float*) frames, (float*) frames + frameCount * SOUND_CHANNELS);
+        ma_free(frames, NULL);
     }
 
-    musicConfig = ma_device_config_init(ma_device_type_playback);
-    musicConfig.playback.format   = musicDecoder.outputFormat;
-    musicConfig.playback.channels = musicDecoder.outputChannels;
-    musicConfig.sampleRate        = musicDecoder.outputSampleRate;
-    musicConfig.dataCallback      = data_callback;
-    musicConfig.pUserData         = &musicDecoder;
-
-    // ma_device device;
-    if (ma_device_init(NULL, &musicConfig, &musicDevice) != MA_SUCCESS) {
+    // One device plays everything
+    ma_device_config config = ma_device_config_init(ma_device_type_playback);
+    config.playback.format   = ma_format_f32;
+    config.playback.channels = SOUND_CHANNELS;
+    config.sampleRate        = SOUND_SAMPLE_RATE;
+    config.dataCallback      = dataCallback;
+    config.pUserData         = this;
+    if (ma_device_init(NULL, &config, &device) != MA_SUCCESS) {
         printf("Failed to open playback device.\n");
-        ma_decoder_uninit(&musicDecoder);
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
+        return;
     }
+    deviceInitialized = true;
 
-    if (ma_device_start(&musicDevice) != MA_SUCCESS) {
+    if (ma_device_start(&device) != MA_SUCCESS)
         printf("Failed to start playback device.\n");
-        ma_device_uninit(&musicDevice);
-        ma_decoder_uninit(&musicDecoder);
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
-    }
-
-    // ma_decoder decoder;
-    result = ma_decoder_init_file(chargingPath, NULL, &chargingDecoder);
-    if (result != MA_SUCCESS) {
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
-    }
+}
 
-    chargingConfig = ma_device_config_init(ma_device_type_playback);
-    chargingConfig.playback.format   = chargingDecoder.outputFormat;
-    chargingConfig.playback.channels = chargingDecoder.outputChannels;
-    chargingConfig.sampleRate        = chargingDecoder.outputSampleRate;
-    chargingConfig.dataCallback      = data_callback;
-    chargingConfig.pUserData         = &chargingDecoder;
+Sound::~Sound() {
+    // Stopping the device waits for the audio thread, after that the music can be freed
+    if (deviceInitialized)
+        ma_device_uninit(&device);
+    if (musicInitialized)
+        ma_decoder_uninit(&musicDecoder);
+}
 
-    // ma_device device;
-    if (ma_device_init(NULL, &chargingConfig, &chargingDevice) != MA_SUCCESS) {
-        printf("Failed to open playback device.\n");
-        ma_decoder_uninit(&chargingDecoder);
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
-    }
+void Sound::SetCharging(bool val) {
+    if (val == charging || !gameRunning) return;
+    charging = val;
 
-    result = ma_decoder_init_file(bouncePath, NULL, &bounceDecoder);
-    if (result != MA_SUCCESS) {
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
-    }
+    send({val ? Command::Start : Command::Stop, ChargingEffect, false, std::chrono::steady_clock::now()});
+}
 
-    bounceConfig = ma_device_config_init(ma_device_type_playback);
-    bounceConfig.playback.format   = bounceDecoder.outputFormat;
-    bounceConfig.playback.channels = bounceDecoder.outputChannels;
-    bounceConfig.sampleRate        = bounceDecoder.outputSampleRate;
-    bounceConfig.dataCallback      = data_callback;
-    bounceConfig.pUserData         = &bounceDecoder;
+void Sound::Bounce() {
+    send({Command::Start, BounceEffect, false, std::chrono::steady_clock::now()});
+}
 
-    // ma_device device;
-    if (ma_device_init(NULL, &bounceConfig, &bounceDevice) != MA_SUCCESS) {
-        printf("Failed to open playback device.\n");
-        ma_decoder_uninit(&bounceDecoder);
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
-    }
+void Sound::LoseBall() {
+    send({Command::Start, LoseBallEffect, false, std::chrono::steady_clock::now()});
+}
 
+void Sound::send(const Command& command) {
+    // If the queue is full the audio thread has fallen behind, dropping the sound is better than waiting on it
+    commands.push(command);
+}
 
-    result = ma_decoder_init_file(loseBallPath, NULL, &loseBallDecoder);
-    if (result != MA_SUCCESS) {
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
+void Sound::apply(const Command& command) {
+    if (command.type == Command::Stop) {
+        for (auto& voice : voices)
+            if (voice.effect == command.effect)
+                voice.effect = -1;
+        return;
     }
 
-    loseBallConfig = ma_device_config_init(ma_device_type_playback);
-    loseBallConfig.playback.format   = loseBallDecoder.outputFormat;
-    loseBallConfig.playback.channels = loseBallDecoder.outputChannels;
-    loseBallConfig.sampleRate        = loseBallDecoder.outputSampleRate;
-    loseBallConfig.dataCallback      = data_callback;
-    loseBallConfig.pUserData         = &loseBallDecoder;
-
-    // ma_device device;
-    if (ma_device_init(NULL, &loseBallConfig, &loseBallDevice) != MA_SUCCESS) {
-        printf("Failed to open playback device.\n");
-        ma_decoder_uninit(&loseBallDecoder);
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
-    }
+    // Every trigger gets a voice of its own, so overlapping bounces no longer cut each other off
+    Voice* voice = allocateVoice();
+    voice->effect = command.effect;
+    voice->cursor = 0;
+    voice->looping = command.looping;
+    voice->started = voicesStarted++;
 }
 
-Sound::~Sound() {
-    ma_device_uninit(&musicDevice);
-    ma_decoder_uninit(&musicDecoder);
+Sound::Voice* Sound::allocateVoice() {
+    for (auto& voice : voices)
+        if (voice.effect < 0)
+            return &voice;
 
-    ma_device_uninit(&chargingDevice);
-    ma_decoder_uninit(&chargingDecoder);
+    // Every voice is busy, steal the oldest one
+    return &*std::min_element(voices.begin(), voices.end(), [](const Voice& a, const Voice& b) { return a.started < b.started; });
 }
 
-void Sound::SetCharging(bool val) {
-    if(val == ma_device_is_started(&chargingDevice) || !gameRunning) return;
+bool Sound::mixVoice(Voice& voice, float* output, ma_uint32 frameCount) {
+    const std::vector<float>& samples = effects[voice.effect];
+    uint64_t length = samples.size() / SOUND_CHANNELS;
 
-    if(val) {
+    for (ma_uint32 mixed = 0; mixed < frameCount; ) {
+        if (voice.cursor >= length) {
+            if (!voice.looping) return false;
+            voice.cursor = 0;
+        }
 
-        ma_decoder_seek_to_pcm_frame(&chargingDecoder, 0);
+        ma_uint32 count = std::min<uint64_t>(frameCount - mixed, length - voice.cursor);
+        const float* source = samples.data() + voice.cursor * SOUND_CHANNELS;
+        float* destination = output + mixed * SOUND_CHANNELS;
+        for (size_t i = 0; i < count * SOUND_CHANNELS; i++)
+            destination[i] += source[i];
 
-        if (ma_device_start(&chargingDevice) != MA_SUCCESS) {
-            printf("Failed to start playback device.\n");
-            ma_device_uninit(&chargingDevice);
-            ma_decoder_uninit(&chargingDecoder);
-            std::cout << "ERROR INITIALIZING SOUND" << std::endl;
-        }
-    } else {
-        ma_device_stop(&chargingDevice);
+        voice.cursor += count;
+        mixed += count;
     }
+    return true;
 }
 
-void Sound::Bounce() {
-    if(ma_device_is_started(&bounceDevice)) {
-        ma_device_stop(&bounceDevice);
-    }
-
-    ma_decoder_seek_to_pcm_frame(&bounceDecoder, 0);
-
-    if (ma_device_start(&bounceDevice) != MA_SUCCESS) {
-        printf("Failed to start playback device.\n");
-        ma_device_uninit(&bounceDevice);
-        ma_decoder_uninit(&bounceDecoder);
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
+void Sound::mixMusic(float* output, ma_uint32 frameCount) {
+    // Decode the music a chunk at a time (looping forever) and add it in
+    for (ma_uint32 mixed = 0; mixed < frameCount; ) {
+        ma_uint64 read = 0;
+        ma_uint32 chunk = std::min<ma_uint32>(frameCount - mixed, SOUND_STREAM_CHUNK);
+        ma_data_source_read_pcm_frames(&musicDecoder, streamBuffer.data(), chunk, &read, MA_TRUE);
+        for (size_t i = 0; i < read * SOUND_CHANNELS; i++)
+            output[mixed * SOUND_CHANNELS + i] += streamBuffer[i];
+
+        mixed += read;
+        if (read < chunk) return;
     }
 }
 
-void Sound::LoseBall() {
-    if(ma_device_is_started(&loseBallDevice)) {
-        ma_device_stop(&loseBallDevice);
-    }
+void Sound::mix(float* output, ma_uint32 frameCount) {
+    auto start = std::chrono::steady_clock::now();
 
-    ma_decoder_seek_to_pcm_frame(&loseBallDecoder, 0);
+    // Apply every command which has arrived, measuring how long until they are heard (the time they waited in the queue, plus the time to play out what the device has already buffered)
+    float buffered = 1000.0f * device.playback.internalPeriodSizeInFrames * device.playback.internalPeriods / device.playback.internalSampleRate;
+    Command command;
+    while (commands.pop(command)) {
+        apply(command);
+        if (command.type != Command::Start) continue;
 
-    if (ma_device_start(&loseBallDevice) != MA_SUCCESS) {
-        printf("Failed to start playback device.\n");
-        ma_device_uninit(&loseBallDevice);
-        ma_decoder_uninit(&loseBallDecoder);
-        std::cout << "ERROR INITIALIZING SOUND" << std::endl;
+        float latency = std::chrono::duration<float, std::milli>(start - command.issued).count() + buffered;
+        averageLatency = averageLatency ? averageLatency * .9f + latency * .1f : latency;
     }
+
+    // The output starts silent (the device clears it), the music and every playing voice are added in
+    if (musicInitialized)
+        mixMusic(output, frameCount);
+    for (auto& voice : voices)
+        if (voice.effect >= 0 && !mixVoice(voice, output, frameCount))
+            voice.effect = -1;
+    for (size_t i = 0; i < frameCount * SOUND_CHANNELS; i++)
+        output[i] = std::clamp(output[i], -1.0f, 1.0f);
+
+    // Compare the time spent mixing to the time the mixed audio lasts
+    float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    load = load * .95f + elapsed / (frameCount / (float) SOUND_SAMPLE_RATE) * .05f;
 }
 
-void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
+// Callback function which provides more audio data to the sound device when it runs out
+void Sound::dataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
 {
-    ma_decoder* pDecoder = (ma_decoder*)pDevice->pUserData;
-    if (pDecoder == NULL) {
+    Sound* sound = (Sound*) pDevice->pUserData;
+    if (sound == NULL) {
         return;
     }
 
-    ma_decoder_read_pcm_frames(pDecoder, pOutput, frameCount);
+    sound->mix((float*) pOutput, frameCount);
 
     (void)pInput;
-}
\ No newline at end of file
+}
@@ -0,0 +1,134 @@
+#include "timerWheel.h"
+
+bool TimerWheel::cancel(Handle handle) {
+	if(!isPending(handle)) return false;
+
+	Node& node = nodes[handle.index];
+	// A timer cancelled from inside its own callback is freed once the callback returns
+	if(!node.linked) {
+		node.cancelled = true;
+		count--;
+		return true;
+	}
+
+	unlink(handle.index);
+	free(handle.index);
+	count--;
+	return true;
+}
+
+bool TimerWheel::isPending(Handle handle) const {
+	if(handle.index >= nodes.size()) return false;
+
+	const Node& node = nodes[handle.index];
+	return node.generation == handle.generation && (node.linked || (node.function && !node.cancelled));
+}
+
+void TimerWheel::advance(uint64_t milliseconds) {
+	for(uint64_t target = now + milliseconds; now < target; ) {
+		uint64_t tick = ++now;
+
+		// When a level wraps around, the next slot of the level above it is spread out (from the top down so nodes can fall several levels)
+		uint32_t levels = 0;
+		while(levels + 1 < TIMER_WHEEL_LEVELS && ((tick >> (TIMER_WHEEL_BITS * (levels + 1))) << (TIMER_WHEEL_BITS * (levels + 1))) == tick)
+			levels++;
+		for(uint32_t level = levels; level > 0; level--)
+			cascade(level, (tick >> (TIMER_WHEEL_BITS * level)) & MASK);
+
+		expire(tick & MASK);
+	}
+}
+
+TimerWheel::Handle TimerWheel::add(std::function<void()>&& function, int64_t delay, uint64_t interval) {
+	uint32_t index;
+	if(freeList != NIL) {
+		index = freeList;
+		freeList = nodes[index].next;
+	} else {
+		index = nodes.size();
+		nodes.emplace_back();
+	}
+
+	// A timer never fires on the tick it was added in (it would be missed if the current slot is being expired)
+	Node& node = nodes[index];
+	node.function = std::move(function);
+	node.expiry = now + std::max<int64_t>(delay, 1);
+	node.interval = interval;
+	node.cancelled = false;
+	link(index);
+	count++;
+
+	return {index, node.generation};
+}
+
+void TimerWheel::link(uint32_t index) {
+	Node& node = nodes[index];
+
+	// Find the lowest level whose turn still covers the expiry (past the last level, wait in the furthest slot and be re-linked from there)
+	uint64_t delta = node.expiry - now, expiry = node.expiry;
+	uint32_t level = 0;
+	while(level + 1 < TIMER_WHEEL_LEVELS && delta >= (uint64_t(1) << (TIMER_WHEEL_BITS * (level + 1))))
+		level++;
+	if(delta >= (uint64_t(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)))
+		expiry = now + (uint64_t(1) << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+
+	node.level = level;
+	node.slot = (expiry >> (TIMER_WHEEL_BITS * level)) & MASK;
+	node.previous = NIL;
+	node.next = slots[level][node.slot];
+	if(node.next != NIL) nodes[node.next].previous = index;
+	slots[level][node.slot] = index;
+	node.linked = true;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+	Node& node = nodes[index];
+	if(node.previous != NIL) nodes[node.previous].next = node.next;
+	else slots[node.level][node.slot] = node.next;
+	if(node.next != NIL) nodes[node.next].previous = node.previous;
+	node.linked = false;
+}
+
+void TimerWheel::free(uint32_t index) {
+	Node& node = nodes[index];
+	node.function = nullptr;
+	node.generation++;
+	node.linked = false;
+	node.next = freeList;
+	freeList = index;
+}
+
+void TimerWheel::cascade(uint32_t level, uint32_t slot) {
+	uint32_t index = slots[level][slot];
+	slots[level][slot] = NIL;
+	while(index != NIL) {
+		uint32_t next = nodes[index].next;
+		link(index);
+		index = next;
+	}
+}
+
+void TimerWheel::expire(uint32_t slot) {
+	// Nodes are taken off one at a time, since callbacks may add or cancel timers (even ones in this slot)
+	while(slots[0][slot] != NIL) {
+		uint32_t index = slots[0][slot];
+		unlink(index);
+
+		// The callback may add timers (reallocating the nodes), so it is moved out while it runs
+		std::function<void()> function = std::move(nodes[index].function);
+		nodes[index].function = [](){};
+		function();
+
+		Node& node = nodes[index];
+		if(node.cancelled) {
+			free(index);
+		} else if(node.interval) {
+			node.function = std::move(function);
+			node.expiry = now + node.interval;
+			link(index);
+		} else {
+			free(index);
+			count--;
+		}
+	}
+}
@@ -5,10 +5,36 @@
 #include "leaderboard.h"
 #include "voxel_world.h"
 #include "light.h"
+#include "crowd.h"
 
 #include <vector>
 
-class NPC;
+// How large of a hole (radius) the abduction beam digs and how quickly (density per second)
+#define BEAM_DIG_RADIUS 3
+#define BEAM_DIG_RATE 6
+// How many random edits per frame the terrain stress test (toggled with F9) applies
+#define TERRAIN_STRESS_EDITS_PER_FRAME 8
+// How long (in seconds) the scripted flight (toggled with F10) flies in each direction
+#define SCRIPTED_FLIGHT_LEG_TIME 20
+// How many UFOs (each with a beam and two running lights) the lighting benchmark (toggled with F11) flies around the player,
+// and how long (in seconds) it measures the frame time with clustered lighting on and then off
+#define LIGHT_BENCHMARK_UFOS 64
+#define LIGHT_BENCHMARK_PHASE_TIME 10
+#define LIGHT_BENCHMARK_RADIUS 60
+// How many cows the crowd benchmark (toggled with F12) adds around the player, how far out they are scattered, and how long (in seconds) it measures for
+#define CROWD_BENCHMARK_AGENTS 10000
+#define CROWD_BENCHMARK_RADIUS 120
+#define CROWD_BENCHMARK_TIME 10
+// How many queries of each shape the spatial query benchmark (run with F8) times, how far out (in each direction) its points are scattered, and the size of its queries
+#define SPATIAL_BENCHMARK_QUERIES 1000
+#define SPATIAL_BENCHMARK_EXTENT 256
+#define SPATIAL_BENCHMARK_QUERY_RADIUS 20
+// How many players the leaderboard benchmark (run with F7) loads, and how many updates and queries it times
+#define LEADERBOARD_BENCHMARK_PLAYERS 1000000
+#define LEADERBOARD_BENCHMARK_OPERATIONS 100000
+// How many chunk boundary crossings the chunk work queue benchmark (run with F6) simulates, and how much work is pushed and popped around each
+#define QUEUE_BENCHMARK_CROSSINGS 2000
+#define QUEUE_BENCHMARK_PUSHES 33
 
 // Class which provides engine related internals
 class Application: public Engine {
@@ -21,12 +47,19 @@ public:
 	bool initialize(const Arguments& args);
 	void update(float dt) override;
 	void render(Shader* boundShader) override;
+	void submit(RenderQueue& queue) override;
 	void drawGUI();
 	void reset();
 
-	void createNPC(std::string type);
 	void controlUFO(float dt);
-	void repositionNPC(std::shared_ptr<NPC> npc, bool checkDistance);
+	void startLightBenchmark();
+	void updateLightBenchmark(float dt);
+	void stopLightBenchmark();
+	void startCrowdBenchmark();
+	void updateCrowdBenchmark(float dt);
+	void stopCrowdBenchmark();
+	void runSpatialBenchmark();
+	void repositionAgent(size_t agent, bool checkDistance = true);
 	int getScore() {return points; };
 	float getTimeRemaining() {return timeRemaining;};
 
@@ -36,9 +69,9 @@ public:
 	void mouseWheel(const SDL_MouseWheelEvent& e);
 
 	Object::ptr ufo;
-	std::vector<std::shared_ptr<NPC>> npcs;
 
 	std::shared_ptr<VoxelWorld> getWorld() const { return world; }
+	std::shared_ptr<Crowd> getCrowd() const { return crowd; }
 
 	Arguments args;
 
@@ -51,16 +84,37 @@ public:
 
 private:
 	std::shared_ptr<VoxelWorld> world;
+	// The cows and aliens
+	std::shared_ptr<Crowd> crowd;
+	// The agents in the abduction beam (kept between frames to reuse its memory)
+	std::vector<uint32_t> inBeam;
 
 	glm::vec3 inputDirection;
 	glm::vec3 desiredVelocity;
 	glm::vec3 velocity;
 
 	bool abducting = false;
+	bool terrainStressTest = false;
+	bool scriptedFlight = false;
+	float scriptedFlightTime = 0;
+
+	// The lighting benchmark's fleet, and the frame times measured with clustering on (0) and off (1)
+	Object::ptr lightBenchmarkFleet;
+	float lightBenchmarkTime = 0;
+	double lightBenchmarkFrameTime[2] = {};
+	size_t lightBenchmarkFrames[2] = {};
+
+	// How many agents there were before the crowd benchmark added its cows, and the frame and crowd update times it has measured
+	bool crowdBenchmark = false;
+	size_t crowdBenchmarkBase = 0;
+	float crowdBenchmarkTime = 0;
+	double crowdBenchmarkFrameTime = 0, crowdBenchmarkUpdateTime = 0;
+	size_t crowdBenchmarkFrames = 0;
+
 	float timeRemaining = 0;
 
 	float accelerationRate = 0.5;
-	int npci = 0; // npc index
+	size_t npci = 0; // npc index
 
 	std::shared_ptr<SpotLight> ufoLight;
 };
@@ -18,6 +18,11 @@ private:
 
 	json config;
 
+	// Whether the models should be cooked instead of running the game
+	bool cook = false;
+	// File the memory statistics are periodically dumped to (not dumped if empty)
+	std::string memoryDumpPath;
+
 	// Variable tracking whether or not we can continue
 	bool canContinue = true;
 public:
@@ -35,6 +40,8 @@ public:
 	std::string getPerVertexFragmentFilePath() const { return perVertexFragmentFilePath; }
 
 	json getConfig() const { return config; }
+	bool getCook() const { return cook; }
+	std::string getMemoryDumpPath() const { return memoryDumpPath; }
 
 	bool getCanContinue() const { return canContinue; }
 };
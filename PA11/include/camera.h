@@ -18,6 +18,7 @@ public:
 	glm::mat4 getProjection() { return projection; }
 	glm::mat4 getView() { return view; }
 	glm::vec3 getLookDirection() { return normalize(focusPos - eyePos);}
+	glm::vec3 getPosition() { return eyePos; }
 	void setFocus(std::shared_ptr<Object> object) {focusObj = object;}
 
 	glm::ivec2 getDimensions() const { return dimensions; }
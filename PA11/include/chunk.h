@@ -2,13 +2,34 @@
 #define CHUNK_H
 
 #include "object.h"
+#include "task_scheduler.h"
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+
 #define NOISE_SEED 12345
 
 #define CHUNK_WIDTH 17
 #define CHUNK_HEIGHT 256
 
+// The mesh is split into vertical sections which can be remeshed and uploaded independently
+#define CHUNK_SECTION_HEIGHT 16
+#define CHUNK_SECTIONS (CHUNK_HEIGHT / CHUNK_SECTION_HEIGHT)
+// Extra room (as a fraction of its size) each section is given in the buffers so edits can usually be uploaded in place
+#define CHUNK_SECTION_SLACK 0.5
+
 #define TREE_MAX_ANGLE 0.0872665
-#define TREE_SPARCITY 100
+#define TREE_MIN_HEIGHT 55
+// Trees are scattered with one candidate per (world space) cell, a fraction of which are kept, and none of which are closer than the minimum distance
+#define TREE_CELL_SIZE 4
+#define TREE_DENSITY 0.25
+#define TREE_MIN_DISTANCE 4
+#define TREE_MODEL_COUNT 2
 
 struct Chunk : public Object {
     using ptr = std::shared_ptr<Chunk>;
@@ -32,19 +53,130 @@ struct Chunk : public Object {
         Generated,
         Meshed,
         Finalized
-    } state = NotStarted;
+    };
+    std::atomic<GenerateState> state = NotStarted;
+
+    // A change to the terrain's density (in world space)
+    struct DensityEdit {
+        enum Shape {
+            Sphere, // Inscribed in the bounds
+            Box
+        };
+
+        Shape shape;
+        glm::vec3 min, max;
+        float delta; // Positive adds terrain, negative removes it
+    };
+
+    // A placed tree (in world space)
+    struct TreeInstance {
+        glm::vec3 position;
+        float rotation; // Around the y axis
+        uint8_t model;
+    };
+
+    // A piece of the mesh which can be rebuilt on its own
+    struct Section {
+        // Where the section's vertices and (section relative) indices live in the chunk's buffers, and how much room they have
+        uint32_t firstVertex = 0, vertexCount = 0, vertexCapacity = 0;
+        uint32_t firstIndex = 0, indexCount = 0, indexCapacity = 0;
+
+        // The section's piece of the collider
+        std::unique_ptr<btTriangleMesh> trimesh;
+        std::unique_ptr<btBvhTriangleMeshShape> shape;
+    };
+
+    // When the chunk was requested (used to measure how long it takes to become collidable)
+    std::chrono::steady_clock::time_point requestTime;
+    // How long it took to generate and mesh the chunk
+    std::chrono::steady_clock::duration generateTime = {};
+    // The final task in the chunk's generate -> mesh -> upload -> collide pipeline
+    TaskScheduler::Task::ptr collideTask;
+    // If the chunk has already been counted as popping in (seen before it was finalized)
+    bool poppedIn = false;
+    // Set when edits change the voxels, cleared once the chunk has been stored again
+    std::atomic<bool> unsavedEdits = false;
 
     // Only render the chunk if it has finished being generated
     void render(Shader* boundShader) override { if(state == Finalized) Object::render(boundShader); }
+    void submit(RenderQueue& queue) override { if(state == Finalized) Object::submit(queue); }
 
     // TODO: Chunk width
     // TODO: See if riged perlin noise can generate caves?
 
+    // Compiles the voxel generation compute shader (on the calling thread, which must own the OpenGL context) so it isn't compiled on first use,
+    // returns a hash of the shader's source (stored chunks generated by a different version of it are stale)
+    static uint64_t loadVoxelGenerator(const Arguments& args);
     void generateVoxels(const Arguments& args, int x, int z);
     void rebuildMesh(const Arguments& args);
-    void generateTrees(const Arguments& args);
+    // Scatters trees over the chunk's surface, the placement only depends on the chunk's coordinates and voxels (so it is the same on every run and thread)
+    void scatterTrees(glm::ivec2 chunkCoordinates);
+
+    // Builds a collider made of one piece per section
+    bool createMeshCollider(const Arguments& args, Physics& physics, size_t maxHulls = CONCAVE_MESH, std::string path = "") override;
+
+    // Queues an edit, returns true if the chunk needs a task scheduled to apply its queued edits
+    bool queueEdit(const DensityEdit& edit);
+    // Applies the queued edits, then remeshes and rebuilds the collider for only the affected sections, and places the trees on the new surface (worker thread)
+    void applyQueuedEdits();
+    // Checks if edits have changed the chunk since it was last stored (including edits which haven't been applied yet)
+    bool hasUnsavedEdits();
+    // Uploads the mesh (only the sections which have changed, unless the layout changed) to the gpu, and swaps in any trees placed by edits (main thread)
+    void uploadMesh();
 
     Voxel voxels[CHUNK_WIDTH][CHUNK_HEIGHT][CHUNK_WIDTH]; // X, Y, Z
+    // The trees scattered over the chunk (only safe to read once the chunk is finalized, and then only from the main thread)
+    std::vector<TreeInstance> trees;
+    // The world space height of each column's surface (NAN if the column is empty), rebuilt whenever the mesh is uploaded (main thread only)
+    using Heightmap = std::array<std::array<float, CHUNK_WIDTH>, CHUNK_WIDTH>;
+    Heightmap heightmap;
+
+protected:
+    // Meshes of every section (built in the thread's scratch arena)
+    using SectionVertices = std::pmr::vector<std::pmr::vector<Vertex>>;
+    using SectionIndices = std::pmr::vector<std::pmr::vector<unsigned int>>;
+
+    // Finds the height of the top surface of a column of voxels (NAN if the column is empty)
+    float surfaceHeight(size_t x, size_t z) const;
+    // Places the trees scattered over the chunk's surface
+    std::vector<TreeInstance> placeTrees(glm::ivec2 chunkCoordinates) const;
+
+    // Marching cubes the cells in a section
+    void meshSection(size_t section, std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices) const;
+    // Copies a remeshed section into the buffers, returns false if it didn't fit in the section's capacity
+    bool placeSection(size_t section, const std::pmr::vector<Vertex>& vertices, const std::pmr::vector<unsigned int>& indices);
+    // Lays out every section from scratch (with fresh slack)
+    void layoutSections(const SectionVertices& sectionVertices, const SectionIndices& sectionIndices);
+    // Builds the collider piece for a section
+    void buildSectionCollider(Section& section) const;
+
+    // Draws each section
+    void draw() override;
+
+protected:
+    // The mesh is split into sections
+    std::array<Section, CHUNK_SECTIONS> sections;
+    // Guards the voxels, buffers, and sections while edits are applied, uploaded, or stored
+    mutable std::mutex meshMutex;
+    // Sections which have changed since the last upload (and if the whole layout has changed)
+    std::bitset<CHUNK_SECTIONS> uploadDirty;
+    bool layoutDirty = true;
+    // Trees placed on the surface left by the last edits, waiting for the next upload to replace the drawn trees
+    std::optional<std::vector<TreeInstance>> editedTrees;
+    // If the section collider has been built yet
+    bool hasSectionCollider = false;
+
+    // Edits waiting to be applied
+    std::mutex editMutex;
+    std::vector<DensityEdit> queuedEdits;
+
+    // What was last uploaded to the gpu, used when drawing (main thread only)
+    std::array<GLsizei, CHUNK_SECTIONS> drawCounts = {};
+    std::array<void*, CHUNK_SECTIONS> drawOffsets = {};
+    std::array<GLint, CHUNK_SECTIONS> drawBaseVertices = {};
+
+    // The store saves and restores the chunk's mesh
+    friend class ChunkStore;
 };
 
 #endif // CHUNK_H
@@ -0,0 +1,126 @@
+#ifndef CHUNK_STORE_H
+#define CHUNK_STORE_H
+
+#include "graphics_headers.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The number of chunks along each side of a region file
+#define REGION_WIDTH 16
+// The number of recently used chunks kept decompressed in memory
+#define CHUNK_STORE_MEMORY_CAPACITY 128
+// The bump in this number invalidates every region file on disk
+#define CHUNK_STORE_VERSION 3
+// Chunks are given space in their region file in multiples of this many bytes, so a chunk which grows a little when it is edited can be rewritten in place
+#define REGION_SECTOR_SIZE 4096
+
+struct Chunk;
+
+// Persistent store for generated chunks (their voxels and finished, sectioned, mesh)
+// NOTE: Chunks are grouped into region files of REGION_WIDTH x REGION_WIDTH chunks, each of which starts with a table of where each
+//	chunk's (zlib compressed) data lives in the file. Regions are memory mapped for reading, chunks are rewritten in place when they
+//	still fit in their slot and appended otherwise (compacting the region first if that would abandon a slot), and an LRU of
+//	decompressed chunks sits in front of the disk so chunks which are flown back over are just copied.
+class ChunkStore {
+public:
+	// Statistics about how well the store is working
+	struct Stats {
+		size_t memoryHits, diskHits, misses;
+		float averageLoadTime, averageGenerateTime; // Milliseconds
+
+		float hitRate() const { size_t total = memoryHits + diskHits + misses; return total ? float(memoryHits + diskHits) / total : 0; }
+		float timeSavedPerChunk() const { return memoryHits + diskHits ? averageGenerateTime - averageLoadTime : 0; } // For each chunk served from the store
+	};
+
+	// Opens the store (nothing is stored or loaded until it has been opened), regions stored with a different seed or voxel generator are started over
+	void initialize(std::string directory, uint32_t seed, uint64_t generator);
+
+	// Checks if a chunk has been stored (cheap enough to call on the main thread)
+	bool contains(glm::ivec2 chunkCoordinates);
+	// Copies a stored chunk's data into the given chunk, returns false if the chunk isn't stored (or couldn't be read)
+	bool load(glm::ivec2 chunkCoordinates, Chunk& chunk);
+	// Compresses and stores a chunk's data
+	bool save(glm::ivec2 chunkCoordinates, const Chunk& chunk);
+
+	// Records how long it took to generate and mesh a chunk which wasn't stored (counted as a miss)
+	void recordGeneration(float milliseconds);
+	Stats getStats() const;
+
+protected:
+	// Where a chunk lives in a region file
+	struct TableEntry {
+		uint64_t offset;
+		uint32_t size; // Compressed size
+		uint32_t rawSize;
+		uint32_t capacity; // Bytes reserved for the chunk (its size rounded up to a whole number of sectors)
+		uint32_t padding;
+	};
+
+	// Region file header
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t seed;
+		uint32_t padding;
+		uint64_t generator; // Hash of the voxel generator's source
+		TableEntry table[REGION_WIDTH * REGION_WIDTH];
+	};
+
+	// An open region file
+	struct Region {
+		std::shared_mutex mutex;
+		std::string path;
+		int fd = -1;
+		Header header;
+		uint64_t end = sizeof(Header); // Where the next chunk will be appended
+		const uint8_t* map = nullptr;
+		size_t mappedSize = 0;
+
+		~Region();
+		// Makes sure the map covers at least <size> bytes (requires a unique lock)
+		bool remap(size_t size);
+		// Rewrites the region through a temporary file without the chunk at <index>, so the space it used isn't abandoned when it moves (requires a unique lock)
+		bool compact(size_t index);
+	};
+
+	using Blob = std::shared_ptr<const std::vector<uint8_t>>;
+
+	static uint64_t key(glm::ivec2 chunkCoordinates) { return (uint64_t(uint32_t(chunkCoordinates.x)) << 32) | uint32_t(chunkCoordinates.y); }
+	static glm::ivec2 regionCoordinates(glm::ivec2 chunkCoordinates);
+	static size_t tableIndex(glm::ivec2 chunkCoordinates);
+
+	// Gets (opening or creating if needed) the region file a chunk belongs to
+	Region* getRegion(glm::ivec2 chunkCoordinates);
+
+	// In memory LRU tier
+	Blob getCached(uint64_t key);
+	void cache(uint64_t key, Blob blob);
+
+	// Conversion between chunks and raw (uncompressed) data
+	static std::vector<uint8_t> serialize(const Chunk& chunk);
+	static bool deserialize(const std::vector<uint8_t>& data, Chunk& chunk);
+
+protected:
+	std::string directory;
+	uint32_t seed = 0;
+	uint64_t generator = 0;
+
+	std::mutex regionsMutex;
+	std::unordered_map<uint64_t, std::unique_ptr<Region>> regions;
+
+	std::mutex lruMutex;
+	std::list<std::pair<uint64_t, Blob>> lru; // Most recently used first
+	std::unordered_map<uint64_t, std::list<std::pair<uint64_t, Blob>>::iterator> lruLookup;
+
+	std::atomic<size_t> memoryHits = 0, diskHits = 0, misses = 0;
+	std::atomic<uint64_t> loadMicroseconds = 0, generateMicroseconds = 0;
+};
+
+#endif // CHUNK_STORE_H
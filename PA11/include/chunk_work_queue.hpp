@@ -0,0 +1,301 @@
+#ifndef CHUNK_WORK_QUEUE_HPP
+#define CHUNK_WORK_QUEUE_HPP
+
+#include "graphics_headers.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <vector>
+
+// Concurrent work queue which hands out work tied to the chunks closest to the player first
+// NOTE: There is one bucket for every chunk cell in the square around the focus, indexed by the chunk's coordinates wrapped into the square
+//	(like the world's circular buffers). Positions in the square are ordered by their distance from the focus (the ring order), and a
+//	bitmap over that order marks which buckets hold work, so popping finds the nearest occupied bucket with a couple of bit scans.
+//	When the player crosses a chunk boundary nothing is resorted, only the bitmap is rebuilt from a second bitmap of the occupied buckets
+//	(one step per occupied bucket). Chunks a whole square apart share a bucket, so work left in a bucket by chunks which are no longer
+//	inside the square is moved to the overflow when the bucket is next visited, keeping each bucket to the work of a single chunk.
+//	Each bucket has its own lock so multiple consumers can pop at once, pushes and pops only share the layout lock (which is held
+//	exclusively while the focus or size of the square changes)
+template<typename T>
+class ChunkWorkQueue {
+	// A piece of work and the chunk it belongs to
+	struct Entry {
+		T value;
+		glm::ivec2 chunk;
+	};
+
+	// A single bucket of work (the count is only kept for the urgent work and overflow, which are checked before being locked)
+	struct Bucket {
+		std::mutex mutex;
+		std::deque<Entry> entries;
+		std::atomic<size_t> count = 0;
+	};
+
+public:
+	ChunkWorkQueue(int radius) { layout(radius); }
+
+	// Adds work which is tied to a chunk
+	void push(T value, glm::ivec2 chunk) {
+		std::shared_lock lock(layoutMutex);
+		pushLocked({std::move(value), chunk});
+	}
+
+	// Adds work which should run before anything tied to a chunk
+	void pushUrgent(T value) { pushInto(urgent, {std::move(value), {}}); }
+
+	// Removes the most important piece of work (if there is any)
+	std::optional<T> pop() {
+		if(auto value = popFrom(urgent)) return value;
+
+		// Visit the occupied buckets nearest first
+		{
+			std::shared_lock lock(layoutMutex);
+			while(std::optional<size_t> position = nearestMarked())
+				if(auto value = popChunk(*position)) return value;
+		}
+
+		return popFrom(overflow);
+	}
+
+	// Changes which chunk work is prioritized around
+	void setFocus(glm::ivec2 newFocus) {
+		std::unique_lock lock(layoutMutex);
+		if(newFocus == focus) return;
+		focus = newFocus;
+
+		// Every bucket now sits at a different position in the ring order, so mark the occupied ones again
+		remark();
+		moveOverflowInside();
+	}
+
+	// Changes how far from the focus work is bucketed (the work already queued is bucketed again)
+	void setRadius(int newRadius) {
+		std::unique_lock lock(layoutMutex);
+		if(newRadius == radius) return;
+
+		std::vector<Entry> entries;
+		for(auto& bucket: buckets)
+			std::move(bucket.entries.begin(), bucket.entries.end(), std::back_inserter(entries));
+		count -= entries.size();
+
+		layout(newRadius);
+		for(auto& entry: entries)
+			pushLocked(std::move(entry));
+		moveOverflowInside();
+	}
+
+	// The amount of work waiting in the queue
+	size_t size() const { return count; }
+	bool empty() const { return size() == 0; }
+
+protected:
+	// Whether a chunk is inside the square around the focus
+	bool contains(glm::ivec2 chunk) const {
+		glm::ivec2 offset = chunk - focus;
+		return std::max(std::abs(offset.x), std::abs(offset.y)) <= radius;
+	}
+	int wrap(int coordinate) const { return ((coordinate % width) + width) % width; }
+	size_t offsetIndex(glm::ivec2 offset) const { return (offset.x + radius) * width + (offset.y + radius); }
+	size_t bucketIndex(glm::ivec2 chunk) const { return wrap(chunk.x) * width + wrap(chunk.y); }
+
+	// Creates the (empty) buckets and ring order for a square of the given radius (nothing else can be using the queue)
+	void layout(int newRadius) {
+		radius = newRadius;
+		width = radius * 2 + 1;
+		size_t cells = width * width;
+		std::vector<Bucket>(cells).swap(buckets);
+		std::vector<std::atomic<uint64_t>>((cells + 63) / 64).swap(occupiedBuckets);
+		std::vector<std::atomic<uint64_t>>((cells + 63) / 64).swap(occupied);
+		std::vector<std::atomic<uint64_t>>((occupied.size() + 63) / 64).swap(occupiedWords);
+
+		// Order every offset in the square by how far it is from the center
+		ringOrder.clear();
+		for(int x = -radius; x <= radius; x++)
+			for(int z = -radius; z <= radius; z++)
+				ringOrder.emplace_back(x, z);
+		std::stable_sort(ringOrder.begin(), ringOrder.end(), [](const glm::ivec2& a, const glm::ivec2& b){
+			return a.x * a.x + a.y * a.y < b.x * b.x + b.y * b.y;
+		});
+
+		// Create a reverse lookup from an offset to its place in the order
+		ringOrderIndex.resize(cells);
+		for(size_t i = 0; i < ringOrder.size(); i++)
+			ringOrderIndex[offsetIndex(ringOrder[i])] = i;
+	}
+
+	// Adds work tied to a chunk (the layout lock must be held)
+	void pushLocked(Entry&& entry) {
+		// Work outside of the square can't be placed into a bucket, put it in the overflow
+		if(!contains(entry.chunk))
+			return pushInto(overflow, std::move(entry));
+
+		size_t index = bucketIndex(entry.chunk);
+		size_t position = ringOrderIndex[offsetIndex(entry.chunk - focus)];
+		Bucket& bucket = buckets[index];
+		std::scoped_lock lock(bucket.mutex);
+		bucket.entries.push_back(std::move(entry));
+		count++;
+		occupiedBuckets[index / 64] |= uint64_t(1) << (index % 64);
+		mark(position);
+	}
+
+	// Marks the position of every occupied bucket in the ring order around the focus (the layout lock must be held exclusively)
+	void remark() {
+		// Nothing else can touch the bitmaps, so they are built in plain words and then stored
+		marks.assign(occupied.size(), 0);
+		words.assign(occupiedWords.size(), 0);
+
+		// A bucket's chunk inside the square is the one whose offset from the focus wraps into [-radius, radius], which is found for each row
+		// and column of buckets once (so the buckets are walked without any divisions)
+		rows.resize(width);
+		columns.resize(width);
+		for(int i = 0; i < width; i++) {
+			rows[i] = wrap(i - focus.x + radius) * width;
+			columns[i] = wrap(i - focus.y + radius);
+		}
+
+		size_t row = 0, rowStart = 0;
+		for(size_t word = 0; word < occupiedBuckets.size(); word++)
+			for(uint64_t bits = occupiedBuckets[word].load(std::memory_order_relaxed); bits; bits &= bits - 1) {
+				size_t bucket = word * 64 + glm::findLSB(bits);
+				while(bucket >= rowStart + width) { row++; rowStart += width; }
+
+				size_t position = ringOrderIndex[rows[row] + columns[bucket - rowStart]];
+				marks[position / 64] |= uint64_t(1) << (position % 64);
+				words[position / 64 / 64] |= uint64_t(1) << (position / 64 % 64);
+			}
+
+		for(size_t i = 0; i < marks.size(); i++) occupied[i].store(marks[i], std::memory_order_relaxed);
+		for(size_t i = 0; i < words.size(); i++) occupiedWords[i].store(words[i], std::memory_order_relaxed);
+	}
+
+	// Moves any overflow work which is inside the square into its bucket (the layout lock must be held exclusively)
+	void moveOverflowInside() {
+		// The overflow is popped without the layout lock, so it still needs its own
+		std::vector<Entry> inside;
+		{
+			std::scoped_lock lock(overflow.mutex);
+			auto split = std::stable_partition(overflow.entries.begin(), overflow.entries.end(), [&](const Entry& entry) { return !contains(entry.chunk); });
+			std::move(split, overflow.entries.end(), std::back_inserter(inside));
+			overflow.entries.erase(split, overflow.entries.end());
+			overflow.count -= inside.size();
+			count -= inside.size();
+		}
+
+		for(auto& entry: inside)
+			pushLocked(std::move(entry));
+	}
+
+	// Marks the bucket at a position in the ring order as holding work (the word is marked after the bit, see nearestMarked)
+	void mark(size_t position) {
+		occupied[position / 64] |= uint64_t(1) << (position % 64);
+
+		// The word is usually marked already, and checking is much cheaper than an atomic or
+		uint64_t word = uint64_t(1) << (position / 64 % 64);
+		if(!(occupiedWords[position / 64 / 64] & word))
+			occupiedWords[position / 64 / 64] |= word;
+	}
+
+	// Finds the nearest position in the ring order whose bucket is marked as holding work
+	std::optional<size_t> nearestMarked() {
+		for(size_t group = 0; group < occupiedWords.size(); group++)
+			for(uint64_t words = occupiedWords[group]; words; words &= words - 1) {
+				size_t word = group * 64 + glm::findLSB(words);
+				if(uint64_t bits = occupied[word]) return word * 64 + glm::findLSB(bits);
+
+				// The word has emptied, unmark it (then check again, in case a push marked a bit between the two)
+				occupiedWords[group] &= ~(uint64_t(1) << (word % 64));
+				if(uint64_t bits = occupied[word]) {
+					occupiedWords[group] |= uint64_t(1) << (word % 64);
+					return word * 64 + glm::findLSB(bits);
+				}
+			}
+		return {};
+	}
+
+	// Pops the work of the chunk at a position in the ring order, unmarking the position once its bucket is empty (the layout lock must be held)
+	std::optional<T> popChunk(size_t position) {
+		size_t index = bucketIndex(focus + ringOrder[position]);
+		Bucket& bucket = buckets[index];
+		std::optional<T> out;
+		std::vector<Entry> aliased;
+		{
+			std::scoped_lock lock(bucket.mutex);
+
+			// Only one of the chunks sharing the bucket can be inside the square, work for the others was pushed before the focus moved and is
+			// now farther than everything in the square (so it moves to the overflow instead of being handed out in the nearer chunk's place)
+			auto inside = [&](const Entry& entry) { return contains(entry.chunk); };
+			if(!std::all_of(bucket.entries.begin(), bucket.entries.end(), inside)) {
+				auto split = std::stable_partition(bucket.entries.begin(), bucket.entries.end(), inside);
+				std::move(split, bucket.entries.end(), std::back_inserter(aliased));
+				bucket.entries.erase(split, bucket.entries.end());
+			}
+
+			if(!bucket.entries.empty()) {
+				out = std::move(bucket.entries.front().value);
+				bucket.entries.pop_front();
+			}
+			count -= aliased.size() + (out ? 1 : 0);
+
+			// Unmark the bucket once it is empty (under its lock, so a push can't be between filling the bucket and marking it)
+			if(bucket.entries.empty()) {
+				occupied[position / 64] &= ~(uint64_t(1) << (position % 64));
+				occupiedBuckets[index / 64] &= ~(uint64_t(1) << (index % 64));
+			}
+		}
+
+		for(auto& entry: aliased)
+			pushInto(overflow, std::move(entry));
+		return out;
+	}
+
+	void pushInto(Bucket& bucket, Entry&& entry) {
+		std::scoped_lock lock(bucket.mutex);
+		bucket.entries.push_back(std::move(entry));
+		bucket.count++;
+		count++;
+	}
+
+	std::optional<T> popFrom(Bucket& bucket) {
+		// Skip locking empty buckets
+		if(bucket.count == 0) return {};
+
+		std::scoped_lock lock(bucket.mutex);
+		if(bucket.entries.empty()) return {};
+
+		T out = std::move(bucket.entries.front().value);
+		bucket.entries.pop_front();
+		bucket.count--;
+		count--;
+		return out;
+	}
+
+protected:
+	// Held shared while pushing and popping chunk work, and exclusively while the focus or radius (and so the meaning of the bitmaps) changes
+	std::shared_mutex layoutMutex;
+	glm::ivec2 focus = {0, 0};
+	int radius = 0, width = 1;
+
+	std::vector<Bucket> buckets;
+	Bucket urgent, overflow;
+
+	// Offsets from the focus sorted by distance, and the reverse lookup
+	std::vector<glm::ivec2> ringOrder;
+	std::vector<size_t> ringOrderIndex;
+
+	// One bit per bucket set while it holds work, then (found from those whenever the focus changes) one bit per position in the ring order
+	// set while its bucket holds work, and one bit per word of those set while the word has any set
+	std::vector<std::atomic<uint64_t>> occupiedBuckets, occupied, occupiedWords;
+	// Scratch space for rebuilding the bitmaps
+	std::vector<uint64_t> marks, words;
+	std::vector<size_t> rows, columns;
+
+	std::atomic<size_t> count = 0;
+};
+
+#endif // CHUNK_WORK_QUEUE_HPP
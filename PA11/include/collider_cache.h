@@ -0,0 +1,58 @@
+#ifndef COLLIDER_CACHE_H
+#define COLLIDER_CACHE_H
+
+#include "physics.h"
+#include "mesh_blob.h"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The bump in this number invalidates every decomposition cached on disk
+#define COLLIDER_CACHE_VERSION 1
+
+// Result of a convex decomposition
+struct ConvexDecomposition {
+	struct Hull {
+		std::vector<float> points; // x, y, z triples
+		std::vector<uint32_t> triangles; // Index triples
+	};
+
+	std::vector<Hull> hulls;
+
+	// Functions which read and write the decomposition in the compact binary cache format
+	bool load(const std::string& path, uint64_t key);
+	bool save(const std::string& path, uint64_t key) const;
+};
+
+// Bullet shapes built from a decomposition, shared between every object which uses the same model
+struct SharedConvexCollider {
+	using ptr = std::shared_ptr<SharedConvexCollider>;
+
+	std::vector<std::unique_ptr<btStridingMeshInterface>> trimeshs;
+	std::vector<std::unique_ptr<btConvexTriangleMeshShape>> shapes;
+	std::unique_ptr<btCompoundShape> compound;
+	// Cooked model the meshes point into (if they were built from one)
+	MeshBlob::ptr blob;
+};
+
+// Cache which makes sure each mesh is only ever decomposed once, results are kept in memory and on disk (keyed by a hash of the mesh and parameters)
+class ColliderCache {
+public:
+	// Requests the convex collider for a mesh, the decomposition (or cache load) happens on a worker thread
+	static std::shared_future<SharedConvexCollider::ptr> request(const Arguments& args, std::vector<float> points, std::vector<uint32_t> indices, size_t maxHulls);
+	// Requests the convex collider for a cooked model's decomposition (ready immediately, the shapes read the hulls straight out of the model)
+	static std::shared_future<SharedConvexCollider::ptr> request(MeshBlob::ptr blob);
+	// Runs V-HACD over a mesh (also used when cooking models)
+	static ConvexDecomposition decompose(const std::vector<float>& points, const std::vector<uint32_t>& indices, size_t maxHulls);
+
+protected:
+	// Hash of a mesh and the parameters used to decompose it
+	static uint64_t hash(const std::vector<float>& points, const std::vector<uint32_t>& indices, size_t maxHulls);
+	// Converts a decomposition into bullet shapes
+	static SharedConvexCollider::ptr buildCollider(const ConvexDecomposition& decomposition);
+	static SharedConvexCollider::ptr buildCollider(MeshBlob::ptr blob);
+};
+
+#endif // COLLIDER_CACHE_H
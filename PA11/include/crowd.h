@@ -0,0 +1,175 @@
+#ifndef CROWD_H
+#define CROWD_H
+
+#include "object.h"
+#include "spatial_grid.hpp"
+#include "voxel_world.h"
+
+#include <array>
+#include <vector>
+
+// The crowd is simulated at a fixed rate (catching up at most a few steps a frame), in batches of agents which are spread across the workers
+#define CROWD_STEP (1 / 30.0f)
+#define CROWD_MAX_STEPS_PER_FRAME 4
+#define CROWD_BATCH_SIZE 1024
+// How far (in each direction) an agent wanders to each waypoint, the biggest change in height it will walk to, and the longest it waits between waypoints
+#define CROWD_WANDER_DISTANCE 10
+#define CROWD_MAX_STEP_HEIGHT 5
+#define CROWD_MAX_WAIT 10
+// How fast agents wander (each is randomly up to a quarter faster or slower) and how fast aliens chase, along with how quickly (per second) agents turn towards where they want to go
+#define CROWD_WANDER_SPEED 3
+#define CROWD_CHASE_SPEED 10
+#define CROWD_STEERING 4
+// How high above the terrain an agent's origin sits
+#define CROWD_HEIGHT_OFFSET 1
+// How many agents of each species can have a rigid body (while being abducted, and until they land again) at once
+#define CROWD_BODY_POOL 8
+// How long a released body may fall before it is given back to the pool, and how slow it needs to be to count as landed
+#define CROWD_MAX_FALL_TIME 5
+#define CROWD_LANDED_SPEED 0.5
+
+// A herd of cows and aliens which are simulated together instead of as individual objects. Agents are stored as a structure of arrays
+// and moved kinematically along the terrain's heightmap, only the agents being abducted are given (pooled) rigid bodies
+class Crowd {
+public:
+	enum Species : uint8_t {
+		Cow,
+		Alien,
+		SpeciesCount
+	};
+
+	Crowd(std::shared_ptr<VoxelWorld> world): world(world) {}
+	~Crowd();
+
+	// Loads each species' model (adding them to the scene) and creates the pool of rigid bodies
+	bool initialize(const Arguments& args, Physics& physics, Object::ptr sceneRoot);
+
+	// Adds an agent, it is placed on the terrain once the terrain under it has loaded
+	size_t spawn(Species species, glm::vec2 position);
+	// Removes every agent past the given count
+	void truncate(size_t count);
+	size_t size() const { return agents.x.size(); }
+
+	// Moves an agent to a new position, clearing its waypoint and giving back its rigid body
+	void teleport(size_t agent, glm::vec2 position);
+
+	// Steps the simulation, syncs the agents with rigid bodies, and uploads the instances (main thread)
+	void update(float dt);
+
+	Species getSpecies(size_t agent) const { return (Species) agents.species[agent]; }
+	glm::vec3 getPosition(size_t agent) const { return {agents.x[agent], agents.y[agent], agents.z[agent]}; }
+	bool isPlaced(size_t agent) const { return agents.flags[agent] & Placed; }
+
+	// Finds the placed agents less than <range> from the apex whose direction from it is within the cone (by cosine) around the axis
+	void findInCone(glm::vec3 apex, glm::vec3 axis, float minCosine, float range, std::vector<uint32_t>& out) const;
+	// Finds the placed agents less than <radius> from the center
+	void findWithin(glm::vec3 center, float radius, std::vector<uint32_t>& out) const;
+	// Counts the aliens chasing the target which are within the radius of it
+	size_t countChasing(float radius) const;
+	// The index of where every agent is (kept up to date every update)
+	const SpatialGrid& getIndex() const { return index; }
+
+	// Aliens chase the target once it is close and visible enough ((100 - distance) * visibility > 10)
+	void setChaseTarget(glm::vec3 target, float visibility) { chaseTarget = target; chaseVisibility = visibility; }
+
+	// Gives every listed agent a rigid body (while the pool lasts) which floats without gravity, every other held agent is dropped
+	void hold(const std::vector<uint32_t>& held);
+	// The agents currently being held, along with their bodies
+	std::vector<std::pair<uint32_t, Object::ptr>> getHeld() const;
+
+	// The time (in milliseconds) the last update took, and the average an update has recently taken
+	float getLastUpdateTime() const { return lastUpdateTime; }
+	float getAverageUpdateTime() const { return averageUpdateTime; }
+
+protected:
+	enum Flags : uint8_t {
+		Placed = 1 << 0, // Has found the terrain under it
+		Promoted = 1 << 1, // Moved by a rigid body instead of the crowd
+		Chasing = 1 << 2
+	};
+
+	// The agents, one array per field
+	struct Agents {
+		std::vector<float> x, y, z;
+		std::vector<float> previousX, previousY, previousZ; // Before the last step (positions are interpolated between steps when drawn)
+		std::vector<float> vx, vz;
+		std::vector<float> targetX, targetZ;
+		std::vector<float> speed; // How fast the agent wanders
+		std::vector<float> wait; // Seconds until a new waypoint is picked
+		std::vector<float> heading; // Around the y axis
+		std::vector<uint32_t> random; // Per agent random state (so batches don't share a generator)
+		std::vector<int16_t> body; // Index into the species' body pool (-1 if not promoted)
+		std::vector<uint8_t> species, flags;
+	};
+
+	// A rigid body in a species' pool
+	struct Body {
+		Object::ptr object;
+		int32_t agent = -1;
+		bool held = false;
+		float fallTime = 0;
+	};
+
+	// Model which draws every agent of a species in one instanced call
+	class Model : public Object {
+	public:
+		~Model();
+		void render(Shader* boundShader) override;
+		void submit(RenderQueue& queue) override;
+		// Uploads the instance matrices (main thread)
+		void setInstances(const std::vector<glm::mat4>& instances);
+
+	protected:
+		void draw() override;
+		// The vertex array also reads the instance matrices
+		void configureVertexArray() override;
+
+		GLuint instanceBuffer = 0;
+		GLsizei instanceCount = 0;
+	};
+
+	// Steps a range of agents forward (worker threads), the agents are independent so batches never touch each other's data
+	void stepBatch(size_t begin, size_t end, size_t steps);
+	// Picks new waypoints and decides which aliens chase (branchy, so kept out of the movement loop)
+	void think(size_t begin, size_t end);
+	// Moves every agent towards its waypoint
+	void move(size_t begin, size_t end);
+	// Snaps every agent to the terrain
+	void ground(size_t begin, size_t end);
+
+	// Copies the bodies' positions into their agents, and gives back the bodies which have landed
+	void syncBodies(float dt);
+	// Gives an agent a body from its species' pool (returns false if the pool is empty)
+	bool promote(size_t agent);
+	// Gives back an agent's body
+	void demote(size_t agent);
+	// Moves every agent in the index to where it ended up this update
+	void updateIndex();
+	// Builds and uploads the instance matrices for the agents which aren't promoted
+	void uploadInstances();
+
+	// Returns a random number in [0, 1) from an agent's random state (xorshift)
+	static float random(uint32_t& state);
+
+protected:
+	std::shared_ptr<VoxelWorld> world;
+	Physics* physics = nullptr;
+	Object::ptr sceneRoot;
+
+	Agents agents;
+	SpatialGrid index;
+	// The heightmaps around the agents, copied before each update's batches are handed to the workers
+	VoxelWorld::TerrainSnapshot terrain;
+	std::array<std::shared_ptr<Model>, SpeciesCount> models;
+	std::array<std::vector<Body>, SpeciesCount> bodies;
+	std::array<std::vector<glm::mat4>, SpeciesCount> instances;
+
+	glm::vec3 chaseTarget = glm::vec3(0);
+	float chaseVisibility = 0;
+
+	float accumulator = 0;
+	float lastUpdateTime = 0, averageUpdateTime = 0;
+	uint32_t nextSeed = 1;
+};
+
+#endif // CROWD_H
@@ -6,9 +6,10 @@ enum CollisionGroups : int {
     CG_UFO = 1 << 1,
     CG_COW = 1 << 2,
     CG_ALIEN = 1 << 3,
+    CG_VEGETATION = 1 << 4,
     
     CG_NONE = 0,
-    CG_ALL = CG_ENVIRONMENT | CG_UFO | CG_COW | CG_ALIEN
+    CG_ALL = CG_ENVIRONMENT | CG_UFO | CG_COW | CG_ALIEN | CG_VEGETATION
 };
 
 #endif // CONFIG_H
\ No newline at end of file
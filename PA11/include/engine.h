@@ -19,6 +19,7 @@ class Celestial;
 class Light;
 class Sound;
 class Shader;
+class RenderQueue;
 
 // Class which provides engine related internals
 class Engine {
@@ -29,7 +30,10 @@ public:
 	virtual bool initialize(const Arguments& args);
 	virtual void run();
 	virtual void update(float dt) {}
+	// Sets any per pass uniforms (and draws anything which isn't drawn through the render queue) with the bound shader
 	virtual void render(Shader* boundShader) {}
+	// Submits the application's draws to the render queue (once per frame)
+	virtual void submit(RenderQueue& queue) {}
 
 	// Time functions
 	float getDT();
@@ -63,9 +67,15 @@ private:
 	float DT;
 	float physicsAccumulator = 0;
 	std::chrono::high_resolution_clock::time_point frameStartTime;
+	// When initialization started (used to report how long it took to get the first frame on screen)
+	std::chrono::high_resolution_clock::time_point startTime;
 	circular_buffer_array<float, 60> fpsMeasurements;
 	bool running;
 
+	// File the memory statistics are dumped to (if any) and when they were last dumped
+	std::string memoryDumpPath;
+	std::chrono::high_resolution_clock::time_point lastMemoryDump;
+
 	std::shared_ptr<Object> sceneRoot;
 };
 
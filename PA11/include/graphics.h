@@ -9,13 +9,42 @@
 #include "shader.h"
 #include "object.h"
 #include "light.h"
+#include "light_clusters.h"
+#include "render_queue.h"
 #include "gui.h"
 #include "arguments.h"
 
 
 // The height and width of our shadow maps
 #define SHADOW_RESOLUTION 4096
+// Texture units the shadow map is bound to (once with hardware depth comparison, and once without for the PCSS blocker search)
+#define SHADOW_MAP_UNIT 1
+#define SHADOW_DEPTH_UNIT 2
 
+// How many frames of gpu queries are kept in flight (so reading one back never stalls)
+#define GPU_QUERY_FRAMES 3
+
+// The filtering used when sampling the shadow map (from cheapest to softest)
+enum class ShadowQuality : int {
+	Hard, // A single hardware filtered tap
+	Poisson, // Four hardware filtered taps spread over a poisson disk
+	PCSS, // Percentage closer soft shadows (penumbras widen with the distance to the occluder)
+	Count
+};
+
+
+// A gpu query made once a frame, read back a few frames later (so it never stalls) and averaged into one of several buckets
+struct FrameQuery {
+	GLenum target;
+	GLuint queries[GPU_QUERY_FRAMES];
+	int buckets[GPU_QUERY_FRAMES]; // Which average each slot's result goes into (-1 if the slot isn't in use)
+	std::vector<float> averages; // 0 until measured
+
+	void initialize(GLenum target, size_t bucketCount);
+	// Reads back the slot's previous result, then starts measuring into the given bucket
+	void begin(size_t frame, int bucket);
+	void end(size_t frame);
+};
 
 // Forward declarations
 class Engine;
@@ -31,12 +60,31 @@ public:
 	bool initialize(int width, int height, Engine* engine, const Arguments& args);
 	void update(float dt);
 	void render();
-	void renderScene(Shader* boundShader);
+	// Renders the scene's pass (and optionally the GUI) with the bound shader
+	void renderScene(Shader* boundShader, RenderPass pass, bool drawGUI = true);
 
 	GUI* getGUI() const { return gui; }
 	Camera* getCamera() const { return camera; }
+	LightClusters& getLightClusters() { return lightClusters; }
 
 	bool useFragShader = true;
+	ShadowQuality shadowQuality = ShadowQuality::Poisson;
+	// When enabled the scene's depth is laid down first, so the lit pass only shades the visible fragment of each pixel
+	bool depthPrePass = true;
+	// When enabled the scene is submitted to the render queue (and drawn sorted by state) instead of each object drawing itself immediately
+	bool useRenderQueue = true;
+
+	static const char* shadowQualityName(ShadowQuality quality);
+	// The average gpu time (in milliseconds) of the lit pass with the given shadow quality (and with or without the depth pre-pass)
+	float getLitPassTime(ShadowQuality quality, bool prePass) const { return litPassTimer.averages[(int) quality * 2 + prePass] / 1e6; }
+	// The average gpu time (in milliseconds) of the depth pre-pass
+	float getPrePassTime() const { return prePassTimer.averages[0] / 1e6; }
+	// The average number of fragments the lit pass shades (with or without the depth pre-pass)
+	float getShadedFragments(bool prePass) const { return shadedFragments.averages[prePass]; }
+	// The average number of gl calls drawing the scene's objects takes each frame (with or without the render queue)
+	float getSceneGLCalls(bool renderQueue) const { return sceneGLCalls[renderQueue]; }
+	const RenderQueue& getRenderQueue() const { return renderQueue; }
+
 protected:
 	std::string errorString(GLenum error);
 
@@ -56,7 +104,20 @@ protected:
 	GLuint depthMapFBO;
 	GLuint depthMap;
 	GLuint debugVBO;
-	GLint lightSpaceMatrixLocation;
+	GLint lightSpaceMatrixLocation, depthViewMatrixLocation;
+	GLuint shadowCompareSampler, shadowDepthSampler;
+
+	// Queries measuring the lit pass and depth pre-pass
+	FrameQuery litPassTimer, prePassTimer, shadedFragments;
+	size_t frame = 0;
+
+	// Lights binned into view space clusters
+	LightClusters lightClusters;
+
+	// Draws gathered from the scene each frame, and the vertex array bound when drawing outside of it
+	RenderQueue renderQueue;
+	GLuint vao;
+	float sceneGLCalls[2] = {};
 
 	Object::ptr& sceneRoot;
 };
@@ -3,6 +3,9 @@
 
 #include "object.h"
 
+// How much of a light's brightness is left at the edge of its range (point and spot lights fade to nothing there)
+#define LIGHT_ATTENUATION_CUTOFF 0.01
+
 class Light : public Object {
 public:
 	using ptr = std::shared_ptr<Light>;
@@ -15,13 +18,18 @@ public:
 		Spot = 4
 	};
 public:
-	static size_t count;
-
 	Light() : Light(Type::Disabled) {}
-	Light(Type type, size_t id = 0) : type(type), id(id) {}
-	void render(Shader* boundShader) override;
+	Light(Type type);
+	~Light();
 	void update(float dt) override;
 
+	// Every light which currently exists (gathered by the renderer each frame)
+	static const std::vector<Light*>& getLights() { return lights; }
+
+	Type getType() const { return type; }
+	// The distance past which the light no longer contributes anything
+	float getRange() const { return lightAttenuationStartDistance / glm::sqrt(float(LIGHT_ATTENUATION_CUTOFF)); }
+
 	// Light color setting
 	void setAmbient(glm::vec4 color) {lightAmbient = color;}
 	void setDiffuse(glm::vec4 color) {lightDiffuse = color;}
@@ -39,22 +47,7 @@ public:
 	void enable() { setEnabled(true); }
 	void disable() { setEnabled(false); }
 protected:
-	int setupID() { return count++; }
-
-protected:
-	const size_t id;
-
-	std::string uniformLocationLightType;
-	std::string uniformLocationAmbient;
-	std::string uniformLocationDiffuse;
-	std::string uniformLocationSpecular;
-	std::string uniformLocationPosition;
-	std::string uniformLocationDirection;
-	std::string uniformLocationLightCutoffAngleCosine;
-	std::string uniformLocationLightIntensity;
-	std::string uniformLocationLightFalloff;
-	std::string uniformLocationLightAttenuationStartDistance;
-	// const std::string uniformLocationNumLights;
+	static std::vector<Light*> lights;
 
 	Type type = Type::Disabled;
 
@@ -73,7 +66,7 @@ public:
 
 class AmbientLight: public Light {
 public:
-	AmbientLight(std::string lightVariable = "lights");
+	AmbientLight();
 
 	void setEnabled(bool enable) override { type = enable ? Type::Ambient : Type::Disabled; }
 };
@@ -83,7 +76,7 @@ class DirectionalLight : public Light {
 	static DirectionalLight* primary;
 
 public:
-	DirectionalLight(std::string lightVariable = "lights");
+	DirectionalLight();
 
 	void setEnabled(bool enable) override { type = enable ? Type::Directional : Type::Disabled; }
 
@@ -93,7 +86,7 @@ public:
 // Point light object for a light source casting in all directions
 class PointLight : public Light {
 public:
-	PointLight(std::string lightVariable = "lights");
+	PointLight();
 
 	void setEnabled(bool enable) override { type = enable ? Type::Point : Type::Disabled; }
 };
@@ -102,7 +95,7 @@ public:
 class SpotLight : public Light {
 	// glm::vec3 relativeDirection = {0, -1, 0};
 public:
-	SpotLight(std::string lightVariable = "lights");
+	SpotLight();
 
 	// void update(float dt) override { lightDirection = glm::transpose(glm::inverse(getParent()->getChildBaseModel())) * glm::vec4(relativeDirection, 0); }
 
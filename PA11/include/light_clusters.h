@@ -0,0 +1,90 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include "graphics_headers.h"
+
+#include <vector>
+
+// The most lights which will be sent to the gpu each frame
+#define MAX_LIGHTS 512
+// The most lights any one cluster will shade with
+#define MAX_LIGHTS_PER_CLUSTER 64
+
+// The number of clusters (froxels) the view frustum is split into along x, y, and (exponentially spaced) z
+#define CLUSTER_COUNT_X 16
+#define CLUSTER_COUNT_Y 9
+#define CLUSTER_COUNT_Z 24
+// The view space depths the clusters cover (anything closer or farther is put in the first or last slice)
+#define CLUSTER_NEAR 1
+#define CLUSTER_FAR 1024
+
+// Shader storage binding points
+#define LIGHT_BUFFER_BINDING 0
+#define CLUSTER_BUFFER_BINDING 1
+#define CLUSTER_INDEX_BUFFER_BINDING 2
+
+class Light;
+class Shader;
+
+// Bins the scene's point and spot lights into view space clusters so each fragment only loops over the lights which can reach it
+// NOTE: Ambient terms are summed into a single color, and directional lights are shaded everywhere (they are stored ahead of the local lights)
+class LightClusters {
+public:
+	~LightClusters();
+	bool initialize();
+
+	// Gathers every enabled light and rebuilds the clusters for the current camera (main thread)
+	void update(const glm::mat4& view, const glm::mat4& projection);
+	// Binds the buffers and sets the uniforms the lighting shaders need
+	void bind(Shader* boundShader);
+
+	// When disabled every local light is put in every cluster (so the cost of shading each light can be compared)
+	bool enabled = true;
+
+	size_t getLightCount() const { return lights.size(); }
+	// The average number of lights in the clusters with at least one light
+	float getAverageLightsPerCluster() const;
+
+protected:
+	// Light as laid out in the shader storage buffer (std430)
+	struct GPULight {
+		glm::vec4 diffuse;
+		glm::vec4 specular;
+		glm::vec4 position; // World space, w = range
+		glm::vec4 direction; // w = cutoff angle cosine
+		uint32_t type;
+		float intensity;
+		float falloff;
+		float attenuationDistance;
+	};
+
+	// Where a cluster's light indices start, and how many there are
+	struct Cluster {
+		uint32_t offset, count;
+	};
+
+	// Converts a light to its gpu representation, returns false if it can't light anything
+	static bool pack(Light& light, GPULight& out);
+	// Finds a sphere (in world space) bounding the volume a light can reach
+	static glm::vec4 boundingSphere(const GPULight& light);
+	// Finds which depth slice a view space depth falls in
+	static int slice(float depth);
+
+	// Inserts a (view space) sphere into every cluster it touches
+	void insert(uint32_t lightIndex, glm::vec3 center, float radius, float tanHalfFovX, float tanHalfFovY);
+
+protected:
+	GLuint lightBuffer = 0, clusterBuffer = 0, indexBuffer = 0;
+
+	std::vector<GPULight> lights, local;
+	uint32_t directionalCount = 0;
+	glm::vec3 ambient;
+	glm::vec2 tanHalfFov;
+
+	// The lights touching each cluster (before they are flattened into the index list)
+	std::vector<std::vector<uint32_t>> clusterLights;
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> indices;
+};
+
+#endif // LIGHT_CLUSTERS_H
@@ -0,0 +1,91 @@
+#ifndef MEMORY_TRACKER_H
+#define MEMORY_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// How often (in seconds) the memory statistics are dumped when a dump file is given on the command line
+#define MEMORY_DUMP_INTERVAL 5
+
+// Accounts for where the game's memory goes. Every heap allocation (through operator new or bullet's allocator) is charged to the
+// subsystem its thread is tagged with when it is made, and credited back to that same subsystem when it is freed (the tag is kept in
+// a small header in front of the allocation). Gpu memory can't be seen from here, so the code creating buffers and textures reports
+// their sizes instead. Tag the allocations a piece of code makes with a scope, ex: MemoryTracker::Scope tag(MemoryTracker::Meshes);
+class MemoryTracker {
+public:
+	// Subsystems cpu memory is charged to
+	enum Tag : uint8_t {
+		General, // Anything not tagged
+		Voxels, // Chunks (almost entirely their voxel arrays)
+		Meshes, // Model and chunk vertices/indices (kept after they are uploaded)
+		Physics, // Everything bullet allocates (trimeshes, BVHs, shapes, bodies...)
+		Textures, // Decoded images waiting to be uploaded
+		Scratch, // Blocks held by the scratch arenas
+		TagCount
+	};
+
+	// Kinds of gpu memory
+	enum GpuTag : uint8_t {
+		GpuBuffers, // Model and chunk vertex/index buffers
+		GpuTextures, // Textures (and their mip chains)
+		GpuTagCount
+	};
+
+	// Tags every allocation the calling thread makes while the scope is alive
+	class Scope {
+	public:
+		Scope(Tag tag) : previous(current) { current = tag; }
+		~Scope() { current = previous; }
+		Scope(const Scope&) = delete;
+
+	protected:
+		Tag previous;
+	};
+
+	// Bytes currently allocated, the most there have ever been, and how many allocations are currently alive
+	struct Stats {
+		size_t bytes, highWater, allocations;
+	};
+
+public:
+	// The tag the calling thread's allocations are currently charged to
+	static Tag getTag() { return current; }
+	// The number of heap allocations the calling thread has made (ever)
+	static size_t getHeapAllocations() { return heapAllocations; }
+
+	// Charge (or credit) a heap allocation to a subsystem
+	static void allocated(Tag tag, size_t bytes);
+	static void freed(Tag tag, size_t bytes);
+	// Charge (or credit) gpu memory, ex: whenever a buffer's storage is (re)specified
+	static void gpuAllocated(GpuTag tag, size_t bytes);
+	static void gpuFreed(GpuTag tag, size_t bytes);
+	static void gpuResized(GpuTag tag, size_t oldBytes, size_t newBytes);
+
+	static Stats getStats(Tag tag);
+	static Stats getGpuStats(GpuTag tag);
+	static const char* getName(Tag tag);
+	static const char* getGpuName(GpuTag tag);
+
+	// Writes every statistic to a json file (the file is replaced all at once, so readers never see half of it)
+	static bool dump(const std::string& path);
+	// Prints how much memory each subsystem still has allocated and the most it ever had (called at shutdown to catch leaks)
+	static void report(std::ostream& out);
+
+protected:
+	struct Counter {
+		std::atomic<int64_t> bytes = 0, highWater = 0, allocations = 0;
+
+		void add(int64_t bytes, int64_t allocations);
+	};
+
+	static Counter counters[TagCount];
+	static Counter gpuCounters[GpuTagCount];
+
+	static thread_local Tag current;
+	static thread_local size_t heapAllocations;
+};
+
+#endif // MEMORY_TRACKER_H
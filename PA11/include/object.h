@@ -6,6 +6,10 @@
 #include <SDL2/SDL.h>
 #include <glm/gtx/matrix_decompose.hpp> // Matrix decomposition
 #include "physics.h"
+#include "collider_cache.h"
+#include "mesh_blob.h"
+#include "texture_streamer.h"
+#include "render_queue.h"
 #include "graphics_headers.h"
 #include "arguments.h"
 #include "defs.h"
@@ -25,8 +29,12 @@ public:
 	virtual bool initializeGraphics(const Arguments& args, std::string filepath = "", std::string texturePath = "", bool inThread = false);
 	virtual bool initializePhysics(const Arguments& args, Physics& physics, int collisionGroup = CollisionGroups::CG_NONE, float mass = 1, bool addToWorldAutomatically = true);
 	void addToPhysicsWorld(Physics& physics, int collisionGroup = CollisionGroups::CG_NONE);
+	void removeFromPhysicsWorld(Physics& physics);
 	virtual void update(float dt);
+	// Draws the object (and its children) right away, setting up all of the state each draw needs
 	virtual void render(Shader* boundShader);
+	// Submits draws of the object (and its children) to a render queue instead
+	virtual void submit(RenderQueue& queue);
 
 	// Mouse and Keyboard event propagation
 	virtual void keyboard(const SDL_KeyboardEvent& e);
@@ -54,6 +62,7 @@ public:
 	Object::ptr setParent(Object::ptr p);
 	Object::ptr getParent() const { return parent->shared_from_this(); }
 	Object::ptr addChild(Object::ptr child);
+	void removeChild(Object::ptr child);
 	const std::vector<Object::ptr>& getChildren() const { return children; }
 
 	// Sets model matrix
@@ -94,10 +103,10 @@ public:
 	// The depth in the scene tree of this object
 	const uint sceneDepth = 0;
 
-	// Load a texture from a file
+	// Load a texture from a file (the invalid texture is used until it has been streamed in)
 	bool loadTextureFile(const Arguments& args, std::string path, bool makeRelative = true);
 	// Use the same texture as another already loaded object
-	void linkTexture(Object::ptr object) { tex = object->tex; }
+	void linkTexture(Object::ptr object) { tex = object->tex; streamedTexture = object->streamedTexture; }
 
 	// Uploads the model data to the GPU
 	void finalizeModel(bool recursive = true);
@@ -105,10 +114,24 @@ public:
 protected:
 	// Model/Texture loading
 	bool LoadModelFile(const Arguments& args, const std::string& path, glm::mat4 onImportTransformation = glm::mat4(1), bool inThread = true);
+	bool LoadCookedModel(MeshBlob::ptr blob, bool inThread = true);
+
+	// The model data (read out of the cooked model if there is one)
+	const Vertex* getVertexData() const { return meshBlob ? meshBlob->getVertices(meshBlobSubmesh) : vertices.data(); }
+	size_t getVertexCount() const { return meshBlob ? meshBlob->getVertexCount(meshBlobSubmesh) : vertices.size(); }
+	const unsigned int* getIndexData() const { return meshBlob ? meshBlob->getIndices(meshBlobSubmesh) : indices.data(); }
+	size_t getIndexCount() const { return meshBlob ? meshBlob->getIndexCount(meshBlobSubmesh) : indices.size(); }
 
 	// Create a reference to the invalid texture
 	bool initalizeInvalidTexture(const Arguments& args);
 
+	// Issues the draw call once the object's buffers have been bound
+	virtual void draw();
+	// Describes the vertex layout to the object's vertex array (called once, with the vertex array bound, when the buffers are created)
+	virtual void configureVertexArray();
+	// Swaps in the texture once it has been streamed in
+	void updateStreamedTexture();
+
 	// Physics functions
 	void setPhysicsTransform(btTransform&& t) {
 		if(rigidBody) { 
@@ -118,6 +141,8 @@ protected:
 	}
 	void syncPhysicsWithGraphics(){ setPhysicsTransform( toBullet(getModel()) ); }
 	void syncGraphicsWithPhysics(){ if(rigidBody) setModel( toGLM(rigidBody->getWorldTransform()) ); }
+	// Swaps in the shared convex collider once its decomposition has finished
+	void applyPendingCollider();
 		
 
 	// Decompose the model matrix
@@ -153,24 +178,40 @@ protected:
 	glm::mat4 childModel = glm::mat4(1); // Model matrix that is used as the base of to this object's children's model matricies
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
+	// Cooked model (and which of its submeshes) this object's model data is read from instead, when its model has been cooked
+	MeshBlob::ptr meshBlob;
+	size_t meshBlobSubmesh = 0;
 
 	GLuint VB = -1;
 	GLuint IB = -1;
+	// Vertex array describing the buffers (so the render queue can draw the mesh with a single bind)
+	GLuint VAO = -1;
+	// Size of the vertex and index buffers together (tracked for the memory statistics)
+	size_t bufferBytes = 0;
 	GLuint tex = -1;
 	static GLuint invalidTex;
+	// Texture which is swapped in once it has been streamed onto the gpu
+	StreamedTexture::ptr streamedTexture;
 
 	// Physics rigidbody
 	bool addedToPhysicsWorld = false;
+	int collisionGroup = CollisionGroups::CG_NONE;
 	std::vector<std::unique_ptr<btTriangleMesh>> trimeshs;
 	std::vector<std::unique_ptr<btConvexTriangleMeshShape>> shapes;
 	std::unique_ptr<btDefaultMotionState> motionState = nullptr;
 	std::unique_ptr<btRigidBody> rigidBody = nullptr;
 	std::unique_ptr<btCollisionShape> collisionShape = nullptr;
+	// Convex collider shared with every other object using the same mesh (and the decomposition it is waiting on)
+	std::shared_future<SharedConvexCollider::ptr> pendingCollider;
+	SharedConvexCollider::ptr sharedCollider = nullptr;
 
 	// rp3d::Collider* collider = nullptr;
 
 	Object* parent;
 	std::vector<Object::ptr> children;
+
+	// The render queue issues the draws
+	friend class RenderQueue;
 };
 
 // Objects which do nothing when initialized and link their model matrix to their parent each frame
@@ -0,0 +1,91 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include "graphics_headers.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Bits of the sort key given to each field (from most to least significant), names and distances are truncated to fit
+#define RENDER_KEY_PASS_BITS 4
+#define RENDER_KEY_PROGRAM_BITS 8
+#define RENDER_KEY_TEXTURE_BITS 12
+#define RENDER_KEY_MESH_BITS 20
+#define RENDER_KEY_DEPTH_BITS 20
+// Distance from the camera covered by the depth field (anything farther shares the last value)
+#define RENDER_QUEUE_MAX_DEPTH 1024
+
+// Counts a gl call made while drawing the scene's objects (so drawing them through the queue can be compared to drawing them immediately)
+#define COUNTED_GL(call) (RenderQueue::glCalls++, call)
+
+class Object;
+class Shader;
+
+// The passes the scene is drawn in (in the order they are drawn)
+enum class RenderPass : uint8_t {
+	Shadow, // Depth from the primary light
+	DepthPrePass, // Depth from the camera
+	Lit,
+	Count
+};
+
+// Draws the scene in two phases: every object submits the draws it wants to a queue once per frame, producing small packets ordered by a
+// 64 bit key (pass, program, texture, mesh, then depth), then each pass walks its packets in key order. Since draws sharing state end up
+// next to each other, the state is only changed when it differs from the last packet's. Passes which lay down depth (and the lit pass when
+// there is no pre-pass) are ordered front to back instead (pass, program, depth, then mesh), so nearer terrain hides what is behind it.
+// NOTE: Meshes are drawn through their own vertex array (configured once when they are uploaded), so a draw is just a bind and a call
+class RenderQueue {
+public:
+	// Called with the vertex array which is bound outside of the queue (it is rebound once a pass finishes, so nothing else modifies a mesh's)
+	void initialize(GLuint defaultVertexArray) { this->defaultVertexArray = defaultVertexArray; }
+
+	// Starts a new frame, the shader each pass will be drawn with is given up front (passes without one aren't drawn this frame)
+	void begin(glm::vec3 viewPosition, const std::array<Shader*, (size_t) RenderPass::Count>& passShaders);
+	// Adds a draw of an object's mesh to every pass drawn this frame (main thread)
+	void submit(Object* object, const glm::mat4& model, GLuint vertexArray, GLuint texture, bool instanced = false);
+	// Orders the packets by their keys, call once everything has been submitted
+	void sort();
+	// Draws a pass' packets, its shader must already be bound (with texture unit 0 active)
+	void execute(RenderPass pass);
+
+	// Packets made this frame, and how many times the program, vertex array, and texture were changed while drawing them
+	size_t getPacketCount() const { return packets.size(); }
+	size_t getStateChanges() const { return stateChanges; }
+
+	// Gl calls made drawing the scene's objects (reset every frame by the graphics)
+	static size_t glCalls;
+
+protected:
+	// Everything needed to draw an object once (shared by the packets of every pass)
+	struct Draw {
+		glm::mat4 model;
+		Object* object;
+		GLuint vertexArray, texture;
+		bool instanced;
+	};
+
+	// A draw in a pass
+	struct Packet {
+		uint64_t key;
+		uint32_t draw;
+	};
+
+	// Builds a sort key, ordering by state or front to back (depth ahead of the texture and mesh)
+	static uint64_t makeKey(RenderPass pass, GLuint program, GLuint texture, GLuint vertexArray, float depth, bool frontToBack);
+	static RenderPass passOf(uint64_t key) { return (RenderPass) (key >> (64 - RENDER_KEY_PASS_BITS)); }
+
+protected:
+	std::vector<Draw> draws;
+	std::vector<Packet> packets;
+	glm::vec3 viewPosition;
+	size_t stateChanges = 0;
+
+	// The shader of each pass (and where its uniforms are)
+	std::array<Shader*, (size_t) RenderPass::Count> passShaders = {};
+	std::array<GLint, (size_t) RenderPass::Count> modelMatrixLocations, instancedLocations;
+
+	GLuint defaultVertexArray = 0;
+};
+
+#endif // RENDER_QUEUE_H
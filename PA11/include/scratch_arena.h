@@ -0,0 +1,62 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+// Size of the blocks scratch arenas are made of (allocations larger than this get a block of their own)
+#define SCRATCH_ARENA_BLOCK_SIZE (1024 * 1024)
+
+// Linear allocator for the temporary data chunk jobs build up (section meshes while generating and remeshing). Allocating just bumps an
+// offset through a list of blocks and freeing does nothing, instead everything allocated inside of a scope is released at once when
+// the scope ends. The blocks are kept for the next scope, so once a thread's arena has grown to fit its jobs they stop touching the heap.
+// Containers draw from an arena through std::pmr, ex: std::pmr::vector<Vertex> vertices(&ScratchArena::local());
+class ScratchArena : public std::pmr::memory_resource {
+public:
+	// Releases everything allocated from an arena while the scope was alive (every task the scheduler runs is wrapped in one)
+	class Scope {
+	public:
+		Scope(ScratchArena& arena = ScratchArena::local()) : arena(arena), block(arena.block), offset(arena.offset) {}
+		~Scope() { arena.rewind(block, offset); }
+		Scope(const Scope&) = delete;
+
+	protected:
+		ScratchArena& arena;
+		size_t block, offset;
+	};
+
+public:
+	ScratchArena() = default;
+	~ScratchArena();
+	ScratchArena(const ScratchArena&) = delete;
+
+	// The calling thread's arena
+	static ScratchArena& local();
+
+	// Bytes currently allocated from the arena, the most there have ever been, and how much the arena is holding onto
+	size_t getUsed() const { return usedBefore + offset; }
+	size_t getHighWater() const { return highWater; }
+	size_t getCapacity() const;
+
+protected:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	// Memory is only released when a scope ends
+	void do_deallocate(void* pointer, size_t bytes, size_t alignment) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	// Releases everything allocated after a position
+	void rewind(size_t block, size_t offset);
+
+protected:
+	struct Block {
+		std::byte* data;
+		size_t size;
+	};
+	std::vector<Block> blocks;
+	// Where the next allocation goes (a block, and how far into it), and the size of the blocks before it
+	size_t block = 0, offset = 0, usedBefore = 0;
+	size_t highWater = 0;
+};
+
+#endif // SCRATCH_ARENA_H
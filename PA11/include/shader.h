@@ -7,7 +7,15 @@
 #include "graphics_headers.h"
 #include "arguments.h"
 
+// Uncomment to validate programs after they are linked (validation depends on the current GL state, so it is only useful while debugging)
+// #define SHADER_VALIDATE
+
+// The bump in this number invalidates every program binary cached on disk
+#define SHADER_CACHE_VERSION 1
+
 // Object representing a shader program
+// NOTE: Linked programs are cached on disk (keyed by a hash of their sources and the driver), and linking is split from waiting on the
+//	result so that several programs can be compiled at once. Call link() on every program before finalize() on any of them.
 class Shader {
 public:
 	Shader();
@@ -15,12 +23,39 @@ public:
 	bool initialize();
 	void enable();
 	bool addShader(GLenum ShaderType, std::string filePath, const Arguments& args);
+	// Starts loading the program from the cache, or compiling and linking it, without waiting for the driver to finish
+	bool link();
+	// Waits for the program to finish linking, reports any errors, and caches the program if it was compiled
 	bool finalize();
 	GLint getUniformLocation(const char* pUniformName);
+	GLuint getProgram() const { return shaderProg; }
+
+	// How many programs were loaded from (or missing from) the cache
+	static size_t getCacheHits() { return cacheHits; }
+	static size_t getCacheMisses() { return cacheMisses; }
+
+private:
+	// Hash of the program's sources and the driver which compiles them
+	uint64_t cacheKey() const;
+	std::string cachePath() const;
+	// Functions which load and save the linked program
+	bool loadBinary();
+	bool saveBinary() const;
 
 private:
 	GLuint shaderProg;
 	std::vector<GLuint> shaderObjList;
+
+	// The source of each stage, compiled when the program is linked (if it wasn't in the cache)
+	struct Stage {
+		GLenum type;
+		std::string filePath, source;
+	};
+	std::vector<Stage> stages;
+	std::string cacheDirectory;
+	bool linked = false, loadedFromCache = false;
+
+	static size_t cacheHits, cacheMisses;
 };
 
 #endif  /* SHADER_H */
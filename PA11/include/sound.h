@@ -2,36 +2,54 @@
 #define SOUND_H
 
 #include "../thirdparty/miniaudio.h"
+#include "spsc_queue.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <map>
 #include <string>
+#include <vector>
 
-//One individual sound effect
+// The format every sound is converted to and mixed in
+#define SOUND_CHANNELS 2
+#define SOUND_SAMPLE_RATE 48000
+// How many sounds can play at once (when every voice is busy the oldest one-shot is cut off)
+#define SOUND_VOICES 16
+// How many commands can be waiting for the mixer (commands past this are dropped rather than waiting on the audio thread)
+#define SOUND_COMMAND_QUEUE_SIZE 64
+// How many frames of a streamed sound are decoded at a time
+#define SOUND_STREAM_CHUNK 1024
+
+// One individual sound effect, either decoded into memory up front (short effects) or decoded from disk as it plays (music)
 class SoundEffect {
 friend class Sound;
 public:
-	// Struct storing the data which is provided to the data callback
-	struct UserData {
-		ma_decoder* decoder;
-		bool looping = false;
-	};
-public:
-	SoundEffect(const char* filePath);
-	ma_device* getDevice() { return device; }
-	ma_decoder* getDecoder() { return userData.decoder; }
+	SoundEffect(const char* filePath, bool streamed);
+	~SoundEffect();
 
-	void setLooping(bool looping) { userData.looping = looping; }
+	bool isValid() const { return streamed ? decoder != nullptr : !samples.empty(); }
 
 private:
-	UserData userData;
-	ma_device_config config;
-	ma_device* device;
-	const char* filePath;
-
-	bool isPlaying = false;
+	// The decoded sound (interleaved), empty if the sound is streamed
+	std::vector<float> samples;
+	// The decoder a streamed sound reads from (only touched by the audio thread once the mixer has started)
+	ma_decoder* decoder = nullptr;
+	bool streamed;
 };
 
-//Stores sound effects. Starts and stops sounds
+// Mixes every sound effect into a single playback device. The game thread sends commands through a lock-free queue,
+// so starting and stopping sounds never waits on the audio thread
 class Sound {
+public:
+	// Measurements taken on the audio thread
+	struct Stats {
+		float averageLatency; // Milliseconds from a sound being started to its first samples being handed to the device
+		float maxLatency;
+		float load; // Fraction of each callback's time budget spent mixing
+		uint32_t activeVoices;
+		uint32_t droppedCommands;
+	};
+
 public:
 	Sound();
 	~Sound();
@@ -40,8 +58,62 @@ public:
 	void stopSound(std::string key);
 	void stopAllSounds();
 
+	Stats getStats() const;
+
+private:
+	// A request from the game thread
+	struct Command {
+		enum Type : uint8_t {
+			Start,
+			Stop,
+			StopAll
+		};
+
+		Type type;
+		uint8_t effect;
+		bool fromBeginning, looping;
+		std::chrono::steady_clock::time_point issued;
+	};
+
+	// A sound being played (only touched by the audio thread)
+	struct Voice {
+		int effect = -1; // -1 if the voice is free
+		uint64_t cursor = 0; // Next frame to play (cached sounds)
+		bool looping = false;
+		uint64_t started = 0; // When the voice was started (used to pick which voice to steal)
+	};
+
+	// Adds an effect which can be started by name
+	void addEffect(std::string key, const char* filePath, bool streamed = false);
+	// Sends a command to the audio thread (dropping it if the queue is full)
+	void send(const Command& command);
+
+	// Audio thread: applies the waiting commands, then mixes every voice into the output
+	void mix(float* output, ma_uint32 frameCount);
+	void apply(const Command& command);
+	// Audio thread: finds a free voice, or steals the oldest one-shot
+	Voice* allocateVoice();
+	// Audio thread: adds a voice into the output, returns false once the voice has finished
+	bool mixVoice(Voice& voice, float* output, ma_uint32 frameCount);
+
+	static void dataCallback(ma_device* device, void* output, const void* input, ma_uint32 frameCount);
+
 private:
-	std::map<std::string, SoundEffect*> soundEffects;
+	std::map<std::string, uint8_t> effectIndices;
+	std::vector<SoundEffect*> soundEffects;
+
+	ma_device device;
+	bool deviceInitialized = false;
+
+	spsc_queue<Command, SOUND_COMMAND_QUEUE_SIZE> commands;
+	std::array<Voice, SOUND_VOICES> voices;
+	uint64_t voicesStarted = 0;
+	// Scratch space streamed sounds are decoded into
+	std::array<float, SOUND_STREAM_CHUNK * SOUND_CHANNELS> streamBuffer;
+
+	// Written by the audio thread, read by the game thread
+	std::atomic<float> averageLatency = 0, maxLatency = 0, load = 0;
+	std::atomic<uint32_t> activeVoices = 0, droppedCommands = 0;
 };
 
 #endif
@@ -0,0 +1,131 @@
+#ifndef SPATIAL_GRID_HPP
+#define SPATIAL_GRID_HPP
+
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+#include <glm/gtx/norm.hpp>
+
+// The default size of a cell (the same as a chunk, so the cells line up with the chunks)
+#define SPATIAL_GRID_CELL_SIZE 16
+
+// Uniform grid over x and z which indexes points by a (dense) integer id, so proximity queries only visit the cells near them
+// NOTE: The cells are columns (the world is only a few hundred units tall), y is only checked against each point.
+//	Positions must have a finite x and z
+class SpatialGrid {
+public:
+	SpatialGrid(float cellSize = SPATIAL_GRID_CELL_SIZE): cellSize(cellSize) {}
+
+	// Adds a point, or moves it (it only changes cells when it crosses into another one)
+	void update(uint32_t id, glm::vec3 position) {
+		if(id >= locations.size()) locations.resize(id + 1);
+		Location& location = locations[id];
+		glm::ivec2 cell = cellOf(position);
+
+		if(location.bucket) {
+			// Staying in the same cell only needs the stored position updated
+			if(location.cell == cell) {
+				(*location.bucket)[location.slot].position = position;
+				return;
+			}
+			erase(location);
+		}
+
+		// NOTE: Pointers to the buckets stay valid as other cells are added and removed
+		auto& bucket = cells[cell];
+		location = {cell, &bucket, (uint32_t) bucket.size()};
+		bucket.push_back({position, id});
+		count++;
+	}
+
+	// Removes a point (if it is in the grid)
+	void remove(uint32_t id) {
+		if(id >= locations.size() || !locations[id].bucket) return;
+		erase(locations[id]);
+	}
+
+	void clear() {
+		cells.clear();
+		locations.clear();
+		count = 0;
+	}
+
+	size_t size() const { return count; }
+
+	// Calls f(id, position) for every point inside the box
+	template<typename F>
+	void forEachInBox(glm::vec3 min, glm::vec3 max, F&& f) const {
+		glm::ivec2 first = cellOf(min), last = cellOf(max);
+		for(int x = first.x; x <= last.x; x++)
+			for(int z = first.y; z <= last.y; z++) {
+				auto found = cells.find({x, z});
+				if(found == cells.end()) continue;
+
+				for(auto& entry: found->second)
+					if(glm::all(glm::greaterThanEqual(entry.position, min)) && glm::all(glm::lessThanEqual(entry.position, max)))
+						f(entry.id, entry.position);
+			}
+	}
+
+	// Calls f(id, position) for every point less than <radius> from the center
+	template<typename F>
+	void forEachInRadius(glm::vec3 center, float radius, F&& f) const {
+		forEachInBox(center - radius, center + radius, [&](uint32_t id, glm::vec3 position) {
+			if(glm::distance2(position, center) < radius * radius)
+				f(id, position);
+		});
+	}
+
+	// Calls f(id, position) for every point less than <range> from the apex whose direction from it is within the cone (by cosine) around the (normalized) axis
+	template<typename F>
+	void forEachInCone(glm::vec3 apex, glm::vec3 axis, float minCosine, float range, F&& f) const {
+		forEachInRadius(apex, range, [&](uint32_t id, glm::vec3 position) {
+			glm::vec3 offset = position - apex;
+			if(glm::dot(offset, axis) > minCosine * glm::length(offset))
+				f(id, position);
+		});
+	}
+
+	// Collect the ids (instead of visiting them)
+	void queryBox(glm::vec3 min, glm::vec3 max, std::vector<uint32_t>& out) const { out.clear(); forEachInBox(min, max, [&out](uint32_t id, glm::vec3) { out.push_back(id); }); }
+	void queryRadius(glm::vec3 center, float radius, std::vector<uint32_t>& out) const { out.clear(); forEachInRadius(center, radius, [&out](uint32_t id, glm::vec3) { out.push_back(id); }); }
+	void queryCone(glm::vec3 apex, glm::vec3 axis, float minCosine, float range, std::vector<uint32_t>& out) const { out.clear(); forEachInCone(apex, axis, minCosine, range, [&out](uint32_t id, glm::vec3) { out.push_back(id); }); }
+
+protected:
+	struct Entry {
+		glm::vec3 position;
+		uint32_t id;
+	};
+
+	// Where a point is stored (a null bucket if it isn't in the grid)
+	struct Location {
+		glm::ivec2 cell;
+		std::vector<Entry>* bucket = nullptr;
+		uint32_t slot = 0;
+	};
+
+	glm::ivec2 cellOf(glm::vec3 position) const { return glm::ivec2(glm::floor(glm::vec2(position.x, position.z) / cellSize)); }
+
+	// Swaps the last point in the bucket into the removed point's slot (freeing the cell once it is empty)
+	void erase(Location& location) {
+		auto& bucket = *location.bucket;
+		bucket[location.slot] = bucket.back();
+		locations[bucket[location.slot].id].slot = location.slot;
+		bucket.pop_back();
+		if(bucket.empty()) cells.erase(location.cell);
+
+		location.bucket = nullptr;
+		count--;
+	}
+
+protected:
+	float cellSize;
+	std::unordered_map<glm::ivec2, std::vector<Entry>> cells;
+	std::vector<Location> locations;
+	size_t count = 0;
+};
+
+#endif // SPATIAL_GRID_HPP
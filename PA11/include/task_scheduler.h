@@ -0,0 +1,100 @@
+#ifndef TASK_SCHEDULER_H
+#define TASK_SCHEDULER_H
+
+#include "chunk_work_queue.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Class which runs a graph of dependent tasks. Tasks either run on a pool of worker threads or on the main thread
+// (for anything which needs the OpenGL context), and a task only becomes runnable once every task it depends on has finished
+class TaskScheduler {
+public:
+	// Where a task is allowed to run
+	enum Affinity {
+		Worker,
+		MainThread
+	};
+
+	// A single node in the task graph
+	struct Task {
+		using ptr = std::shared_ptr<Task>;
+
+		Task(Affinity affinity, std::function<void()> function, std::optional<glm::ivec2> chunkCoordinates)
+			: affinity(affinity), function(std::move(function)), chunkCoordinates(chunkCoordinates) {}
+
+		// Where the task runs
+		const Affinity affinity;
+		// The work the task preforms (released once the task has run so that captured state doesn't outlive the task)
+		std::function<void()> function;
+		// The chunk the task works on, tasks are prioritized by how close their chunk is to the focus (tasks without a chunk run first)
+		const std::optional<glm::ivec2> chunkCoordinates;
+
+		bool isFinished() { std::scoped_lock lock(mutex); return finished; }
+
+	protected:
+		friend class TaskScheduler;
+
+		// Mutex guarding the list of dependents and the finished flag
+		std::mutex mutex;
+		std::vector<ptr> dependents;
+		bool finished = false;
+		// The number of dependencies which haven't finished yet (starts at one, that hold is released when the task is submitted)
+		std::atomic<size_t> unresolvedDependencies = 1;
+	};
+
+public:
+	TaskScheduler(int radius, size_t workerCount = std::max<size_t>(std::thread::hardware_concurrency(), 3) - 1);
+	~TaskScheduler() { stop(); }
+
+	// Creates a task which won't run until it has been submitted
+	Task::ptr createTask(Affinity affinity, std::function<void()> function, std::optional<glm::ivec2> chunkCoordinates = {}) { return std::make_shared<Task>(affinity, std::move(function), chunkCoordinates); }
+	// Marks that <task> can't start until <dependency> has finished (must be called before <task> is submitted)
+	void addDependency(const Task::ptr& task, const Task::ptr& dependency);
+	// Marks the task as ready to run once its dependencies have finished
+	void submit(const Task::ptr& task);
+	// Creates, links, and submits a task all at once
+	Task::ptr schedule(Affinity affinity, std::function<void()> function, std::optional<glm::ivec2> chunkCoordinates = {}, std::initializer_list<Task::ptr> dependencies = {});
+
+	// Changes which chunk tasks are prioritized around (called when the player crosses a chunk boundary)
+	void setFocus(glm::ivec2 chunkCoordinates) { workerQueue.setFocus(chunkCoordinates); mainThreadQueue.setFocus(chunkCoordinates); }
+	// Changes how far from the focus chunk tasks are prioritized by distance (tasks for chunks farther away run after all of them)
+	void setRadius(int radius) { workerQueue.setRadius(radius); mainThreadQueue.setRadius(radius); }
+
+	// Runs main thread tasks until there are none left or the time budget has been spent (at least one task is always run)
+	size_t drainMainThread(std::chrono::microseconds budget);
+
+	// Stops and joins all of the worker threads
+	void stop();
+
+	size_t getWorkerCount() const { return workers.size(); }
+
+	// Measures the chunk work queue against a heap which is re-sorted whenever the focus moves (printed to the console)
+	static void benchmark(int radius, size_t crossings, size_t pushesPerCrossing);
+
+protected:
+	// Adds a task whose dependencies have all been resolved to the correct ready queue
+	void enqueue(Task::ptr task);
+	// Runs a task and releases its dependents
+	void run(const Task::ptr& task);
+
+	// Worker thread state (the mutex is only used to put idle workers to sleep, popping work doesn't need it)
+	std::vector<std::thread> workers;
+	std::mutex workerMutex;
+	std::condition_variable workerCondition;
+	ChunkWorkQueue<Task::ptr> workerQueue;
+	std::atomic<bool> shouldWorkersRun = true;
+
+	// Main thread state
+	ChunkWorkQueue<Task::ptr> mainThreadQueue;
+};
+
+#endif // TASK_SCHEDULER_H
@@ -0,0 +1,89 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include "graphics_headers.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// How long (in milliseconds) the main thread may spend each frame uploading textures
+#define TEXTURE_UPLOAD_BUDGET 2
+// How many rows of a mip level are uploaded in each step
+#define TEXTURE_UPLOAD_ROWS 128
+
+// A texture which is streamed in, it can't be used until it is resident
+struct StreamedTexture {
+	using ptr = std::shared_ptr<StreamedTexture>;
+
+	// The OpenGL texture (only valid once the texture is resident)
+	GLuint id = 0;
+	bool isResident() const { return resident.load(std::memory_order_acquire); }
+
+protected:
+	std::atomic<bool> resident = false;
+	friend class TextureStreamer;
+};
+
+// Service which streams textures onto the gpu
+// NOTE: Images are decoded (and their mip chains built) on worker threads, the main thread then uploads them through a pixel buffer
+//	object a few rows at a time, stopping each frame once its budget has been spent. Textures are shared between everything which requests the same file.
+class TextureStreamer {
+public:
+	// Requests a texture, returns immediately (safe to call from any thread)
+	static StreamedTexture::ptr request(const std::string& path);
+	// Loads a texture and waits for it to be resident, returns nullptr if it couldn't be loaded (main thread)
+	static StreamedTexture::ptr load(const std::string& path);
+	// Uploads decoded textures until the budget runs out (main thread)
+	static void pump(std::chrono::steady_clock::duration budget = std::chrono::milliseconds(TEXTURE_UPLOAD_BUDGET));
+
+protected:
+	// A decoded RGBA image and its mip chain
+	struct Image {
+		struct Level {
+			int width, height;
+			std::vector<uint8_t> pixels;
+		};
+		std::vector<Level> levels;
+	};
+
+	// A texture being decoded
+	struct Decode {
+		StreamedTexture::ptr texture;
+		std::string path;
+		std::future<std::optional<Image>> image;
+	};
+
+	// A texture being uploaded
+	struct Upload {
+		StreamedTexture::ptr texture;
+		Image image;
+		size_t level = 0, row = 0;
+	};
+
+	// Decodes an image and builds its mip chain (worker thread)
+	static std::optional<Image> decode(const std::string& path);
+	// Creates the texture and allocates every mip level
+	static void allocate(StreamedTexture& texture, const Image& image);
+	// Uploads the next few rows of a texture, returns true once the whole texture has been uploaded
+	static bool uploadStep(Upload& upload);
+
+protected:
+	// Every texture which has been requested (keyed by path) and the textures still being decoded
+	static std::mutex mutex;
+	static std::unordered_map<std::string, StreamedTexture::ptr> textures;
+	static std::vector<Decode> decoding;
+
+	// Textures waiting to be (or partially) uploaded and the buffer they are uploaded through (main thread only)
+	static std::deque<Upload> uploads;
+	static GLuint pixelBuffer;
+};
+
+#endif // TEXTURE_STREAMER_H
@@ -2,25 +2,49 @@
 #define VOXEL_WORLD_H
 
 #include "chunk.h"
+#include "chunk_store.h"
 #include "circular_buffer.hpp"
 #include "monitor.hpp"
+#include "task_scheduler.h"
 
-#include <queue>
 #include <algorithm>
-#include <thread>
 #include <optional>
+#include <unordered_map>
+#include <glm/gtx/hash.hpp>
 
+// The default number of chunks loaded in each direction around the player (can be overridden by the "View Radius" config key)
 #define WORLD_RADIUS 16
-
-// Class which extends a priority queue to allow access to its comparision object
-template<class T, class Container = std::vector<T>, class Compare = std::less<typename Container::value_type>>
-struct ModifiablePriorityQueue : public std::priority_queue<T, Container, Compare> {
-	using std::priority_queue<T, Container, Compare>::priority_queue;
-	Compare& getCompare() { return std::priority_queue<T, Container, Compare>::comp; }
-	Container& getContainer() { return std::priority_queue<T, Container, Compare>::c; }
-};
+// The range the view radius can be changed within at runtime
+#define MIN_WORLD_RADIUS 4
+#define MAX_WORLD_RADIUS 48
+// How many rows past the view radius chunks in the direction of travel are prefetched, and how wide (cosine of the half angle) that cone is
+#define PREFETCH_ROWS 4
+#define PREFETCH_CONE_COS 0.866 // 30 degrees
+// How far ahead (in seconds of travel) the chunk scheduler's focus is moved, so chunks ahead are worked on before chunks behind
+#define PREFETCH_LOOKAHEAD 3
+// How much the camera's look direction is weighted against the direction of travel
+#define PREFETCH_LOOK_WEIGHT 0.5
+// Speed below which the player isn't considered to be traveling anywhere
+#define PREFETCH_MIN_SPEED 1
+// The number of distinct directions the travel direction is snapped to (so the cone isn't recalculated every frame)
+#define PREFETCH_DIRECTIONS 16
+// How close (in world units) a dynamic body needs to be to a tree for the tree to be given a collider, and the size of that collider
+#define TREE_PROXY_DISTANCE 8
+#define TREE_TRUNK_RADIUS 1
+#define TREE_TRUNK_HEIGHT 5
+// How long (in milliseconds) the main thread may spend each frame on chunk tasks which need the OpenGL context
+#define CHUNK_MAIN_THREAD_BUDGET 4
 
 struct VoxelWorld {
+	// Shapes which can be used to edit the terrain
+	struct Sphere {
+		glm::vec3 center;
+		float radius;
+	};
+	struct Box {
+		glm::vec3 min, max;
+	};
+
 	struct RaycastResult {
 		float closestHitFraction;
 		const btCollisionObject* collisionObject;
@@ -28,18 +52,41 @@ struct VoxelWorld {
 		glm::vec3 point, normal;
 	};
 
-	VoxelWorld(Arguments& args): args(args) {}
-	~VoxelWorld() {
-		shouldMeshingThreadRun = false; meshingThread.join();
-		shouldCollisionThreadRun = false; collisionThread.join();
-	}
+	// Copies of some of the uploaded chunks' heightmaps, which worker threads can sample while the chunk pipeline keeps changing the world
+	struct TerrainSnapshot {
+		std::unordered_map<glm::ivec2, Chunk::Heightmap> heightmaps;
+		// Samples the copied heightmaps the same way as getTerrainHeight (NAN outside of the copied chunks)
+		float getHeight(glm::vec2 worldPos) const;
+	};
+
+	VoxelWorld(Arguments& args): args(args), scheduler(WORLD_RADIUS + PREFETCH_ROWS * 2) {}
+	~VoxelWorld();
 
 	void initialize(glm::ivec2 playerChunk = {0, 0});
     void update(float dt);
-    void render(Shader* boundShader);
+    // Draws the chunks (and their trees) front to back from the view position, so nearer terrain hides what is behind it before it is shaded
+    void render(Shader* boundShader, glm::vec3 viewPosition);
+    // Submits the chunks (and their trees) to a render queue instead
+    void submit(RenderQueue& queue, glm::vec3 viewPosition);
 
 	glm::ivec2 getPlayerChunkCoordinates(){ return playerChunk; }
 
+	// Functions which change how many chunks are loaded around the player, only the chunks entering or leaving the radius are touched
+	int getRadius() const { return radius; }
+	void setRadius(int radius);
+	// Function which returns how many chunks are currently loaded
+	size_t getLoadedChunkCount() const { return chunks.size(); }
+
+	// Function which tells the world how the player is moving and looking (in world space), chunks in the cone ahead of them are prefetched and prioritized
+	void setPlayerMotion(glm::vec3 velocity, glm::vec3 lookDirection);
+	// Functions which enable or disable the velocity aware prefetching
+	bool getPrefetching() const { return prefetching; }
+	void setPrefetching(bool prefetching);
+
+	// Functions which track how many chunks have been visible (within the radius and in front of the camera) before they finished generating
+	size_t getPopInCount() const { return popInCount; }
+	void resetPopInCount() { popInCount = 0; }
+
 	// Functions which update which chunk the player is in and load chunks around them accordingly
 	void stepPlayerPosX();
 	void stepPlayerNegX();
@@ -59,51 +106,112 @@ struct VoxelWorld {
 	// Function which determines the highest Y of the world value given its X and Z coordinate
 	float getWorldHeight(glm::ivec2 worldPos);
 	float getWorldHeight(glm::ivec3 worldPos) { return getWorldHeight({worldPos.x, worldPos.z}); }
+	// Function which bilinearly samples the heightmaps of the uploaded chunks (NAN if the terrain there isn't loaded), cheaper than getWorldHeight since nothing is raycast
+	// NOTE: Main thread only, worker threads sample a TerrainSnapshot instead
+	float getTerrainHeight(glm::vec2 worldPos) const;
+	// Function which copies the heightmaps of the uploaded chunks between two chunk coordinates (inclusive) into a snapshot (main thread)
+	void snapshotTerrain(glm::ivec2 min, glm::ivec2 max, TerrainSnapshot& snapshot) const;
+
+	// The scheduler the chunk pipeline runs on (other systems may split their work across its workers)
+	TaskScheduler& getScheduler() { return scheduler; }
+
+	// Functions which add (positive delta) or remove (negative delta) terrain inside of a shape, only the affected sections of the affected chunks are rebuilt
+	void modifyDensity(Sphere sphere, float delta) { modifyDensity({Chunk::DensityEdit::Sphere, sphere.center - sphere.radius, sphere.center + sphere.radius, delta}); }
+	void modifyDensity(Box box, float delta) { modifyDensity({Chunk::DensityEdit::Box, box.min, box.max, delta}); }
+
+	// Function which runs the provided function on the main thread once the chunk containing the given position is collidable
+	void whenCollidable(glm::ivec2 worldPos, std::function<void()> callback);
+	// Function which returns the average time (in milliseconds) it has recently taken for chunks to go from requested to collidable
+	float getAverageChunkLatency();
+	// Functions which return how many heap allocations meshing a chunk and building its collider have recently taken (on average)
+	float getAverageMeshAllocations() { return average(meshAllocationMeasurements); }
+	float getAverageColliderAllocations() { return average(colliderAllocationMeasurements); }
+	// Function which returns how often chunks are being served from the chunk store instead of being regenerated
+	ChunkStore::Stats getChunkStoreStats() const { return store.getStats(); }
 
 protected:
-    void AddPosX(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks);
-    void AddNegX(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks);
-    static std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1> generateChunksX(const Arguments& args, size_t X, size_t startZ);
-
-    void AddPosZ(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks);
-    void AddNegZ(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks);
-    static std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1> generateChunksZ(const Arguments& args, size_t startX, size_t Z);
-
-	// Structure which sorts chunks based on their distance to the player's chunk
-	struct MeshingSort {
-		glm::ivec2* playerChunk;
-
-		bool operator() (const Chunk::ptr& a, const Chunk::ptr& b){
-			glm::vec3 origin = {16 * playerChunk->x, -CHUNK_HEIGHT / 2, 16 * playerChunk->y};
-			return glm::length2(a->getPosition() - origin) > glm::length2(b->getPosition() - origin);
-		}
-		// Overload which allows generation pairs to be passed in
-		bool operator() (const std::pair<Chunk::ptr, glm::ivec2>& a, const std::pair<Chunk::ptr, glm::ivec2>& b){ return operator() (a.first, b.first); }
-	};
+	// Function which moves the player by the given number of chunks
+	void stepPlayer(glm::ivec2 step);
+	// Function which frees the chunks outside of the square around the player (and the prefetch cone) and requests the chunks inside of them which aren't loaded
+	void updateLoadedChunks();
+	// Function which checks if an offset from the player's chunk is inside of the prefetch cone
+	bool inPrefetchCone(glm::ivec2 offset) const;
+	// Function which counts the visible chunks which haven't finished generating
+	void countPopIns();
+
+	// Functions which draw (or submit) every tree in the finalized chunks
+	void renderTrees(Shader* boundShader);
+	void submitTrees(RenderQueue& queue);
+	// Function which resorts the chunks if the view has moved to another chunk (or chunks have been loaded or freed)
+	void updateDrawOrder(glm::vec3 viewPosition);
+	// Function which sorts the chunks by their distance from the chunk the view is in
+	void sortDrawOrder(glm::ivec2 viewChunk);
+	// Function which gives the trees near dynamic bodies colliders (and removes the colliders from trees which are no longer near any)
+	void updateTreeProxies();
+	// Function which creates a chunk and schedules it to be generated
+	void loadChunk(glm::ivec2 chunkCoordinates);
+	// Function which writes a chunk's edits (applying any still queued) back to the store, so they aren't lost when the chunk is loaded again
+	void saveEdits(glm::ivec2 chunkCoordinates, Chunk& chunk);
+
+	// Function which queues an edit on every chunk it overlaps
+	void modifyDensity(const Chunk::DensityEdit& edit);
+
+	// Function which queues the (load) -> generate -> mesh -> upload -> collide pipeline for a chunk
+	void scheduleChunk(Chunk::ptr chunk, glm::ivec2 chunkCoordinates);
 
 protected:
 	Arguments& args;
 
-	// Circular Buffer of Circular Buffers of Chunks
-	// Need +1 on the radius to include 0,0
-	// Outer = X, Inner = Z
-    circular_buffer_array<finalizeable_circular_buffer_array<Chunk::ptr, WORLD_RADIUS * 2 + 1>, WORLD_RADIUS * 2 + 1> chunks; // Outer = X, Inner = Z
+	// The loaded chunks (every chunk in the square of the given radius around the player), keyed by their chunk coordinates
+	std::unordered_map<glm::ivec2, Chunk::ptr> chunks;
+	// The number of chunks loaded in each direction around the player
+	int radius = WORLD_RADIUS;
+	// The loaded chunks sorted front to back (only resorted when the view moves to another chunk, or chunks are loaded or freed)
+	std::vector<Chunk*> drawOrder;
+	glm::ivec2 drawOrderOrigin = {0, 0};
+	bool drawOrderDirty = true;
 
 	// Vec2 storing the chunk the player is currently in
 	glm::ivec2 playerChunk = {0, 0};
 
-	// Queue of chunks that need their data generated
-	static ModifiablePriorityQueue<std::pair<Chunk::ptr, glm::ivec2>, std::vector<std::pair<Chunk::ptr, glm::ivec2>>, MeshingSort> generationQueue;
-
-	// Queue of chunks that need to be meshed
-	monitor<ModifiablePriorityQueue<Chunk::ptr, std::vector<Chunk::ptr>, MeshingSort>> meshingQueue, collisionQueue;
-	// Thread responsible for meshing chunks
-	std::thread meshingThread, collisionThread;
-	// Bool which checks if the meshing thread should keep running
-	bool shouldMeshingThreadRun = true, shouldCollisionThreadRun = true;
+	// The direction (in chunk space, zero if not traveling) the player is traveling and how far ahead of them the scheduler is focused
+	bool prefetching = true;
+	glm::vec2 travelDirection = {0, 0};
+	glm::ivec2 focusLead = {0, 0};
+	// The direction the camera is looking (in chunk space)
+	glm::vec2 lookDirection = {0, 0};
+	// The number of chunks which have been seen before they finished generating
+	size_t popInCount = 0;
+
+	// Recent measurements of how long it took chunks to become collidable
+	monitor<circular_buffer_array<float, 60>> chunkLatencyMeasurements;
+	// Recent measurements of how many heap allocations meshing chunks and building their colliders took
+	monitor<circular_buffer_array<float, 60>> meshAllocationMeasurements, colliderAllocationMeasurements;
+	// Function which averages a set of recent measurements
+	static float average(monitor<circular_buffer_array<float, 60>>& measurements);
+
+	// The models shared by every tree
+	std::array<Object::ptr, TREE_MODEL_COUNT> treeModels;
+	// Colliders for the trees near dynamic bodies (keyed by the world space cell the tree is in), which all share the same shape
+	struct TreeProxy {
+		std::unique_ptr<btRigidBody> body;
+		glm::vec3 position; // Of the tree the collider was placed on
+		bool used;
+	};
+	std::unordered_map<glm::ivec2, TreeProxy> treeProxies;
+	btCylinderShape treeProxyShape{btVector3(TREE_TRUNK_RADIUS, TREE_TRUNK_HEIGHT / 2.0, TREE_TRUNK_RADIUS)};
+
+	// Persistent store of chunks which have already been generated
+	ChunkStore store;
+	// Edited chunks which have been freed and the tasks writing them back to the store (a chunk being loaded again waits for its write back)
+	struct WriteBack {
+		Chunk::ptr chunk;
+		TaskScheduler::Task::ptr task;
+	};
+	std::unordered_map<glm::ivec2, WriteBack> writeBacks;
 
-	// Queue of chunks which need to be uploaded to the gpu
-	std::queue<Chunk::ptr> uploadQueue;
+	// Scheduler which runs the chunk pipeline (declared last so its workers are stopped before anything they reference is destroyed)
+	TaskScheduler scheduler;
 };
 
 #endif // VOXEL_WORLD_H
@@ -1,9 +1,16 @@
 #version 330 core
 layout (location = 0) in vec3 v_position;
+layout (location = 4) in mat4 v_instanceModel; // Per instance (locations 4-7), only used when instanced
 
-uniform mat4 lightSpaceMatrix;
+uniform mat4 lightSpaceMatrix; // The camera's projection during the depth pre-pass
+uniform mat4 viewMatrix; // Identity when rendering the shadow map
 uniform mat4 modelMatrix;
+uniform bool instanced; // If the model matrix comes from the instance attribute instead of the uniform
+
+// Computed exactly like the lit pass computes it, so the pre-pass depths can be tested for equality
+invariant gl_Position;
 
 void main() {
-	gl_Position = lightSpaceMatrix * modelMatrix * vec4(v_position, 1.0);
-}
\ No newline at end of file
+	mat4 model = instanced ? v_instanceModel : modelMatrix;
+	gl_Position = lightSpaceMatrix * (viewMatrix * model) * vec4(v_position, 1.0);
+}
@@ -1,10 +1,11 @@
-#version 330
+#version 430
 
 // attributes
 layout (location = 0) in vec3 v_position;
 layout (location = 1) in vec3 v_color;
 layout (location = 2) in vec2 v_uv;
 layout (location = 3) in vec3 v_normal;
+layout (location = 4) in mat4 v_instanceModel; // Per instance (locations 4-7), only used when instanced
 
 // structs
 #define TYPE_DISABLED 0u
@@ -13,17 +14,17 @@ layout (location = 3) in vec3 v_normal;
 #define TYPE_POINT 3u
 #define TYPE_SPOT 4u
 
+// Matches LightClusters::GPULight
 struct Light
 {
-	uint type;
-	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
-	vec4 position;
-	vec3 direction;
-	float cutoffAngleCosine;
+	vec4 position; // w = range
+	vec4 direction; // w = cutoff angle cosine
+	uint type;
 	float intensity;
 	float falloff;
+	float attenuationDistance;
 };
 
 struct Material
@@ -34,12 +35,19 @@ struct Material
 	float shininess;
 };
 
-// defines
-#define MAX_LIGHTS 20
+// Light buffers (directional lights come first, then the local lights which are binned into clusters)
+layout(std430, binding = 0) readonly buffer LightBuffer { Light lights[]; };
+layout(std430, binding = 1) readonly buffer ClusterBuffer { uvec2 clusters[]; }; // Offset and count into the cluster indices
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer { uint clusterIndices[]; };
 
 // uniforms
-uniform Light lights[MAX_LIGHTS];
+uniform vec3 ambientLight; // Every light's ambient term summed
+uniform uint num_directional_lights;
 uniform uint num_lights;
+uniform bool clusteredLighting;
+uniform uvec3 clusterCount;
+uniform vec2 clusterDepthRange; // Near and far
+uniform vec2 viewportSize;
 
 uniform Material material;
 uniform sampler2D sampler;
@@ -47,59 +55,82 @@ uniform sampler2D sampler;
 uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 modelMatrix;
+uniform bool instanced; // If the model matrix comes from the instance attribute instead of the uniform
 
 // outs
 out vec3 lightingColor;
 flat out vec3 varyingColor;
 out vec2 varyingUV;
 out vec4 worldPosition;
+invariant gl_Position; // Must match the depth pre-pass exactly
 
-vec3 calculateLighting(Light light, vec4 P, vec3 N, vec3 V, mat4 mv_matrix){
-	// Disabled lights contribute nothing
-	if(light.type == TYPE_DISABLED)
-		return vec3(0);
-
-	vec3 ambient = (light.ambient * material.ambient).xyz;
+// Function which preforms lighting calculations (for everything but the ambient term)
+vec3 calculateLighting(Light light, vec4 P, vec3 N, vec3 V){
 	vec3 L = vec3(0);
 	float falloff = 1;
+	float attenuation = 1;
 
-	if(light.type == TYPE_AMBIENT){
-		return ambient;
-	} else if (light.type == TYPE_DIRECTIONAL){
-		L = -normalize(light.direction);
+	if (light.type == TYPE_DIRECTIONAL){
+		L = -normalize(light.direction.xyz);
 	} else if(light.type == TYPE_POINT || light.type == TYPE_SPOT){
-		L = normalize((mv_matrix * light.position).xyz - P.xyz);
+		L = normalize((viewMatrix * vec4(light.position.xyz, 1)).xyz - P.xyz);
 
 		if(light.type == TYPE_SPOT){
-			float phi = dot(-normalize(light.direction), normalize((light.position - modelMatrix * vec4(v_position, 1)).xyz));
+			float phi = dot(-normalize(light.direction.xyz), normalize(light.position.xyz - worldPosition.xyz));
 			float intensityFactor = pow(phi, light.intensity);
-			falloff = smoothstep(light.cutoffAngleCosine, light.cutoffAngleCosine + light.falloff, intensityFactor);
+			falloff = smoothstep(light.direction.w, light.direction.w + light.falloff, intensityFactor);
 		}
+
+		// Inverse square falloff, windowed so it reaches zero at the light's range
+		vec3 toLight = light.position.xyz - worldPosition.xyz;
+		float dist2 = dot(toLight, toLight);
+		float window = clamp(1 - pow(dist2 / (light.position.w * light.position.w), 2), 0.0, 1.0);
+		attenuation = clamp((light.attenuationDistance * light.attenuationDistance) / dist2, 0.0, 1.0) * window * window;
 	}
 
 	vec3 H = normalize(L + V);
 
-	vec3 diffuse = light.diffuse.xyz * material.diffuse.xyz * max(dot(N,L), 0.0) * falloff;
-	vec3 specular = material.specular.xyz * light.specular.xyz * pow(max(dot(N, H), 0.0f), 4 * material.shininess) * falloff;
+	vec3 diffuse = light.diffuse.xyz * material.diffuse.xyz * max(dot(N,L), 0.0) * falloff * attenuation;
+	vec3 specular = material.specular.xyz * light.specular.xyz * pow(max(dot(N, H), 0.0f), 4 * material.shininess) * falloff * attenuation;
 	if(max(dot(N,L), 0.0) == 0) specular = vec3(0);
 
-	return ambient + diffuse + specular;
+	return diffuse + specular;
+}
+
+// Function which finds the cluster a view space position falls in
+uint clusterIndex(vec2 fragCoord, float depth){
+	uvec2 tile = min(uvec2(max(fragCoord, 0) / viewportSize * vec2(clusterCount.xy)), clusterCount.xy - 1u);
+	float slice = log(max(depth, clusterDepthRange.x) / clusterDepthRange.x) / log(clusterDepthRange.y / clusterDepthRange.x) * float(clusterCount.z);
+	uint z = min(uint(slice), clusterCount.z - 1u);
+	return tile.x + clusterCount.x * (tile.y + clusterCount.y * z);
 }
 
 void main(void) {
-	mat4 mv_matrix = viewMatrix * modelMatrix;
+	mat4 model = instanced ? v_instanceModel : modelMatrix;
+	mat4 mv_matrix = viewMatrix * model;
 	mat4 norm_matrix = transpose(inverse(mv_matrix));
 
 	vec4 P = mv_matrix * vec4(v_position,1.0);
 	vec3 N = normalize((norm_matrix * vec4(v_normal,1.0)).xyz);
 	vec3 V = normalize(-P.xyz);
 
-	lightingColor = vec3(0);
-	for(uint i = 0u; i < num_lights; i++)
-	   lightingColor += calculateLighting(lights[i], P, N, V, mv_matrix);
+	gl_Position = projectionMatrix * mv_matrix * vec4(v_position, 1.0);
+	worldPosition = model * vec4(v_position, 1);
+
+	lightingColor = ambientLight * material.ambient.xyz;
+	for(uint i = 0u; i < num_directional_lights; i++)
+		lightingColor += calculateLighting(lights[i], P, N, V);
+
+	// Only the local lights binned into this vertex's cluster can reach it (unless clustering is off, then every light is checked)
+	if(clusteredLighting) {
+		vec2 fragCoord = (gl_Position.xy / max(gl_Position.w, 1e-4) * .5 + .5) * viewportSize;
+		uvec2 cluster = clusters[clusterIndex(fragCoord, -P.z)];
+		for(uint i = 0u; i < cluster.y; i++)
+			lightingColor += calculateLighting(lights[clusterIndices[cluster.x + i]], P, N, V);
+	} else
+		for(uint i = num_directional_lights; i < num_lights; i++)
+			lightingColor += calculateLighting(lights[i], P, N, V);
 
-	gl_Position = projectionMatrix * P;
-	worldPosition = modelMatrix * vec4(v_position, 1);
 	varyingColor = v_color;
 	varyingUV = v_uv;
 }
@@ -11,15 +11,14 @@
 #define TYPE_POINT 3u
 #define TYPE_SPOT 4u
 
+// Matches LightClusters::GPULight
 struct Light
 {
-	uint type;
-	vec4 ambient;
 	vec4 diffuse;
 	vec4 specular;
-	vec4 position;
-	vec3 direction;
-	float cutoffAngleCosine;
+	vec4 position; // w = range
+	vec4 direction; // w = cutoff angle cosine
+	uint type;
 	float intensity;
 	float falloff;
 	float attenuationDistance;
@@ -33,16 +32,30 @@ struct Material
 	float shininess;
 };
 
-// defines
-#define MAX_LIGHTS 20
+// Light buffers (directional lights come first, then the local lights which are binned into clusters)
+layout(std430, binding = 0) readonly buffer LightBuffer { Light lights[]; };
+layout(std430, binding = 1) readonly buffer ClusterBuffer { uvec2 clusters[]; }; // Offset and count into the cluster indices
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer { uint clusterIndices[]; };
 
 // uniforms
-uniform Light lights[MAX_LIGHTS];
+uniform vec3 ambientLight; // Every light's ambient term summed
+uniform uint num_directional_lights;
 uniform uint num_lights;
+uniform bool clusteredLighting;
+uniform uvec3 clusterCount;
+uniform vec2 clusterDepthRange; // Near and far
+uniform vec2 viewportSize;
 
 uniform Material material;
 layout(binding = 0) uniform sampler2D sampler;
-layout(binding = 1) uniform sampler2D shadowMap;
+layout(binding = 1) uniform sampler2DShadow shadowMap;
+layout(binding = 2) uniform sampler2D shadowDepth; // The same texture, without the depth comparison
+
+// Shadow filtering (matches the ShadowQuality enum)
+#define SHADOW_HARD 0
+#define SHADOW_POISSON 1
+#define SHADOW_PCSS 2
+uniform int shadowQuality;
 
 uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
@@ -64,31 +77,59 @@ flat in mat4 mv_matrix;
 
 out vec4 fragColor;
 
-// Function which calculates if the current pixel should be in shadow or not
+// How far (in texels) the poisson taps are spread
+#define SHADOW_POISSON_SPREAD 1.5
+// How far (in texels) PCSS searches for blockers, how wide a penumbra gets per unit of (normalized) depth between the blocker and receiver, and the widest penumbra
+#define SHADOW_BLOCKER_SEARCH 8
+#define SHADOW_PENUMBRA_SCALE 400
+#define SHADOW_MAX_PENUMBRA 12
+
+const vec2 poissonDisk[16] = vec2[](
+	vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725), vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+	vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464), vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+	vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420), vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+	vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590), vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+
+// Function which calculates how much of the current pixel is in shadow (0 fully lit, 1 fully shadowed)
 float shadowCalculations(float normalLightDot){
 	// perform perspective divide (normalized to [0, 1])
 	vec3 projCoords = lightSpacePosition.xyz / lightSpacePosition.w;
 	projCoords = projCoords * 0.5 + 0.5;
-	// get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-	float closestDepth = texture(shadowMap, projCoords.xy).r; 
-	// get depth of current fragment from light's perspective (clampped to a maximum value of 1)
-	float currentDepth = projCoords.z;
-	if(currentDepth > 1) currentDepth = 1;
+	// depth of current fragment from light's perspective (clampped to a maximum value of 1), biased to reduce stair-stepping
+	float currentDepth = min(projCoords.z, 1);
+	float bias = max(.01 * (1.0 - normalLightDot), .0005); // TODO: Tweak so that we can see the UFO's shadow when it lands
+	float reference = currentDepth - bias;
+	vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
 
-	// Calculate the bias to reduce stair-stepping
-	double bias = max(.01 * (1.0 - normalLightDot), .0005); // TODO: Tweak so that we can see the UFO's shadow when it lands
+	// Each tap is compared (and 2x2 filtered) by the hardware, returning how lit it is
+	if(shadowQuality == SHADOW_HARD)
+		return 1 - texture(shadowMap, vec3(projCoords.xy, reference));
+
+	float filterRadius = SHADOW_POISSON_SPREAD;
+	int taps = 4;
+	if(shadowQuality == SHADOW_PCSS) {
+		// Find the average depth of whatever is blocking the light
+		float blockerDepth = 0, blockers = 0;
+		for(int i = 0; i < 16; i++) {
+			float depth = texture(shadowDepth, projCoords.xy + poissonDisk[i] * texelSize * SHADOW_BLOCKER_SEARCH).r;
+			if(depth < reference) {
+				blockerDepth += depth;
+				blockers++;
+			}
+		}
+		if(blockers == 0) return 0;
 
-	// Sample several textures around the current texture and average the results
-	float shadow = 0.0;
-	vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-	for(int x = -1; x <= 1; ++x)
-		for(int y = -1; y <= 1; ++y) {
-			double pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r; 
-			shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
-		}    
-
-	// Return the averaged result of the differet pixels
-	return shadow / 9;
+		// The penumbra widens the farther the receiver is from the blocker
+		blockerDepth /= blockers;
+		filterRadius = clamp((reference - blockerDepth) * SHADOW_PENUMBRA_SCALE, 1, SHADOW_MAX_PENUMBRA);
+		taps = 16;
+	}
+
+	float lit = 0;
+	for(int i = 0; i < taps; i++)
+		lit += texture(shadowMap, vec3(projCoords.xy + poissonDisk[i] * texelSize * filterRadius, reference));
+	return 1 - lit / taps;
 }
 
 float distance2(vec3 A, vec3 B) {
@@ -96,45 +137,51 @@ float distance2(vec3 A, vec3 B) {
 	return dot(dist, dist);
 }
 
-// Function which preforms lighting calculations
+// Function which preforms lighting calculations (for everything but the ambient term)
 vec3 calculateLighting(Light light, vec4 P, vec3 N, vec3 V){
-	// Disabled lights contribute nothing
-	if(light.type == TYPE_DISABLED)
-		return vec3(0);
-
-	vec3 ambient = (light.ambient * material.ambient).xyz;
 	vec3 L = vec3(0);
 	float spotlightFalloff = 1;
+	float attenuation = 1;
 
-	if(light.type == TYPE_AMBIENT){
-		return ambient;
-	} else if (light.type == TYPE_DIRECTIONAL){
-		L = -normalize(light.direction);
+	if (light.type == TYPE_DIRECTIONAL){
+		L = -normalize(light.direction.xyz);
 	} else if(light.type == TYPE_POINT || light.type == TYPE_SPOT){
-		L = normalize(viewMatrix * light.position - P).xyz;
+		L = normalize(viewMatrix * vec4(light.position.xyz, 1) - P).xyz;
 
 		if(light.type == TYPE_SPOT){
-			float phi = dot(normalize(-light.direction), normalize((light.position - worldPosition).xyz));
+			float phi = dot(normalize(-light.direction.xyz), normalize(light.position.xyz - worldPosition.xyz));
 			float intensityFactor = pow(phi, light.intensity);
 
-			spotlightFalloff = smoothstep(light.cutoffAngleCosine, light.cutoffAngleCosine + light.falloff, intensityFactor);
+			spotlightFalloff = smoothstep(light.direction.w, light.direction.w + light.falloff, intensityFactor);
 		}
+
+		// Inverse square falloff, windowed so it reaches zero at the light's range
+		float dist2 = distance2(light.position.xyz, worldPosition.xyz);
+		float window = clamp(1 - pow(dist2 / (light.position.w * light.position.w), 2), 0.0, 1.0);
+		attenuation = clamp((light.attenuationDistance * light.attenuationDistance) / dist2, 0.0, 1.0) * window * window;
 	}
 
 	vec3 H = normalize(L + V);
 
-	float attenuation = clamp((light.attenuationDistance * light.attenuationDistance) / distance2(light.position.xyz, worldPosition.xyz), 0.0, 1.0);
-
 	float kD = max(dot(N,L), 0.0);
 	vec3 diffuse = light.diffuse.xyz * material.diffuse.xyz * kD * spotlightFalloff * attenuation;
 	vec3 specular = material.specular.xyz * light.specular.xyz * pow(max(dot(N, H), 0.0f), 4 * material.shininess) * spotlightFalloff * attenuation;
 	if(kD == 0) specular = vec3(0);
 
 	float shadowMask = 0;
-	if(light.type == TYPE_DIRECTIONAL) shadowMask = shadowCalculations(kD);
+	// Fragments facing away from the light are unlit anyways, so they don't need to check the shadow map
+	if(light.type == TYPE_DIRECTIONAL && kD > 0) shadowMask = shadowCalculations(kD);
 
-	return ambient + (1.0 - shadowMask) * (diffuse + specular);
-} 
+	return (1.0 - shadowMask) * (diffuse + specular);
+}
+
+// Function which finds the cluster a view space position falls in
+uint clusterIndex(vec2 fragCoord, float depth){
+	uvec2 tile = min(uvec2(fragCoord / viewportSize * vec2(clusterCount.xy)), clusterCount.xy - 1u);
+	float slice = log(max(depth, clusterDepthRange.x) / clusterDepthRange.x) / log(clusterDepthRange.y / clusterDepthRange.x) * float(clusterCount.z);
+	uint z = min(uint(slice), clusterCount.z - 1u);
+	return tile.x + clusterCount.x * (tile.y + clusterCount.y * z);
+}
 
 // Function which returns 0 when there shouldn't be fog, 1 when there should be and smoothly blends between them
 float fogMask(){
@@ -156,9 +203,19 @@ void main(void) {
 	vec3 N = normalize(varyingN);
 	vec3 V = normalize(-varyingP);
 
-	vec3 color = vec3(0);
-	for(uint i = 0u; i < num_lights; i++)
-	   color += calculateLighting(lights[i], viewMatrix * worldPosition, N, V);
+	vec4 P = viewMatrix * worldPosition;
+	vec3 color = ambientLight * material.ambient.xyz;
+	for(uint i = 0u; i < num_directional_lights; i++)
+		color += calculateLighting(lights[i], P, N, V);
+
+	// Only the local lights binned into this fragment's cluster can reach it (unless clustering is off, then every light is checked)
+	if(clusteredLighting) {
+		uvec2 cluster = clusters[clusterIndex(gl_FragCoord.xy, -P.z)];
+		for(uint i = 0u; i < cluster.y; i++)
+			color += calculateLighting(lights[clusterIndices[cluster.x + i]], P, N, V);
+	} else
+		for(uint i = num_directional_lights; i < num_lights; i++)
+			color += calculateLighting(lights[i], P, N, V);
 
 	if(varyingColor.x > 0) color *= texture(sampler, varyingUV).rgb;
 	fragColor = vec4(color * typeToColor( int(varyingColor.y)), 1);
@@ -5,28 +5,9 @@ layout (location = 0) in vec3 v_position;
 layout (location = 1) in vec3 v_color;
 layout (location = 2) in vec2 v_uv;
 layout (location = 3) in vec3 v_normal;
+layout (location = 4) in mat4 v_instanceModel; // Per instance (locations 4-7), only used when instanced
 
 // structs
-#define TYPE_DISABLED 0u
-#define TYPE_AMBIENT 1u
-#define TYPE_DIRECTIONAL 2u
-#define TYPE_POINT 3u
-#define TYPE_SPOT 4u
-
-struct Light
-{
-    uint type;
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    vec4 position;
-    vec3 direction;
-    float cutoffAngleCosine;
-    float intensity;
-    float falloff;
-    float attenuationDistance;
-};
-
 struct Material
 {
     vec4 ambient;
@@ -35,18 +16,13 @@ struct Material
     float shininess;
 };
 
-// defines
-#define MAX_LIGHTS 20
-
 // uniforms
-uniform Light lights[MAX_LIGHTS];
-uniform uint num_lights;
-
 uniform Material material;
 
 uniform mat4 projectionMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 modelMatrix;
+uniform bool instanced; // If the model matrix comes from the instance attribute instead of the uniform
 uniform mat4 lightSpaceMatrix;
 
 // outs
@@ -57,9 +33,11 @@ out vec3 varyingN;
 out vec4 worldPosition;
 out vec4 lightSpacePosition;
 flat out mat4 mv_matrix;
+invariant gl_Position; // Must match the depth pre-pass exactly
 
 void main(void) {
-    mv_matrix = viewMatrix * modelMatrix;
+    mat4 model = instanced ? v_instanceModel : modelMatrix;
+    mv_matrix = viewMatrix * model;
     mat4 norm_matrix = transpose(inverse(mv_matrix));
 
     // output vertex position and normal to the rasterizer for interpolation
@@ -67,7 +45,7 @@ void main(void) {
     varyingN = (norm_matrix * vec4(v_normal,1.0)).xyz;
 
     gl_Position = projectionMatrix * mv_matrix * vec4(v_position,1.0);
-    worldPosition = modelMatrix * vec4(v_position, 1);
+    worldPosition = model * vec4(v_position, 1);
     lightSpacePosition = lightSpaceMatrix * worldPosition;
 
 	varyingColor = v_color;
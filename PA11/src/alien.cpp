@@ -1,3 +0,0 @@
-#include "alien.h"
-
-Alien::~Alien() {}
\ No newline at end of file
@@ -6,15 +6,15 @@
 #include "camera.h"
 #include "threadTimer.h"
 #include "shader.h"
-#include "cow.h"
-#include "alien.h"
 #include "chunk.h"
 
+#include <chrono>
+#include <random>
+
 bool Application::initialize(const Arguments& args) {
 	bool ret = Engine::initialize(args);
 
-	// Create a leaderboard
-	leaderboard = Leaderboard();
+	// Load the leaderboard
 	leaderboard.initialize(args, "leaderstats.csv");
 
 	this->args = args;
@@ -28,13 +28,6 @@ bool Application::initialize(const Arguments& args) {
 	ufo->createMeshCollider(args, Engine::getPhysics(), CONVEX_MESH, "ufo.obj");
 	ufo->makeDynamic();
 	ufo->getRigidBody().setGravity({0, 0, 0}); // Disable gravity on the UFO
-	// Sleep until the ground under the UFO has spawned, and then set the UFO's position relative to the ground
-	std::thread([this](){
-		while(std::isnan(world->getWorldHeight({8, 8})))
-			std::this_thread::sleep_for(std::chrono::milliseconds(5));
-		
-		reset();
-	}).detach();
 
 	ufoLight = std::make_shared<SpotLight>();
 	ufo->addChild(ufoLight);
@@ -42,6 +35,7 @@ bool Application::initialize(const Arguments& args) {
 	ufoLight->setDiffuse(glm::vec4{.7, .7, 1, 1/3.0} * 3.0f);
 	ufoLight->setSpecular({.8, .8, 1, 1});
 	ufoLight->setAttenuationStartDistance(15);
+	ufoLight->setCutoffAngle(0); // The beam is off until the player starts abducting
 
 	auto ambient = std::make_shared<AmbientLight>();
 	getSceneRoot()->addChild(ambient);
@@ -53,16 +47,20 @@ bool Application::initialize(const Arguments& args) {
 	light->setDiffuse({.8, .8, .8, 1});
 
 	world->initialize();
+	// Once the ground under the UFO has spawned, set the UFO's position relative to the ground
+	world->whenCollidable({8, 8}, [this](){ reset(); });
 
-	// Create the NPCs
+	// Create the NPCs (they are scattered around the UFO when the game is reset)
+	crowd = std::make_shared<Crowd>(world);
+	crowd->initialize(args, Engine::getPhysics(), getSceneRoot());
 	int numCows = 3;
 	for (int i = 0; i < numCows; i++) {
-		createNPC("cow");
+		crowd->spawn(Crowd::Cow, {8, 8});
 	}
 
 	int numAliens = 7;
 	for (int i = 0; i < numAliens; i++) {
-		createNPC("alien");
+		crowd->spawn(Crowd::Alien, {8, 8});
 	}
 
 	// Hookup the input events
@@ -78,28 +76,6 @@ bool Application::initialize(const Arguments& args) {
 	return ret;
 }
 
-void Application::createNPC(std::string type) {
-	std::shared_ptr<NPC> npc = nullptr;
-	std::string modelFile = "";
-	if (type == "cow") {
-		npc = std::make_shared<Cow>(world);
-		modelFile = "cow.obj";
-		npc->setSpeed(5);
-	} else if (type == "alien") {
-		npc = std::make_shared<Alien>(world);
-		modelFile = "alien.obj";
-		npc->setSpeed(1);
-	}
-	getSceneRoot()->addChild(npc);
-	npc->initializeGraphics(args, modelFile, "texturemap.png");
-
-	// Create Physics
-	npc->initializePhysics(args, Engine::getPhysics(), CollisionGroups::CG_COW, /*mass*/ 100);
-	npc->createMeshCollider(args, Engine::getPhysics(), CONVEX_MESH, "cube.obj");
-	npc->makeDynamic();
-	npcs.push_back(npc);
-}
-
 void Application::controlUFO(float dt) {
 
 
@@ -124,7 +100,7 @@ void Application::controlUFO(float dt) {
 			Engine::getSound()->startSound("Abducting", true, true);
 			ufoLight->setCutoffAngle(75);
 		}
-	} else {
+	} else if(abducting) {
 		abducting = false;
 		Engine::getSound()->stopSound("Abducting");
 		ufoLight->setCutoffAngle(0);
@@ -134,6 +110,15 @@ void Application::controlUFO(float dt) {
 	float speed = 10;
 	glm::vec3 camDirection = Engine::getGraphics()->getCamera()->getLookDirection();
 	glm::vec3 planeDirection = glm::normalize(glm::vec3(camDirection.x, 0, camDirection.z));
+
+	// The scripted flight flies forward, turning a quarter turn at the end of each leg
+	if (scriptedFlight) {
+		scriptedFlightTime += dt;
+		float heading = std::floor(scriptedFlightTime / SCRIPTED_FLIGHT_LEG_TIME) * glm::half_pi<float>();
+		camDirection = planeDirection = glm::vec3(std::cos(heading), 0, std::sin(heading));
+		inputDirection = glm::vec3(1, 0, 0);
+	}
+
 	glm::vec3 force = speed * inputDirection;
 
 	desiredVelocity = 
@@ -144,6 +129,8 @@ void Application::controlUFO(float dt) {
     velocity += diff * accelerationRate * dt;
 
 	ufo->setLinearVelocity(velocity);
+	// Let the world prefetch chunks in the direction we are heading
+	world->setPlayerMotion(velocity, camDirection);
 
 	if (glm::length(velocity) > (speed / 2.0f)) {
 		visibility += 0.05 * dt;
@@ -180,28 +167,209 @@ void Application::controlUFO(float dt) {
 	//ufoLight->setDirection(ufo->down());
 }
 
-void Application::repositionNPC(std::shared_ptr<NPC> npc, bool checkDistance = true) {
+void Application::startLightBenchmark() {
+	lightBenchmarkFleet = std::make_shared<Object>();
+	getSceneRoot()->addChild(lightBenchmarkFleet);
+
+	// Each UFO has a beam shining down and a pair of running lights
+	for (int i = 0; i < LIGHT_BENCHMARK_UFOS; i++) {
+		auto member = std::make_shared<Object>();
+		lightBenchmarkFleet->addChild(member);
+		member->initializeGraphics(args, "ufo.obj", "texturemap.png");
+
+		glm::vec3 color = glm::vec3(.5) + .5f * glm::vec3(std::sin(i * 1.3f), std::sin(i * 2.1f + 1), std::sin(i * 0.7f + 2));
+		auto beam = std::make_shared<SpotLight>();
+		member->addChild(beam);
+		beam->setDiffuse(glm::vec4(color, 1) * 2.0f);
+		beam->setAttenuationStartDistance(15);
+		beam->setCutoffAngle(75);
+
+		for (float side: {-2.f, 2.f}) {
+			auto running = std::make_shared<PointLight>();
+			member->addChild(running);
+			running->setPosition({side, 0, 0});
+			running->setDiffuse(side < 0 ? glm::vec4(1, .2, .2, 1) : glm::vec4(.2, 1, .2, 1));
+			running->setAttenuationStartDistance(4);
+		}
+	}
+
+	lightBenchmarkTime = 0;
+	for (int phase = 0; phase < 2; phase++) {
+		lightBenchmarkFrameTime[phase] = 0;
+		lightBenchmarkFrames[phase] = 0;
+	}
+	std::cout << "Lighting benchmark started (" << Light::getLights().size() << " lights)" << std::endl;
+}
+
+void Application::updateLightBenchmark(float dt) {
+	// Clustering is on for the first phase, and off for the second (the first second of each is skipped so the switch settles)
+	int phase = lightBenchmarkTime < LIGHT_BENCHMARK_PHASE_TIME ? 0 : 1;
+	float phaseTime = lightBenchmarkTime - phase * LIGHT_BENCHMARK_PHASE_TIME;
+	Engine::getGraphics()->getLightClusters().enabled = phase == 0;
+	if (phaseTime > 1) {
+		lightBenchmarkFrameTime[phase] += dt;
+		lightBenchmarkFrames[phase]++;
+	}
+
+	lightBenchmarkTime += dt;
+	if (lightBenchmarkTime > 2 * LIGHT_BENCHMARK_PHASE_TIME) {
+		stopLightBenchmark();
+		return;
+	}
+
+	// Circle the player in rings, alternating direction
+	glm::vec3 center = ufo->getPosition() + glm::vec3(0, 10, 0);
+	auto& members = lightBenchmarkFleet->getChildren();
+	for (size_t i = 0; i < members.size(); i++) {
+		int ring = i % 4;
+		float angle = glm::two_pi<float>() * i / members.size() + lightBenchmarkTime * (ring % 2 ? .2f : -.2f);
+		float radius = LIGHT_BENCHMARK_RADIUS * (ring + 1) / 4.0f;
+		members[i]->setPosition(center + glm::vec3(std::cos(angle) * radius, ring * 4, std::sin(angle) * radius));
+	}
+}
+
+void Application::stopLightBenchmark() {
+	if (!lightBenchmarkFleet) return;
+
+	// Report the average frame time of each phase
+	auto average = [this](int phase) { return lightBenchmarkFrames[phase] ? 1000 * lightBenchmarkFrameTime[phase] / lightBenchmarkFrames[phase] : 0; };
+	std::cout << "Lighting benchmark ended: " << average(0) << "ms per frame clustered, " << average(1) << "ms per frame unclustered" << std::endl;
+
+	getSceneRoot()->removeChild(lightBenchmarkFleet);
+	lightBenchmarkFleet = nullptr;
+	Engine::getGraphics()->getLightClusters().enabled = true;
+}
+
+void Application::startCrowdBenchmark() {
+	// Scatter the herd evenly over a disc around the player
+	crowdBenchmarkBase = crowd->size();
+	glm::vec2 center = {ufo->getPosition().x, ufo->getPosition().z};
+	for (int i = 0; i < CROWD_BENCHMARK_AGENTS; i++) {
+		float angle = glm::two_pi<float>() * rand() / RAND_MAX;
+		float radius = CROWD_BENCHMARK_RADIUS * std::sqrt(rand() / (float) RAND_MAX);
+		crowd->spawn(Crowd::Cow, center + radius * glm::vec2(std::cos(angle), std::sin(angle)));
+	}
+
+	crowdBenchmark = true;
+	crowdBenchmarkTime = 0;
+	crowdBenchmarkFrameTime = crowdBenchmarkUpdateTime = 0;
+	crowdBenchmarkFrames = 0;
+	std::cout << "Crowd benchmark started (" << crowd->size() << " agents)" << std::endl;
+}
+
+void Application::updateCrowdBenchmark(float dt) {
+	// The first second is skipped so the herd can settle onto the terrain
+	if (crowdBenchmarkTime > 1) {
+		crowdBenchmarkFrameTime += dt;
+		crowdBenchmarkUpdateTime += crowd->getLastUpdateTime() / 1000;
+		crowdBenchmarkFrames++;
+	}
+
+	crowdBenchmarkTime += dt;
+	if (crowdBenchmarkTime > CROWD_BENCHMARK_TIME + 1)
+		stopCrowdBenchmark();
+}
+
+void Application::stopCrowdBenchmark() {
+	if (!crowdBenchmark) return;
+
+	// Report the average frame and crowd update times
+	double frameTime = crowdBenchmarkFrames ? 1000 * crowdBenchmarkFrameTime / crowdBenchmarkFrames : 0;
+	double updateTime = crowdBenchmarkFrames ? 1000 * crowdBenchmarkUpdateTime / crowdBenchmarkFrames : 0;
+	std::cout << "Crowd benchmark ended: " << frameTime << "ms per frame (" << (frameTime ? 1000 / frameTime : 0) << " FPS), "
+		<< updateTime << "ms per crowd update with " << crowd->size() << " agents" << std::endl;
+
+	crowd->truncate(crowdBenchmarkBase);
+	crowdBenchmark = false;
+}
+
+void Application::runSpatialBenchmark() {
+	// The same points and queries are used every run (and for both methods)
+	std::mt19937 generator(NOISE_SEED);
+	std::uniform_real_distribution<float> horizontal(-SPATIAL_BENCHMARK_EXTENT, SPATIAL_BENCHMARK_EXTENT), vertical(-64, 64);
+	auto randomPoint = [&]() { return glm::vec3(horizontal(generator), vertical(generator), horizontal(generator)); };
+	float radius = SPATIAL_BENCHMARK_QUERY_RADIUS;
+	glm::vec3 down = {0, -1, 0};
+
+	std::cout << "Spatial query benchmark (queries per second, grid vs linear scan)" << std::endl;
+	for (size_t count: {10, 1'000, 100'000}) {
+		std::vector<glm::vec3> points(count);
+		SpatialGrid grid;
+		for (size_t i = 0; i < count; i++)
+			grid.update(i, points[i] = randomPoint());
+		std::vector<glm::vec3> centers(SPATIAL_BENCHMARK_QUERIES);
+		for (auto& center: centers)
+			center = randomPoint();
+
+		// Runs every query with both methods, checking that they found the same number of points
+		std::cout << "	" << count << " entities:";
+		auto compare = [&](const char* shape, auto gridQuery, auto linearQuery) {
+			auto measure = [&](auto query, size_t& found) {
+				auto start = std::chrono::steady_clock::now();
+				for (auto& center: centers)
+					found += query(center);
+				return SPATIAL_BENCHMARK_QUERIES / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			};
+			size_t gridFound = 0, linearFound = 0;
+			double gridRate = measure(gridQuery, gridFound), linearRate = measure(linearQuery, linearFound);
+			std::cout << " " << shape << " " << (size_t) gridRate << " vs " << (size_t) linearRate << (gridFound != linearFound ? " (MISMATCH)" : "") << ";";
+		};
+
+		compare("radius", [&](glm::vec3 center) {
+			size_t found = 0;
+			grid.forEachInRadius(center, radius, [&](uint32_t, glm::vec3) { found++; });
+			return found;
+		}, [&](glm::vec3 center) {
+			size_t found = 0;
+			for (auto& point: points)
+				found += glm::distance2(point, center) < radius * radius;
+			return found;
+		});
+		compare("cone", [&](glm::vec3 center) {
+			size_t found = 0;
+			grid.forEachInCone(center, down, .8, radius, [&](uint32_t, glm::vec3) { found++; });
+			return found;
+		}, [&](glm::vec3 center) {
+			size_t found = 0;
+			for (auto& point: points) {
+				glm::vec3 offset = point - center;
+				float distance = glm::length(offset);
+				found += distance < radius && glm::dot(offset, down) > .8f * distance;
+			}
+			return found;
+		});
+		compare("box", [&](glm::vec3 center) {
+			size_t found = 0;
+			grid.forEachInBox(center - radius, center + radius, [&](uint32_t, glm::vec3) { found++; });
+			return found;
+		}, [&](glm::vec3 center) {
+			size_t found = 0;
+			for (auto& point: points)
+				found += glm::all(glm::greaterThanEqual(point, center - radius)) && glm::all(glm::lessThanEqual(point, center + radius));
+			return found;
+		});
+		std::cout << std::endl;
+	}
+}
+
+void Application::repositionAgent(size_t agent, bool checkDistance) {
 	float proximity = 75;
 	//float angle = (float) (rand() % 360);
 	//float probOfRepos = 0.2;
 	float innerRadiusPercentage = .75;
-	glm::vec3 direction = glm::normalize(velocity);
+	glm::vec3 direction = glm::length(velocity) > 0 ? glm::normalize(velocity) : glm::vec3(0, 0, 1);
 
 	// Check a NPC position in relationship to the moving UFO
-	if (!checkDistance || glm::distance(npc->getPosition(), glm::vec3(ufo->getPosition().x, npc->getPosition().y, ufo->getPosition().z)) > proximity) {
+	glm::vec3 position = crowd->getPosition(agent);
+	if (!checkDistance || glm::distance(glm::vec2(position.x, position.z), glm::vec2(ufo->getPosition().x, ufo->getPosition().z)) > proximity) {
 		// Get the angle relative to UFO movement and within some random range
 		int angleTolerance = 90;
 		float angle = std::atan2(direction.x, direction.z) + glm::radians((float) (rand() % angleTolerance) - (angleTolerance / 2));
 		//std::cout << glm::degrees(angle) << " " << direction.x << " " << direction.z << std::endl;
 		glm::vec3 newPos = ufo->getPosition() + (glm::vec3(glm::sin(angle), 0, glm::cos(angle)) * proximity * innerRadiusPercentage);
-		float y = world->getWorldHeight((glm::ivec3) newPos) + 1;
-		if (!isnan(y)) {
-			newPos.y = y;
-			//std::cout << glm::distance(newPos, glm::vec3(ufo->getPosition().x, npcs[npci]->getPosition().y, ufo->getPosition().z)) << std::endl;
-			npc->setPosition(newPos);
-			npc->setLinearVelocity(glm::vec3());
-			npc->clearTargets();
-		}
+		// Captured NPCs always respawn (they wait hidden for the terrain to load), others are only moved onto loaded terrain
+		if (!checkDistance || !isnan(world->getTerrainHeight({newPos.x, newPos.z})))
+			crowd->teleport(agent, {newPos.x, newPos.z});
 	}
 }
 
@@ -213,17 +381,12 @@ void Application::reset() {
 	points = 0;
 	visibility = 0;
 
-	// Reset npc positions around spawn
-	for (std::shared_ptr<NPC> npc: npcs) {
+	// Reset npc positions around spawn (each is placed on the terrain once it has loaded)
+	for (size_t agent = 0; agent < crowd->size(); agent++) {
 		float range = 50;
 		float x = ufo->getPosition().x + (rand() % (int) range) -(range/2.0f);
 		float z = ufo->getPosition().z + (rand() % (int) range) -(range/2.0f);
-		float y = -50;
-		glm::ivec3 ufoPos = glm::ivec3(x, 0, z);
-		if (!isnan(world->getWorldHeight(ufoPos)))
-			y = world->getWorldHeight(ufoPos);
-
-		npc->setPosition(glm::vec3(x, y, z));
+		crowd->teleport(agent, {x, z});
 	}
 }
 
@@ -242,100 +405,102 @@ void Application::update(float dt) {
 
 		// Only modify npcs when UFO is moving
 		float realSpeed = glm::length(velocity);
-		if (realSpeed > 0.2f) {
+		if (realSpeed > 0.2f && npci < crowd->size()) {
 			// Move NPC's to new locations
-			repositionNPC(npcs[npci]);
+			repositionAgent(npci);
 		}
 
 		// Increment a once per frame index for npcs
 		npci ++;
-		if (npci >= npcs.size()) {
+		if (npci >= crowd->size()) {
 			npci = 0;
 		}
 
-		//std::cout << npcs[npci]->getPosition().x << npcs[npci]->getPosition().y << npcs[npci]->getPosition().y << std::endl;
+		// The abduction beam digs into the terrain beneath the UFO
+		if (abducting)
+			if (auto hit = world->raycast(dir2end(ufo->getPosition(), ufo->down()), CollisionGroups::CG_ENVIRONMENT))
+				world->modifyDensity(VoxelWorld::Sphere{hit->point, BEAM_DIG_RADIUS}, -BEAM_DIG_RATE * dt);
+
+		// Aliens near the UFO chase it once they can see it
+		crowd->setChaseTarget(ufo->getPosition(), visibility);
+	}
+
+	// Move the crowd (before it is queried, so the queries see where the agents are this frame)
+	crowd->update(dt);
 
-		// Attempt to abduct something
+	if (!gameOver) {
+		// Attempt to abduct something (only the agents in the beam are given rigid bodies)
 		float abductionDistance = 20;
-		sightings = 0;
-		// Find a new abduction targets
-		for (std::shared_ptr<NPC> npc : npcs) {
-			if (abducting) {
-				glm::vec3 diffVec = npc->getPosition() - ufo->getPosition();
-				float distanceToUFO = glm::length(diffVec);
-				glm::vec3 dirVec = glm::normalize(diffVec);
-				
-				float angle = glm::dot(dirVec, ufo->down());
-
-				if (distanceToUFO < abductionDistance && angle > 0.8){ // && angle > 0  && angle < 3) {
-					//std::cout << angle << std::endl;
-
-					// NPC in range
-					if (!npc->getIsBeingAbducted()) {
-						// NPC not being abducted so enable abduction
-						npc->setIsBeingAbducted(true);
-					}
-
-					// move npc towards UFO
-					glm::vec3 npcToUfoDirection = -dirVec;
-					float abductionSpeed = 200.0f;
-					npc->setLinearVelocity(npcToUfoDirection * abductionSpeed * dt);
-
-					// check if object is captured
-					if (distanceToUFO < 2) {
-						npc->setIsBeingAbducted(false);
-						repositionNPC(npc, false);
-						if (npc->getTypeID() == 2) {
-							Engine::getSound()->startSound("Penalty");
-							timeRemaining = 0;
-						} else {
-							points += rand() % 5 + 5;
-							Engine::getSound()->startSound("Score");
-						}
-						std::cout << "Your score is: " << points << std::endl;
-					}
-				} else {
-					// NPC not in range
-					if (npc->getIsBeingAbducted()) {
-						// NPC is being abducted so disable abduction
-						npc->setIsBeingAbducted(false);
-					} 
-				}
-			} else {
-				if (npc->getIsBeingAbducted()) {
-					// NPC is being abducted so disable abduction
-					npc->setIsBeingAbducted(false);
-				} 
-			}
-			// If the UFO is near the alien set the alien to move towards the UFO
-			if (npc->getTypeID() == 2) {
-				float distanceToUFO = glm::distance(ufo->getPosition(), npc->getPosition());
-				if ((100 - distanceToUFO) * visibility > 10) {
-					npc->setWaypoint(ufo->getPosition());
-					npc->setSpeed(20);
-					if (distanceToUFO < abductionDistance) {
-						sightings += 1;
-					}
+		inBeam.clear();
+		if (abducting)
+			crowd->findInCone(ufo->getPosition(), ufo->down(), 0.8, abductionDistance, inBeam);
+		crowd->hold(inBeam);
+
+		for (auto& [agent, body] : crowd->getHeld()) {
+			glm::vec3 diffVec = body->getPosition() - ufo->getPosition();
+			float distanceToUFO = glm::length(diffVec);
+
+			// move npc towards UFO
+			glm::vec3 npcToUfoDirection = -glm::normalize(diffVec);
+			float abductionSpeed = 200.0f;
+			body->setLinearVelocity(npcToUfoDirection * abductionSpeed * dt);
+
+			// check if object is captured
+			if (distanceToUFO < 2) {
+				bool alien = crowd->getSpecies(agent) == Crowd::Alien;
+				repositionAgent(agent, false);
+				if (alien) {
+					Engine::getSound()->startSound("Penalty");
+					timeRemaining = 0;
 				} else {
-					npc->setSpeed(7);
+					points += rand() % 5 + 5;
+					Engine::getSound()->startSound("Score");
 				}
+				std::cout << "Your score is: " << points << std::endl;
 			}
 		}
+
+		// Count the aliens which have spotted the UFO
+		sightings = crowd->countChasing(abductionDistance);
 	}
 
 	// Reduce points if visible
 	if (sightings > 0) {
 		points -= visibility * 0.5 * dt;
 	}
+
+	// Stress test the terrain editing by randomly carving and filling craters around the UFO
+	if (terrainStressTest)
+		for (int i = 0; i < TERRAIN_STRESS_EDITS_PER_FRAME; i++) {
+			glm::vec3 pos = ufo->getPosition() + glm::vec3(rand() % 80 - 40, 0, rand() % 80 - 40);
+			float height = world->getWorldHeight(glm::ivec3(pos));
+			if (std::isnan(height)) continue;
+
+			pos.y = height;
+			world->modifyDensity(VoxelWorld::Sphere{pos, float(rand() % 4 + 2)}, rand() % 2 ? 2 : -2);
+		}
+
+	// Fly the lighting benchmark's fleet (and measure how long the frames are taking)
+	if (lightBenchmarkFleet)
+		updateLightBenchmark(dt);
+	// Measure how long the frames (and crowd updates) are taking with the crowd benchmark's herd
+	if (crowdBenchmark)
+		updateCrowdBenchmark(dt);
 }
 
 void Application::render(Shader* boundShader){
 	// Set the player's position
 	glUniform3fv(boundShader->getUniformLocation("playerPosition"), 1, glm::value_ptr(ufo->getPosition()));
 	// Set the radius of the world
-	glUniform1f(boundShader->getUniformLocation("worldRadius"), (WORLD_RADIUS - 1) * 16);
+	glUniform1f(boundShader->getUniformLocation("worldRadius"), (world->getRadius() - 1) * (CHUNK_WIDTH - 1));
+
+	// The world is drawn through the render queue instead when it is enabled
+	if(!Engine::getGraphics()->useRenderQueue)
+		world->render(boundShader, Engine::getGraphics()->getCamera()->getPosition());
+}
 
-	world->render(boundShader);
+void Application::submit(RenderQueue& queue){
+	world->submit(queue, Engine::getGraphics()->getCamera()->getPosition());
 }
 
 void Application::drawGUI(){
@@ -343,8 +508,50 @@ void Application::drawGUI(){
 }
 
 void Application::keyboard(const SDL_KeyboardEvent& e) {
+	// F9 toggles the terrain editing stress test
+	if (e.type == SDL_KEYDOWN && e.keysym.sym == SDLK_F9 && !e.repeat) {
+		terrainStressTest = !terrainStressTest;
+		std::cout << "Terrain stress test " << (terrainStressTest ? "enabled" : "disabled") << std::endl;
+	}
+
+	// F10 toggles the scripted flight, reporting how many chunks popped in during it
+	if (e.type == SDL_KEYDOWN && e.keysym.sym == SDLK_F10 && !e.repeat) {
+		scriptedFlight = !scriptedFlight;
+		if (scriptedFlight) {
+			scriptedFlightTime = 0;
+			world->resetPopInCount();
+			std::cout << "Scripted flight started (prefetching " << (world->getPrefetching() ? "enabled" : "disabled") << ")" << std::endl;
+		} else
+			std::cout << "Scripted flight ended: " << world->getPopInCount() << " chunks popped in over " << scriptedFlightTime << "s" << std::endl;
+	}
+
+	// F11 starts (or cuts short) the lighting benchmark
+	if (e.type == SDL_KEYDOWN && e.keysym.sym == SDLK_F11 && !e.repeat) {
+		if (lightBenchmarkFleet)
+			stopLightBenchmark();
+		else
+			startLightBenchmark();
+	}
+
+	// F7 times loading, updating, and querying a huge leaderboard
+	if (e.type == SDL_KEYDOWN && e.keysym.sym == SDLK_F7 && !e.repeat)
+		Leaderboard::benchmark(LEADERBOARD_BENCHMARK_PLAYERS, LEADERBOARD_BENCHMARK_OPERATIONS);
 
+	// F6 times the chunk work queue against a re-sorted heap (over a square the size of the world's)
+	if (e.type == SDL_KEYDOWN && e.keysym.sym == SDLK_F6 && !e.repeat)
+		TaskScheduler::benchmark(world->getRadius() + PREFETCH_ROWS * 2, QUEUE_BENCHMARK_CROSSINGS, QUEUE_BENCHMARK_PUSHES);
 
+	// F8 times the spatial queries against linear scans
+	if (e.type == SDL_KEYDOWN && e.keysym.sym == SDLK_F8 && !e.repeat)
+		runSpatialBenchmark();
+
+	// F12 starts (or cuts short) the crowd benchmark
+	if (e.type == SDL_KEYDOWN && e.keysym.sym == SDLK_F12 && !e.repeat) {
+		if (crowdBenchmark)
+			stopCrowdBenchmark();
+		else
+			startCrowdBenchmark();
+	}
 }
 
 void Application::mouseButton(const SDL_MouseButtonEvent& e) {
@@ -27,6 +27,8 @@ Arguments::Arguments(int argc, char **argv) {
 
 			std::cout << "Optional" << std::endl;
 			std::cout << "\t--resource-path <path> - Sets the resource directory, the directory" << std::endl << "\t\twhere all of the program's resources can be found. [default=../]" << std::endl;
+			std::cout << "\t--cook - Cooks every model into the binary format loaded in their place," << std::endl << "\t\tand compares loading them to importing them (instead of running)" << std::endl;
+			std::cout << "\t--memory-dump <file> - Dumps how much memory each subsystem is using to a" << std::endl << "\t\tjson file every few seconds" << std::endl;
 
 			std::cout << std::string(60, '-') << std::endl;
 			std::cout << "Keys" << std::endl;
@@ -107,6 +109,16 @@ Arguments::Arguments(int argc, char **argv) {
 			i++;
 			resourcePath = argv[i];
 		}
+
+		// If the argument is "--cook"
+		else if(arg == "--cook")
+			cook = true;
+
+		// If the argument is "--memory-dump"
+		else if(arg == "--memory-dump" && i + 1 < argc) {
+			i++;
+			memoryDumpPath = argv[i];
+		}
 	}
 
 	// Make sure the config file exists and parse it
@@ -1,14 +1,18 @@
 #include "chunk.h"
+#include "memory_tracker.h"
+#include "scratch_arena.h"
 
+#include <algorithm>
 #include <unordered_map>
+#include <limits>
 #include <list>
 
 #include "FastNoise/FastNoise.h"
 #include "ComputeBuffer.hpp"
 #include "ComputeShader.hpp"
 
-// Function which generates the data we will mesh
-void Chunk::generateVoxels(const Arguments& args, int X, int Z) {
+// Function which loads (and compiles) the voxel generation compute shader
+static ComputeShader& getVoxelGenerator(const Arguments& args) {
 	static std::unique_ptr<ComputeShader> voxelGenerator = [](const Arguments& args){
 		std::ifstream fin(args.getResourcePath() + "/shaders/generateVoxels.compute.glsl");
 		if(!fin)
@@ -16,12 +20,34 @@ void Chunk::generateVoxels(const Arguments& args, int X, int Z) {
 
 		return std::make_unique<ComputeShader>(fin);
 	}(args);
+	return *voxelGenerator;
+}
+
+uint64_t Chunk::loadVoxelGenerator(const Arguments& args) {
+	getVoxelGenerator(args);
+
+	// FNV-1a
+	static uint64_t hash = [](const Arguments& args){
+		std::ifstream fin(args.getResourcePath() + "/shaders/generateVoxels.compute.glsl", std::ios::binary);
+		uint64_t hash = 0xcbf29ce484222325;
+		for(char c; fin.get(c);) {
+			hash ^= (uint8_t) c;
+			hash *= 0x100000001b3;
+		}
+		return hash;
+	}(args);
+	return hash;
+}
+
+// Function which generates the data we will mesh
+void Chunk::generateVoxels(const Arguments& args, int X, int Z) {
+	ComputeShader& voxelGenerator = getVoxelGenerator(args);
 
 	ComputeBuffer buffer(1, sizeof(voxels), voxels);
 
-	voxelGenerator->setParameter("chunkX", X);
-	voxelGenerator->setParameter("chunkZ", Z);
-	voxelGenerator->dispatch(17, 256 / 16, 17);
+	voxelGenerator.setParameter("chunkX", X);
+	voxelGenerator.setParameter("chunkZ", Z);
+	voxelGenerator.dispatch(17, 256 / 16, 17);
 
 	buffer.getData(voxels);
 }
@@ -76,9 +102,13 @@ struct IsoGridSample {
 	Chunk::Voxel values[8];
 };
 
-// Calculates a marching cubes approximation of a single grid sample of a voxelized IsoFunction with a surface at <isoLevel>
+// The most vertices (5 triangles) marching cubes produces for a single grid sample
+#define MARCHING_CUBES_MAX_VERTICES 15
+
+// Calculates a marching cubes approximation of a single grid sample of a voxelized IsoFunction with a surface at <isoLevel>,
+// returns the number of vertices written to <out>
 // Implementation from: https://paulbourke.net/geometry/polygonise/
-std::vector<std::pair<glm::vec3, Chunk::Voxel::Type>> calculateMarchingCubes(const IsoGridSample& grid, float isolevel = 0) {
+size_t calculateMarchingCubes(const IsoGridSample& grid, std::pair<glm::vec3, Chunk::Voxel::Type> (&out)[MARCHING_CUBES_MAX_VERTICES], float isolevel = 0) {
 	static int edgeTable[256]={
 	0x0 , 0x109, 0x203, 0x30a, 0x406, 0x50f, 0x605, 0x70c,
 	0x80c, 0x905, 0xa0f, 0xb06, 0xc0a, 0xd03, 0xe09, 0xf00,
@@ -390,7 +420,7 @@ std::vector<std::pair<glm::vec3, Chunk::Voxel::Type>> calculateMarchingCubes(con
 
 	/* Cube is entirely in/out of the surface */
 	if (edgeTable[cubeindex] == 0)
-		return {};
+		return 0;
 
 	/* Find the vertices where the surface intersects the cube */
 	if (edgeTable[cubeindex] & 1)
@@ -419,26 +449,38 @@ std::vector<std::pair<glm::vec3, Chunk::Voxel::Type>> calculateMarchingCubes(con
 		vertlist[11] = vertexInterp(isolevel, glm::vec4(grid.points[3], grid.values[3].isoLevel), glm::vec4(grid.points[7], grid.values[7].isoLevel), grid.values[3].type, grid.values[7].type);
 
 	/* Create the triangle */
-	std::vector<std::pair<glm::vec3, Chunk::Voxel::Type>> out;
 	for (i = 0; triTable[cubeindex][i] != -1; i += 3) {
-		out.emplace_back(vertlist[triTable[cubeindex][i]]);
-		out.emplace_back(vertlist[triTable[cubeindex][i+1]]);
-		out.emplace_back(vertlist[triTable[cubeindex][i+2]]);
+		out[i] = vertlist[triTable[cubeindex][i]];
+		out[i+1] = vertlist[triTable[cubeindex][i+1]];
+		out[i+2] = vertlist[triTable[cubeindex][i+2]];
 	}
 
-	return out;
+	return i;
 }
 
 void Chunk::rebuildMesh(const Arguments& args) {
+	// Mesh every section (into the thread's scratch arena, only the final buffers are allocated on the heap)
+	ScratchArena& scratch = ScratchArena::local();
+	SectionVertices sectionVertices(CHUNK_SECTIONS, &scratch);
+	SectionIndices sectionIndices(CHUNK_SECTIONS, &scratch);
+	for(size_t section = 0; section < CHUNK_SECTIONS; section++)
+		meshSection(section, sectionVertices[section], sectionIndices[section]);
+
+	std::scoped_lock lock(meshMutex);
+	layoutSections(sectionVertices, sectionIndices);
+}
+
+void Chunk::meshSection(size_t section, std::pmr::vector<Vertex>& vertices, std::pmr::vector<unsigned int>& indices) const {
 	vertices.clear();
 	indices.clear();
 
-	// Map of vertecies to their index and normal accumulator
-	std::unordered_map<Vertex, std::pair<size_t, glm::vec3>> vertexIndicesAndNormals;
+	// Map of vertecies to their index and normal accumulator (in the same arena as the section's vertices)
+	std::pmr::unordered_map<Vertex, std::pair<size_t, glm::vec3>> vertexIndicesAndNormals(vertices.get_allocator());
 
 	size_t index = 0, face = 0;
+	size_t startY = section * CHUNK_SECTION_HEIGHT, endY = std::min<size_t>(startY + CHUNK_SECTION_HEIGHT, CHUNK_HEIGHT - 1);
 	for(size_t x = 0; x < CHUNK_WIDTH - 1; x++)
-		for(size_t y = 0; y < CHUNK_HEIGHT - 1; y++)
+		for(size_t y = startY; y < endY; y++)
 			for(size_t z = 0; z < CHUNK_WIDTH - 1; z++){
 				// Define our sample
 				IsoGridSample cell;
@@ -461,12 +503,13 @@ void Chunk::rebuildMesh(const Arguments& args) {
 				cell.values[7] = voxels[x][y + 1][z + 1];
 
 				// Calculate marching cubes vertecies
-				auto verts = calculateMarchingCubes(cell);
+				std::pair<glm::vec3, Chunk::Voxel::Type> verts[MARCHING_CUBES_MAX_VERTICES];
+				size_t vertCount = calculateMarchingCubes(cell, verts);
 
 				// TODO: apply additional smoothing?
 
 				// Merge the marching cubes vertecies into our existing list of vertices with index optimizations
-				for(int i = 0; i < verts.size(); i++){
+				for(int i = 0; i < vertCount; i++){
 					const auto& pos = verts[i].first;
 					const auto& type = verts[i].second;
 					int face = i - (i % 3);
@@ -477,13 +520,14 @@ void Chunk::rebuildMesh(const Arguments& args) {
 					// TODO: Normal calculations incorrect?
 
 					// If the vertex has already been cached... push its index back again and add this new face's normal to its normal
-					if(vertexIndicesAndNormals.find(v) != vertexIndicesAndNormals.end()){
-						indices.push_back(vertexIndicesAndNormals[v].first);
-						vertexIndicesAndNormals[v].second += glm::cross(verts[face + 1].first - verts[face].first, verts[face + 2].first - verts[face].first);
-					// Otherwise add it to the list of vertecies and cache its index and base normal
+					glm::vec3 normal = glm::cross(verts[face + 1].first - verts[face].first, verts[face + 2].first - verts[face].first);
+					auto [cached, added] = vertexIndicesAndNormals.try_emplace(v, index, normal);
+					if(!added){
+						indices.push_back(cached->second.first);
+						cached->second.second += normal;
+					// Otherwise add it to the list of vertecies (its index and base normal were cached above)
 					} else {
 						vertices.emplace_back(std::move(v));
-						vertexIndicesAndNormals[v] = {index, glm::cross(verts[face + 1].first - verts[face].first, verts[face + 2].first - verts[face].first)};
 						indices.push_back(index++);
 					}
 				}
@@ -494,19 +538,322 @@ void Chunk::rebuildMesh(const Arguments& args) {
 		v.normal = glm::normalize(vertexIndicesAndNormals[v].second);
 }
 
-void Chunk::generateTrees(const Arguments& args) {
-	glm::vec3 pos = getPosition();
-	srand(pos.x + pos.y);
-	for(Vertex& v: vertices) {
-		if(acos(dot(v.normal, glm::vec3(0, 1, 0))) < TREE_MAX_ANGLE && v.vertex.y > 55) {
-			if(rand() % TREE_SPARCITY == 0) {
-			Object::ptr tree = std::make_shared<Object>();
-				addChild(tree);
-				tree->setPosition(v.vertex, true);
-				tree->rotate(rand(), glm::vec3(0, 1, 0));
-				tree->initializeGraphics(args, rand() % 100 < 50 ? "tree1.obj" : "tree2.obj", "", true);
-				tree->initializePhysics(args, Physics::getSingleton(), CollisionGroups::CG_ENVIRONMENT);
+// Hashes a (world space) scatter cell into a random number, which is the same no matter which run, thread, or order it is calculated in
+static uint32_t hashCell(glm::ivec2 cell, uint32_t salt) {
+	uint32_t h = NOISE_SEED ^ (salt * 0x9E3779B9u);
+	h = (h ^ (uint32_t(cell.x) * 0x85EBCA6Bu)) * 0xC2B2AE35u;
+	h ^= h >> 15;
+	h = (h ^ (uint32_t(cell.y) * 0x27D4EB2Fu)) * 0x165667B1u;
+	h ^= h >> 13;
+	return h * 0x2C1B3C6Du ^ (h >> 16);
+}
+// Hashes a scatter cell into a random number in [0, 1)
+static float hashCellFloat(glm::ivec2 cell, uint32_t salt) { return (hashCell(cell, salt) >> 8) * (1.0f / (1 << 24)); }
+
+// The (world space x, z) position of the tree candidate in a scatter cell
+static glm::vec2 cellCandidate(glm::ivec2 cell) { return (glm::vec2(cell) + glm::vec2(hashCellFloat(cell, 1), hashCellFloat(cell, 2))) * float(TREE_CELL_SIZE); }
+
+// Checks if the candidate in a cell survives the poisson disk test, a candidate is kept if it is active and it beats every active neighbor closer than the minimum distance
+// NOTE: This only looks at the hashes of the cells (never at the terrain or any other chunk), so every chunk makes the same decision about a cell
+static bool keepCandidate(glm::ivec2 cell) {
+	auto active = [](glm::ivec2 cell) { return hashCellFloat(cell, 0) < TREE_DENSITY; };
+	if(!active(cell)) return false;
+
+	constexpr int reach = (TREE_MIN_DISTANCE + TREE_CELL_SIZE - 1) / TREE_CELL_SIZE;
+	glm::vec2 candidate = cellCandidate(cell);
+	uint32_t priority = hashCell(cell, 3);
+	for(int x = -reach; x <= reach; x++)
+		for(int z = -reach; z <= reach; z++) {
+			glm::ivec2 neighbor = cell + glm::ivec2(x, z);
+			if((x == 0 && z == 0) || !active(neighbor)) continue;
+			if(glm::length2(cellCandidate(neighbor) - candidate) >= TREE_MIN_DISTANCE * TREE_MIN_DISTANCE) continue;
+
+			// Ties (which should never happen) are broken by the cell's coordinates
+			uint32_t neighborPriority = hashCell(neighbor, 3);
+			if(neighborPriority > priority || (neighborPriority == priority && std::make_pair(neighbor.x, neighbor.y) > std::make_pair(cell.x, cell.y)))
+				return false;
+		}
+
+	return true;
+}
+
+float Chunk::surfaceHeight(size_t x, size_t z) const {
+	// Scanning down from the top, find the first solid voxel with air above it and interpolate where the surface crosses between them
+	for(int y = CHUNK_HEIGHT - 2; y >= 0; y--) {
+		float below = voxels[x][y][z].isoLevel, above = voxels[x][y + 1][z].isoLevel;
+		if(below < 0 && above >= 0)
+			return y + -below / (above - below);
+	}
+	return NAN;
+}
+
+void Chunk::scatterTrees(glm::ivec2 chunkCoordinates) {
+	trees = placeTrees(chunkCoordinates);
+}
+
+std::vector<Chunk::TreeInstance> Chunk::placeTrees(glm::ivec2 chunkCoordinates) const {
+	// Build a heightmap of the chunk's surface
+	std::array<std::array<float, CHUNK_WIDTH>, CHUNK_WIDTH> heights;
+	for(size_t x = 0; x < CHUNK_WIDTH; x++)
+		for(size_t z = 0; z < CHUNK_WIDTH; z++)
+			heights[x][z] = surfaceHeight(x, z);
+	auto height = [&heights](int x, int z) { return heights[std::clamp(x, 0, CHUNK_WIDTH - 1)][std::clamp(z, 0, CHUNK_WIDTH - 1)]; };
+
+	// The chunk owns the candidates which land in [0, CHUNK_WIDTH - 1) (its neighbors own the shared border)
+	glm::vec2 origin = glm::vec2(chunkCoordinates) * float(CHUNK_WIDTH - 1);
+	glm::ivec2 firstCell = glm::floor(origin / float(TREE_CELL_SIZE)), lastCell = glm::floor((origin + float(CHUNK_WIDTH - 1)) / float(TREE_CELL_SIZE));
+
+	std::vector<TreeInstance> scattered;
+	for(int cx = firstCell.x; cx <= lastCell.x; cx++)
+		for(int cz = firstCell.y; cz <= lastCell.y; cz++) {
+			glm::ivec2 cell = {cx, cz};
+			glm::vec2 local = cellCandidate(cell) - origin;
+			if(local.x < 0 || local.y < 0 || local.x >= CHUNK_WIDTH - 1 || local.y >= CHUNK_WIDTH - 1) continue;
+			if(!keepCandidate(cell)) continue;
+
+			// Bilinearly sample the height of the surface
+			int x = local.x, z = local.y;
+			glm::vec2 t = local - glm::vec2(x, z);
+			float y = glm::mix(glm::mix(height(x, z), height(x + 1, z), t.x), glm::mix(height(x, z + 1), height(x + 1, z + 1), t.x), t.y);
+			if(!(y > TREE_MIN_HEIGHT)) continue; // NOTE: Also rejects columns with no surface
+
+			// Calculate the surface's normal from the heightmap (central differences at the nearest column) and make sure it isn't too steep
+			int nx = std::round(local.x), nz = std::round(local.y);
+			float dx = (height(nx + 1, nz) - height(nx - 1, nz)) / (std::min(nx + 1, CHUNK_WIDTH - 1) - std::max(nx - 1, 0));
+			float dz = (height(nx, nz + 1) - height(nx, nz - 1)) / (std::min(nz + 1, CHUNK_WIDTH - 1) - std::max(nz - 1, 0));
+			glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1, -dz));
+			if(!(normal.y >= std::cos(TREE_MAX_ANGLE))) continue;
+
+			scattered.push_back({
+				{origin.x + local.x, y - CHUNK_HEIGHT / 2, origin.y + local.y},
+				hashCellFloat(cell, 4) * glm::two_pi<float>(),
+				uint8_t(hashCell(cell, 5) % TREE_MODEL_COUNT)
+			});
+		}
+
+	return scattered;
+}
+
+void Chunk::layoutSections(const SectionVertices& sectionVertices, const SectionIndices& sectionIndices) {
+	// Give each section room to grow
+	uint32_t vertexCount = 0, indexCount = 0;
+	for(size_t i = 0; i < CHUNK_SECTIONS; i++) {
+		auto& section = sections[i];
+		section.firstVertex = vertexCount;
+		section.vertexCount = sectionVertices[i].size();
+		section.vertexCapacity = section.vertexCount + std::max<uint32_t>(section.vertexCount * CHUNK_SECTION_SLACK, 32);
+		section.firstIndex = indexCount;
+		section.indexCount = sectionIndices[i].size();
+		section.indexCapacity = section.indexCount + std::max<uint32_t>(section.indexCount * CHUNK_SECTION_SLACK, 96);
+
+		vertexCount += section.vertexCapacity;
+		indexCount += section.indexCapacity;
+	}
+
+	// Copy the sections into the buffers (which are kept after they are uploaded)
+	MemoryTracker::Scope tag(MemoryTracker::Meshes);
+	vertices.assign(vertexCount, Vertex(glm::vec3(0), glm::vec3(0), glm::vec2(0), glm::vec3(0)));
+	indices.assign(indexCount, 0);
+	for(size_t i = 0; i < CHUNK_SECTIONS; i++) {
+		std::copy(sectionVertices[i].begin(), sectionVertices[i].end(), vertices.begin() + sections[i].firstVertex);
+		std::copy(sectionIndices[i].begin(), sectionIndices[i].end(), indices.begin() + sections[i].firstIndex);
+	}
+
+	layoutDirty = true;
+	uploadDirty.set();
+}
+
+bool Chunk::placeSection(size_t i, const std::pmr::vector<Vertex>& sectionVertices, const std::pmr::vector<unsigned int>& sectionIndices) {
+	auto& section = sections[i];
+	if(sectionVertices.size() > section.vertexCapacity || sectionIndices.size() > section.indexCapacity)
+		return false;
+
+	std::copy(sectionVertices.begin(), sectionVertices.end(), vertices.begin() + section.firstVertex);
+	std::copy(sectionIndices.begin(), sectionIndices.end(), indices.begin() + section.firstIndex);
+	section.vertexCount = sectionVertices.size();
+	section.indexCount = sectionIndices.size();
+
+	uploadDirty.set(i);
+	return true;
+}
+
+void Chunk::buildSectionCollider(Section& section) const {
+	section.shape = nullptr;
+	section.trimesh = nullptr;
+	// Bullet can't build a BVH without any triangles
+	if(section.indexCount == 0) return;
+
+	// The section's vertices are shared between its triangles (and the trimesh's arrays are sized up front) rather than adding three vertices per triangle
+	section.trimesh = std::make_unique<btTriangleMesh>();
+	section.trimesh->preallocateVertices(section.vertexCount);
+	section.trimesh->preallocateIndices(section.indexCount);
+	for(size_t i = section.firstVertex; i < section.firstVertex + section.vertexCount; i++)
+		section.trimesh->findOrAddVertex(toBullet(vertices[i].vertex), /*removeDuplicateVertices*/ false);
+	for(size_t i = section.firstIndex; i + 2 < section.firstIndex + section.indexCount; i += 3)
+		section.trimesh->addTriangleIndices(indices[i], indices[i + 1], indices[i + 2]);
+	section.shape = std::make_unique<btBvhTriangleMeshShape>(section.trimesh.get(), true);
+}
+
+bool Chunk::createMeshCollider(const Arguments& args, Physics& physics, size_t maxHulls /*= CONCAVE_MESH*/, std::string path /*= ""*/) {
+	std::scoped_lock lock(meshMutex);
+
+	// The collider is a compound of one concave mesh per section so sections can be swapped out when they are edited
+	auto compound = std::make_unique<btCompoundShape>();
+	for(auto& section: sections) {
+		buildSectionCollider(section);
+		if(section.shape) compound->addChildShape(btTransform::getIdentity(), section.shape.get());
+	}
+
+	collisionShape = std::move(compound);
+	rigidBody->setCollisionShape(collisionShape.get());
+	hasSectionCollider = true;
+	return true;
+}
+
+bool Chunk::queueEdit(const DensityEdit& edit) {
+	std::scoped_lock lock(editMutex);
+	queuedEdits.push_back(edit);
+	// Only the first queued edit needs a task, later edits are picked up by the same task
+	return queuedEdits.size() == 1;
+}
+
+bool Chunk::hasUnsavedEdits() {
+	std::scoped_lock lock(editMutex);
+	return unsavedEdits || !queuedEdits.empty();
+}
+
+void Chunk::applyQueuedEdits() {
+	// Take the edits while holding the mesh (so anyone storing the chunk, after applying the queued edits themselves, waits for these)
+	std::scoped_lock lock(meshMutex);
+	std::vector<DensityEdit> edits;
+	{
+		std::scoped_lock editLock(editMutex);
+		edits.swap(queuedEdits);
+		// Marked as soon as the edits leave the queue, so the chunk never looks unedited while they are being applied
+		if(!edits.empty()) unsavedEdits = true;
+	}
+	if(edits.empty()) return;
+
+	// Apply the edits to the voxels, tracking which sections have cells touching a changed voxel
+	glm::vec3 origin = getPosition();
+	std::bitset<CHUNK_SECTIONS> dirty;
+	for(auto& edit: edits) {
+		glm::ivec3 low = glm::max(glm::ivec3(glm::floor(edit.min - origin)), glm::ivec3(0));
+		glm::ivec3 high = glm::min(glm::ivec3(glm::ceil(edit.max - origin)), glm::ivec3(CHUNK_WIDTH - 1, CHUNK_HEIGHT - 1, CHUNK_WIDTH - 1));
+		if(glm::any(glm::lessThan(high, low))) continue;
+
+		glm::vec3 center = (edit.min + edit.max) / 2.0f, radius = glm::max((edit.max - edit.min) / 2.0f, glm::vec3(.001));
+		bool changed = false;
+		for(int x = low.x; x <= high.x; x++)
+			for(int y = low.y; y <= high.y; y++)
+				for(int z = low.z; z <= high.z; z++) {
+					// Spheres fall off towards their edge
+					float weight = 1;
+					if(edit.shape == DensityEdit::Sphere) {
+						weight = 1 - glm::length((origin + glm::vec3(x, y, z) - center) / radius);
+						if(weight <= 0) continue;
+					}
+
+					Voxel& voxel = voxels[x][y][z];
+					voxel.isoLevel -= edit.delta * weight;
+					if(voxel.isoLevel > 0) voxel.type = Voxel::Type::Air;
+					else if(voxel.type == Voxel::Type::Air) voxel.type = Voxel::Type::Grass;
+					changed = true;
+				}
+
+		// A voxel is a corner of the cells above and below it
+		if(changed)
+			for(int section = std::max(low.y - 1, 0) / CHUNK_SECTION_HEIGHT; section <= std::min(high.y, CHUNK_HEIGHT - 2) / CHUNK_SECTION_HEIGHT; section++)
+				dirty.set(section);
+	}
+	if(dirty.none()) return;
+
+	// Remesh the dirty sections, if one of them outgrew its space then lay the whole mesh out again
+	ScratchArena& scratch = ScratchArena::local();
+	SectionVertices sectionVertices(CHUNK_SECTIONS, &scratch);
+	SectionIndices sectionIndices(CHUNK_SECTIONS, &scratch);
+	bool fits = true;
+	for(size_t i = 0; i < CHUNK_SECTIONS; i++)
+		if(dirty[i]) {
+			meshSection(i, sectionVertices[i], sectionIndices[i]);
+			fits &= placeSection(i, sectionVertices[i], sectionIndices[i]);
+		}
+	if(!fits) {
+		for(size_t i = 0; i < CHUNK_SECTIONS; i++)
+			if(!dirty[i]) {
+				auto& section = sections[i];
+				sectionVertices[i].assign(vertices.begin() + section.firstVertex, vertices.begin() + section.firstVertex + section.vertexCount);
+				sectionIndices[i].assign(indices.begin() + section.firstIndex, indices.begin() + section.firstIndex + section.indexCount);
 			}
+		layoutSections(sectionVertices, sectionIndices);
+	}
+
+	// Trees on a changed surface would float over holes (or be buried), so place them again (the placement only depends on the surface, so
+	// they match what scattering the edited chunk from scratch would place)
+	editedTrees = placeTrees(glm::ivec2(glm::round(glm::vec2(origin.x, origin.z) / float(CHUNK_WIDTH - 1))));
+
+	// Swap the dirty sections' collider pieces (if the chunk is collidable yet, otherwise the whole collider will be built from the new mesh)
+	if(!hasSectionCollider) return;
+	std::array<Section, CHUNK_SECTIONS> replaced;
+	for(size_t i = 0; i < CHUNK_SECTIONS; i++)
+		if(dirty[i]) {
+			replaced[i].trimesh = std::move(sections[i].trimesh);
+			replaced[i].shape = std::move(sections[i].shape);
+			buildSectionCollider(sections[i]);
 		}
+
+	auto compound = (btCompoundShape*) collisionShape.get();
+	auto world = Physics::getSingleton().getWorld().write_lock();
+	for(size_t i = 0; i < CHUNK_SECTIONS; i++)
+		if(dirty[i]) {
+			if(replaced[i].shape) compound->removeChildShape(replaced[i].shape.get());
+			if(sections[i].shape) compound->addChildShape(btTransform::getIdentity(), sections[i].shape.get());
+		}
+	if(rigidBody->getBroadphaseHandle()) world->updateSingleAabb(rigidBody.get());
+}
+
+void Chunk::uploadMesh() {
+	std::scoped_lock lock(meshMutex);
+
+	// If the layout changed (or this is the first upload) upload everything
+	if(layoutDirty) {
+		bool firstUpload = VB == std::numeric_limits<GLuint>::max();
+		finalizeModel(/*recursive*/ firstUpload);
+
+	// Otherwise only upload the ranges of the sections which changed
+	} else if(uploadDirty.any()) {
+		glBindBuffer(GL_ARRAY_BUFFER, VB);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
+		for(size_t i = 0; i < CHUNK_SECTIONS; i++)
+			if(uploadDirty[i]) {
+				auto& section = sections[i];
+				glBufferSubData(GL_ARRAY_BUFFER, section.firstVertex * sizeof(Vertex), section.vertexCount * sizeof(Vertex), vertices.data() + section.firstVertex);
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, section.firstIndex * sizeof(unsigned int), section.indexCount * sizeof(unsigned int), indices.data() + section.firstIndex);
+			}
+	}
+	layoutDirty = false;
+	uploadDirty.reset();
+
+	// Draw the trees placed on the edited surface
+	if(editedTrees) {
+		trees = std::move(*editedTrees);
+		editedTrees.reset();
 	}
-}
\ No newline at end of file
+
+	// Rebuild the heightmap so things walking on the terrain don't need to raycast it
+	for(size_t x = 0; x < CHUNK_WIDTH; x++)
+		for(size_t z = 0; z < CHUNK_WIDTH; z++)
+			heightmap[x][z] = surfaceHeight(x, z) - CHUNK_HEIGHT / 2;
+
+	// Update what gets drawn to match what was uploaded
+	for(size_t i = 0; i < CHUNK_SECTIONS; i++) {
+		drawCounts[i] = sections[i].indexCount;
+		drawOffsets[i] = (void*) (sections[i].firstIndex * sizeof(unsigned int));
+		drawBaseVertices[i] = sections[i].firstVertex;
+	}
+}
+
+void Chunk::draw() {
+	// Draw every section in one call (section indices are relative to the section's first vertex)
+	COUNTED_GL(glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT, drawOffsets.data(), CHUNK_SECTIONS, drawBaseVertices.data()));
+}
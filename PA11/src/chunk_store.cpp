@@ -0,0 +1,369 @@
+#include "chunk_store.h"
+#include "chunk.h"
+#include "memory_tracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// Magic number at the start of every region file
+static const char REGION_MAGIC[4] = {'R', 'G', 'N', 'S'};
+
+// Division which rounds towards negative infinity (so chunks at negative coordinates land in the correct region)
+static int floorDiv(int a, int b) { return a / b - (a % b < 0); }
+
+// Functions which regroup data (made of 4 byte values) so that the first bytes of every value are together, then the second bytes, etc...
+// Neighboring voxels and vertices have very similar high bytes, so this greatly improves how well the data compresses
+static std::vector<uint8_t> shuffle(const std::vector<uint8_t>& data) {
+	std::vector<uint8_t> out(data.size());
+	size_t count = data.size() / 4;
+	for(size_t i = 0; i < count; i++)
+		for(size_t b = 0; b < 4; b++)
+			out[b * count + i] = data[i * 4 + b];
+	return out;
+}
+static std::vector<uint8_t> unshuffle(const std::vector<uint8_t>& data) {
+	std::vector<uint8_t> out(data.size());
+	size_t count = data.size() / 4;
+	for(size_t i = 0; i < count; i++)
+		for(size_t b = 0; b < 4; b++)
+			out[i * 4 + b] = data[b * count + i];
+	return out;
+}
+
+
+ChunkStore::Region::~Region() {
+	if(map) munmap((void*) map, mappedSize);
+	if(fd >= 0) close(fd);
+}
+
+bool ChunkStore::Region::remap(size_t size) {
+	if(size <= mappedSize) return true;
+
+	if(map) munmap((void*) map, mappedSize);
+	map = nullptr;
+	mappedSize = 0;
+
+	// Map the whole file
+	struct stat info;
+	if(fstat(fd, &info) != 0 || size_t(info.st_size) < size) return false;
+	void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if(mapped == MAP_FAILED) return false;
+
+	map = (const uint8_t*) mapped;
+	mappedSize = info.st_size;
+	return true;
+}
+
+bool ChunkStore::Region::compact(size_t index) {
+	std::string temporaryPath = path + ".tmp";
+	int out = ::open(temporaryPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if(out < 0) return false;
+
+	// Copy every other chunk into the temporary file, one after another
+	Header compacted = header;
+	compacted.table[index] = {};
+	uint64_t offset = sizeof(Header);
+	std::vector<uint8_t> buffer;
+	bool success = true;
+	for(TableEntry& entry: compacted.table) {
+		if(entry.size == 0) continue;
+		buffer.resize(entry.size);
+		success &= pread(fd, buffer.data(), entry.size, entry.offset) == ssize_t(entry.size)
+			&& pwrite(out, buffer.data(), entry.size, offset) == ssize_t(entry.size);
+		if(!success) break;
+		entry.offset = offset;
+		offset += entry.capacity;
+	}
+
+	// Then swap it in for the region file
+	success = success && pwrite(out, &compacted, sizeof(Header), 0) == sizeof(Header) && ftruncate(out, offset) == 0
+		&& std::rename(temporaryPath.c_str(), path.c_str()) == 0;
+	if(!success) {
+		close(out);
+		unlink(temporaryPath.c_str());
+		return false;
+	}
+
+	// The old map (and file descriptor) are of the replaced file
+	if(map) munmap((void*) map, mappedSize);
+	map = nullptr;
+	mappedSize = 0;
+	close(fd);
+	fd = out;
+	header = compacted;
+	end = offset;
+	return true;
+}
+
+void ChunkStore::initialize(std::string directory, uint32_t seed, uint64_t generator) {
+	this->directory = std::move(directory);
+	this->seed = seed;
+	this->generator = generator;
+}
+
+glm::ivec2 ChunkStore::regionCoordinates(glm::ivec2 chunkCoordinates) {
+	return { floorDiv(chunkCoordinates.x, REGION_WIDTH), floorDiv(chunkCoordinates.y, REGION_WIDTH) };
+}
+
+size_t ChunkStore::tableIndex(glm::ivec2 chunkCoordinates) {
+	glm::ivec2 inner = chunkCoordinates - regionCoordinates(chunkCoordinates) * REGION_WIDTH;
+	return inner.x * REGION_WIDTH + inner.y;
+}
+
+ChunkStore::Region* ChunkStore::getRegion(glm::ivec2 chunkCoordinates) {
+	glm::ivec2 coordinates = regionCoordinates(chunkCoordinates);
+	if(directory.empty()) return nullptr; // The store hasn't been opened
+
+	std::scoped_lock lock(regionsMutex);
+	auto& region = regions[key(coordinates)];
+	if(region) return region->fd >= 0 ? region.get() : nullptr;
+	region = std::make_unique<Region>();
+
+	// Open (or create) the region file
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	std::stringstream path;
+	path << directory << "r." << coordinates.x << "." << coordinates.y << ".region";
+	region->path = path.str();
+	region->fd = open(region->path.c_str(), O_RDWR | O_CREAT, 0644);
+	if(region->fd < 0) {
+		std::cerr << "Failed to open region file `" << region->path << "`" << std::endl;
+		return nullptr;
+	}
+
+	// If the file already has a valid header, use its table
+	struct stat info;
+	fstat(region->fd, &info);
+	if(size_t(info.st_size) >= sizeof(Header) && pread(region->fd, &region->header, sizeof(Header), 0) == sizeof(Header)
+	  && std::memcmp(region->header.magic, REGION_MAGIC, sizeof(REGION_MAGIC)) == 0 && region->header.version == CHUNK_STORE_VERSION && region->header.seed == seed
+	  && region->header.generator == generator) {
+		// The last chunk's slot may run past the end of the file
+		region->end = info.st_size;
+		for(auto& entry: region->header.table)
+			if(entry.size > 0) region->end = std::max(region->end, entry.offset + entry.capacity);
+		return region.get();
+	}
+
+	// Otherwise start a fresh file
+	std::memset(&region->header, 0, sizeof(Header));
+	std::memcpy(region->header.magic, REGION_MAGIC, sizeof(REGION_MAGIC));
+	region->header.version = CHUNK_STORE_VERSION;
+	region->header.seed = seed;
+	region->header.generator = generator;
+	if(ftruncate(region->fd, 0) != 0 || pwrite(region->fd, &region->header, sizeof(Header), 0) != sizeof(Header)) {
+		std::cerr << "Failed to initialize region file `" << region->path << "`" << std::endl;
+		close(region->fd);
+		region->fd = -1;
+		return nullptr;
+	}
+	region->end = sizeof(Header);
+	return region.get();
+}
+
+bool ChunkStore::contains(glm::ivec2 chunkCoordinates) {
+	{
+		std::scoped_lock lock(lruMutex);
+		if(lruLookup.count(key(chunkCoordinates))) return true;
+	}
+
+	Region* region = getRegion(chunkCoordinates);
+	if(!region) return false;
+
+	std::shared_lock lock(region->mutex);
+	return region->header.table[tableIndex(chunkCoordinates)].size > 0;
+}
+
+bool ChunkStore::load(glm::ivec2 chunkCoordinates, Chunk& chunk) {
+	auto start = std::chrono::steady_clock::now();
+	auto recordLoad = [&](std::atomic<size_t>& hits) {
+		hits++;
+		loadMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	};
+
+	// Check the memory tier first
+	if(Blob blob = getCached(key(chunkCoordinates)))
+		if(deserialize(*blob, chunk))
+			return recordLoad(memoryHits);
+
+	Region* region = getRegion(chunkCoordinates);
+	if(!region) return false;
+
+	// Decompress the chunk straight out of the mapped file
+	auto data = std::make_shared<std::vector<uint8_t>>();
+	{
+		size_t index = tableIndex(chunkCoordinates);
+		std::shared_lock lock(region->mutex);
+		TableEntry entry = region->header.table[index];
+		if(entry.size == 0) return false;
+
+		// Grow the map if the chunk was written after the region was last mapped (or the region has been compacted since)
+		if(entry.offset + entry.size > region->mappedSize) {
+			lock.unlock();
+			{
+				std::unique_lock growLock(region->mutex);
+				entry = region->header.table[index];
+				if(entry.size == 0 || !region->remap(entry.offset + entry.size)) return false;
+			}
+			lock.lock();
+
+			// The chunk may have been moved again while the lock was let go
+			entry = region->header.table[index];
+			if(entry.size == 0 || entry.offset + entry.size > region->mappedSize) return false;
+		}
+
+		std::vector<uint8_t> shuffled(entry.rawSize);
+		uLongf rawSize = entry.rawSize;
+		if(uncompress(shuffled.data(), &rawSize, region->map + entry.offset, entry.size) != Z_OK || rawSize != entry.rawSize)
+			return false;
+		*data = unshuffle(shuffled);
+	}
+
+	if(!deserialize(*data, chunk)) return false;
+	cache(key(chunkCoordinates), data);
+	return recordLoad(diskHits);
+}
+
+bool ChunkStore::save(glm::ivec2 chunkCoordinates, const Chunk& chunk) {
+	auto data = std::make_shared<std::vector<uint8_t>>(serialize(chunk));
+	cache(key(chunkCoordinates), data);
+
+	// Compress the data
+	auto shuffled = shuffle(*data);
+	std::vector<uint8_t> compressed(compressBound(shuffled.size()));
+	uLongf compressedSize = compressed.size();
+	if(compress2(compressed.data(), &compressedSize, shuffled.data(), shuffled.size(), Z_BEST_SPEED) != Z_OK)
+		return false;
+
+	Region* region = getRegion(chunkCoordinates);
+	if(!region) return false;
+
+	std::unique_lock lock(region->mutex);
+	size_t index = tableIndex(chunkCoordinates);
+	TableEntry entry = region->header.table[index];
+
+	// Rewrite the chunk in place if it still fits in its slot, otherwise give it a new slot at the end of the region
+	// (compacting the region first, so the old slot isn't left abandoned in the file)
+	if(entry.size == 0 || compressedSize > entry.capacity) {
+		if(entry.size > 0 && !region->compact(index)) return false;
+		uint32_t capacity = (compressedSize + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE * REGION_SECTOR_SIZE;
+		entry = { region->end, 0, 0, capacity, 0 };
+		region->end += capacity;
+	}
+	entry.size = compressedSize;
+	entry.rawSize = data->size();
+	if(pwrite(region->fd, compressed.data(), compressedSize, entry.offset) != ssize_t(compressedSize))
+		return false;
+
+	region->header.table[index] = entry;
+	return pwrite(region->fd, &entry, sizeof(entry), offsetof(Header, table) + index * sizeof(TableEntry)) == sizeof(entry);
+}
+
+void ChunkStore::recordGeneration(float milliseconds) {
+	misses++;
+	generateMicroseconds += uint64_t(milliseconds * 1000);
+}
+
+ChunkStore::Stats ChunkStore::getStats() const {
+	Stats stats;
+	stats.memoryHits = memoryHits;
+	stats.diskHits = diskHits;
+	stats.misses = misses;
+
+	size_t hits = stats.memoryHits + stats.diskHits;
+	stats.averageLoadTime = hits ? loadMicroseconds / 1000.0f / hits : 0;
+	stats.averageGenerateTime = stats.misses ? generateMicroseconds / 1000.0f / stats.misses : 0;
+	return stats;
+}
+
+ChunkStore::Blob ChunkStore::getCached(uint64_t key) {
+	std::scoped_lock lock(lruMutex);
+	auto found = lruLookup.find(key);
+	if(found == lruLookup.end()) return nullptr;
+
+	// Mark the chunk as the most recently used
+	lru.splice(lru.begin(), lru, found->second);
+	return found->second->second;
+}
+
+void ChunkStore::cache(uint64_t key, Blob blob) {
+	std::scoped_lock lock(lruMutex);
+	if(auto found = lruLookup.find(key); found != lruLookup.end()) {
+		found->second->second = std::move(blob);
+		lru.splice(lru.begin(), lru, found->second);
+		return;
+	}
+
+	lru.emplace_front(key, std::move(blob));
+	lruLookup[key] = lru.begin();
+
+	// Evict the least recently used chunk
+	if(lru.size() > CHUNK_STORE_MEMORY_CAPACITY) {
+		lruLookup.erase(lru.back().first);
+		lru.pop_back();
+	}
+}
+
+// Raw layout: vertex count, index count, section table, voxels, vertices, indices
+std::vector<uint8_t> ChunkStore::serialize(const Chunk& chunk) {
+	// Edited chunks are stored again, so don't copy one halfway through an edit
+	std::scoped_lock lock(chunk.meshMutex);
+	uint32_t vertexCount = chunk.vertices.size(), indexCount = chunk.indices.size();
+	std::vector<uint8_t> out(2 * sizeof(uint32_t) + CHUNK_SECTIONS * 6 * sizeof(uint32_t) + sizeof(chunk.voxels) + vertexCount * sizeof(Vertex) + indexCount * sizeof(uint32_t));
+
+	uint8_t* cursor = out.data();
+	auto write = [&cursor](const void* data, size_t size) { std::memcpy(cursor, data, size); cursor += size; };
+	write(&vertexCount, sizeof(vertexCount));
+	write(&indexCount, sizeof(indexCount));
+	for(auto& section: chunk.sections) {
+		uint32_t table[6] = { section.firstVertex, section.vertexCount, section.vertexCapacity, section.firstIndex, section.indexCount, section.indexCapacity };
+		write(table, sizeof(table));
+	}
+	write(chunk.voxels, sizeof(chunk.voxels));
+	write(chunk.vertices.data(), vertexCount * sizeof(Vertex));
+	write(chunk.indices.data(), indexCount * sizeof(uint32_t));
+	return out;
+}
+
+bool ChunkStore::deserialize(const std::vector<uint8_t>& data, Chunk& chunk) {
+	const size_t fixedSize = 2 * sizeof(uint32_t) + CHUNK_SECTIONS * 6 * sizeof(uint32_t) + sizeof(chunk.voxels);
+	if(data.size() < fixedSize) return false;
+
+	const uint8_t* cursor = data.data();
+	auto read = [&cursor](void* data, size_t size) { std::memcpy(data, cursor, size); cursor += size; };
+	uint32_t vertexCount, indexCount;
+	read(&vertexCount, sizeof(vertexCount));
+	read(&indexCount, sizeof(indexCount));
+	if(data.size() != fixedSize + vertexCount * sizeof(Vertex) + indexCount * sizeof(uint32_t))
+		return false;
+
+	std::scoped_lock lock(chunk.meshMutex);
+	for(auto& section: chunk.sections) {
+		uint32_t table[6];
+		read(table, sizeof(table));
+		section.firstVertex = table[0]; section.vertexCount = table[1]; section.vertexCapacity = table[2];
+		section.firstIndex = table[3]; section.indexCount = table[4]; section.indexCapacity = table[5];
+	}
+	read(chunk.voxels, sizeof(chunk.voxels));
+	MemoryTracker::Scope tag(MemoryTracker::Meshes);
+	chunk.vertices.resize(vertexCount, Vertex({}, {}, {}, {}));
+	read(chunk.vertices.data(), vertexCount * sizeof(Vertex));
+	chunk.indices.resize(indexCount);
+	read(chunk.indices.data(), indexCount * sizeof(uint32_t));
+
+	chunk.layoutDirty = true;
+	chunk.uploadDirty.set();
+	return true;
+}
@@ -0,0 +1,225 @@
+#include "collider_cache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+// Convex hull
+#include "VHACD.h"
+
+// Magic number at the start of every cache file
+static const char CACHE_MAGIC[4] = {'V', 'H', 'C', 'D'};
+
+bool ConvexDecomposition::load(const std::string& path, uint64_t key) {
+	std::ifstream fin(path, std::ios::binary);
+	if(!fin) return false;
+
+	// Make sure the file is a cache file, from this version, for this mesh
+	char magic[4];
+	uint32_t version, hullCount;
+	uint64_t fileKey;
+	fin.read(magic, sizeof(magic));
+	fin.read((char*) &version, sizeof(version));
+	fin.read((char*) &fileKey, sizeof(fileKey));
+	fin.read((char*) &hullCount, sizeof(hullCount));
+	if(!fin || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || version != COLLIDER_CACHE_VERSION || fileKey != key)
+		return false;
+
+	// Read each hull
+	hulls.resize(hullCount);
+	for(auto& hull: hulls) {
+		uint32_t pointCount, triangleCount;
+		fin.read((char*) &pointCount, sizeof(pointCount));
+		fin.read((char*) &triangleCount, sizeof(triangleCount));
+		if(!fin) return false;
+
+		hull.points.resize(pointCount * 3);
+		hull.triangles.resize(triangleCount * 3);
+		fin.read((char*) hull.points.data(), hull.points.size() * sizeof(float));
+		fin.read((char*) hull.triangles.data(), hull.triangles.size() * sizeof(uint32_t));
+	}
+
+	return bool(fin);
+}
+
+bool ConvexDecomposition::save(const std::string& path, uint64_t key) const {
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+	// Write to a temporary file and then move it into place so a half written file is never read
+	std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream fout(temporaryPath, std::ios::binary);
+		if(!fout) return false;
+
+		uint32_t version = COLLIDER_CACHE_VERSION, hullCount = hulls.size();
+		fout.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		fout.write((char*) &version, sizeof(version));
+		fout.write((char*) &key, sizeof(key));
+		fout.write((char*) &hullCount, sizeof(hullCount));
+
+		for(auto& hull: hulls) {
+			uint32_t pointCount = hull.points.size() / 3, triangleCount = hull.triangles.size() / 3;
+			fout.write((char*) &pointCount, sizeof(pointCount));
+			fout.write((char*) &triangleCount, sizeof(triangleCount));
+			fout.write((char*) hull.points.data(), hull.points.size() * sizeof(float));
+			fout.write((char*) hull.triangles.data(), hull.triangles.size() * sizeof(uint32_t));
+		}
+
+		if(!fout) return false;
+	}
+
+	std::filesystem::rename(temporaryPath, path, error);
+	return !error;
+}
+
+
+std::shared_future<SharedConvexCollider::ptr> ColliderCache::request(const Arguments& args, std::vector<float> points, std::vector<uint32_t> indices, size_t maxHulls) {
+	// Colliders which have already been requested (the futures are shared so that every object using the same mesh waits on the same decomposition)
+	static std::mutex mutex;
+	static std::unordered_map<uint64_t, std::shared_future<SharedConvexCollider::ptr>> colliders;
+
+	uint64_t key = hash(points, indices, maxHulls);
+
+	std::scoped_lock lock(mutex);
+	if(auto found = colliders.find(key); found != colliders.end())
+		return found->second;
+
+	std::stringstream path;
+	path << args.getResourcePath() << "cache/vhacd/" << std::hex << std::setw(16) << std::setfill('0') << key << ".hulls";
+
+	// Load (or compute and save) the decomposition on a worker thread
+	auto future = std::async(std::launch::async, [path = path.str(), key, points = std::move(points), indices = std::move(indices), maxHulls]() {
+		ConvexDecomposition decomposition;
+		if(!decomposition.load(path, key)) {
+			decomposition = decompose(points, indices, maxHulls);
+			if(!decomposition.save(path, key))
+				std::cerr << "Failed to save convex decomposition cache `" << path << "`" << std::endl;
+		}
+
+		return buildCollider(decomposition);
+	}).share();
+
+	colliders.emplace(key, future);
+	return future;
+}
+
+std::shared_future<SharedConvexCollider::ptr> ColliderCache::request(MeshBlob::ptr blob) {
+	// Colliders which have already been built (the collider keeps its model mapped, so a model's address is never reused while it is in here)
+	static std::mutex mutex;
+	static std::unordered_map<const MeshBlob*, std::shared_future<SharedConvexCollider::ptr>> colliders;
+
+	std::scoped_lock lock(mutex);
+	if(auto found = colliders.find(blob.get()); found != colliders.end())
+		return found->second;
+
+	std::promise<SharedConvexCollider::ptr> collider;
+	collider.set_value(buildCollider(blob));
+	auto future = collider.get_future().share();
+	colliders.emplace(blob.get(), future);
+	return future;
+}
+
+uint64_t ColliderCache::hash(const std::vector<float>& points, const std::vector<uint32_t>& indices, size_t maxHulls) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	auto combine = [&hash](const void* data, size_t size) {
+		const uint8_t* bytes = (const uint8_t*) data;
+		for(size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3;
+		}
+	};
+
+	uint64_t version = COLLIDER_CACHE_VERSION, hulls = maxHulls, pointCount = points.size(), indexCount = indices.size();
+	combine(&version, sizeof(version));
+	combine(&hulls, sizeof(hulls));
+	combine(&pointCount, sizeof(pointCount));
+	combine(points.data(), points.size() * sizeof(float));
+	combine(&indexCount, sizeof(indexCount));
+	combine(indices.data(), indices.size() * sizeof(uint32_t));
+	return hash;
+}
+
+ConvexDecomposition ColliderCache::decompose(const std::vector<float>& points, const std::vector<uint32_t>& indices, size_t maxHulls) {
+	VHACD::IVHACD::Parameters params; // V-HACD parameters
+	params.m_maxConvexHulls = maxHulls;
+	VHACD::IVHACD* interfaceVHACD = VHACD::CreateVHACD(); // Create Decomposer
+
+	// Compute approximate convex decomposition
+	interfaceVHACD->Compute(points.data(), points.size() / 3, indices.data(), indices.size() / 3, params);
+
+	// Copy each computed convex hull out of the decomposer
+	ConvexDecomposition out;
+	out.hulls.resize(interfaceVHACD->GetNConvexHulls());
+	for (size_t i = 0; i < out.hulls.size(); i++) {
+		VHACD::IVHACD::ConvexHull hull;
+		interfaceVHACD->GetConvexHull(i, hull);
+
+		out.hulls[i].points.assign(hull.m_points, hull.m_points + hull.m_nPoints * 3);
+		out.hulls[i].triangles.assign(hull.m_triangles, hull.m_triangles + hull.m_nTriangles * 3);
+	}
+
+	// Release decomposer memory
+	interfaceVHACD->Clean();
+	interfaceVHACD->Release();
+
+	return out;
+}
+
+SharedConvexCollider::ptr ColliderCache::buildCollider(const ConvexDecomposition& decomposition) {
+	auto collider = std::make_shared<SharedConvexCollider>();
+	collider->compound = std::make_unique<btCompoundShape>();
+
+	for(auto& hull: decomposition.hulls) {
+		// Add each point once and then the triangles between them (with the trimesh's arrays sized up front)
+		auto trimesh = std::make_unique<btTriangleMesh>();
+		trimesh->preallocateVertices(hull.points.size() / 3);
+		trimesh->preallocateIndices(hull.triangles.size());
+		for (size_t i = 0; i + 2 < hull.points.size(); i += 3)
+			trimesh->findOrAddVertex(btVector3(hull.points[i], hull.points[i + 1], hull.points[i + 2]), /*removeDuplicateVertices*/ false);
+		for (size_t i = 0; i + 2 < hull.triangles.size(); i += 3)
+			trimesh->addTriangleIndices(hull.triangles[i], hull.triangles[i + 1], hull.triangles[i + 2]);
+		collider->trimeshs.emplace_back( std::move(trimesh) );
+
+		collider->shapes.emplace_back( std::make_unique<btConvexTriangleMeshShape>( collider->trimeshs.back().get() ) );
+		collider->compound->addChildShape(btTransform::getIdentity(), collider->shapes.back().get());
+	}
+
+	return collider;
+}
+
+SharedConvexCollider::ptr ColliderCache::buildCollider(MeshBlob::ptr blob) {
+	static_assert(sizeof(btScalar) == sizeof(float), "Cooked hulls are stored as floats");
+
+	auto collider = std::make_shared<SharedConvexCollider>();
+	collider->compound = std::make_unique<btCompoundShape>();
+	collider->blob = blob;
+
+	for(size_t hull = 0; hull < blob->getHullCount(); hull++) {
+		// Point bullet at the hull inside of the mapping rather than copying it
+		btIndexedMesh mesh;
+		mesh.m_numTriangles = blob->getHullTriangleCount(hull);
+		mesh.m_triangleIndexBase = (const unsigned char*) blob->getHullTriangles(hull);
+		mesh.m_triangleIndexStride = 3 * sizeof(uint32_t);
+		mesh.m_numVertices = blob->getHullPointCount(hull);
+		mesh.m_vertexBase = (const unsigned char*) blob->getHullPoints(hull);
+		mesh.m_vertexStride = 3 * sizeof(float);
+		mesh.m_indexType = PHY_INTEGER;
+		mesh.m_vertexType = PHY_FLOAT;
+
+		auto trimesh = std::make_unique<btTriangleIndexVertexArray>();
+		trimesh->addIndexedMesh(mesh, PHY_INTEGER);
+		collider->trimeshs.emplace_back( std::move(trimesh) );
+
+		collider->shapes.emplace_back( std::make_unique<btConvexTriangleMeshShape>( collider->trimeshs.back().get() ) );
+		collider->compound->addChildShape(btTransform::getIdentity(), collider->shapes.back().get());
+	}
+
+	return collider;
+}
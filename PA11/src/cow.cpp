@@ -1,3 +0,0 @@
-#include "cow.h"
-
-Cow::~Cow() {}
\ No newline at end of file
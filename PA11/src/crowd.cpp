@@ -0,0 +1,463 @@
+#include "crowd.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+
+Crowd::~Crowd() {
+	// Make sure none of the pool's bodies are left in the scene or the physics world
+	truncate(0);
+}
+
+bool Crowd::initialize(const Arguments& args, Physics& physics, Object::ptr sceneRoot) {
+	this->physics = &physics;
+	this->sceneRoot = sceneRoot;
+
+	const char* modelFiles[SpeciesCount] = {"cow.obj", "alien.obj"};
+	for(size_t species = 0; species < SpeciesCount; species++) {
+		models[species] = std::make_shared<Model>();
+		sceneRoot->addChild(models[species]);
+		if(!models[species]->initializeGraphics(args, modelFiles[species], "texturemap.png"))
+			return false;
+
+		// The bodies are created up front so abducting something never waits on a model to load
+		for(size_t i = 0; i < CROWD_BODY_POOL; i++) {
+			auto object = std::make_shared<Object>();
+			object->initializeGraphics(args, modelFiles[species], "texturemap.png");
+			object->initializePhysics(args, physics, CollisionGroups::CG_COW, /*mass*/ 100, /*addToWorldAutomatically*/ false);
+			object->createMeshCollider(args, physics, CONVEX_MESH, "cube.obj");
+			object->makeDynamic();
+			bodies[species].push_back({object});
+		}
+	}
+
+	return true;
+}
+
+size_t Crowd::spawn(Species species, glm::vec2 position) {
+	size_t agent = size();
+	auto grow = [agent](auto&... fields) { (fields.resize(agent + 1), ...); };
+	grow(agents.x, agents.y, agents.z, agents.previousX, agents.previousY, agents.previousZ, agents.vx, agents.vz, agents.targetX, agents.targetZ,
+		agents.speed, agents.wait, agents.heading, agents.random, agents.body, agents.species, agents.flags);
+
+	// Not given a height until it is placed on the terrain
+	agents.x[agent] = agents.previousX[agent] = agents.targetX[agent] = position.x;
+	agents.z[agent] = agents.previousZ[agent] = agents.targetZ[agent] = position.y;
+	agents.y[agent] = agents.previousY[agent] = NAN;
+	agents.vx[agent] = agents.vz[agent] = 0;
+
+	// Each agent gets its own (never zero) random state
+	uint32_t& state = agents.random[agent];
+	state = (nextSeed++ * 2654435761u) | 1;
+	agents.speed[agent] = CROWD_WANDER_SPEED * (.75f + .5f * random(state));
+	agents.wait[agent] = random(state) * CROWD_MAX_WAIT;
+	agents.heading[agent] = random(state) * glm::two_pi<float>();
+
+	agents.body[agent] = -1;
+	agents.species[agent] = species;
+	agents.flags[agent] = 0;
+	index.update(agent, getPosition(agent));
+	return agent;
+}
+
+void Crowd::truncate(size_t count) {
+	if(count >= size()) return;
+
+	for(size_t agent = count; agent < size(); agent++) {
+		if(agents.flags[agent] & Promoted)
+			demote(agent);
+		index.remove(agent);
+	}
+
+	auto shrink = [count](auto&... fields) { (fields.resize(count), ...); };
+	shrink(agents.x, agents.y, agents.z, agents.previousX, agents.previousY, agents.previousZ, agents.vx, agents.vz, agents.targetX, agents.targetZ,
+		agents.speed, agents.wait, agents.heading, agents.random, agents.body, agents.species, agents.flags);
+}
+
+void Crowd::teleport(size_t agent, glm::vec2 position) {
+	if(agents.flags[agent] & Promoted)
+		demote(agent);
+
+	// The agent is hidden until the next step places it on the terrain at its new position
+	agents.x[agent] = agents.previousX[agent] = agents.targetX[agent] = position.x;
+	agents.z[agent] = agents.previousZ[agent] = agents.targetZ[agent] = position.y;
+	agents.vx[agent] = agents.vz[agent] = 0;
+	agents.wait[agent] = 0;
+	agents.flags[agent] &= ~(Placed | Chasing);
+	index.update(agent, getPosition(agent));
+}
+
+void Crowd::update(float dt) {
+	auto start = std::chrono::steady_clock::now();
+
+	// Figure out how many fixed steps need to be taken (dropping time if we have fallen too far behind)
+	accumulator = std::min(accumulator + dt, CROWD_STEP * CROWD_MAX_STEPS_PER_FRAME);
+	size_t steps = accumulator / CROWD_STEP;
+	accumulator -= steps * CROWD_STEP;
+
+	if(steps && size()) {
+		// The batches can't read the world while the chunk pipeline is changing it, so copy the heightmaps of the chunks around the agents
+		// (agents only wander to, and step within, the chunks next to theirs)
+		glm::vec2 min = glm::vec2(std::numeric_limits<float>::max()), max = -min;
+		for(size_t i = 0; i < size(); i++) {
+			min = glm::min(min, glm::vec2(agents.x[i], agents.z[i]));
+			max = glm::max(max, glm::vec2(agents.x[i], agents.z[i]));
+		}
+		world->snapshotTerrain(glm::ivec2(glm::floor(min / float(CHUNK_WIDTH - 1))) - 1, glm::ivec2(glm::floor(max / float(CHUNK_WIDTH - 1))) + 1, terrain);
+
+		// The workers and this thread pull batches until there are none left, then this thread sleeps until the batches still running finish
+		struct Batches {
+			std::atomic<size_t> next{0};
+			size_t count, done = 0;
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		auto batches = std::make_shared<Batches>();
+		batches->count = (size() + CROWD_BATCH_SIZE - 1) / CROWD_BATCH_SIZE;
+		auto work = [this, batches, steps]() {
+			// NOTE: A worker which starts after every batch has been taken returns without touching the crowd
+			for(size_t batch; (batch = batches->next++) < batches->count; ) {
+				stepBatch(batch * CROWD_BATCH_SIZE, std::min((batch + 1) * CROWD_BATCH_SIZE, size()), steps);
+
+				std::scoped_lock lock(batches->mutex);
+				if(++batches->done == batches->count)
+					batches->finished.notify_one();
+			}
+		};
+
+		auto& scheduler = world->getScheduler();
+		size_t helpers = std::min(scheduler.getWorkerCount(), batches->count - 1);
+		for(size_t i = 0; i < helpers; i++)
+			scheduler.schedule(TaskScheduler::Affinity::Worker, work);
+		work();
+
+		std::unique_lock lock(batches->mutex);
+		batches->finished.wait(lock, [&]{ return batches->done == batches->count; });
+	}
+
+	syncBodies(dt);
+	updateIndex();
+	uploadInstances();
+
+	lastUpdateTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	averageUpdateTime = glm::mix(averageUpdateTime, lastUpdateTime, .05f);
+}
+
+void Crowd::stepBatch(size_t begin, size_t end, size_t steps) {
+	for(size_t step = 0; step < steps; step++) {
+		think(begin, end);
+		move(begin, end);
+		ground(begin, end);
+	}
+}
+
+void Crowd::think(size_t begin, size_t end) {
+	for(size_t i = begin; i < end; i++) {
+		uint8_t& flags = agents.flags[i];
+		if(!(flags & Placed) || (flags & Promoted)) continue;
+
+		// Aliens which can see the target run at it, and go back to wandering once they lose sight of it
+		if(agents.species[i] == Alien) {
+			float distance = glm::distance(chaseTarget, glm::vec3(agents.x[i], agents.y[i], agents.z[i]));
+			if((100 - distance) * chaseVisibility > 10) {
+				flags |= Chasing;
+				agents.targetX[i] = chaseTarget.x;
+				agents.targetZ[i] = chaseTarget.z;
+				agents.speed[i] = CROWD_CHASE_SPEED;
+				continue;
+			} else if(flags & Chasing) {
+				flags &= ~Chasing;
+				agents.speed[i] = CROWD_WANDER_SPEED * (.75f + .5f * random(agents.random[i]));
+				agents.wait[i] = 0;
+			}
+		}
+
+		agents.wait[i] -= CROWD_STEP;
+		if(agents.wait[i] > 0) continue;
+
+		// Pick a new waypoint, only walking to loaded terrain which isn't too far of a step up or down
+		uint32_t& state = agents.random[i];
+		agents.wait[i] = random(state) * CROWD_MAX_WAIT;
+		float x = agents.x[i] + (random(state) * 2 - 1) * CROWD_WANDER_DISTANCE;
+		float z = agents.z[i] + (random(state) * 2 - 1) * CROWD_WANDER_DISTANCE;
+		float height = terrain.getHeight({x, z}) + CROWD_HEIGHT_OFFSET;
+		if(std::isnan(height) || std::abs(height - agents.y[i]) > CROWD_MAX_STEP_HEIGHT) {
+			x = agents.x[i];
+			z = agents.z[i];
+		}
+		agents.targetX[i] = x;
+		agents.targetZ[i] = z;
+	}
+}
+
+void Crowd::move(size_t begin, size_t end) {
+	// Plain loops over the arrays (no branches or lookups) so the compiler can vectorize them
+	float* __restrict x = agents.x.data();
+	float* __restrict y = agents.y.data();
+	float* __restrict z = agents.z.data();
+	float* __restrict previousX = agents.previousX.data();
+	float* __restrict previousY = agents.previousY.data();
+	float* __restrict previousZ = agents.previousZ.data();
+	float* __restrict vx = agents.vx.data();
+	float* __restrict vz = agents.vz.data();
+	const float* __restrict targetX = agents.targetX.data();
+	const float* __restrict targetZ = agents.targetZ.data();
+	const float* __restrict speed = agents.speed.data();
+	const float steering = std::min(CROWD_STEERING * CROWD_STEP, 1.0f);
+
+	for(size_t i = begin; i < end; i++) {
+		previousX[i] = x[i];
+		previousY[i] = y[i];
+		previousZ[i] = z[i];
+	}
+
+	for(size_t i = begin; i < end; i++) {
+		float dx = targetX[i] - x[i], dz = targetZ[i] - z[i];
+		float distance = std::sqrt(dx * dx + dz * dz);
+		// Full speed until within a unit of the waypoint, then slow to a stop on it
+		float scale = speed[i] * std::min(distance, 1.0f) / std::max(distance, 1e-3f);
+		vx[i] += (dx * scale - vx[i]) * steering;
+		vz[i] += (dz * scale - vz[i]) * steering;
+		x[i] += vx[i] * CROWD_STEP;
+		z[i] += vz[i] * CROWD_STEP;
+	}
+}
+
+void Crowd::ground(size_t begin, size_t end) {
+	for(size_t i = begin; i < end; i++) {
+		uint8_t& flags = agents.flags[i];
+		if(flags & Promoted) continue;
+
+		float height = terrain.getHeight({agents.x[i], agents.z[i]});
+		if(std::isnan(height)) {
+			// Placed agents don't walk off of the loaded terrain (unplaced agents wait for it to load)
+			if(flags & Placed) {
+				agents.x[i] = agents.targetX[i] = agents.previousX[i];
+				agents.z[i] = agents.targetZ[i] = agents.previousZ[i];
+				agents.vx[i] = agents.vz[i] = 0;
+			}
+			continue;
+		}
+
+		agents.y[i] = height + CROWD_HEIGHT_OFFSET;
+		if(!(flags & Placed)) {
+			agents.previousY[i] = agents.y[i];
+			flags |= Placed;
+		}
+
+		// Face the direction of travel (once moving fast enough for it to be meaningful)
+		if(agents.vx[i] * agents.vx[i] + agents.vz[i] * agents.vz[i] > .25f)
+			agents.heading[i] = std::atan2(agents.vz[i], agents.vx[i]);
+	}
+}
+
+void Crowd::findInCone(glm::vec3 apex, glm::vec3 axis, float minCosine, float range, std::vector<uint32_t>& out) const {
+	out.clear();
+	index.forEachInCone(apex, axis, minCosine, range, [&](uint32_t agent, glm::vec3) {
+		if(agents.flags[agent] & Placed) out.push_back(agent);
+	});
+}
+
+void Crowd::findWithin(glm::vec3 center, float radius, std::vector<uint32_t>& out) const {
+	out.clear();
+	index.forEachInRadius(center, radius, [&](uint32_t agent, glm::vec3) {
+		if(agents.flags[agent] & Placed) out.push_back(agent);
+	});
+}
+
+size_t Crowd::countChasing(float radius) const {
+	size_t count = 0;
+	index.forEachInRadius(chaseTarget, radius, [&](uint32_t agent, glm::vec3) {
+		if(agents.flags[agent] & Chasing) count++;
+	});
+	return count;
+}
+
+void Crowd::hold(const std::vector<uint32_t>& held) {
+	// Anything held last frame which isn't held this frame is dropped
+	std::vector<Body*> dropped;
+	for(auto& pool: bodies)
+		for(auto& body: pool)
+			if(body.agent >= 0 && body.held)
+				dropped.push_back(&body);
+
+	for(uint32_t agent: held) {
+		if(!(agents.flags[agent] & Promoted) && !promote(agent)) continue;
+
+		Body& body = bodies[agents.species[agent]][agents.body[agent]];
+		dropped.erase(std::remove(dropped.begin(), dropped.end(), &body), dropped.end());
+		if(body.held) continue;
+
+		// Float (and tumble) in the beam
+		uint32_t& state = agents.random[agent];
+		body.held = true;
+		body.object->getRigidBody().setGravity({0, 0, 0});
+		body.object->setAngularVelocity(glm::vec3(random(state), random(state), random(state)) * 2.0f - 1.0f);
+	}
+
+	for(Body* body: dropped) {
+		body->held = false;
+		body->fallTime = 0;
+		body->object->getRigidBody().setGravity({0, -9.81, 0});
+	}
+}
+
+std::vector<std::pair<uint32_t, Object::ptr>> Crowd::getHeld() const {
+	std::vector<std::pair<uint32_t, Object::ptr>> held;
+	for(auto& pool: bodies)
+		for(auto& body: pool)
+			if(body.agent >= 0 && body.held)
+				held.emplace_back(body.agent, body.object);
+	return held;
+}
+
+void Crowd::syncBodies(float dt) {
+	for(auto& pool: bodies)
+		for(auto& body: pool) {
+			if(body.agent < 0) continue;
+
+			size_t agent = body.agent;
+			glm::vec3 position = body.object->getPosition();
+			agents.x[agent] = agents.previousX[agent] = position.x;
+			agents.y[agent] = agents.previousY[agent] = position.y;
+			agents.z[agent] = agents.previousZ[agent] = position.z;
+			if(body.held) continue;
+
+			// Dropped bodies are given back once they land (or have fallen for too long)
+			body.fallTime += dt;
+			float height = world->getTerrainHeight({position.x, position.z}) + CROWD_HEIGHT_OFFSET;
+			bool landed = std::abs(position.y - height) < CROWD_HEIGHT_OFFSET && glm::length(body.object->getLinearVelocity()) < CROWD_LANDED_SPEED;
+			if(landed || body.fallTime > CROWD_MAX_FALL_TIME)
+				demote(agent);
+		}
+}
+
+bool Crowd::promote(size_t agent) {
+	auto& pool = bodies[agents.species[agent]];
+	auto free = std::find_if(pool.begin(), pool.end(), [](const Body& body) { return body.agent < 0; });
+	if(free == pool.end()) return false;
+
+	// Swap the agent for the body, carrying over where it is and how it is moving
+	free->agent = agent;
+	free->held = false;
+	free->fallTime = 0;
+	free->object->setModel(glm::rotate(glm::translate(glm::mat4(1), getPosition(agent)), -agents.heading[agent], glm::vec3(0, 1, 0)));
+	sceneRoot->addChild(free->object);
+	free->object->addToPhysicsWorld(*physics, CollisionGroups::CG_COW);
+	free->object->setLinearVelocity({agents.vx[agent], 0, agents.vz[agent]});
+
+	agents.body[agent] = free - pool.begin();
+	agents.flags[agent] |= Promoted;
+	return true;
+}
+
+void Crowd::demote(size_t agent) {
+	Body& body = bodies[agents.species[agent]][agents.body[agent]];
+	sceneRoot->removeChild(body.object);
+	body.object->removeFromPhysicsWorld(*physics);
+	body.agent = -1;
+	body.held = false;
+
+	// The agent picks up where the body left it (and is snapped back onto the terrain by the next step)
+	agents.body[agent] = -1;
+	agents.flags[agent] &= ~Promoted;
+	agents.vx[agent] = agents.vz[agent] = 0;
+	agents.targetX[agent] = agents.x[agent];
+	agents.targetZ[agent] = agents.z[agent];
+	agents.wait[agent] = 0;
+}
+
+void Crowd::updateIndex() {
+	// NOTE: Most agents stay in their cell, which only rewrites their stored position
+	for(size_t i = 0; i < size(); i++)
+		index.update(i, getPosition(i));
+}
+
+void Crowd::uploadInstances() {
+	for(auto& list: instances)
+		list.clear();
+
+	// Positions are interpolated between the last two steps so the agents move smoothly at any frame rate
+	float alpha = accumulator / CROWD_STEP;
+	for(size_t i = 0; i < size(); i++) {
+		if(!(agents.flags[i] & Placed) || (agents.flags[i] & Promoted)) continue;
+
+		glm::vec3 previous = {agents.previousX[i], agents.previousY[i], agents.previousZ[i]};
+		glm::vec3 position = glm::mix(previous, getPosition(i), alpha);
+		instances[agents.species[i]].push_back(glm::rotate(glm::translate(glm::mat4(1), position), -agents.heading[i], glm::vec3(0, 1, 0)));
+	}
+
+	for(size_t species = 0; species < SpeciesCount; species++)
+		if(models[species]) models[species]->setInstances(instances[species]);
+}
+
+float Crowd::random(uint32_t& state) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state >> 8) * (1.0f / (1 << 24));
+}
+
+Crowd::Model::~Model() {
+	if(instanceBuffer) glDeleteBuffers(1, &instanceBuffer);
+}
+
+void Crowd::Model::setInstances(const std::vector<glm::mat4>& instances) {
+	if(!instanceBuffer) glGenBuffers(1, &instanceBuffer);
+
+	// Respecifying the whole buffer lets the driver hand us fresh storage instead of waiting on draws still reading last frame's
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(glm::mat4), instances.data(), GL_STREAM_DRAW);
+	instanceCount = instances.size();
+}
+
+void Crowd::Model::render(Shader* boundShader) {
+	if(!instanceCount) return;
+
+	// Each instance's model matrix is spread across four attributes which advance once per instance
+	COUNTED_GL(glUniform1i(COUNTED_GL(boundShader->getUniformLocation("instanced")), true));
+	COUNTED_GL(glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer));
+	for(GLuint column = 0; column < 4; column++) {
+		COUNTED_GL(glEnableVertexAttribArray(4 + column));
+		COUNTED_GL(glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*) (column * sizeof(glm::vec4))));
+		COUNTED_GL(glVertexAttribDivisor(4 + column, 1));
+	}
+
+	Object::render(boundShader);
+
+	for(GLuint column = 0; column < 4; column++) {
+		COUNTED_GL(glVertexAttribDivisor(4 + column, 0));
+		COUNTED_GL(glDisableVertexAttribArray(4 + column));
+	}
+	COUNTED_GL(glUniform1i(COUNTED_GL(boundShader->getUniformLocation("instanced")), false));
+}
+
+void Crowd::Model::submit(RenderQueue& queue) {
+	if(!instanceCount || VAO == std::numeric_limits<GLuint>::max()) return;
+
+	updateStreamedTexture();
+	queue.submit(this, getModel(), VAO, tex, /*instanced*/ true);
+	for(auto& child: children)
+		child->submit(queue);
+}
+
+void Crowd::Model::draw() {
+	COUNTED_GL(glDrawElementsInstanced(GL_TRIANGLES, getIndexCount(), GL_UNSIGNED_INT, 0, instanceCount));
+}
+
+void Crowd::Model::configureVertexArray() {
+	Object::configureVertexArray();
+
+	// Each instance's model matrix is spread across four attributes which advance once per instance
+	if(!instanceBuffer) glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	for(GLuint column = 0; column < 4; column++) {
+		glEnableVertexAttribArray(4 + column);
+		glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*) (column * sizeof(glm::vec4)));
+		glVertexAttribDivisor(4 + column, 1);
+	}
+}
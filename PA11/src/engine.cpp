@@ -5,6 +5,9 @@
 #include "physics.h"
 #include "camera.h"
 #include "sound.h"
+#include "shader.h"
+#include "texture_streamer.h"
+#include "memory_tracker.h"
 
 Engine::Engine(std::string name, int width, int height) {
 	WINDOW_NAME = name;
@@ -30,6 +33,9 @@ Engine::~Engine() {
 }
 
 bool Engine::initialize(const Arguments& args) {
+	startTime = std::chrono::high_resolution_clock::now();
+	memoryDumpPath = args.getMemoryDumpPath();
+
 	// Start a window
 	window = new Window();
 	if(!window->initialize(WINDOW_NAME, &WINDOW_WIDTH, &WINDOW_HEIGHT)) {
@@ -112,6 +118,8 @@ void Engine::run() {
 
 		// Update the scene tree
 		sceneRoot->update(DT);
+		// Upload any textures which have finished decoding
+		TextureStreamer::pump();
 		// Update and render the graphics
 		graphics->update(DT);
 		graphics->render();
@@ -123,6 +131,21 @@ void Engine::run() {
 
 		// Swap the framebuffer
 		window->swap();
+
+		// Report how long it took to get the first frame on screen (and if the shaders came from the cache)
+		static bool firstFrame = true;
+		if(firstFrame) {
+			firstFrame = false;
+			auto milliseconds = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			std::cout << "First frame after " << milliseconds << "ms (" << Shader::getCacheHits() << " shader programs cached, " << Shader::getCacheMisses() << " compiled)" << std::endl;
+		}
+
+		// Periodically dump the memory statistics (if we were asked to)
+		if(auto now = std::chrono::high_resolution_clock::now(); !memoryDumpPath.empty() && now - lastMemoryDump > std::chrono::seconds(MEMORY_DUMP_INTERVAL)) {
+			lastMemoryDump = now;
+			if(!MemoryTracker::dump(memoryDumpPath))
+				std::cerr << "Failed to dump the memory statistics to `" << memoryDumpPath << "`" << std::endl;
+		}
 	}
 }
 
@@ -4,8 +4,40 @@
 #include "window.h"
 
 #include "skybox.h"
+#include <algorithm>
 #include <fstream>
 
+void FrameQuery::initialize(GLenum target, size_t bucketCount) {
+	this->target = target;
+	glGenQueries(GPU_QUERY_FRAMES, queries);
+	std::fill(buckets, buckets + GPU_QUERY_FRAMES, -1);
+	averages.assign(bucketCount, 0);
+}
+
+void FrameQuery::begin(size_t frame, int bucket) {
+	size_t slot = frame % GPU_QUERY_FRAMES;
+
+	// Fold the query this slot made a few frames ago into its bucket's average (if it still isn't done, it is dropped rather than waited on)
+	GLint available = GL_FALSE;
+	if(buckets[slot] >= 0)
+		glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if(available) {
+		GLuint64 result;
+		glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &result);
+		float& average = averages[buckets[slot]];
+		average = average == 0 ? result : average * .95f + result * .05f;
+	}
+
+	buckets[slot] = bucket;
+	if(bucket >= 0)
+		glBeginQuery(target, queries[slot]);
+}
+
+void FrameQuery::end(size_t frame) {
+	if(buckets[frame % GPU_QUERY_FRAMES] >= 0)
+		glEndQuery(target);
+}
+
 Graphics::Graphics(Object::ptr& sceneRoot) : sceneRoot(sceneRoot) { }
 
 Graphics::~Graphics() { }
@@ -31,10 +63,10 @@ bool Graphics::initialize(int width, int height, Engine* engine, const Arguments
 	}
 #endif
 
-	// For OpenGL 3
-	GLuint vao;
+	// For OpenGL 3 (meshes drawn through the render queue have their own vertex arrays, this one is used by everything else)
 	glGenVertexArrays(1, &vao);
 	glBindVertexArray(vao);
+	renderQueue.initialize(vao);
 
 	// Init Camera
 	camera = new Camera((Application*) engine);
@@ -65,11 +97,6 @@ bool Graphics::initialize(int width, int height, Engine* engine, const Arguments
 		printf("Per Vertex, Fragment Shader failed to initialize\n");
 		return false;
 	}
-	// Link the program
-	if(!perVertShader->finalize()) {
-		printf("Program failed to finalize\n");
-		return false;
-	}
 
 	// Set up the Per-Fragment shader
 	perFragShader = new Shader();
@@ -87,11 +114,6 @@ bool Graphics::initialize(int width, int height, Engine* engine, const Arguments
 		printf("Per Fragment, Fragment Shader failed to initialize\n");
 		return false;
 	}
-	// Link the program
-	if(!perFragShader->finalize()) {
-		printf("Program failed to finalize\n");
-		return false;
-	}
 
 
 	// Set up the Depth shader
@@ -110,12 +132,6 @@ bool Graphics::initialize(int width, int height, Engine* engine, const Arguments
 		printf("Depth Fragment Shader failed to initialize\n");
 		return false;
 	}
-	// Link the program
-	if(!depthShader->finalize()) {
-		printf("Program failed to finalize\n");
-		return false;
-	}
-	lightSpaceMatrixLocation = depthShader->getUniformLocation("lightSpaceMatrix");
 
 	// Set up the Depth shader
 	debug = new Shader();
@@ -133,11 +149,28 @@ bool Graphics::initialize(int width, int height, Engine* engine, const Arguments
 		printf("Debug Fragment Shader failed to initialize\n");
 		return false;
 	}
-	// Link the program
-	if(!debug->finalize()) {
-		printf("Program failed to finalize\n");
+
+	// Start linking every program before waiting on any of them, so the driver can compile them in parallel (and cached programs skip compiling entirely)
+	for(Shader* shader: {perVertShader, perFragShader, depthShader, debug})
+		if(!shader->link()) {
+			printf("Program failed to link\n");
+			return false;
+		}
+	// Wait for each program to finish linking
+	for(Shader* shader: {perVertShader, perFragShader, depthShader, debug})
+		if(!shader->finalize()) {
+			printf("Program failed to finalize\n");
+			return false;
+		}
+	lightSpaceMatrixLocation = depthShader->getUniformLocation("lightSpaceMatrix");
+	depthViewMatrixLocation = depthShader->getUniformLocation("viewMatrix");
+
+	// Create the buffers the lights are binned into
+	if(!lightClusters.initialize()) {
+		printf("Light Clusters Failed to initialize\n");
 		return false;
 	}
+
 	// Vertex buffer for debug
 	glGenBuffers(1, &debugVBO);
 
@@ -180,6 +213,45 @@ bool Graphics::initialize(int width, int height, Engine* engine, const Arguments
 	glReadBuffer(GL_NONE);
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+	// The shadow map is sampled with hardware depth comparison (bilinearly filtered, so each tap is a 2x2 PCF)...
+	glGenSamplers(1, &shadowCompareSampler);
+	glSamplerParameteri(shadowCompareSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glSamplerParameteri(shadowCompareSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glSamplerParameteri(shadowCompareSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glSamplerParameteri(shadowCompareSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glSamplerParameterfv(shadowCompareSampler, GL_TEXTURE_BORDER_COLOR, borderColor);
+	glSamplerParameteri(shadowCompareSampler, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glSamplerParameteri(shadowCompareSampler, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	// ... and as raw depth for the PCSS blocker search
+	glGenSamplers(1, &shadowDepthSampler);
+	glSamplerParameteri(shadowDepthSampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glSamplerParameteri(shadowDepthSampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glSamplerParameteri(shadowDepthSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glSamplerParameteri(shadowDepthSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	glSamplerParameterfv(shadowDepthSampler, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+	// Pick the shadow quality
+	if(auto config = args.getConfig(); config.contains("Shadow Quality")) {
+		std::string name = config["Shadow Quality"].get<std::string>();
+		bool found = false;
+		for(int quality = 0; quality < (int) ShadowQuality::Count; quality++)
+			if(name == shadowQualityName((ShadowQuality) quality)) {
+				shadowQuality = (ShadowQuality) quality;
+				found = true;
+			}
+		if(!found) std::cerr << "Unknown shadow quality `" << name << "`, using " << shadowQualityName(shadowQuality) << std::endl;
+	}
+
+	if(auto config = args.getConfig(); config.contains("Depth Pre-pass"))
+		depthPrePass = config["Depth Pre-pass"].get<bool>();
+	if(auto config = args.getConfig(); config.contains("Render Queue"))
+		useRenderQueue = config["Render Queue"].get<bool>();
+
+	// Queries measuring the lit pass (per shadow quality, with and without the pre-pass) and the pre-pass
+	litPassTimer.initialize(GL_TIME_ELAPSED, (int) ShadowQuality::Count * 2);
+	prePassTimer.initialize(GL_TIME_ELAPSED, 1);
+	shadedFragments.initialize(GL_SAMPLES_PASSED, 2);
+
 	return true;
 }
 
@@ -191,6 +263,15 @@ void Graphics::update(float dt) {
 }
 
 void Graphics::render() {
+	// Gather the frame's draws for every pass being drawn (when drawing through the render queue)
+	RenderQueue::glCalls = 0;
+	bool queued = useRenderQueue;
+	if(queued) {
+		renderQueue.begin(camera->getPosition(), {DirectionalLight::getPrimary() ? depthShader : nullptr, depthPrePass ? depthShader : nullptr, useFragShader ? perFragShader : perVertShader});
+		engine->submit(renderQueue);
+		sceneRoot->submit(renderQueue);
+		renderQueue.sort();
+	}
 
 	glm::mat4 lightSpaceMatrix(-1);
 
@@ -211,8 +292,9 @@ void Graphics::render() {
 
 			depthShader->enable();
 			glUniformMatrix4fv(lightSpaceMatrixLocation, 1, GL_FALSE, glm::value_ptr(lightSpaceMatrix));
+			glUniformMatrix4fv(depthViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(glm::mat4(1)));
 
-			renderScene(depthShader);
+			renderScene(depthShader, RenderPass::Shadow, false);
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		glCullFace(GL_BACK);
 
@@ -241,6 +323,22 @@ void Graphics::render() {
 	// render the skybox first (thus everything else is drawn in front of it)
 	// skybox->render();
 
+	// Lay down the scene's depth (with the same view and projection as the lit pass, so the depths match exactly)
+	if(depthPrePass) {
+		prePassTimer.begin(frame, 0);
+		depthShader->enable();
+		glUniformMatrix4fv(lightSpaceMatrixLocation, 1, GL_FALSE, glm::value_ptr(camera->getProjection()));
+		glUniformMatrix4fv(depthViewMatrixLocation, 1, GL_FALSE, glm::value_ptr(camera->getView()));
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		renderScene(depthShader, RenderPass::DepthPrePass, false);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		prePassTimer.end(frame);
+
+		// Then only shade the fragments which ended up visible
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
+
 	// Start the correct program
 	Shader* boundShader;
 	if(useFragShader) {
@@ -251,9 +349,17 @@ void Graphics::render() {
 		boundShader = perVertShader;
 	}
 
-	// Bind the depth map as texture 1
-	glActiveTexture(GL_TEXTURE1);
+	// Bind the depth map for comparison and raw depth lookups
+	glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+	glBindTexture(GL_TEXTURE_2D, depthMap);
+	glBindSampler(SHADOW_MAP_UNIT, shadowCompareSampler);
+	glActiveTexture(GL_TEXTURE0 + SHADOW_DEPTH_UNIT);
 	glBindTexture(GL_TEXTURE_2D, depthMap);
+	glBindSampler(SHADOW_DEPTH_UNIT, shadowDepthSampler);
+	glActiveTexture(GL_TEXTURE0);
+	// Only the per fragment shader samples shadows
+	if(useFragShader)
+		glUniform1i(boundShader->getUniformLocation("shadowQuality"), (int) shadowQuality);
 
 	// Send in the projection and view to the shader
 	glUniformMatrix4fv(boundShader->getUniformLocation("projectionMatrix"), 1, GL_FALSE, glm::value_ptr(camera->getProjection()));
@@ -271,21 +377,45 @@ void Graphics::render() {
 	glUniform4fv(boundShader->getUniformLocation("material.specular"), 1, glm::value_ptr(materialSpecular));
 	glUniform1f(boundShader->getUniformLocation("material.shininess"), materialShininess);
 
-	// Bind the number of lights
-	glUniform1ui(boundShader->getUniformLocation("num_lights"), Light::count);
+	// Bin the lights for this frame's view and bind them
+	lightClusters.update(camera->getView(), camera->getProjection());
+	lightClusters.bind(boundShader);
+
+	// The per vertex shader doesn't sample shadows, so it isn't timed
+	litPassTimer.begin(frame, useFragShader ? (int) shadowQuality * 2 + depthPrePass : -1);
+	shadedFragments.begin(frame, depthPrePass);
+	renderScene(boundShader, RenderPass::Lit);
+	shadedFragments.end(frame);
+	litPassTimer.end(frame);
+	frame++;
+
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+
+	// Average how many gl calls drawing the scene's objects took (the render queue may have been toggled by the GUI partway through the frame)
+	float& glCalls = sceneGLCalls[queued];
+	glCalls = glCalls == 0 ? RenderQueue::glCalls : glCalls * .95f + RenderQueue::glCalls * .05f;
+}
 
-	renderScene(boundShader);
+const char* Graphics::shadowQualityName(ShadowQuality quality) {
+	switch(quality) {
+	case ShadowQuality::Hard: return "Hard";
+	case ShadowQuality::Poisson: return "Poisson";
+	case ShadowQuality::PCSS: return "PCSS";
+	default: return "Unknown";
+	}
 }
 
-void Graphics::renderScene(Shader* boundShader) {
+void Graphics::renderScene(Shader* boundShader, RenderPass pass, bool drawGUI) {
 	// Preform custom rendering
 	engine->render(boundShader);
 
-	// render the object
-	sceneRoot->render(boundShader);
+	// render the objects (sorted by state if they have been submitted to the render queue)
+	if(useRenderQueue) renderQueue.execute(pass);
+	else sceneRoot->render(boundShader);
 
 	// render the GUI
-	gui->render();
+	if(drawGUI) gui->render();
 
 	// Get any errors from OpenGL
 	auto error = glGetError();
@@ -7,6 +7,8 @@
 #include "application.h"
 #include "window.h"
 #include "graphics.h"
+#include "sound.h"
+#include "memory_tracker.h"
 
 #include <sstream>
 
@@ -71,18 +73,23 @@ void GUI::render() {
 		if(ImGui::BeginMenu("Leaderboard")) {
 
 			ImGui::TextColored(ImVec4(.9,.9,1,1), "Leaderboard");
-			if (ImGui::BeginTable("", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+			if (ImGui::BeginTable("", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
 				ImGui::TableNextRow();
 					ImGui::TableSetColumnIndex(0);
-					ImGui::TableHeader("Player");
+					ImGui::TableHeader("Rank");
 					ImGui::TableSetColumnIndex(1);
+					ImGui::TableHeader("Player");
+					ImGui::TableSetColumnIndex(2);
 					ImGui::TableHeader("Score");
-				for (std::pair<std::string, float> stat: app->leaderboard.leaderstats) {
+				size_t rank = 1;
+				for (const Leaderboard::Entry& entry: app->leaderboard.getTop(LEADERBOARD_DISPLAY_COUNT)) {
 					ImGui::TableNextRow();
 						ImGui::TableSetColumnIndex(0);
-						ImGui::Text(stat.first.c_str());
+						ImGui::Text("%zu", rank++);
 						ImGui::TableSetColumnIndex(1);
-						ImGui::Text(std::to_string(stat.second).c_str());
+						ImGui::TextUnformatted(entry.name.c_str());
+						ImGui::TableSetColumnIndex(2);
+						ImGui::Text("%.0f", entry.score);
 				}
 
 				ImGui::EndTable();
@@ -91,6 +98,110 @@ void GUI::render() {
 		}
 
 
+		// World settings
+		if(ImGui::BeginMenu("World")) {
+			auto world = app->getWorld();
+
+			// Changing the radius only loads (or frees) the chunks entering (or leaving) it
+			int radius = world->getRadius();
+			if(ImGui::SliderInt("View Radius", &radius, MIN_WORLD_RADIUS, MAX_WORLD_RADIUS))
+				world->setRadius(radius);
+
+			// Prefetching loads (and prioritizes) the chunks ahead of the UFO
+			bool prefetching = world->getPrefetching();
+			if(ImGui::Checkbox("Prefetch Ahead", &prefetching))
+				world->setPrefetching(prefetching);
+
+			std::stringstream loaded;
+			loaded << "Loaded Chunks: " << world->getLoadedChunkCount() << " (" << std::fixed << std::setprecision(1)
+				<< world->getLoadedChunkCount() * sizeof(Chunk::voxels) / (1024.0 * 1024.0) << "MB of voxels)";
+			ImGui::Text(loaded.str().c_str());
+			ImGui::Text(("Pop-ins: " + std::to_string(world->getPopInCount())).c_str());
+
+			std::stringstream allocations;
+			allocations << "Heap Allocations per Chunk: " << std::fixed << std::setprecision(1) << world->getAverageMeshAllocations() << " meshing, "
+				<< world->getAverageColliderAllocations() << " collider";
+			ImGui::Text(allocations.str().c_str());
+
+			std::stringstream crowd;
+			crowd << "Crowd: " << app->getCrowd()->size() << " agents (" << std::fixed << std::setprecision(2) << app->getCrowd()->getAverageUpdateTime() << "ms per update)";
+			ImGui::Text(crowd.str().c_str());
+			ImGui::EndMenu();
+		}
+
+		// Lighting settings
+		if(ImGui::BeginMenu("Lighting")) {
+			auto& clusters = graphics->getLightClusters();
+
+			// Without clustering every fragment loops over every light
+			ImGui::Checkbox("Clustered Lighting", &clusters.enabled);
+
+			std::stringstream lights;
+			lights << "Lights: " << clusters.getLightCount() << " (" << std::fixed << std::setprecision(1) << clusters.getAverageLightsPerCluster() << " per occupied cluster)";
+			ImGui::Text(lights.str().c_str());
+
+			// Shadow filtering, along with how long the lit pass has taken on the gpu with each
+			ImGui::Separator();
+			int quality = (int) graphics->shadowQuality;
+			const char* qualities[] = {Graphics::shadowQualityName(ShadowQuality::Hard), Graphics::shadowQualityName(ShadowQuality::Poisson), Graphics::shadowQualityName(ShadowQuality::PCSS)};
+			if(ImGui::Combo("Shadow Quality", &quality, qualities, (int) ShadowQuality::Count))
+				graphics->shadowQuality = (ShadowQuality) quality;
+
+			// The depth pre-pass means only the visible fragments are shaded
+			ImGui::Checkbox("Depth Pre-pass", &graphics->depthPrePass);
+			// The render queue sorts the frame's draws by state, so only the state which changes between draws is set
+			ImGui::Checkbox("Render Queue", &graphics->useRenderQueue);
+
+			auto measurement = [](float value, int precision, const char* unit) {
+				std::stringstream out;
+				if(value) out << std::fixed << std::setprecision(precision) << value << unit;
+				else out << "not measured";
+				return out.str();
+			};
+			for(int i = 0; i < (int) ShadowQuality::Count; i++)
+				ImGui::Text(("Lit Pass (" + std::string(qualities[i]) + "): " + measurement(graphics->getLitPassTime((ShadowQuality) i, true), 2, "ms") + " with pre-pass, "
+					+ measurement(graphics->getLitPassTime((ShadowQuality) i, false), 2, "ms") + " without").c_str());
+			ImGui::Text(("Pre-pass: " + measurement(graphics->getPrePassTime(), 2, "ms")).c_str());
+			ImGui::Text(("Shaded Fragments: " + measurement(graphics->getShadedFragments(true) / 1e6, 2, "M") + " with pre-pass, "
+				+ measurement(graphics->getShadedFragments(false) / 1e6, 2, "M") + " without").c_str());
+			ImGui::Text(("Scene GL Calls per Frame: " + measurement(graphics->getSceneGLCalls(true), 0, "") + " with render queue, "
+				+ measurement(graphics->getSceneGLCalls(false), 0, "") + " without").c_str());
+			auto& queue = graphics->getRenderQueue();
+			ImGui::Text(("Draw Packets: " + std::to_string(queue.getPacketCount()) + " (" + std::to_string(queue.getStateChanges()) + " state changes)").c_str());
+			ImGui::EndMenu();
+		}
+
+		// Audio mixer measurements
+		if(ImGui::BeginMenu("Audio")) {
+			auto stats = app->getSound()->getStats();
+			std::stringstream audio;
+			audio << std::fixed << std::setprecision(1) << "Trigger Latency: " << stats.averageLatency << "ms (" << stats.maxLatency << "ms max)\n"
+				<< "Mixer Load: " << stats.load * 100 << "%\n"
+				<< "Voices: " << stats.activeVoices << "/" << SOUND_VOICES << " (" << stats.droppedCommands << " commands dropped)";
+			ImGui::Text(audio.str().c_str());
+			ImGui::EndMenu();
+		}
+
+		// Where the memory is going
+		if(ImGui::BeginMenu("Memory")) {
+			auto line = [](const char* name, MemoryTracker::Stats stats) {
+				std::stringstream out;
+				out << name << ": " << std::fixed << std::setprecision(1) << stats.bytes / (1024.0 * 1024.0) << "MB in " << stats.allocations
+					<< " allocations (" << stats.highWater / (1024.0 * 1024.0) << "MB high water)";
+				ImGui::Text(out.str().c_str());
+			};
+
+			ImGui::Text("CPU");
+			for(int tag = 0; tag < MemoryTracker::TagCount; tag++)
+				line(MemoryTracker::getName((MemoryTracker::Tag) tag), MemoryTracker::getStats((MemoryTracker::Tag) tag));
+			ImGui::Separator();
+			ImGui::Text("GPU");
+			for(int tag = 0; tag < MemoryTracker::GpuTagCount; tag++)
+				line(MemoryTracker::getGpuName((MemoryTracker::GpuTag) tag), MemoryTracker::getGpuStats((MemoryTracker::GpuTag) tag));
+			ImGui::EndMenu();
+		}
+
+
 		// Render help menu
 		if(ImGui::BeginMenu("Help")) {
 			ImGui::NewLine();
@@ -253,7 +364,10 @@ void GUI::render() {
 		app->drawGUI();
 
 		std::stringstream fps;
-		fps << "FPS: " << std::setprecision(4) << app->getAverageFPS();
+		auto storeStats = app->getWorld()->getChunkStoreStats();
+		fps << "Chunk Store: " << std::fixed << std::setprecision(0) << storeStats.hitRate() * 100 << "% hits, " << std::setprecision(1) << storeStats.timeSavedPerChunk() << "ms saved/chunk    ";
+		fps << "Chunk Latency: " << std::fixed << std::setprecision(1) << app->getWorld()->getAverageChunkLatency() << "ms    ";
+		fps << "FPS: " << std::defaultfloat << std::setprecision(4) << app->getAverageFPS();
 		// Right justify the fps text
 		ImGui::SetCursorPosX(ImGui::GetWindowWidth() - ImGui::CalcTextSize(fps.str().c_str()).x - 10);
 		ImGui::Text(fps.str().c_str());
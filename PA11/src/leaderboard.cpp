@@ -1,84 +1,372 @@
 #include "leaderboard.h"
 #include "arguments.h"
 
-#include <vector>
-
-#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
 
 bool Leaderboard::initialize(const Arguments& args, const std::string &filename) {
-    //std::cout << "Loading leaderleaderstats from " << filename << std::endl;
     //std::string leaderboardDirectory = args.getResourcePath() + "models/";
-    filepath = filename;
-    std::vector<std::string> tokens;
-
-    // Load data from file
-    std::ifstream file(filename.c_str());
-    if (file) {
-        std::string line;
-        if (file.is_open()) {
-            while(getline(file, line)) {
-                std::istringstream ssLine(line);
-                std::string token;
-                while(getline(ssLine, token, ',')) {
-                    tokens.push_back(token);
-                }
-            }
-            file.close();
-        }
-    }
-
-    for(int i = 0; i < tokens.size(); i+=2) {
-        std::cout << tokens[i] << ", " << tokens[i+1] << std::endl;
-        updateScore(tokens[i], stof(tokens[i+1]));
-    }
+    open(filename);
+    std::cout << "Loaded " << size() << " players from " << filename << std::endl;
     return true;
 }
 
 bool Leaderboard::addPlayer(const std::string& userId) {
-    // Check if player already exists
-    if (leaderstats.find(userId) != leaderstats.end())
+    // Check if the name is valid and the player doesn't already exist
+    if (!validName(userId) || find(userId) != NIL)
         return false;
 
-    // Add player to dictionary
-    leaderstats.insert(std::pair<std::string, float>(userId, 0));
+    // Add player to the board
+    set(userId, 0);
+    log(userId, 0);
     return true;
 }
 
 void Leaderboard::updateScore(const std::string& userId, float score) {
     // Update the players score if its a valid name
-    if (userId != "") {
-        if (leaderstats.find(userId) == leaderstats.end())
-            leaderstats.insert(std::pair<std::string, float>(userId, score));
-        else
-            leaderstats[userId] = score;
-    }
-    sort();
+    if (!validName(userId))
+        return;
+
+    set(userId, score);
+    log(userId, score);
 }
 
 void Leaderboard::save() {
-    std::ofstream file(filepath);
-    for (auto const& element : leaderstats) {
-        file << element.first << "," << std::to_string(element.second) << std::endl;
+    if (logRecords > size())
+        compact();
+    else logFile.flush();
+}
+
+bool Leaderboard::getScore(const std::string& userId, float& score) const {
+    uint32_t node = find(userId);
+    if (node == NIL)
+        return false;
+
+    score = nodes[node].score;
+    return true;
+}
+
+size_t Leaderboard::getRank(const std::string& userId) const {
+    uint32_t node = find(userId);
+    if (node == NIL)
+        return -1;
+
+    // Walk down to the player, counting everyone ranked before them along the way
+    size_t rank = 0;
+    for (uint32_t current = root; current != node; )
+        if (before(node, current))
+            current = nodes[current].left;
+        else {
+            rank += sizeOf(nodes[current].left) + 1;
+            current = nodes[current].right;
+        }
+    return rank + sizeOf(nodes[node].left);
+}
+
+Leaderboard::Entry Leaderboard::getEntry(size_t rank) const {
+    uint32_t current = root;
+    while (current != NIL) {
+        size_t leftSize = sizeOf(nodes[current].left);
+        if (rank < leftSize)
+            current = nodes[current].left;
+        else if (rank == leftSize)
+            return {nodes[current].name, nodes[current].score};
+        else {
+            rank -= leftSize + 1;
+            current = nodes[current].right;
+        }
     }
-    //file << "write this to file";
-    file.close();
+    return {"", 0};
 }
 
-bool compare(std::pair<std::string, float>& a, std::pair<std::string, float>& b) {
-    return a.second < b.second;
+std::vector<Leaderboard::Entry> Leaderboard::getTop(size_t k) const {
+    std::vector<Entry> top;
+    top.reserve(std::min(k, size()));
+    forEachInOrder(k, [&](const Node& node) { top.push_back({node.name, node.score}); });
+    return top;
+}
+
+void Leaderboard::open(const std::string& path) {
+    filepath = path;
+    load(path);
+    logFile.open(path, std::ios::app);
+
+    // If the board was last closed without saving, the log might already be due for compaction
+    if (logRecords >= LEADERBOARD_COMPACT_RATIO * size() + LEADERBOARD_COMPACT_SLACK)
+        compact();
 }
 
-void Leaderboard::sort() {
-    // Sort the leaderboard
-    std::vector<std::pair<std::string, float>> items;
-    for (auto& it : leaderstats) {
-        items.push_back(it);
+void Leaderboard::load(const std::string& path) {
+    nodes.clear();
+    index.clear();
+    root = NIL;
+    logRecords = 0;
+
+    // Read the whole log at once
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file)
+        return;
+    std::string data((size_t) file.tellg(), '\0');
+    file.seekg(0);
+    file.read(data.data(), data.size());
+
+    // Replay every name,score record (later records replace earlier ones), the ranking is built once they have all been read
+    reserve(std::count(data.begin(), data.end(), '\n') + 1);
+    for (size_t start = 0; start < data.size(); ) {
+        size_t end = data.find('\n', start);
+        if (end == std::string::npos) end = data.size();
+
+        size_t comma = data.rfind(',', end);
+        if (comma != std::string::npos && comma > start) {
+            std::string_view name(data.data() + start, comma - start);
+            float score = std::strtof(data.c_str() + comma + 1, nullptr);
+
+            uint32_t node = find(name);
+            if (node == NIL)
+                add(name, score);
+            else nodes[node].score = score;
+            logRecords++;
+        }
+        start = end + 1;
     }
 
-    std::sort(items.begin(), items.end(), compare);
+    build();
+}
 
-    leaderstats.clear();
-    for (auto& it : items) {
-        leaderstats.insert(it);
+void Leaderboard::set(const std::string& userId, float score) {
+    uint32_t node = find(userId);
+    if (node == NIL) {
+        node = add(userId, score);
+    } else {
+        // Take the player out of the ranking while their score changes
+        root = erase(root, node);
+        nodes[node].score = score;
+        nodes[node].left = nodes[node].right = NIL;
+        nodes[node].size = 1;
     }
+    root = insert(root, node);
+}
+
+uint32_t Leaderboard::find(std::string_view userId) const {
+    if (index.empty())
+        return NIL;
+
+    size_t mask = index.size() - 1;
+    for (size_t slot = hashOf(userId) & mask; index[slot] != NIL; slot = (slot + 1) & mask)
+        if (nodes[index[slot]].name == userId)
+            return index[slot];
+    return NIL;
+}
+
+uint32_t Leaderboard::add(std::string_view userId, float score) {
+    // Keep the index at most half full
+    if ((nodes.size() + 1) * 2 > index.size())
+        reserve(nodes.size() + 1);
+
+    uint32_t node = nodes.size();
+    nodes.push_back({std::string(userId), score, (uint32_t) random(), hashOf(userId)});
+
+    size_t mask = index.size() - 1, slot = nodes[node].hash & mask;
+    while (index[slot] != NIL)
+        slot = (slot + 1) & mask;
+    index[slot] = node;
+    return node;
+}
+
+void Leaderboard::reserve(size_t players) {
+    nodes.reserve(players);
+
+    size_t capacity = 16;
+    while (capacity < players * 2)
+        capacity *= 2;
+    if (capacity <= index.size())
+        return;
+
+    index.assign(capacity, NIL);
+    size_t mask = capacity - 1;
+    for (uint32_t node = 0; node < nodes.size(); node++) {
+        size_t slot = nodes[node].hash & mask;
+        while (index[slot] != NIL)
+            slot = (slot + 1) & mask;
+        index[slot] = node;
+    }
+}
+
+void Leaderboard::log(const std::string& userId, float score) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", score);
+    logFile << userId << "," << buffer << "\n";
+    logFile.flush();
+
+    if (++logRecords >= LEADERBOARD_COMPACT_RATIO * size() + LEADERBOARD_COMPACT_SLACK)
+        compact();
+}
+
+void Leaderboard::compact() {
+    // Write the board (best first) next to the log, then swap it in so a crash part way through never loses the log
+    std::string temporary = filepath + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        char buffer[32];
+        forEachInOrder(size(), [&](const Node& node) {
+            std::snprintf(buffer, sizeof(buffer), "%.9g", node.score);
+            file << node.name << "," << buffer << "\n";
+        });
+        if (!file)
+            return;
+    }
+
+    logFile.close();
+    std::rename(temporary.c_str(), filepath.c_str());
+    logFile.open(filepath, std::ios::app);
+    logRecords = size();
+}
+
+void Leaderboard::split(uint32_t subtree, uint32_t key, uint32_t& left, uint32_t& right) {
+    if (subtree == NIL) {
+        left = right = NIL;
+        return;
+    }
+
+    if (before(subtree, key)) {
+        split(nodes[subtree].right, key, nodes[subtree].right, right);
+        left = subtree;
+    } else {
+        split(nodes[subtree].left, key, left, nodes[subtree].left);
+        right = subtree;
+    }
+    update(subtree);
+}
+
+uint32_t Leaderboard::merge(uint32_t left, uint32_t right) {
+    if (left == NIL) return right;
+    if (right == NIL) return left;
+
+    // The higher priority node becomes the root
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        update(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    update(right);
+    return right;
+}
+
+uint32_t Leaderboard::insert(uint32_t subtree, uint32_t node) {
+    if (subtree == NIL)
+        return node;
+
+    // The node goes where its priority places it, taking the nodes around it as its children
+    if (nodes[node].priority > nodes[subtree].priority) {
+        split(subtree, node, nodes[node].left, nodes[node].right);
+        update(node);
+        return node;
+    }
+
+    if (before(node, subtree))
+        nodes[subtree].left = insert(nodes[subtree].left, node);
+    else nodes[subtree].right = insert(nodes[subtree].right, node);
+    update(subtree);
+    return subtree;
+}
+
+uint32_t Leaderboard::erase(uint32_t subtree, uint32_t node) {
+    if (subtree == node)
+        return merge(nodes[node].left, nodes[node].right);
+
+    if (before(node, subtree))
+        nodes[subtree].left = erase(nodes[subtree].left, node);
+    else nodes[subtree].right = erase(nodes[subtree].right, node);
+    update(subtree);
+    return subtree;
+}
+
+void Leaderboard::build() {
+    // Sort copies of the scores (so sorting never has to touch the nodes)
+    std::vector<std::pair<float, uint32_t>> order(nodes.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = {nodes[i].score, i};
+        nodes[i].left = nodes[i].right = NIL;
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); });
+
+    // Add the nodes in rank order along the right edge of the tree, lower priority nodes along it become the left child of the new node
+    std::vector<uint32_t> edge;
+    for (auto [score, node] : order) {
+        uint32_t last = NIL;
+        while (!edge.empty() && nodes[edge.back()].priority < nodes[node].priority) {
+            last = edge.back();
+            edge.pop_back();
+        }
+        nodes[node].left = last;
+        if (!edge.empty())
+            nodes[edge.back()].right = node;
+        edge.push_back(node);
+    }
+
+    root = edge.empty() ? NIL : edge.front();
+    updateSizes(root);
+}
+
+uint32_t Leaderboard::updateSizes(uint32_t subtree) {
+    if (subtree == NIL)
+        return 0;
+
+    nodes[subtree].size = 1 + updateSizes(nodes[subtree].left) + updateSizes(nodes[subtree].right);
+    return nodes[subtree].size;
+}
+
+void Leaderboard::benchmark(size_t players, size_t operations) {
+    using clock = std::chrono::steady_clock;
+    auto milliseconds = [](clock::duration elapsed) { return std::chrono::duration<double, std::milli>(elapsed).count(); };
+    std::string path = (std::filesystem::temp_directory_path() / "leaderboard-benchmark.csv").string();
+    std::mt19937 generator(players);
+    std::uniform_real_distribution<float> scores(0, 100000);
+
+    // Write a log with every player in it
+    {
+        std::ofstream file(path, std::ios::trunc);
+        for (size_t i = 0; i < players; i++)
+            file << "player" << i << "," << (int) scores(generator) << "\n";
+    }
+
+    Leaderboard board;
+    auto start = clock::now();
+    board.open(path);
+    double loadTime = milliseconds(clock::now() - start);
+
+    start = clock::now();
+    for (size_t i = 0; i < operations; i++)
+        board.updateScore("player" + std::to_string(generator() % players), (int) scores(generator));
+    double updateTime = milliseconds(clock::now() - start);
+
+    size_t checksum = 0;
+    start = clock::now();
+    for (size_t i = 0; i < operations; i++)
+        checksum += board.getRank("player" + std::to_string(generator() % players));
+    double rankTime = milliseconds(clock::now() - start);
+
+    start = clock::now();
+    for (size_t i = 0; i < operations; i++)
+        checksum += board.getTop(LEADERBOARD_DISPLAY_COUNT).size();
+    double topTime = milliseconds(clock::now() - start);
+
+    start = clock::now();
+    board.compact();
+    double compactTime = milliseconds(clock::now() - start);
+
+    std::cout << "Leaderboard benchmark (" << players << " players, " << operations << " operations, checksum " << checksum << "):" << std::endl
+        << "\tLoad: " << loadTime << "ms" << std::endl
+        << "\tUpdate (logged): " << updateTime * 1000 / operations << "us each" << std::endl
+        << "\tRank: " << rankTime * 1000 / operations << "us each" << std::endl
+        << "\tTop " << LEADERBOARD_DISPLAY_COUNT << ": " << topTime * 1000 / operations << "us each" << std::endl
+        << "\tCompact: " << compactTime << "ms" << std::endl;
+
+    board.logFile.close();
+    std::remove(path.c_str());
 }
@@ -0,0 +1,188 @@
+#include "light_clusters.h"
+#include "light.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+LightClusters::~LightClusters() {
+	GLuint buffers[] = {lightBuffer, clusterBuffer, indexBuffer};
+	glDeleteBuffers(3, buffers);
+}
+
+bool LightClusters::initialize() {
+	glGenBuffers(1, &lightBuffer);
+	glGenBuffers(1, &clusterBuffer);
+	glGenBuffers(1, &indexBuffer);
+
+	clusterLights.resize(CLUSTER_COUNT_X * CLUSTER_COUNT_Y * CLUSTER_COUNT_Z);
+	clusters.resize(clusterLights.size());
+	return lightBuffer && clusterBuffer && indexBuffer;
+}
+
+void LightClusters::update(const glm::mat4& view, const glm::mat4& projection) {
+	tanHalfFov = {1 / projection[0][0], 1 / projection[1][1]};
+
+	// Gather the lights (directional lights first, since they are shaded everywhere)
+	lights.clear();
+	local.clear();
+	ambient = glm::vec3(0);
+	size_t dropped = 0;
+	for(Light* light: Light::getLights()) {
+		if(light->getType() == Light::Type::Disabled) continue;
+		// Every light's ambient term applies everywhere, so they are just summed
+		ambient += glm::vec3(light->lightAmbient);
+
+		GPULight packed;
+		if(!pack(*light, packed)) continue;
+		if(lights.size() + local.size() >= MAX_LIGHTS) { dropped++; continue; }
+		(light->getType() == Light::Type::Directional ? lights : local).push_back(packed);
+	}
+	directionalCount = lights.size();
+	lights.insert(lights.end(), local.begin(), local.end());
+
+	// Warn (once) if there are more lights than the buffer holds
+	static bool warned = false;
+	if(dropped && !warned) {
+		std::cerr << "Warning! " << dropped << " lights were dropped (only " << MAX_LIGHTS << " are supported)" << std::endl;
+		warned = true;
+	}
+
+	// Bin the local lights (unless every fragment is going to loop over every light anyway)
+	for(auto& cluster: clusterLights) cluster.clear();
+	if(enabled)
+		for(uint32_t i = directionalCount; i < lights.size(); i++) {
+			glm::vec4 sphere = boundingSphere(lights[i]);
+			insert(i, glm::vec3(view * glm::vec4(glm::vec3(sphere), 1)), sphere.w, tanHalfFov.x, tanHalfFov.y);
+		}
+
+	// Flatten the clusters into a single index list
+	indices.clear();
+	for(size_t i = 0; i < clusterLights.size(); i++) {
+		clusters[i].offset = indices.size();
+		clusters[i].count = std::min<size_t>(clusterLights[i].size(), MAX_LIGHTS_PER_CLUSTER);
+		indices.insert(indices.end(), clusterLights[i].begin(), clusterLights[i].begin() + clusters[i].count);
+	}
+
+	// Upload everything (orphaning last frame's buffers, the buffers are never empty so they can always be bound)
+	auto upload = [](GLuint buffer, const void* data, size_t size, size_t minimum) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(size, minimum), nullptr, GL_STREAM_DRAW);
+		if(size) glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+	};
+	upload(lightBuffer, lights.data(), lights.size() * sizeof(GPULight), sizeof(GPULight));
+	upload(clusterBuffer, clusters.data(), clusters.size() * sizeof(Cluster), sizeof(Cluster));
+	upload(indexBuffer, indices.data(), indices.size() * sizeof(uint32_t), sizeof(uint32_t));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void LightClusters::bind(Shader* boundShader) {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BUFFER_BINDING, lightBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_BUFFER_BINDING, clusterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BUFFER_BINDING, indexBuffer);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glUniform3fv(boundShader->getUniformLocation("ambientLight"), 1, glm::value_ptr(ambient));
+	glUniform1ui(boundShader->getUniformLocation("num_directional_lights"), directionalCount);
+	glUniform1ui(boundShader->getUniformLocation("num_lights"), lights.size());
+	glUniform1i(boundShader->getUniformLocation("clusteredLighting"), enabled);
+	glUniform3ui(boundShader->getUniformLocation("clusterCount"), CLUSTER_COUNT_X, CLUSTER_COUNT_Y, CLUSTER_COUNT_Z);
+	glUniform2f(boundShader->getUniformLocation("clusterDepthRange"), CLUSTER_NEAR, CLUSTER_FAR);
+	glUniform2f(boundShader->getUniformLocation("viewportSize"), viewport[2], viewport[3]);
+}
+
+float LightClusters::getAverageLightsPerCluster() const {
+	size_t occupied = 0;
+	for(auto& cluster: clusters)
+		if(cluster.count) occupied++;
+	return occupied ? float(indices.size()) / occupied : 0;
+}
+
+bool LightClusters::pack(Light& light, GPULight& out) {
+	Light::Type type = light.getType();
+	if(type == Light::Type::Disabled || type == Light::Type::Ambient)
+		return false;
+	// A spotlight whose cutoff is fully closed can't light anything
+	if(type == Light::Type::Spot && light.lightCutoffAngleCosine >= 1)
+		return false;
+
+	out.diffuse = light.lightDiffuse;
+	out.specular = light.lightSpecular;
+	out.position = glm::vec4(light.getPosition(), type == Light::Type::Directional ? INFINITY : light.getRange());
+	out.direction = glm::vec4(light.lightDirection, light.lightCutoffAngleCosine);
+	out.type = type;
+	out.intensity = light.lightIntensity;
+	out.falloff = light.lightFalloff;
+	out.attenuationDistance = light.lightAttenuationStartDistance;
+	return true;
+}
+
+glm::vec4 LightClusters::boundingSphere(const GPULight& light) {
+	glm::vec3 position = light.position;
+	float range = light.position.w;
+	if(light.type != Light::Type::Spot || light.direction.w <= 0 || light.intensity <= 0)
+		return glm::vec4(position, range);
+
+	// The spotlight is lit where pow(phi, intensity) passes the cutoff, so the cone's half angle is where phi = cutoff^(1/intensity)
+	float angle = glm::acos(glm::pow(light.direction.w, 1 / light.intensity));
+	glm::vec3 direction = glm::normalize(glm::vec3(light.direction));
+
+	// Wide cones are bound by the sphere through their rim, narrow ones by the sphere through their apex and rim
+	if(angle > glm::quarter_pi<float>())
+		return glm::vec4(position + direction * glm::cos(angle) * range, glm::sin(angle) * range);
+	float radius = range / (2 * glm::cos(angle));
+	return glm::vec4(position + direction * radius, radius);
+}
+
+int LightClusters::slice(float depth) {
+	if(depth <= CLUSTER_NEAR) return 0;
+	int k = std::log(depth / CLUSTER_NEAR) / std::log(float(CLUSTER_FAR) / CLUSTER_NEAR) * CLUSTER_COUNT_Z;
+	return std::clamp(k, 0, CLUSTER_COUNT_Z - 1);
+}
+
+void LightClusters::insert(uint32_t lightIndex, glm::vec3 center, float radius, float tanHalfFovX, float tanHalfFovY) {
+	// The camera looks down -z, so depths are positive in front of it
+	float depth = -center.z, nearest = depth - radius, farthest = depth + radius;
+	if(farthest <= 0) return; // Behind the camera
+
+	auto sliceDepth = [](int k) { return CLUSTER_NEAR * std::pow(float(CLUSTER_FAR) / CLUSTER_NEAR, float(k) / CLUSTER_COUNT_Z); };
+	auto tile = [](float ndc, int count) { return std::clamp(int(std::floor((ndc * .5f + .5f) * count)), 0, count - 1); };
+
+	for(int k = slice(std::max(nearest, 0.f)), last = slice(farthest); k <= last; k++) {
+		// The first and last slices extend to the camera and off to infinity
+		float d0 = k == 0 ? 0 : sliceDepth(k), d1 = k == CLUSTER_COUNT_Z - 1 ? std::max<float>(CLUSTER_FAR, farthest) : sliceDepth(k + 1);
+
+		// Find the tiles the sphere's bounding box covers (at the part of the slice the sphere overlaps)
+		glm::ivec2 minTile(0), maxTile(CLUSTER_COUNT_X - 1, CLUSTER_COUNT_Y - 1);
+		float a = std::max(d0, nearest), b = std::min(d1, farthest);
+		if(a > 0) {
+			glm::vec2 lo(INFINITY), hi(-INFINITY);
+			for(float d: {a, b})
+				for(float s: {-radius, radius}) {
+					glm::vec2 ndc = (glm::vec2(center) + s) / (d * glm::vec2(tanHalfFovX, tanHalfFovY));
+					lo = glm::min(lo, ndc);
+					hi = glm::max(hi, ndc);
+				}
+			if(lo.x > 1 || lo.y > 1 || hi.x < -1 || hi.y < -1) continue; // Off screen
+			minTile = {tile(lo.x, CLUSTER_COUNT_X), tile(lo.y, CLUSTER_COUNT_Y)};
+			maxTile = {tile(hi.x, CLUSTER_COUNT_X), tile(hi.y, CLUSTER_COUNT_Y)};
+		}
+
+		// Then keep the clusters whose (view space) bounding box actually touches the sphere
+		for(int y = minTile.y; y <= maxTile.y; y++)
+			for(int x = minTile.x; x <= maxTile.x; x++) {
+				glm::vec2 ndc0 = glm::vec2(x, y) / glm::vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y) * 2.f - 1.f;
+				glm::vec2 ndc1 = glm::vec2(x + 1, y + 1) / glm::vec2(CLUSTER_COUNT_X, CLUSTER_COUNT_Y) * 2.f - 1.f;
+				glm::vec2 tanHalf(tanHalfFovX, tanHalfFovY);
+				glm::vec3 boxMin(glm::min(ndc0 * d0, ndc0 * d1) * tanHalf, -d1);
+				glm::vec3 boxMax(glm::max(ndc1 * d0, ndc1 * d1) * tanHalf, -d0);
+
+				glm::vec3 closest = glm::clamp(center, boxMin, boxMax);
+				if(glm::dot(closest - center, closest - center) <= radius * radius)
+					clusterLights[x + CLUSTER_COUNT_X * (y + CLUSTER_COUNT_Y * k)].push_back(lightIndex);
+			}
+	}
+}
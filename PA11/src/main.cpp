@@ -2,6 +2,8 @@
 
 #include "application.h"
 #include "arguments.h"
+#include "memory_tracker.h"
+#include "mesh_blob.h"
 
 
 int main(int argc, char **argv) {
@@ -9,6 +11,10 @@ int main(int argc, char **argv) {
 	Arguments args(argc, argv);
 	if(!args.getCanContinue()) return 1;
 
+	// Cook the models (no window is needed for that) instead of starting the game
+	if(args.getCook())
+		return MeshBlob::cookAll(args) ? 0 : 3;
+
 	// Start an engine
 	Application *engine = new Application("Beef Thief", 1000, 1000);
 	if(!engine->initialize(args)) {
@@ -24,5 +30,8 @@ int main(int argc, char **argv) {
 	// Clean it up
 	delete engine;
 	engine = NULL;
+
+	// Report what is still allocated (everything the engine owned should be gone) and how high each subsystem's usage peaked
+	MemoryTracker::report(std::cout);
 	return 0;
 }
@@ -0,0 +1,149 @@
+#include "memory_tracker.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+#include <LinearMath/btAlignedAllocator.h>
+#include <json.h>
+using json = nlohmann::json;
+
+MemoryTracker::Counter MemoryTracker::counters[MemoryTracker::TagCount];
+MemoryTracker::Counter MemoryTracker::gpuCounters[MemoryTracker::GpuTagCount];
+thread_local MemoryTracker::Tag MemoryTracker::current = MemoryTracker::General;
+thread_local size_t MemoryTracker::heapAllocations = 0;
+
+// Header placed in front of every heap allocation, remembering how big it is and who it was charged to (padded so the allocation keeps malloc's alignment)
+struct alignas(std::max_align_t) AllocationHeader {
+	uint64_t size;
+	MemoryTracker::Tag tag;
+};
+
+static void* trackedAllocate(size_t size, MemoryTracker::Tag tag) {
+	auto header = (AllocationHeader*) std::malloc(sizeof(AllocationHeader) + size);
+	if(!header) return nullptr;
+	*header = {size, tag};
+	MemoryTracker::allocated(tag, size);
+	return header + 1;
+}
+
+static void trackedFree(void* pointer) {
+	if(!pointer) return;
+	auto header = (AllocationHeader*) pointer - 1;
+	MemoryTracker::freed(header->tag, header->size);
+	std::free(header);
+}
+
+void* operator new(size_t size) {
+	if(void* pointer = trackedAllocate(size ? size : 1, MemoryTracker::getTag()))
+		return pointer;
+	throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { trackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { trackedFree(pointer); }
+
+// Bullet allocates everything through its own allocator, which is pointed at tracked versions of malloc and free before main runs
+static void* bulletAllocate(size_t size) { return trackedAllocate(size, MemoryTracker::Physics); }
+static const bool bulletAllocatorTracked = (btAlignedAllocSetCustom(bulletAllocate, trackedFree), true);
+
+
+void MemoryTracker::Counter::add(int64_t bytes, int64_t allocations) {
+	int64_t now = this->bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	this->allocations.fetch_add(allocations, std::memory_order_relaxed);
+
+	// Raise the high water mark if we have passed it
+	int64_t high = highWater.load(std::memory_order_relaxed);
+	while(now > high && !highWater.compare_exchange_weak(high, now, std::memory_order_relaxed));
+}
+
+void MemoryTracker::allocated(Tag tag, size_t bytes) {
+	heapAllocations++;
+	counters[tag].add(bytes, 1);
+}
+
+void MemoryTracker::freed(Tag tag, size_t bytes) {
+	counters[tag].add(-(int64_t) bytes, -1);
+}
+
+void MemoryTracker::gpuAllocated(GpuTag tag, size_t bytes) {
+	gpuResized(tag, 0, bytes);
+}
+
+void MemoryTracker::gpuFreed(GpuTag tag, size_t bytes) {
+	gpuResized(tag, bytes, 0);
+}
+
+void MemoryTracker::gpuResized(GpuTag tag, size_t oldBytes, size_t newBytes) {
+	// Only resources which actually have storage are counted as allocations
+	gpuCounters[tag].add((int64_t) newBytes - (int64_t) oldBytes, (newBytes > 0) - (oldBytes > 0));
+}
+
+MemoryTracker::Stats MemoryTracker::getStats(Tag tag) {
+	auto& counter = counters[tag];
+	return {(size_t) counter.bytes.load(), (size_t) counter.highWater.load(), (size_t) counter.allocations.load()};
+}
+
+MemoryTracker::Stats MemoryTracker::getGpuStats(GpuTag tag) {
+	auto& counter = gpuCounters[tag];
+	return {(size_t) counter.bytes.load(), (size_t) counter.highWater.load(), (size_t) counter.allocations.load()};
+}
+
+const char* MemoryTracker::getName(Tag tag) {
+	switch(tag) {
+		case General: return "General";
+		case Voxels: return "Voxels";
+		case Meshes: return "Meshes";
+		case Physics: return "Physics";
+		case Textures: return "Textures";
+		case Scratch: return "Scratch";
+		default: return "Unknown";
+	}
+}
+
+const char* MemoryTracker::getGpuName(GpuTag tag) {
+	switch(tag) {
+		case GpuBuffers: return "Buffers";
+		case GpuTextures: return "Textures";
+		default: return "Unknown";
+	}
+}
+
+bool MemoryTracker::dump(const std::string& path) {
+	auto toJSON = [](Stats stats) {
+		return json{{"bytes", stats.bytes}, {"highWater", stats.highWater}, {"allocations", stats.allocations}};
+	};
+
+	json out;
+	for(int tag = 0; tag < TagCount; tag++)
+		out["cpu"][getName((Tag) tag)] = toJSON(getStats((Tag) tag));
+	for(int tag = 0; tag < GpuTagCount; tag++)
+		out["gpu"][getGpuName((GpuTag) tag)] = toJSON(getGpuStats((GpuTag) tag));
+
+	// Write to a temporary file, then swap it in
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary);
+		if(!(file << out.dump(1, '\t'))) return false;
+	}
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void MemoryTracker::report(std::ostream& out) {
+	auto megabytes = [](size_t bytes) { return bytes / (1024.0 * 1024.0); };
+	auto line = [&](const char* kind, const char* name, Stats stats) {
+		out << "\t" << kind << " " << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(9) << megabytes(stats.bytes) << "MB in " << std::setw(7) << stats.allocations << " allocations still live, "
+			<< std::setw(9) << megabytes(stats.highWater) << "MB high water" << std::endl;
+	};
+
+	out << "Memory at shutdown:" << std::endl;
+	for(int tag = 0; tag < TagCount; tag++)
+		line("cpu", getName((Tag) tag), getStats((Tag) tag));
+	for(int tag = 0; tag < GpuTagCount; tag++)
+		line("gpu", getGpuName((GpuTag) tag), getGpuStats((GpuTag) tag));
+}
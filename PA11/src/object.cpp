@@ -1,6 +1,9 @@
 #include "object.h"
+#include "memory_tracker.h"
 #include "shader.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
 #include <sstream>
 #include <vector>
@@ -15,9 +18,6 @@
 #include <assimp/postprocess.h>	//includes the postprocessing variables for the importer
 #include <assimp/color4.h>		//includes the aiColor4 object, which is used to handle the colors from the mesh objects
 
-// Convex hull
-#include "VHACD.h"
-
 #include <BulletCollision/CollisionShapes/btConvexPointCloudShape.h>
 #include <BulletCollision/CollisionShapes/btShapeHull.h>
 
@@ -58,9 +58,10 @@ bool Object::initializeGraphics(const Arguments& args, std::string filepath, std
 	// Load the model
 	success &= LoadModelFile(args, filepath, glm::mat4(1), inThread);
 
-	// Load the texture (error texture if none provided, loading fails, or we are in a thread)
-	if(texturePath.empty() || inThread || !loadTextureFile(args, args.getResourcePath() + "textures/" + texturePath, false))
-		tex = invalidTex;
+	// Load the texture (error texture if none provided, loading fails, or until it has been streamed in)
+	tex = invalidTex;
+	if(!texturePath.empty())
+		loadTextureFile(args, args.getResourcePath() + "textures/" + texturePath, false);
 
 	// Ensure that the child model matrix is the same as the normal model matrix
 	childModel = model;
@@ -75,9 +76,12 @@ bool Object::initializeGraphics(const Arguments& args, std::string filepath, std
 GLuint Object::invalidTex = -1;
 
 bool Object::initalizeInvalidTexture(const Arguments& args){
-	auto success = loadTextureFile(args, args.getResourcePath() + "textures/texturemap.png", false);
-	if(success) invalidTex = tex;
-	return success;
+	// Everything else falls back to this texture, so it needs to be loaded right away
+	auto texture = TextureStreamer::load(args.getResourcePath() + "textures/texturemap.png");
+	if(!texture) return false;
+
+	invalidTex = tex = texture->id;
+	return true;
 }
 
 bool Object::initializePhysics(const Arguments& args, Physics& physics, int collisionGroup /*= 0*/, float mass /*= 1*/,  bool addToWorldAutomatically /*= true*/) {
@@ -96,12 +100,20 @@ bool Object::initializePhysics(const Arguments& args, Physics& physics, int coll
 
 void Object::addToPhysicsWorld(Physics& physics, int collisionGroup /*= CollisionGroups::None*/){
 	if(addedToPhysicsWorld) return;
+	this->collisionGroup = collisionGroup;
 
 	// Add the new rigid body to the simulation
 	physics.getWorld()->addRigidBody(rigidBody.get(), collisionGroup, CollisionGroups::CG_ALL);
 	addedToPhysicsWorld = true;
 }
 
+void Object::removeFromPhysicsWorld(Physics& physics){
+	if(!addedToPhysicsWorld) return;
+
+	physics.getWorld()->removeRigidBody(rigidBody.get());
+	addedToPhysicsWorld = false;
+}
+
 void Object::makeDynamic(bool recursive /*= true*/) {
 	rigidBody->setCollisionFlags( rigidBody->getCollisionFlags() & ~btCollisionObject::CF_STATIC_OBJECT & ~btCollisionObject::CF_KINEMATIC_OBJECT );  
 	// rigidBody->setActivationState(ACTIVE_TAG);
@@ -149,143 +161,126 @@ void Object::createSphereCollider(float radius) {
 }
 
 bool Object::createMeshCollider(const Arguments& args, Physics& physics, size_t maxHulls /*= 32*/, std::string path /*= ""*/) {
+	// NOTE: These are handed to the collider cache's worker thread, so they live on the heap rather than in a scratch arena
 	std::vector<float> points;
-	std::vector<int> indices;
+	std::vector<uint32_t> indices;
 
 	// If a model to load was specified, load it into the collision mesh
 	if (path != "") {
 		std::string modelDirectory = args.getResourcePath() + "models/";
 		if(path.find(modelDirectory) == std::string::npos)
 			path = modelDirectory + path;
-		//std::cout << path << std::endl;
-		// Load the model
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
-
-		// Error handling
-		if(scene == nullptr) {
-			std::cerr << "Failed to import model `" << path << "`: ";
-			std::cerr << importer.GetErrorString() << std::endl;
-			return false;
-		}
-
-		// For each mesh...
-		for(int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
 
-			std::vector<glm::vec3> tempVertices = std::vector<glm::vec3>();
-
-			// Extract this mesh from the scene
-			const aiMesh* mesh = scene->mMeshes[meshIndex];
+		// If the model has been cooked...
+		if(MeshBlob::ptr blob = MeshBlob::open(args, path)) {
+			// ... with a matching decomposition, collide with its hulls (until they are swapped in collide as the model's bounds)
+			if(maxHulls > 0 && blob->getMaxHulls() == maxHulls) {
+				glm::vec3 halfExtents = glm::max(glm::max(glm::abs(blob->getBoundsMin()), glm::abs(blob->getBoundsMax())), glm::vec3(.01));
+				collisionShape = std::make_unique<btBoxShape>( toBullet(halfExtents) );
+				pendingCollider = ColliderCache::request(blob);
+				rigidBody->setCollisionShape(collisionShape.get());
+				return true;
+			}
 
-			// For each vertex...
-			for(int vert = 0; vert < mesh->mNumVertices; vert++) {
+			// ... otherwise merge its submeshes into the collision mesh
+			size_t vertexCount = 0, indexCount = 0;
+			for(size_t submesh = 0; submesh < blob->getSubmeshCount(); submesh++) {
+				vertexCount += blob->getVertexCount(submesh);
+				indexCount += blob->getIndexCount(submesh);
+			}
+			points.reserve(vertexCount * 3);
+			indices.reserve(indexCount);
+			for(size_t submesh = 0; submesh < blob->getSubmeshCount(); submesh++) {
+				uint32_t base = points.size() / 3;
+				const Vertex* vertices = blob->getVertices(submesh);
+				for(size_t vert = 0; vert < blob->getVertexCount(submesh); vert++)
+					points.insert(points.end(), {vertices[vert].vertex.x, vertices[vert].vertex.y, vertices[vert].vertex.z});
+				const unsigned int* submeshIndices = blob->getIndices(submesh);
+				for(size_t index = 0; index < blob->getIndexCount(submesh); index++)
+					indices.push_back(base + submeshIndices[index]);
+			}
 
-				// Extract the position
-				auto _pos = mesh->mVertices[vert];
+		// Otherwise import it
+		} else {
+			Assimp::Importer importer;
+			const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
 
-				// Add the vertex to the list of vertecies
-				points.push_back(_pos.x);
-				points.push_back(_pos.y);
-				points.push_back(_pos.z);
+			// Error handling
+			if(scene == nullptr) {
+				std::cerr << "Failed to import model `" << path << "`: ";
+				std::cerr << importer.GetErrorString() << std::endl;
+				return false;
 			}
 
-			// For each face...
-			for(int face = 0; face < mesh->mNumFaces; face++)
-				// For each index in the face (3 in the triangles)
-				for(int index = 0; index < 3; index++)
-					// Add the index to the list of indices
-					indices.push_back(mesh->mFaces[face].mIndices[index]);
-
-			// Store the concave mesh using the exact model data
-			for(glm::vec3& vert: tempVertices) {
-				points.push_back(vert.x);
-				points.push_back(vert.y);
-				points.push_back(vert.z);
+			size_t vertexCount = 0, faceCount = 0;
+			for(int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
+				vertexCount += scene->mMeshes[meshIndex]->mNumVertices;
+				faceCount += scene->mMeshes[meshIndex]->mNumFaces;
+			}
+			points.reserve(vertexCount * 3);
+			indices.reserve(faceCount * 3);
+
+			// For each mesh...
+			for(int meshIndex = 0; meshIndex < scene->mNumMeshes; meshIndex++) {
+				// Extract this mesh from the scene
+				const aiMesh* mesh = scene->mMeshes[meshIndex];
+				// Indices are relative to the mesh, so they are offset past the meshes before it
+				uint32_t base = points.size() / 3;
+
+				// For each vertex...
+				for(int vert = 0; vert < mesh->mNumVertices; vert++) {
+
+					// Extract the position
+					auto _pos = mesh->mVertices[vert];
+
+					// Add the vertex to the list of vertecies
+					points.push_back(_pos.x);
+					points.push_back(_pos.y);
+					points.push_back(_pos.z);
+				}
+
+				// For each face...
+				for(int face = 0; face < mesh->mNumFaces; face++)
+					// For each index in the face (3 in the triangles)
+					for(int index = 0; index < 3; index++)
+						// Add the index to the list of indices
+						indices.push_back(base + mesh->mFaces[face].mIndices[index]);
 			}
 		}
 
 	// If we aren't loading a new mesh... our collision mesh is just the graphics mesh
 	} else {
-		for(Vertex& vert: vertices) {
-			points.push_back(vert.vertex.x);
-			points.push_back(vert.vertex.y);
-			points.push_back(vert.vertex.z);
+		const Vertex* vertexData = getVertexData();
+		points.reserve(getVertexCount() * 3);
+		for(size_t vert = 0; vert < getVertexCount(); vert++) {
+			points.push_back(vertexData[vert].vertex.x);
+			points.push_back(vertexData[vert].vertex.y);
+			points.push_back(vertexData[vert].vertex.z);
 		}
-		indices = std::vector<int>(this->indices.begin(), this->indices.end());
+		indices.assign(getIndexData(), getIndexData() + getIndexCount());
 	}
 
 
-	// If we should convert the data into a convex mesh... perform a convex decomposition
+	// If we should convert the data into a convex mesh... request a (cached) convex decomposition
 	if (maxHulls > 0) {
-		VHACD::IVHACD::Parameters params; // V-HACD parameters
-		// params.m_maxNumVerticesPerCH = 128;
-		params.m_maxConvexHulls = maxHulls;
-		VHACD::IVHACD* interfaceVHACD = VHACD::CreateVHACD(); // Create Decomposer
-
-		// Compute approximate convex decomposition
-		auto uint32Indecies = std::vector<uint32_t>(indices.begin(), indices.end());
-		// bool res = interfaceVHACD->Compute(points.data(), points.size(), uint32Indecies.data(), uint32Indecies.size() / 3, params);
-		bool res = interfaceVHACD->Compute(points.data(), points.size() / 3, uint32Indecies.data(), uint32Indecies.size() / 3, params);
-
-		collisionShape = std::make_unique<btCompoundShape>();
-
-		// Pass each computed convex hull off to react
-		size_t nConvexHulls = interfaceVHACD->GetNConvexHulls(); // Get the number of convex-hulls
-		for (size_t i = 0; i < nConvexHulls; i++) {
-			// Get the i-th convex-hull
-			VHACD::IVHACD::ConvexHull hull;
-			interfaceVHACD->GetConvexHull(i, hull); 
-
-			// Save the points of the hull
-			auto verts = std::vector<btVector3>();
-			for (size_t v = 0, idx = 0; v < hull.m_nPoints; ++v, idx+=3)
-				verts.emplace_back(hull.m_points[idx], hull.m_points[idx + 1], hull.m_points[idx + 2]);
-			
-			// Save the indecies of the hull
-			auto indices = std::vector<int>();
-			for (size_t t = 0, idx = 0; t < hull.m_nTriangles; ++t, idx +=3){
-				indices.push_back(hull.m_triangles[idx]);
-				indices.push_back(hull.m_triangles[idx + 1]);
-				indices.push_back(hull.m_triangles[idx + 2]);
-			}
+		// Until the decomposition is ready collide as a box which covers the mesh
+		glm::vec3 halfExtents(.01);
+		for (size_t i = 0; i + 2 < points.size(); i += 3)
+			halfExtents = glm::max(halfExtents, glm::abs(glm::vec3(points[i], points[i + 1], points[i + 2])));
+		collisionShape = std::make_unique<btBoxShape>( toBullet(halfExtents) );
 
-			trimeshs.emplace_back( std::move(std::make_unique<btTriangleMesh>()) );
-			for (int i = 0; i < indices.size(); i += 3)
-			{
-				int index0 = indices[i];
-				int index1 = indices[i + 1];
-				int index2 = indices[i + 2];
-
-				btVector3 vertex0 = verts[index0];
-				btVector3 vertex1 = verts[index1];
-				btVector3 vertex2 = verts[index2];
-
-				trimeshs.back()->addTriangle(vertex0, vertex1, vertex2);
-			}
-
-			shapes.emplace_back( std::move(std::make_unique<btConvexTriangleMeshShape>( trimeshs.back().get() )) );
-			((btCompoundShape*) collisionShape.get())->addChildShape(btTransform::getIdentity(), shapes.back().get());
-		}
-
-		// Release decomposer memory
-		interfaceVHACD->Clean();
-		interfaceVHACD->Release(); 
+		pendingCollider = ColliderCache::request(args, std::move(points), std::move(indices), maxHulls);
 
 	// Us a concave mesh
 	} else {//if(maxHulls == 1) 
+		// Add each vertex once and then the triangles between them (with the trimesh's arrays sized up front)
 		trimeshs.emplace_back( std::move(std::make_unique<btTriangleMesh>()) );
-		for (int i = 0; i < indices.size(); i += 3)
-		{
-			int index0 = indices[i];
-			int index1 = indices[i + 1];
-			int index2 = indices[i + 2];
-
-			btVector3 vertex0 = toBullet(vertices[index0].vertex);
-			btVector3 vertex1 = toBullet(vertices[index1].vertex);
-			btVector3 vertex2 = toBullet(vertices[index2].vertex);
-
-			trimeshs.back()->addTriangle(vertex0, vertex1, vertex2);
-		}
+		trimeshs.back()->preallocateVertices(points.size() / 3);
+		trimeshs.back()->preallocateIndices(indices.size());
+		for (size_t i = 0; i + 2 < points.size(); i += 3)
+			trimeshs.back()->findOrAddVertex(btVector3(points[i], points[i + 1], points[i + 2]), /*removeDuplicateVertices*/ false);
+		for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			trimeshs.back()->addTriangleIndices(indices[i], indices[i + 1], indices[i + 2]);
 
 		collisionShape  = std::make_unique<btBvhTriangleMeshShape>(trimeshs.back().get(), true);
 	}
@@ -296,7 +291,27 @@ bool Object::createMeshCollider(const Arguments& args, Physics& physics, size_t
 	return true;
 }
 
+void Object::applyPendingCollider() {
+	sharedCollider = pendingCollider.get();
+	pendingCollider = {};
+	if(!rigidBody) return;
+
+	// Bullet caches collision pairs per shape, so the body needs to leave the world while its shape changes
+	auto world = Physics::getSingleton().getWorld().write_lock();
+	if(addedToPhysicsWorld) world->removeRigidBody(rigidBody.get());
+	rigidBody->setCollisionShape(sharedCollider->compound.get());
+	if(addedToPhysicsWorld) world->addRigidBody(rigidBody.get(), collisionGroup, CollisionGroups::CG_ALL);
+
+	// The placeholder is no longer referenced
+	collisionShape.reset();
+}
+
 bool Object::LoadModelFile(const Arguments& args, const std::string& path, glm::mat4 onImportTransformation, bool inThread) {
+	// Use the cooked version of the model if there is one (models are always cooked untransformed)
+	if(onImportTransformation == glm::mat4(1))
+		if(MeshBlob::ptr blob = MeshBlob::open(args, path))
+			return LoadCookedModel(blob, inThread);
+
 	// Load the model
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
@@ -321,6 +336,7 @@ bool Object::LoadModelFile(const Arguments& args, const std::string& path, glm::
 		// Remove a previous model
 		obj->vertices.clear();
 		obj->indices.clear();
+		obj->meshBlob = nullptr;
 
 		// Extract this mesh from the scene
 		const aiMesh* mesh = scene->mMeshes[meshIndex];
@@ -339,46 +355,33 @@ bool Object::LoadModelFile(const Arguments& args, const std::string& path, glm::
 
 		// }
 
-		// For each vertex...
-		for(int vert = 0; vert < mesh->mNumVertices; vert++) {
+		// Extract the vertices and indices (which are kept after they are uploaded)
+		MemoryTracker::Scope tag(MemoryTracker::Meshes);
+		MeshBlob::convert(mesh, onImportTransformation, obj->vertices, obj->indices);
 
-			// Extract the position
-			auto _pos = mesh->mVertices[vert];
-			// Apply an input transformation (defaults to the identity matrix)
-			glm::vec4 pos(_pos.x, _pos.y, _pos.z, 1);
-			pos = onImportTransformation * pos;
-
-			// Extract the (first) vertex color if it exists
-			glm::vec3 color(1, 0, 0); // Enable textures, no voxel tint by default
-			if(mesh->HasVertexColors(0)) {
-				auto col = mesh->mColors[0][vert];
-				color = glm::vec3(col.r, col.g, col.b);
-			}
-
-			// Extract the (first) texture coordinates if they exist
-			glm::vec2 uv(0, 0); // 0,0 by default
-			if(mesh->HasTextureCoords(0)) {
-				auto tex = mesh->mTextureCoords[0][vert];
-				uv = glm::vec2(tex.x, -tex.y);
-			}
+		// Upload the model to the GPU
+		if(!inThread) obj->finalizeModel();
+	}
 
-			// Extract the (first) texture coordinates if they exist
-			glm::vec3 normal(0, 0, 0); // 0,0,0 by default
-			if(mesh->HasNormals()) {
-				auto tex = mesh->mNormals[vert];
-				normal = glm::vec3(tex.x, tex.y, tex.z);
-			}
+	return true;
+}
 
-			// Add the vertex to the list of vertecies
-			obj->vertices.emplace_back(/*position*/ glm::vec3(pos.x, pos.y, pos.z), color, uv, normal);
+bool Object::LoadCookedModel(MeshBlob::ptr blob, bool inThread) {
+	// For each submesh...
+	for(size_t submesh = 0; submesh < blob->getSubmeshCount(); submesh++) {
+		// First submesh is put in this object, future submeshes are added as sub-object
+		Object::ptr obj;
+		if(submesh == 0) obj = shared_from_this();
+		else{
+			obj = std::make_shared<Submesh>(); // Submesh's model matrix are linked to their parent
+			obj->setParent(shared_from_this());
 		}
 
-		// For each face...
-		for(int face = 0; face < mesh->mNumFaces; face++)
-			// For each index in the face (3 in the triangles)
-			for(int index = 0; index < 3; index++)
-				// Add the index to the list of indices
-				obj->indices.push_back(mesh->mFaces[face].mIndices[index]);
+		// The model data is read straight out of the cooked model
+		obj->vertices.clear();
+		obj->indices.clear();
+		obj->meshBlob = blob;
+		obj->meshBlobSubmesh = submesh;
 
 		// Upload the model to the GPU
 		if(!inThread) obj->finalizeModel();
@@ -390,19 +393,36 @@ bool Object::LoadModelFile(const Arguments& args, const std::string& path, glm::
 // Uploads the model data to the GPU
 void Object::finalizeModel(bool recursive) {
 	// If graphics hasn't been initalized
-	if(VB == std::numeric_limits<GLuint>::max() && IB == std::numeric_limits<GLuint>::max()){
-		// Create the vertex and face buffers for this object
+	bool created = VB == std::numeric_limits<GLuint>::max() && IB == std::numeric_limits<GLuint>::max();
+	if(created){
+		// Create the vertex and face buffers (and the vertex array describing them) for this object
 		glGenBuffers(1, &VB);
 		glGenBuffers(1, &IB);
+		glGenVertexArrays(1, &VAO);
 	}
 
 	// Add the data to the vertex buffer
+	size_t vertexBytes = sizeof(Vertex) * getVertexCount();
 	glBindBuffer(GL_ARRAY_BUFFER, VB);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), &vertices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, vertexBytes, getVertexData(), GL_STATIC_DRAW);
 
 	// Add the data to the face buffer
+	size_t indexBytes = sizeof(unsigned int) * getIndexCount();
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), &indices[0], GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, getIndexData(), GL_STATIC_DRAW);
+
+	// Account for the buffers' new sizes
+	MemoryTracker::gpuResized(MemoryTracker::GpuBuffers, bufferBytes, vertexBytes + indexBytes);
+	bufferBytes = vertexBytes + indexBytes;
+
+	// Describe the buffers to the vertex array once (then put back whichever vertex array was bound, so nothing else modifies ours)
+	if(created) {
+		GLint bound;
+		glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &bound);
+		glBindVertexArray(VAO);
+		configureVertexArray();
+		glBindVertexArray(bound);
+	}
 
 	if(recursive)
 		for(auto& child: children)
@@ -416,30 +436,22 @@ bool Object::loadTextureFile(const Arguments& args, std::string path, bool makeR
 	if(path.find(modelDirectory) == std::string::npos && makeRelative)
 		path = modelDirectory + path;
 
-	// Load the image
-	int width, height, channelsPresent;
-	unsigned char* img = stbi_load(path.c_str(), &width, &height, &channelsPresent, /*RGBA*/ 4);
-	if(img == nullptr) {
+	// Make sure the image exists (it is decoded on a worker thread and uploaded over the next few frames)
+	if(!std::filesystem::exists(path)) {
 		std::cerr << "Failed to load image `" << path << "`" << std::endl;
 		return false;
 	}
 
-	// Upload the image to the gpu
-	glGenTextures(1, &tex);
-	glBindTexture(GL_TEXTURE_2D, tex);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, img);
-	glGenerateMipmap(GL_TEXTURE_2D);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	// Free the image
-	stbi_image_free(img);
-
+	streamedTexture = TextureStreamer::request(path);
+	tex = invalidTex;
 	return true;
 }
 
 
 void Object::update(float dt) {
+	// Swap in our convex collider once it has been decomposed
+	if(pendingCollider.valid() && pendingCollider.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		applyPendingCollider();
 	// Make sure the graphics position is updated to match the physics position
 	syncGraphicsWithPhysics();
 	// Pass along to children
@@ -447,46 +459,71 @@ void Object::update(float dt) {
 		child->update(dt);
 }
 
+void Object::draw() {
+	COUNTED_GL(glDrawElements(GL_TRIANGLES, getIndexCount(), GL_UNSIGNED_INT, 0));
+}
+
+void Object::configureVertexArray() {
+	glBindBuffer(GL_ARRAY_BUFFER, VB);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
+	for(GLuint attribute = 0; attribute < 4; attribute++)
+		glEnableVertexAttribArray(attribute);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,color));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,uv));
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,normal));
+}
+
+void Object::updateStreamedTexture() {
+	if(streamedTexture && streamedTexture->isResident()) {
+		tex = streamedTexture->id;
+		streamedTexture = nullptr;
+	}
+}
+
 void Object::render(Shader* boundShader) {
+	// Swap in our texture once it has been streamed in
+	updateStreamedTexture();
+
 	// Only render if graphics have been initalized...
 	if(VB != std::numeric_limits<GLuint>::max() && IB != std::numeric_limits<GLuint>::max()){
 		// Set the model matrix
-		glUniformMatrix4fv(boundShader->getUniformLocation("modelMatrix"), 1, GL_FALSE, glm::value_ptr(getModel()));
+		COUNTED_GL(glUniformMatrix4fv(COUNTED_GL(boundShader->getUniformLocation("modelMatrix")), 1, GL_FALSE, glm::value_ptr(getModel())));
 
 		// Enable 3 vertex attributes
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
-		glEnableVertexAttribArray(3);
+		COUNTED_GL(glEnableVertexAttribArray(0));
+		COUNTED_GL(glEnableVertexAttribArray(1));
+		COUNTED_GL(glEnableVertexAttribArray(2));
+		COUNTED_GL(glEnableVertexAttribArray(3));
 
 		// Specify that we are using the vertex buffer
-		glBindBuffer(GL_ARRAY_BUFFER, VB);
+		COUNTED_GL(glBindBuffer(GL_ARRAY_BUFFER, VB));
 		// Specify where in the vertex buffer we can find position, color, and UVs
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,color));
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,uv));
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,normal));
+		COUNTED_GL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0));
+		COUNTED_GL(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,color)));
+		COUNTED_GL(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,uv)));
+		COUNTED_GL(glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,normal)));
 
 
 		//bind texture (if it exists)
 		if(tex != -1) {
-			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, tex);
+			COUNTED_GL(glActiveTexture(GL_TEXTURE0));
+			COUNTED_GL(glBindTexture(GL_TEXTURE_2D, tex));
 		}
 
 		// Specify that we are using the index buffer
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
+		COUNTED_GL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB));
 
 		// Enable backface culling
-		glEnable(GL_CULL_FACE);
+		COUNTED_GL(glEnable(GL_CULL_FACE));
 		// Draw the triangles
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		draw();
 
 		// Disable the attributes
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glDisableVertexAttribArray(3);
+		COUNTED_GL(glDisableVertexAttribArray(0));
+		COUNTED_GL(glDisableVertexAttribArray(1));
+		COUNTED_GL(glDisableVertexAttribArray(2));
+		COUNTED_GL(glDisableVertexAttribArray(3));
 	}
 
 	// Pass along to children.
@@ -494,6 +531,17 @@ void Object::render(Shader* boundShader) {
 		child->render(boundShader);
 }
 
+void Object::submit(RenderQueue& queue) {
+	updateStreamedTexture();
+
+	// Only submit if graphics have been initalized...
+	if(VAO != std::numeric_limits<GLuint>::max())
+		queue.submit(this, getModel(), VAO, tex);
+
+	for(auto& child: children)
+		child->submit(queue);
+}
+
 Object::ptr Object::setParent(Object::ptr p) {
 	// If the parent is the same as what we are setting it to... do nothing
 	if(parent == p.get()) return p;
@@ -532,6 +580,16 @@ Object::ptr Object::addChild(Object::ptr child) {
 	return child;
 }
 
+void Object::removeChild(Object::ptr child) {
+	auto found = std::find(children.begin(), children.end(), child);
+	if(found == children.end()) return;
+
+	// Detach the child from us (it becomes the root of its own tree)
+	children.erase(found);
+	child->parent = nullptr;
+	*((uint*) &child->sceneDepth) = 0;
+}
+
 void Object::keyboard(const SDL_KeyboardEvent& e) {
 	// Pass along to children
 	for(auto& child: children)
@@ -0,0 +1,101 @@
+#include "render_queue.h"
+#include "object.h"
+#include "shader.h"
+
+#include <algorithm>
+#include <limits>
+
+static_assert(RENDER_KEY_PASS_BITS + RENDER_KEY_PROGRAM_BITS + RENDER_KEY_TEXTURE_BITS + RENDER_KEY_MESH_BITS + RENDER_KEY_DEPTH_BITS == 64, "The sort key's fields must fill 64 bits");
+
+size_t RenderQueue::glCalls = 0;
+
+void RenderQueue::begin(glm::vec3 viewPosition, const std::array<Shader*, (size_t) RenderPass::Count>& passShaders) {
+	draws.clear();
+	packets.clear();
+	stateChanges = 0;
+	this->viewPosition = viewPosition;
+
+	// Look up the uniforms each draw sets whenever a pass' shader changes
+	for(size_t pass = 0; pass < passShaders.size(); pass++)
+		if(passShaders[pass] && passShaders[pass] != this->passShaders[pass]) {
+			modelMatrixLocations[pass] = passShaders[pass]->getUniformLocation("modelMatrix");
+			instancedLocations[pass] = passShaders[pass]->getUniformLocation("instanced");
+		}
+	this->passShaders = passShaders;
+}
+
+void RenderQueue::submit(Object* object, const glm::mat4& model, GLuint vertexArray, GLuint texture, bool instanced) {
+	float depth = glm::distance(viewPosition, glm::vec3(model[3]));
+	uint32_t draw = draws.size();
+	draws.push_back({model, object, vertexArray, texture, instanced});
+
+	for(size_t pass = 0; pass < passShaders.size(); pass++)
+		if(passShaders[pass]) {
+			// The depth only passes don't sample textures (so their draws are grouped by mesh alone) and are drawn front to back, as is the
+			// lit pass when there is no pre-pass (otherwise the pre-pass has already found the visible fragments, so it is ordered by state)
+			bool lit = (RenderPass) pass == RenderPass::Lit;
+			bool frontToBack = !lit || !passShaders[(size_t) RenderPass::DepthPrePass];
+			packets.push_back({makeKey((RenderPass) pass, passShaders[pass]->getProgram(), lit ? texture : 0, vertexArray, depth, frontToBack), draw});
+		}
+}
+
+void RenderQueue::sort() {
+	std::sort(packets.begin(), packets.end(), [](const Packet& a, const Packet& b) { return a.key < b.key; });
+}
+
+void RenderQueue::execute(RenderPass pass) {
+	if(!passShaders[(size_t) pass]) return;
+	GLint modelMatrix = modelMatrixLocations[(size_t) pass], instancedLocation = instancedLocations[(size_t) pass];
+	bool sampleTextures = pass == RenderPass::Lit;
+
+	// The pass is the top of the key, so its packets are next to each other
+	auto packet = std::lower_bound(packets.begin(), packets.end(), (uint64_t) pass << (64 - RENDER_KEY_PASS_BITS),
+		[](const Packet& packet, uint64_t key) { return packet.key < key; });
+
+	// Every packet is drawn with backface culling, and the instanced uniform starts off (it is left off by whatever drew last)
+	COUNTED_GL(glEnable(GL_CULL_FACE));
+	GLuint vertexArray = defaultVertexArray, texture = std::numeric_limits<GLuint>::max();
+	bool instanced = false;
+
+	for(; packet != packets.end() && passOf(packet->key) == pass; packet++) {
+		auto& draw = draws[packet->draw];
+
+		// Only change the state which differs from the last packet's
+		if(draw.vertexArray != vertexArray) {
+			COUNTED_GL(glBindVertexArray(draw.vertexArray));
+			vertexArray = draw.vertexArray;
+			stateChanges++;
+		}
+		if(sampleTextures && draw.texture != std::numeric_limits<GLuint>::max() && draw.texture != texture) {
+			COUNTED_GL(glBindTexture(GL_TEXTURE_2D, draw.texture));
+			texture = draw.texture;
+			stateChanges++;
+		}
+		if(draw.instanced != instanced) {
+			COUNTED_GL(glUniform1i(instancedLocation, draw.instanced));
+			instanced = draw.instanced;
+		}
+
+		// Instanced draws take their model matrices from the instance attributes instead
+		if(!draw.instanced)
+			COUNTED_GL(glUniformMatrix4fv(modelMatrix, 1, GL_FALSE, glm::value_ptr(draw.model)));
+		draw.object->draw();
+	}
+
+	// Put back the state the rest of the frame expects
+	if(instanced) COUNTED_GL(glUniform1i(instancedLocation, false));
+	if(vertexArray != defaultVertexArray) COUNTED_GL(glBindVertexArray(defaultVertexArray));
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, GLuint program, GLuint texture, GLuint vertexArray, float depth, bool frontToBack) {
+	auto field = [](uint64_t value, int bits) { return value & ((uint64_t(1) << bits) - 1); };
+	uint64_t quantizedDepth = std::clamp(depth / RENDER_QUEUE_MAX_DEPTH, 0.f, 1.f) * ((uint64_t(1) << RENDER_KEY_DEPTH_BITS) - 1);
+
+	uint64_t key = field((uint64_t) pass, RENDER_KEY_PASS_BITS);
+	key = key << RENDER_KEY_PROGRAM_BITS | field(program, RENDER_KEY_PROGRAM_BITS);
+	if(frontToBack) key = key << RENDER_KEY_DEPTH_BITS | field(quantizedDepth, RENDER_KEY_DEPTH_BITS);
+	key = key << RENDER_KEY_TEXTURE_BITS | field(texture, RENDER_KEY_TEXTURE_BITS);
+	key = key << RENDER_KEY_MESH_BITS | field(vertexArray, RENDER_KEY_MESH_BITS);
+	if(!frontToBack) key = key << RENDER_KEY_DEPTH_BITS | field(quantizedDepth, RENDER_KEY_DEPTH_BITS);
+	return key;
+}
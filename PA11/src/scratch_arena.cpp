@@ -0,0 +1,52 @@
+#include "scratch_arena.h"
+#include "memory_tracker.h"
+
+#include <algorithm>
+#include <cstdint>
+
+ScratchArena::~ScratchArena() {
+	for(auto& block: blocks)
+		::operator delete(block.data);
+}
+
+ScratchArena& ScratchArena::local() {
+	static thread_local ScratchArena arena;
+	return arena;
+}
+
+size_t ScratchArena::getCapacity() const {
+	size_t capacity = 0;
+	for(auto& block: blocks)
+		capacity += block.size;
+	return capacity;
+}
+
+void* ScratchArena::do_allocate(size_t bytes, size_t alignment) {
+	for(;; block++, offset = 0) {
+		// If we have run out of blocks (or are starting a block which is too small for this allocation) add a block
+		if(block == blocks.size() || (offset == 0 && blocks[block].size < bytes + alignment)) {
+			size_t size = std::max<size_t>(SCRATCH_ARENA_BLOCK_SIZE, bytes + alignment);
+			MemoryTracker::Scope tag(MemoryTracker::Scratch);
+			blocks.insert(blocks.begin() + block, {(std::byte*) ::operator new(size), size});
+		}
+
+		// Bump past the allocation if it fits in the current block, otherwise move on to the next block
+		uintptr_t base = (uintptr_t) blocks[block].data;
+		uintptr_t start = (base + offset + alignment - 1) & ~uintptr_t(alignment - 1);
+		if(start - base + bytes <= blocks[block].size) {
+			offset = start - base + bytes;
+			highWater = std::max(highWater, usedBefore + offset);
+			return (void*) start;
+		}
+		usedBefore += blocks[block].size;
+	}
+}
+
+void ScratchArena::rewind(size_t block, size_t offset) {
+	this->block = block;
+	this->offset = offset;
+
+	usedBefore = 0;
+	for(size_t i = 0; i < block; i++)
+		usedBefore += blocks[i].size;
+}
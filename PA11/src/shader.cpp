@@ -1,6 +1,30 @@
 #include "shader.h"
 
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iomanip>
+#include <sstream>
+
+// Magic number at the start of every cached program
+static const char CACHE_MAGIC[4] = {'G', 'L', 'P', 'B'};
+
+size_t Shader::cacheHits = 0;
+size_t Shader::cacheMisses = 0;
+
+// Checks if the driver can hand us (and take back) linked programs
+static bool supportsProgramBinaries() {
+	static bool supported = []{
+#if !defined(__APPLE__) && !defined(MACOSX)
+		if(!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+#endif
+		// Some drivers support the functions but don't provide any formats
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}();
+	return supported;
+}
 
 Shader::Shader() {
 	shaderProg = 0;
@@ -19,6 +43,15 @@ Shader::~Shader() {
 }
 
 bool Shader::initialize() {
+	// Let the driver compile shaders on as many threads as it likes (only needs to be done once)
+#if !defined(__APPLE__) && !defined(MACOSX) && defined(GL_KHR_parallel_shader_compile)
+	static bool parallelCompileEnabled = false;
+	if(!parallelCompileEnabled && GLEW_KHR_parallel_shader_compile) {
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		parallelCompileEnabled = true;
+	}
+#endif
+
 	shaderProg = glCreateProgram();
 
 	if (shaderProg == 0) {
@@ -29,12 +62,13 @@ bool Shader::initialize() {
 	return true;
 }
 
-// Use this method to add shaders to the program. When finished - call finalize()
+// Use this method to add shaders to the program. When finished - call link() and finalize()
 bool Shader::addShader(GLenum ShaderType, std::string filePath, const Arguments& args) {
 	// If the filepath doesn't already have the shader directory path, add the shader dirrectory path
 	std::string shaderDirectory = args.getResourcePath() + "shaders/";
 	if(filePath.find(shaderDirectory) == std::string::npos)
 		filePath = shaderDirectory + filePath;
+	cacheDirectory = args.getResourcePath() + "cache/shaders/";
 
 	// Make sure that the provided file exists
 	std::ifstream file(filePath);
@@ -43,48 +77,71 @@ bool Shader::addShader(GLenum ShaderType, std::string filePath, const Arguments&
 		return false;
 	}
 
-	// Read it in
+	// Read it in (it is only compiled if the program isn't cached)
 	std::string s( (std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>() );
-	GLuint ShaderObj = glCreateShader(ShaderType);
-	if (ShaderObj == 0) {
-		std::cerr << "Error creating shader type " << ShaderType << std::endl;
-		return false;
+	stages.push_back({ShaderType, filePath, std::move(s)});
+	return true;
+}
+
+// Starts loading the program from the cache, or compiling and linking it, without waiting for the driver to finish
+bool Shader::link() {
+	if(linked) return true;
+	linked = true;
+
+	// If the program is cached there is nothing to compile
+	if(loadBinary()) {
+		loadedFromCache = true;
+		cacheHits++;
+		return true;
 	}
+	cacheMisses++;
 
-	// Save the shader object - will be deleted in the destructor
-	shaderObjList.push_back(ShaderObj);
-
-	// Set the shader's source code and compile it
-	const GLchar* p[1];
-	p[0] = s.c_str();
-	GLint Lengths[1] = { (GLint)s.size() };
-	glShaderSource(ShaderObj, 1, p, Lengths);
-	glCompileShader(ShaderObj);
-
-	// Maje sure compilation was successful
-	GLint success;
-	glGetShaderiv(ShaderObj, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		GLchar InfoLog[1024];
-		glGetShaderInfoLog(ShaderObj, 1024, NULL, InfoLog);
-		std::cerr << "Error compiling: " << InfoLog << std::endl;
-		return false;
+	for(auto& stage: stages) {
+		GLuint ShaderObj = glCreateShader(stage.type);
+		if (ShaderObj == 0) {
+			std::cerr << "Error creating shader type " << stage.type << std::endl;
+			return false;
+		}
+
+		// Save the shader object - will be deleted in the destructor
+		shaderObjList.push_back(ShaderObj);
+
+		// Set the shader's source code and start compiling it (we check if compilation was successful in finalize)
+		const GLchar* p[1];
+		p[0] = stage.source.c_str();
+		GLint Lengths[1] = { (GLint)stage.source.size() };
+		glShaderSource(ShaderObj, 1, p, Lengths);
+		glCompileShader(ShaderObj);
+
+		// Attach the shader to our compiled program
+		glAttachShader(shaderProg, ShaderObj);
 	}
 
-	// Attach the shader to our compiled program
-	glAttachShader(shaderProg, ShaderObj);
+	// Start linking the program (asking the driver to keep around a binary we can cache)
+	if(supportsProgramBinaries())
+		glProgramParameteri(shaderProg, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(shaderProg);
 	return true;
 }
 
-
-// After all the shaders have been added to the program call this function
-// to link and validate the program.
+// After all the shaders have been added to the program (and every program has been linked) call this function
+// to wait on and check the link.
 bool Shader::finalize() {
+	if(!link()) return false;
+
 	GLint Success = 0;
 	GLchar ErrorLog[1024] = { 0 };
 
-	// Link the program
-	glLinkProgram(shaderProg);
+	// Make sure compilation was successful
+	for(size_t i = 0; i < shaderObjList.size(); i++) {
+		glGetShaderiv(shaderObjList[i], GL_COMPILE_STATUS, &Success);
+		if (!Success) {
+			glGetShaderInfoLog(shaderObjList[i], sizeof(ErrorLog), NULL, ErrorLog);
+			std::cerr << "Error compiling `" << stages[i].filePath << "`: " << ErrorLog << std::endl;
+			return false;
+		}
+	}
+
 	// Ensure program linking was successful
 	glGetProgramiv(shaderProg, GL_LINK_STATUS, &Success);
 	if (Success == 0) {
@@ -93,6 +150,7 @@ bool Shader::finalize() {
 		return false;
 	}
 
+#ifdef SHADER_VALIDATE
 	// Validate the linked program
 	glValidateProgram(shaderProg);
 	glGetProgramiv(shaderProg, GL_VALIDATE_STATUS, &Success);
@@ -101,6 +159,11 @@ bool Shader::finalize() {
 		std::cerr << "Invalid shader program: " << ErrorLog << std::endl;
 		return false;
 	}
+#endif
+
+	// Cache the freshly linked program
+	if(!loadedFromCache && supportsProgramBinaries() && !saveBinary())
+		std::cerr << "Failed to cache shader program `" << cachePath() << "`" << std::endl;
 
 	// Delete the intermediate shader objects that have been added to the program
 	for (std::vector<GLuint>::iterator it = shaderObjList.begin(); it != shaderObjList.end(); it++)
@@ -123,3 +186,100 @@ GLint Shader::getUniformLocation(const char* pUniformName) {
 
 	return Location;
 }
+
+uint64_t Shader::cacheKey() const {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325;
+	auto combine = [&hash](const void* data, size_t size) {
+		const uint8_t* bytes = (const uint8_t*) data;
+		for(size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 0x100000001b3;
+		}
+	};
+	auto combineString = [&combine](const char* string) { if(string) combine(string, std::strlen(string) + 1); };
+
+	// A binary is only valid for the driver which produced it
+	uint32_t version = SHADER_CACHE_VERSION;
+	combine(&version, sizeof(version));
+	combineString((const char*) glGetString(GL_VENDOR));
+	combineString((const char*) glGetString(GL_RENDERER));
+	combineString((const char*) glGetString(GL_VERSION));
+
+	for(auto& stage: stages) {
+		combine(&stage.type, sizeof(stage.type));
+		combineString(stage.source.c_str());
+	}
+	return hash;
+}
+
+std::string Shader::cachePath() const {
+	std::stringstream path;
+	path << cacheDirectory << std::hex << std::setw(16) << std::setfill('0') << cacheKey() << ".program";
+	return path.str();
+}
+
+bool Shader::loadBinary() {
+	if(!supportsProgramBinaries()) return false;
+
+	std::ifstream fin(cachePath(), std::ios::binary);
+	if(!fin) return false;
+
+	// Make sure the file is a cached program, from this version, for this program
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	GLenum format;
+	uint32_t length;
+	fin.read(magic, sizeof(magic));
+	fin.read((char*) &version, sizeof(version));
+	fin.read((char*) &key, sizeof(key));
+	fin.read((char*) &format, sizeof(format));
+	fin.read((char*) &length, sizeof(length));
+	if(!fin || std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) != 0 || version != SHADER_CACHE_VERSION || key != cacheKey())
+		return false;
+
+	std::vector<char> binary(length);
+	fin.read(binary.data(), binary.size());
+	if(!fin) return false;
+
+	// The driver may still reject the binary (if it was updated without changing its version string), in which case we compile from source
+	glProgramBinary(shaderProg, format, binary.data(), binary.size());
+	GLint Success = 0;
+	glGetProgramiv(shaderProg, GL_LINK_STATUS, &Success);
+	return Success;
+}
+
+bool Shader::saveBinary() const {
+	GLint length = 0;
+	glGetProgramiv(shaderProg, GL_PROGRAM_BINARY_LENGTH, &length);
+	if(length <= 0) return false;
+
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(shaderProg, length, &length, &format, binary.data());
+
+	std::error_code error;
+	std::filesystem::create_directories(cacheDirectory, error);
+
+	// Write to a temporary file and then move it into place so a half written file is never read
+	std::string path = cachePath(), temporaryPath = path + ".tmp";
+	{
+		std::ofstream fout(temporaryPath, std::ios::binary);
+		if(!fout) return false;
+
+		uint32_t version = SHADER_CACHE_VERSION, size = length;
+		uint64_t key = cacheKey();
+		fout.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+		fout.write((char*) &version, sizeof(version));
+		fout.write((char*) &key, sizeof(key));
+		fout.write((char*) &format, sizeof(format));
+		fout.write((char*) &size, sizeof(size));
+		fout.write(binary.data(), size);
+
+		if(!fout) return false;
+	}
+
+	std::filesystem::rename(temporaryPath, path, error);
+	return !error;
+}
@@ -1,100 +1,242 @@
 #include "sound.h"
+#include <algorithm>
 #include <iostream>
 
 #define MINIAUDIO_IMPLEMENTATION
 #include "../thirdparty/miniaudio.h"
 
-void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+SoundEffect::SoundEffect(const char* filePath, bool streamed): streamed(streamed) {
+	// Everything is converted to the mixer's format when it is decoded
+	ma_decoder_config config = ma_decoder_config_init(ma_format_f32, SOUND_CHANNELS, SOUND_SAMPLE_RATE);
 
-SoundEffect::SoundEffect(const char* filePath) {
-	//Decoder reads in file
-	userData.decoder = new ma_decoder();
-	ma_result result = ma_decoder_init_file(filePath, NULL, userData.decoder);
-	if(result != MA_SUCCESS) {
+	if(streamed) {
+		//Decoder reads in file as it plays
+		decoder = new ma_decoder();
+		if(ma_decoder_init_file(filePath, &config, decoder) != MA_SUCCESS) {
+			std::cout << "ERROR INITIALIZING SOUND: " << filePath << std::endl;
+			delete decoder;
+			decoder = nullptr;
+		}
+		return;
+	}
+
+	// Short effects are decoded once so playing them is just a copy
+	ma_uint64 frameCount;
+	void* frames;
+	if(ma_decode_file(filePath, &config, &frameCount, &frames) != MA_SUCCESS) {
 		std::cout << "ERROR INITIALIZING SOUND: " << filePath << std::endl;
 		return;
 	}
-	//There are the default settings
-	config = ma_device_config_init(ma_device_type_playback);
-	config.playback.format	  = userData.decoder->outputFormat;
-	config.playback.channels = userData.decoder->outputChannels;
-	config.sampleRate		  = userData.decoder->outputSampleRate;
-	config.dataCallback	  = data_callback;
-	config.pUserData		  = &userData;
-	//Device controls starting and stopping
-	device = new ma_device();
-	if (ma_device_init(NULL, &config, device) != MA_SUCCESS) {
-		std::cout << "Failed to open playback device for " << filePath << std::endl;
-		ma_decoder_uninit(userData.decoder);
+	samples.assign((float*) frames, (float*) frames + frameCount * SOUND_CHANNELS);
+	ma_free(frames, NULL);
+}
+
+SoundEffect::~SoundEffect() {
+	if(decoder) {
+		ma_decoder_uninit(decoder);
+		delete decoder;
 	}
 }
 
-//Declare new sounds here and add them to the map. That's all you have to do.
+//Declare new sounds here. That's all you have to do.
 Sound::Sound() {
-	// soundEffects["Music"] = new SoundEffect("../sound/switch-me-on.mp3");
-	// soundEffects["Charging"] = new SoundEffect("../sound/mixkit-arcade-rising-231.wav");
-	// soundEffects["Bounce"] = new SoundEffect("../sound/mixkit-arcade-bonus-alert-767.wav");
-	// soundEffects["LoseBall"] = new SoundEffect("../sound/mixkit-retro-arcade-lose-2027.wav");
-	soundEffects["Music"] = new SoundEffect("../sounds/410574__yummie__game-background-music-loop-short.mp3");
-	soundEffects["Abducting"] = new SoundEffect("../sounds/505379__bloodpixelhero__alien-alarm.wav");
-	soundEffects["Score"] = new SoundEffect("../sounds/mixkit-retro-game-notification-212.wav");
-	soundEffects["Penalty"] = new SoundEffect("../sounds/mixkit-failure-arcade-alert-notification-240.wav");
+	// addEffect("Music", "../sound/switch-me-on.mp3", true);
+	// addEffect("Charging", "../sound/mixkit-arcade-rising-231.wav");
+	// addEffect("Bounce", "../sound/mixkit-arcade-bonus-alert-767.wav");
+	// addEffect("LoseBall", "../sound/mixkit-retro-arcade-lose-2027.wav");
+	addEffect("Music", "../sounds/410574__yummie__game-background-music-loop-short.mp3", /*streamed*/ true);
+	addEffect("Abducting", "../sounds/505379__bloodpixelhero__alien-alarm.wav");
+	addEffect("Score", "../sounds/mixkit-retro-game-notification-212.wav");
+	addEffect("Penalty", "../sounds/mixkit-failure-arcade-alert-notification-240.wav");
+
+	// One device plays everything
+	ma_device_config config = ma_device_config_init(ma_device_type_playback);
+	config.playback.format   = ma_format_f32;
+	config.playback.channels = SOUND_CHANNELS;
+	config.sampleRate        = SOUND_SAMPLE_RATE;
+	config.dataCallback      = dataCallback;
+	config.pUserData         = this;
+	if(ma_device_init(NULL, &config, &device) != MA_SUCCESS) {
+		std::cout << "Failed to open playback device" << std::endl;
+		return;
+	}
+	deviceInitialized = true;
+
+	if(ma_device_start(&device) != MA_SUCCESS)
+		std::cout << "Failed to start playback device" << std::endl;
 }
 
 Sound::~Sound() {
-	//Decoders and devices must be uninitialized
-	for(auto iter = soundEffects.begin(); iter != soundEffects.end(); iter++) {
-		SoundEffect *effect = iter->second;
-		stopSound(iter->first);
-		ma_device_uninit(effect->getDevice());
-		ma_decoder_uninit(effect->getDecoder());
+	// Stopping the device waits for the audio thread, after that the effects can be freed
+	if(deviceInitialized)
+		ma_device_uninit(&device);
+	for(SoundEffect* effect: soundEffects)
+		delete effect;
+}
+
+void Sound::addEffect(std::string key, const char* filePath, bool streamed) {
+	SoundEffect* effect = new SoundEffect(filePath, streamed);
+	if(!effect->isValid()) {
+		delete effect;
+		return;
 	}
+
+	effectIndices[key] = soundEffects.size();
+	soundEffects.push_back(effect);
 }
 
 void Sound::startSound(std::string key, bool fromBeginning, bool looping) {
-	SoundEffect* effect = soundEffects[key];
-	// If the effect is already playing and we aren't starting it over... abort!
-	if(effect->isPlaying && !fromBeginning)
-		return;
+	auto found = effectIndices.find(key);
+	if(found == effectIndices.end()) return;
 
-	//Starting a sound that's already started crashes the program
-	if(ma_device_is_started(effect->getDevice())) {
-		ma_device_stop(effect->getDevice());
-	}
-	//Reset playback position if desired
-	if(fromBeginning) ma_decoder_seek_to_pcm_frame(effect->getDecoder(), 0);
-	// Mark if the sound should loop or not
-	effect->setLooping(looping);
-	//Uninitialize if it fails to start, something must be wrong
-	if(ma_device_start(effect->getDevice()) != MA_SUCCESS) {
-		ma_device_uninit(effect->getDevice());
-		ma_decoder_uninit(effect->getDecoder());
-	// If it starts then mark the effect as playing
-	} else
-		effect->isPlaying = true;
+	send({Command::Start, found->second, fromBeginning, looping, std::chrono::steady_clock::now()});
 }
 
 void Sound::stopSound(std::string key) {
-	SoundEffect* effect = soundEffects[key];
-	ma_device_stop(effect->getDevice());
-	// Mark the effect as no longer playing
-	effect->isPlaying = false;
+	auto found = effectIndices.find(key);
+	if(found == effectIndices.end()) return;
+
+	send({Command::Stop, found->second, false, false, std::chrono::steady_clock::now()});
 }
 
 void Sound::stopAllSounds() {
-	for(auto iter = soundEffects.begin(); iter != soundEffects.end(); iter++) {
-		stopSound(iter->first);
+	send({Command::StopAll, 0, false, false, std::chrono::steady_clock::now()});
+}
+
+Sound::Stats Sound::getStats() const {
+	return {averageLatency, maxLatency, load, activeVoices, droppedCommands};
+}
+
+void Sound::send(const Command& command) {
+	if(!commands.push(command))
+		droppedCommands++;
+}
+
+void Sound::apply(const Command& command) {
+	switch(command.type) {
+	case Command::Start: {
+		SoundEffect* effect = soundEffects[command.effect];
+		Voice* playing = nullptr;
+		for(auto& voice: voices)
+			if(voice.effect == command.effect)
+				playing = &voice;
+
+		// If the effect is already playing and we aren't starting it over... abort!
+		if(playing && !command.fromBeginning) return;
+
+		// One-shots get a voice of their own so overlapping triggers don't cut each other off,
+		// while looping (and streamed) sounds only ever play once and are restarted instead
+		Voice* voice = playing && (command.looping || effect->streamed) ? playing : allocateVoice();
+		voice->effect = command.effect;
+		voice->cursor = 0;
+		voice->looping = command.looping;
+		voice->started = voicesStarted++;
+		if(effect->streamed) ma_decoder_seek_to_pcm_frame(effect->decoder, 0);
+		break;
 	}
+	case Command::Stop:
+		for(auto& voice: voices)
+			if(voice.effect == command.effect)
+				voice.effect = -1;
+		break;
+	case Command::StopAll:
+		for(auto& voice: voices)
+			voice.effect = -1;
+		break;
+	}
+}
+
+Sound::Voice* Sound::allocateVoice() {
+	for(auto& voice: voices)
+		if(voice.effect < 0)
+			return &voice;
+
+	// Every voice is busy, steal the oldest one-shot (or the oldest voice if everything is looping)
+	Voice* oldest = nullptr;
+	for(auto& voice: voices)
+		if(!voice.looping && (!oldest || voice.started < oldest->started))
+			oldest = &voice;
+	if(oldest) return oldest;
+	return &*std::min_element(voices.begin(), voices.end(), [](const Voice& a, const Voice& b) { return a.started < b.started; });
 }
 
-// Callback function which provides more audio data to a sound device when it runs out
-void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
-    SoundEffect::UserData* data = (SoundEffect::UserData*)pDevice->pUserData;
-    if (data == NULL)
-        return;
+bool Sound::mixVoice(Voice& voice, float* output, ma_uint32 frameCount) {
+	SoundEffect* effect = soundEffects[voice.effect];
+
+	if(effect->streamed) {
+		// Decode the sound a chunk at a time and add it in
+		for(ma_uint32 mixed = 0; mixed < frameCount; ) {
+			ma_uint64 read = 0;
+			ma_uint32 chunk = std::min<ma_uint32>(frameCount - mixed, SOUND_STREAM_CHUNK);
+			ma_data_source_read_pcm_frames(effect->decoder, streamBuffer.data(), chunk, &read, voice.looping ? MA_TRUE : MA_FALSE);
+			for(size_t i = 0; i < read * SOUND_CHANNELS; i++)
+				output[mixed * SOUND_CHANNELS + i] += streamBuffer[i];
+
+			mixed += read;
+			if(read < chunk) return false;
+		}
+		return true;
+	}
+
+	// Add the decoded samples straight from memory (wrapping around if looping)
+	uint64_t length = effect->samples.size() / SOUND_CHANNELS;
+	for(ma_uint32 mixed = 0; mixed < frameCount; ) {
+		if(voice.cursor >= length) {
+			if(!voice.looping) return false;
+			voice.cursor = 0;
+		}
+
+		ma_uint32 count = std::min<uint64_t>(frameCount - mixed, length - voice.cursor);
+		const float* source = effect->samples.data() + voice.cursor * SOUND_CHANNELS;
+		float* destination = output + mixed * SOUND_CHANNELS;
+		for(size_t i = 0; i < count * SOUND_CHANNELS; i++)
+			destination[i] += source[i];
+
+		voice.cursor += count;
+		mixed += count;
+	}
+	return true;
+}
+
+void Sound::mix(float* output, ma_uint32 frameCount) {
+	auto start = std::chrono::steady_clock::now();
+
+	// Apply every command which has arrived, measuring how long until they are heard (the time they waited in the queue, plus the time to play out what the device has already buffered)
+	float buffered = 1000.0f * device.playback.internalPeriodSizeInFrames * device.playback.internalPeriods / device.playback.internalSampleRate;
+	Command command;
+	while(commands.pop(command)) {
+		apply(command);
+		if(command.type != Command::Start) continue;
+
+		float latency = std::chrono::duration<float, std::milli>(start - command.issued).count() + buffered;
+		averageLatency = averageLatency ? averageLatency * .9f + latency * .1f : latency;
+		maxLatency = std::max<float>(maxLatency, latency);
+	}
+
+	// The output starts silent (the device clears it), every playing voice is added in
+	uint32_t active = 0;
+	for(auto& voice: voices) {
+		if(voice.effect < 0) continue;
+
+		if(mixVoice(voice, output, frameCount)) active++;
+		else voice.effect = -1;
+	}
+	for(size_t i = 0; i < frameCount * SOUND_CHANNELS; i++)
+		output[i] = std::clamp(output[i], -1.0f, 1.0f);
+	activeVoices = active;
+
+	// Compare the time spent mixing to the time the mixed audio lasts
+	float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+	load = load * .95f + elapsed / (frameCount / (float) SOUND_SAMPLE_RATE) * .05f;
+}
+
+// Callback function which provides more audio data to the sound device when it runs out
+void Sound::dataCallback(ma_device* device, void* output, const void* input, ma_uint32 frameCount) {
+	Sound* sound = (Sound*) device->pUserData;
+	if(sound == NULL)
+		return;
 
-    // A decoder is a data source which means you can seamlessly plug it into the ma_data_source API. We can therefore take advantage of the "loop" parameter of ma_data_source_read_pcframes() to handle looping for us.
-    ma_data_source_read_pcm_frames(data->decoder, pOutput, frameCount, NULL, (data->looping ? MA_TRUE : MA_FALSE));
+	sound->mix((float*) output, frameCount);
 
-    (void)pInput;
+	(void)input;
 }
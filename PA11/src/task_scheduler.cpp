@@ -0,0 +1,173 @@
+#include "task_scheduler.h"
+#include "scratch_arena.h"
+
+#include <iostream>
+
+TaskScheduler::TaskScheduler(int radius, size_t workerCount /*= hardware_concurrency - 1*/) : workerQueue(radius), mainThreadQueue(radius) {
+	// Start the worker threads, each one sleeps while there isn't any work in the queue
+	for(size_t i = 0; i < workerCount; i++)
+		workers.emplace_back([this](){
+			while(shouldWorkersRun){
+				if(auto task = workerQueue.pop()){
+					run(*task);
+					continue;
+				}
+
+				std::unique_lock lock(workerMutex);
+				workerCondition.wait(lock, [this]{ return !shouldWorkersRun || !workerQueue.empty(); });
+			}
+		});
+}
+
+void TaskScheduler::addDependency(const Task::ptr& task, const Task::ptr& dependency) {
+	if(!dependency) return;
+
+	std::scoped_lock lock(dependency->mutex);
+	// If the dependency has already finished there is nothing to wait on
+	if(dependency->finished) return;
+
+	task->unresolvedDependencies++;
+	dependency->dependents.push_back(task);
+}
+
+void TaskScheduler::submit(const Task::ptr& task) {
+	// Release the submission hold, if nothing else is holding the task it is ready to run
+	if(--task->unresolvedDependencies == 0)
+		enqueue(task);
+}
+
+TaskScheduler::Task::ptr TaskScheduler::schedule(Affinity affinity, std::function<void()> function, std::optional<glm::ivec2> chunkCoordinates /*= {}*/, std::initializer_list<Task::ptr> dependencies /*= {}*/) {
+	auto task = createTask(affinity, std::move(function), chunkCoordinates);
+	for(auto& dependency: dependencies)
+		addDependency(task, dependency);
+	submit(task);
+
+	return task;
+}
+
+size_t TaskScheduler::drainMainThread(std::chrono::microseconds budget) {
+	auto start = std::chrono::steady_clock::now();
+
+	size_t count = 0;
+	do {
+		auto task = mainThreadQueue.pop();
+		if(!task) break;
+
+		run(*task);
+		count++;
+	} while(std::chrono::steady_clock::now() - start < budget);
+
+	return count;
+}
+
+void TaskScheduler::stop() {
+	{
+		std::scoped_lock lock(workerMutex);
+		shouldWorkersRun = false;
+	}
+	workerCondition.notify_all();
+
+	for(auto& worker: workers)
+		if(worker.joinable())
+			worker.join();
+	workers.clear();
+}
+
+void TaskScheduler::enqueue(Task::ptr task) {
+	auto& queue = task->affinity == Affinity::MainThread ? mainThreadQueue : workerQueue;
+	if(task->chunkCoordinates) queue.push(task, *task->chunkCoordinates);
+	else queue.pushUrgent(task);
+
+	// Wake up a worker (taking the lock ensures a worker can't miss the wakeup between checking the queue and going to sleep)
+	if(task->affinity == Affinity::Worker) {
+		{ std::scoped_lock lock(workerMutex); }
+		workerCondition.notify_one();
+	}
+}
+
+void TaskScheduler::run(const Task::ptr& task) {
+	if(task->function) {
+		// Anything the task allocated from its thread's scratch arena is released once it finishes
+		ScratchArena::Scope scratch;
+		task->function();
+	}
+	// Release anything the task captured (tasks are often referenced by the objects they capture)
+	task->function = nullptr;
+
+	// Mark the task as finished and grab the tasks waiting on it
+	std::vector<Task::ptr> dependents;
+	{
+		std::scoped_lock lock(task->mutex);
+		task->finished = true;
+		dependents = std::move(task->dependents);
+	}
+
+	// Any dependents which were only waiting on this task are now ready
+	for(auto& dependent: dependents)
+		if(--dependent->unresolvedDependencies == 0)
+			enqueue(dependent);
+}
+
+void TaskScheduler::benchmark(int radius, size_t crossings, size_t pushesPerCrossing) {
+	using clock = std::chrono::steady_clock;
+	auto microseconds = [](clock::duration elapsed) { return std::chrono::duration<double, std::micro>(elapsed).count(); };
+
+	// Both queues see the same work, flying in a straight line: they start with a square of work (pushesPerCrossing chunks wide) around the
+	// focus, then every crossing pushes work for the row of chunks entering the front of that square, moves the focus, and pops as much as was pushed
+	auto simulate = [&](auto push, auto refocus, auto pop) {
+		int half = pushesPerCrossing / 2;
+		glm::ivec2 focus = {0, 0};
+		size_t checksum = 0;
+		for(int x = -half; x < (int) pushesPerCrossing - half; x++)
+			for(int z = -half; z < (int) pushesPerCrossing - half; z++)
+				push({x, z});
+
+		auto start = clock::now();
+		for(size_t crossing = 0; crossing < crossings; crossing++) {
+			for(int z = -half; z < (int) pushesPerCrossing - half; z++)
+				push(focus + glm::ivec2(pushesPerCrossing - half, z));
+			focus.x++;
+			refocus(focus);
+			for(size_t i = 0; i < pushesPerCrossing; i++)
+				checksum += pop();
+		}
+		return std::make_pair(microseconds(clock::now() - start) / crossings, checksum);
+	};
+
+	ChunkWorkQueue<size_t> buckets(radius);
+	size_t id = 0;
+	auto [bucketTime, bucketChecksum] = simulate(
+		[&](glm::ivec2 chunk) { buckets.push(id++, chunk); },
+		[&](glm::ivec2 focus) { buckets.setFocus(focus); },
+		[&]() { return buckets.pop().value_or(0); });
+
+	// The heap's priorities are distances from the focus, so every one of them has to be found again (and the heap rebuilt) when the focus moves
+	struct Ready {
+		int priority;
+		size_t id;
+		glm::ivec2 chunk;
+		bool operator<(const Ready& other) const { return priority != other.priority ? priority > other.priority : id > other.id; }
+	};
+	std::vector<Ready> heap;
+	glm::ivec2 heapFocus = {0, 0};
+	auto distance = [&](glm::ivec2 chunk) { glm::ivec2 offset = chunk - heapFocus; return offset.x * offset.x + offset.y * offset.y; };
+	id = 0;
+	auto [heapTime, heapChecksum] = simulate(
+		[&](glm::ivec2 chunk) { heap.push_back({distance(chunk), id++, chunk}); std::push_heap(heap.begin(), heap.end()); },
+		[&](glm::ivec2 focus) {
+			heapFocus = focus;
+			for(auto& ready: heap) ready.priority = distance(ready.chunk);
+			std::make_heap(heap.begin(), heap.end());
+		},
+		[&]() {
+			std::pop_heap(heap.begin(), heap.end());
+			size_t popped = heap.back().id;
+			heap.pop_back();
+			return popped;
+		});
+
+	std::cout << "Chunk work queue benchmark (radius " << radius << ", " << crossings << " chunk crossings, " << pushesPerCrossing << " pushes and pops each, "
+		<< buckets.size() << " items left queued):" << std::endl
+		<< "\tRing buckets: " << bucketTime << "us per crossing (checksum " << bucketChecksum << ")" << std::endl
+		<< "\tRe-sorted heap: " << heapTime << "us per crossing (checksum " << heapChecksum << ")" << std::endl;
+}
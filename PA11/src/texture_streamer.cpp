@@ -0,0 +1,161 @@
+#include "texture_streamer.h"
+#include "memory_tracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "stb_image.h"
+
+std::mutex TextureStreamer::mutex;
+std::unordered_map<std::string, StreamedTexture::ptr> TextureStreamer::textures;
+std::vector<TextureStreamer::Decode> TextureStreamer::decoding;
+std::deque<TextureStreamer::Upload> TextureStreamer::uploads;
+GLuint TextureStreamer::pixelBuffer = 0;
+
+StreamedTexture::ptr TextureStreamer::request(const std::string& path) {
+	std::scoped_lock lock(mutex);
+	if(auto found = textures.find(path); found != textures.end())
+		return found->second;
+
+	// Decode the image on a worker thread
+	auto texture = std::make_shared<StreamedTexture>();
+	textures.emplace(path, texture);
+	decoding.push_back({texture, path, std::async(std::launch::async, decode, path)});
+	return texture;
+}
+
+StreamedTexture::ptr TextureStreamer::load(const std::string& path) {
+	auto texture = request(path);
+	if(texture->isResident()) return texture;
+
+	// Take the texture out of the decode queue (if it is still being decoded)
+	std::future<std::optional<Image>> decoded;
+	{
+		std::scoped_lock lock(mutex);
+		auto found = std::find_if(decoding.begin(), decoding.end(), [&texture](const Decode& decode){ return decode.texture == texture; });
+		if(found != decoding.end()) {
+			decoded = std::move(found->image);
+			decoding.erase(found);
+		}
+	}
+
+	// Otherwise it is waiting in (or partially through) the upload queue
+	Upload upload;
+	if(decoded.valid()) {
+		auto image = decoded.get();
+		if(!image) return nullptr;
+		upload = {texture, std::move(*image)};
+	} else {
+		auto queued = std::find_if(uploads.begin(), uploads.end(), [&texture](const Upload& upload){ return upload.texture == texture; });
+		if(queued == uploads.end()) return nullptr; // Decoding failed
+		upload = std::move(*queued);
+		uploads.erase(queued);
+	}
+
+	// Upload the rest of the texture right now
+	if(upload.level == 0 && upload.row == 0) allocate(*texture, upload.image);
+	while(!uploadStep(upload));
+	return texture;
+}
+
+void TextureStreamer::pump(std::chrono::steady_clock::duration budget) {
+	auto start = std::chrono::steady_clock::now();
+
+	// Move the textures which have finished decoding into the upload queue
+	{
+		std::scoped_lock lock(mutex);
+		for(auto it = decoding.begin(); it != decoding.end(); )
+			if(it->image.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+				if(auto image = it->image.get())
+					uploads.push_back({it->texture, std::move(*image)});
+				else std::cerr << "Failed to load image `" << it->path << "`" << std::endl;
+				it = decoding.erase(it);
+			} else it++;
+	}
+
+	// Upload a few rows at a time until we run out of time for this frame
+	while(!uploads.empty() && std::chrono::steady_clock::now() - start < budget) {
+		auto& upload = uploads.front();
+		if(upload.level == 0 && upload.row == 0) allocate(*upload.texture, upload.image);
+		if(uploadStep(upload)) uploads.pop_front();
+	}
+}
+
+std::optional<TextureStreamer::Image> TextureStreamer::decode(const std::string& path) {
+	// The decoded image is charged to textures until it has been uploaded
+	MemoryTracker::Scope tag(MemoryTracker::Textures);
+
+	// Load the image
+	int width, height, channelsPresent;
+	unsigned char* img = stbi_load(path.c_str(), &width, &height, &channelsPresent, /*RGBA*/ 4);
+	if(img == nullptr) return {};
+
+	Image image;
+	image.levels.push_back({width, height, std::vector<uint8_t>(img, img + width * height * 4)});
+	stbi_image_free(img);
+
+	// Build the mip chain (each level is a box filter of the one above it)
+	while(image.levels.back().width > 1 || image.levels.back().height > 1) {
+		const auto& above = image.levels.back();
+		Image::Level level = {std::max(above.width / 2, 1), std::max(above.height / 2, 1)};
+		level.pixels.resize(level.width * level.height * 4);
+
+		for(int y = 0; y < level.height; y++)
+			for(int x = 0; x < level.width; x++)
+				for(int c = 0; c < 4; c++) {
+					auto sample = [&above, c](int x, int y) { return above.pixels[(std::min(y, above.height - 1) * above.width + std::min(x, above.width - 1)) * 4 + c]; };
+					int sum = sample(x * 2, y * 2) + sample(x * 2 + 1, y * 2) + sample(x * 2, y * 2 + 1) + sample(x * 2 + 1, y * 2 + 1);
+					level.pixels[(y * level.width + x) * 4 + c] = (sum + 2) / 4;
+				}
+
+		image.levels.push_back(std::move(level));
+	}
+
+	return image;
+}
+
+void TextureStreamer::allocate(StreamedTexture& texture, const Image& image) {
+	glGenTextures(1, &texture.id);
+	glBindTexture(GL_TEXTURE_2D, texture.id);
+	size_t bytes = 0;
+	for(size_t i = 0; i < image.levels.size(); i++) {
+		glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, image.levels[i].width, image.levels[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		bytes += image.levels[i].pixels.size();
+	}
+	MemoryTracker::gpuAllocated(MemoryTracker::GpuTextures, bytes);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels.size() - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+bool TextureStreamer::uploadStep(Upload& upload) {
+	if(pixelBuffer == 0) glGenBuffers(1, &pixelBuffer);
+
+	auto& level = upload.image.levels[upload.level];
+	size_t rows = std::min<size_t>(TEXTURE_UPLOAD_ROWS, level.height - upload.row);
+	size_t bytes = rows * level.width * 4;
+
+	// Copy the rows into the pixel buffer (orphaning its old storage so we don't wait on the previous upload)
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+	if(void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT)) {
+		std::memcpy(mapped, level.pixels.data() + upload.row * level.width * 4, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	// Copy the rows from the pixel buffer into the texture
+	glBindTexture(GL_TEXTURE_2D, upload.texture->id);
+	glTexSubImage2D(GL_TEXTURE_2D, upload.level, 0, upload.row, level.width, rows, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// Move on to the next rows (or level)
+	upload.row += rows;
+	if(upload.row < level.height) return false;
+	upload.row = 0;
+	if(++upload.level < upload.image.levels.size()) return false;
+
+	// The whole texture has been uploaded
+	upload.texture->resident.store(true, std::memory_order_release);
+	return true;
+}
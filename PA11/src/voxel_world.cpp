@@ -1,218 +1,480 @@
 #include "voxel_world.h"
+#include "memory_tracker.h"
 
 // Macros for accessing glm::vec2s which represent points in x, z space
 #define X(variable) (variable).x
 #define Z(variable) (variable).y
 
-// Memory backing for the generation queue
-ModifiablePriorityQueue<std::pair<Chunk::ptr, glm::ivec2>, std::vector<std::pair<Chunk::ptr, glm::ivec2>>, VoxelWorld::MeshingSort> VoxelWorld::generationQueue;
+void VoxelWorld::initialize(glm::ivec2 playerChunk /*= {0, 0}*/){
+	this->playerChunk = playerChunk;
+	scheduler.setFocus(playerChunk);
 
-// Outer = X, Inner = Z
+	// Load the view radius from the config (if present)
+	if(auto config = args.getConfig(); config.contains("View Radius"))
+		radius = std::clamp(config["View Radius"].get<int>(), MIN_WORLD_RADIUS, MAX_WORLD_RADIUS);
 
-// Helper function which returns the top element of a queue, and pops it, all under a monitor's write locker 
-template<class Queue>
-auto topNPop(Queue& q){
-	auto lock = q.write_lock();
-	auto out = lock->top();
-	lock->pop();
+	// Chunks are loaded up to the prefetched rows past the radius, and the focus can lead the player by as many rows again
+	scheduler.setRadius(radius + PREFETCH_ROWS * 2);
 
-	return out;
-}
+	// Compile the voxel generator up front, instead of in the middle of the first chunk's generation
+	uint64_t generator = Chunk::loadVoxelGenerator(args);
 
-void VoxelWorld::initialize(glm::ivec2 playerChunk /*= {0, 0}*/){
-	this->playerChunk = playerChunk;
-	generationQueue.getCompare().playerChunk = &this->playerChunk;
-	meshingQueue->getCompare().playerChunk = &this->playerChunk;
-	collisionQueue->getCompare().playerChunk = &this->playerChunk;
-
-	for(int z = Z(playerChunk) - WORLD_RADIUS; z <= Z(playerChunk) + WORLD_RADIUS; z++){
-		auto chunks = generateChunksZ(args, X(playerChunk) - WORLD_RADIUS, z);
-		for(int x = 0; x < chunks.size(); x++){
-			auto& chunk = chunks[x];
-			chunk->setPosition({(CHUNK_WIDTH - 1) * (x + X(playerChunk) - WORLD_RADIUS), -CHUNK_HEIGHT / 2, (CHUNK_WIDTH - 1) * (z + Z(playerChunk))});
-		}
+	// Open the chunk store now that the arguments have been parsed (chunks generated by another seed or generator are stale)
+	store.initialize(args.getResourcePath() + "cache/regions/", NOISE_SEED, generator);
 
-		AddPosZ(chunks);
+	// Load the models shared by every tree
+	static const char* treeModelFiles[TREE_MODEL_COUNT] = {"tree1.obj", "tree2.obj"};
+	for(size_t i = 0; i < TREE_MODEL_COUNT; i++){
+		treeModels[i] = std::make_shared<Object>();
+		treeModels[i]->initializeGraphics(args, treeModelFiles[i]);
 	}
 
+	updateLoadedChunks();
+}
+
+VoxelWorld::~VoxelWorld(){
+	scheduler.stop();
 
-	// Stop the meshing thread of already started
-	if(meshingThread.joinable()){
-		shouldMeshingThreadRun = false;
-		meshingThread.join();
-	}
+	// Write back the edits which haven't been stored yet (the loaded chunks, and freed chunks whose write back never got to run)
+	for(auto& [coordinates, chunk]: chunks)
+		saveEdits(coordinates, *chunk);
+	for(auto& [coordinates, writeBack]: writeBacks)
+		if(!writeBack.task->isFinished())
+			saveEdits(coordinates, *writeBack.chunk);
 
-	// Resort generation queue so generation happens around the player
-	std::sort(generationQueue.getContainer().begin(), generationQueue.getContainer().end(), generationQueue.getCompare());
+	// Remove the tree colliders from the physics world
+	auto world = Physics::getSingleton().getWorld().write_lock();
+	for(auto& [cell, proxy]: treeProxies)
+		world->removeRigidBody(proxy.body.get());
+}
 
-	// Start a new meshing thread which just meshes chunks while there are chunks to be meshed
-	meshingThread = std::thread([this](){
-		while(shouldMeshingThreadRun){
-			// If there are chunks which need meshes generated for them... generate a mesh for one
-			if(!meshingQueue.unsafe().empty()){
-				auto nextMesh = topNPop(meshingQueue);
-				if(nextMesh->state == Chunk::GenerateState::Freed) continue; // Ignore anything that has already been freed
+void VoxelWorld::update(float dt){
+	for(auto& [coordinates, chunk]: chunks)
+		chunk->update(dt);
+	countPopIns();
+	updateTreeProxies();
 
-				nextMesh->rebuildMesh(args);
-				nextMesh->generateTrees(args);
+	// Run the chunk tasks which need the OpenGL context (voxel generation and gpu uploads) until we run out of time for this frame
+	scheduler.drainMainThread(std::chrono::milliseconds(CHUNK_MAIN_THREAD_BUDGET));
+}
 
-				if(nextMesh->state == Chunk::GenerateState::Freed) continue; // Ignore anything that has already been freed
-				nextMesh->state = Chunk::GenerateState::Meshed;
+// Function which queues the (load) -> generate -> mesh -> upload -> collide pipeline for a chunk
+void VoxelWorld::scheduleChunk(Chunk::ptr chunk, glm::ivec2 chunkCoordinates){
+	using Affinity = TaskScheduler::Affinity;
+	chunk->requestTime = std::chrono::steady_clock::now();
 
-				// Upload the meshed data to the gpu
-				uploadQueue.push(nextMesh);
-				// Prep the mesh for collisions
-				collisionQueue->push(nextMesh);
+	// If the chunk was edited before it was last freed, its edits have to be written back before it is loaded
+	TaskScheduler::Task::ptr writeBack = nullptr;
+	if(auto found = writeBacks.find(chunkCoordinates); found != writeBacks.end()){
+		writeBack = found->second.task;
+		writeBacks.erase(found);
+	}
 
-			// If there aren't chunks to generate... sleep for 5 milliseconds
-			} else std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	// If the chunk has been generated before, copy it out of the store instead of generating it again
+	TaskScheduler::Task::ptr load = nullptr;
+	if(store.contains(chunkCoordinates))
+		load = scheduler.schedule(Affinity::Worker, [this, chunk, chunkCoordinates](){
+			if(chunk->state == Chunk::GenerateState::Freed) return; // Ignore anything that has already been freed
+			if(!store.load(chunkCoordinates, *chunk)) return; // If loading failed fall back to generating the chunk
+
+			if(chunk->state != Chunk::GenerateState::Freed) chunk->state = Chunk::GenerateState::Meshed;
+		}, chunkCoordinates, {writeBack});
+
+	// Generate the chunk's voxel data (the compute shader needs the OpenGL context)
+	auto generate = scheduler.schedule(Affinity::MainThread, [this, chunk, chunkCoordinates](){
+		if(chunk->state != Chunk::GenerateState::NotStarted) return; // Ignore anything that has already been freed (or was loaded)
+
+		auto start = std::chrono::steady_clock::now();
+		chunk->generateVoxels(args, X(chunkCoordinates), Z(chunkCoordinates));
+		chunk->generateTime = std::chrono::steady_clock::now() - start;
+
+		if(chunk->state != Chunk::GenerateState::Freed) chunk->state = Chunk::GenerateState::Generated;
+	}, chunkCoordinates, {load});
+
+	// Mesh the chunk
+	auto mesh = scheduler.schedule(Affinity::Worker, [this, chunk, chunkCoordinates](){
+		if(chunk->state != Chunk::GenerateState::Generated) return; // Ignore anything that has already been freed (or was loaded)
+
+		auto start = std::chrono::steady_clock::now();
+		size_t allocations = MemoryTracker::getHeapAllocations();
+		chunk->rebuildMesh(args);
+		meshAllocationMeasurements->push_back(MemoryTracker::getHeapAllocations() - allocations);
+		chunk->generateTime += std::chrono::steady_clock::now() - start;
+
+		// Save the chunk so we don't need to generate it again
+		store.save(chunkCoordinates, *chunk);
+		store.recordGeneration(std::chrono::duration<float, std::milli>(chunk->generateTime).count());
+
+		if(chunk->state != Chunk::GenerateState::Freed) chunk->state = Chunk::GenerateState::Meshed;
+	}, chunkCoordinates, {generate});
+
+	// Scatter the chunk's trees (only needs the voxels, so it runs alongside meshing)
+	auto scatter = scheduler.schedule(Affinity::Worker, [chunk, chunkCoordinates](){
+		if(chunk->state == Chunk::GenerateState::Freed) return; // Ignore anything that has already been freed
+
+		chunk->scatterTrees(chunkCoordinates);
+	}, chunkCoordinates, {generate});
+
+	// Upload the meshed data to the gpu
+	auto upload = scheduler.schedule(Affinity::MainThread, [this, chunk](){
+		if(chunk->state == Chunk::GenerateState::Freed) return; // Ignore anything that has already been freed
+
+		chunk->uploadMesh();
+		chunk->loadTextureFile(args, args.getResourcePath() + "textures/invalid.png");
+
+		if(chunk->state != Chunk::GenerateState::Freed) chunk->state = Chunk::GenerateState::Finalized;
+	}, chunkCoordinates, {mesh, scatter});
+
+	// Generate the chunk's collision mesh
+	chunk->collideTask = scheduler.schedule(Affinity::Worker, [this, chunk](){
+		if(chunk->state == Chunk::GenerateState::Freed) return; // Ignore anything that has already been freed
+		if(chunk->isPhysicsInitalized()) return; // Ignore anything that already has collisions
+
+		chunk->initializePhysics(args, Physics::getSingleton(), CollisionGroups::CG_ENVIRONMENT, 1'000'000, false);
+		size_t allocations = MemoryTracker::getHeapAllocations();
+		chunk->createMeshCollider(args, Physics::getSingleton(), CONCAVE_MESH);
+		colliderAllocationMeasurements->push_back(MemoryTracker::getHeapAllocations() - allocations);
+		chunk->makeStatic();
+		chunk->addToPhysicsWorld(Physics::getSingleton(), CollisionGroups::CG_ENVIRONMENT);
+
+		// Record how long it took the chunk to become collidable
+		float latency = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - chunk->requestTime).count();
+		chunkLatencyMeasurements->push_back(latency);
+	}, chunkCoordinates, {upload});
+}
+
+// Function which queues an edit on every chunk it overlaps
+void VoxelWorld::modifyDensity(const Chunk::DensityEdit& edit){
+	using Affinity = TaskScheduler::Affinity;
+
+	// Chunks share their border voxels with their neighbors, so a chunk is affected if its voxels (one wider than its spacing) overlap the edit
+	auto firstChunk = [](float min){ return (int) std::ceil((min - (CHUNK_WIDTH - 1)) / (CHUNK_WIDTH - 1)); };
+	auto lastChunk = [](float max){ return (int) std::floor(max / (CHUNK_WIDTH - 1)); };
+	for(int x = firstChunk(edit.min.x); x <= lastChunk(edit.max.x); x++)
+		for(int z = firstChunk(edit.min.z); z <= lastChunk(edit.max.z); z++){
+			// Sample the middle of the chunk (getChunk rounds exact multiples of the chunk width on the negative side into the wrong chunk)
+			auto chunk = getChunk(glm::ivec2{x, z} * (CHUNK_WIDTH - 1) + (CHUNK_WIDTH - 1) / 2);
+			// Only chunks which have finished generating can be edited
+			if(!chunk || chunk->state != Chunk::GenerateState::Finalized) continue;
+
+			// Edits are batched, a chunk only needs a task for the first of them
+			if(!chunk->queueEdit(edit)) continue;
+			scheduler.schedule(Affinity::Worker, [this, chunk](){
+				chunk->applyQueuedEdits();
+
+				// Upload the changed sections
+				scheduler.schedule(Affinity::MainThread, [chunk](){
+					if(chunk->state == Chunk::GenerateState::Freed) return; // Ignore anything that has already been freed
+					chunk->uploadMesh();
+				});
+			});
 		}
-	});
+}
 
-	// Start a new collision thread which just generates colliders for chunks while there are chunks without colliders
-	collisionThread = std::thread([this](){
-		while(shouldCollisionThreadRun){
-			// If there are chunks which need colliders generated for them... generate a collider for one
-			if(!collisionQueue.unsafe().empty()){
-				auto nextMesh = topNPop(collisionQueue);
-				if(nextMesh->state == Chunk::GenerateState::Freed) continue; // Ignore anything that has already been freed
+// Function which writes a chunk's edits (applying any still queued) back to the store, so they aren't lost when the chunk is loaded again
+void VoxelWorld::saveEdits(glm::ivec2 chunkCoordinates, Chunk& chunk){
+	chunk.applyQueuedEdits();
+	if(chunk.unsavedEdits.exchange(false))
+		store.save(chunkCoordinates, chunk);
+}
 
-				// Sleep until the mesh has been uploaded to the gpu (or freed)
-				while( !(nextMesh->state == Chunk::GenerateState::Finalized || nextMesh->state == Chunk::GenerateState::Freed) )
-					std::this_thread::sleep_for(std::chrono::milliseconds(5));
+// Function which runs the provided function on the main thread once the chunk containing the given position is collidable
+void VoxelWorld::whenCollidable(glm::ivec2 worldPos, std::function<void()> callback){
+	auto chunk = getChunk(worldPos);
+	// If the chunk isn't loaded there is nothing to wait for
+	if(!chunk) return;
 
-				if(nextMesh->state == Chunk::GenerateState::Freed) continue; // Ignore anything that has already been freed
+	scheduler.schedule(TaskScheduler::Affinity::MainThread, callback, {}, {chunk->collideTask});
+}
 
-				// Wait a moment
-				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+// Function which returns the average time (in milliseconds) it has recently taken for chunks to go from requested to collidable
+float VoxelWorld::getAverageChunkLatency(){
+	return average(chunkLatencyMeasurements);
+}
 
-				if(nextMesh->state == Chunk::GenerateState::Freed) continue; // Ignore anything that has already been freed
-				if(nextMesh->isPhysicsInitalized()) continue; // Ignore anything that already has collisions
+// Function which averages a set of recent measurements
+float VoxelWorld::average(monitor<circular_buffer_array<float, 60>>& measurementsMonitor){
+	auto measurements = measurementsMonitor.read_lock();
+	if(measurements->empty()) return 0;
 
-				// Generate the chunk's collision mesh
-				nextMesh->initializePhysics(args, Physics::getSingleton(), CollisionGroups::CG_ENVIRONMENT, 1'000'000, false);
-				nextMesh->createMeshCollider(args, Physics::getSingleton(), CONCAVE_MESH);
-				nextMesh->makeStatic();
-				nextMesh->addToPhysicsWorld(Physics::getSingleton(), CollisionGroups::CG_ENVIRONMENT);
+	// Sum all of the recent measurements
+	float accumulator = 0;
+	for(float f: *measurements)
+		accumulator += f;
 
-			// If there aren't colliders to generate... sleep for 5 milliseconds
-			} else std::this_thread::sleep_for(std::chrono::milliseconds(5));
-		}
-	});
+	// Return the sum divided by the number of measurements taken
+	return accumulator / measurements->size();
+}
 
+void VoxelWorld::render(Shader* boundShader, glm::vec3 viewPosition){
+	updateDrawOrder(viewPosition);
+	for(Chunk* chunk: drawOrder)
+		chunk->render(boundShader);
+	renderTrees(boundShader);
+}
 
+void VoxelWorld::submit(RenderQueue& queue, glm::vec3 viewPosition){
+	updateDrawOrder(viewPosition);
+	for(Chunk* chunk: drawOrder)
+		chunk->submit(queue);
+	submitTrees(queue);
 }
 
-void VoxelWorld::update(float dt){
-    for(auto& row: chunks)
-        for(auto& chunk: row)
-            chunk->update(dt);
+// Function which resorts the chunks if the view has moved to another chunk (or chunks have been loaded or freed)
+void VoxelWorld::updateDrawOrder(glm::vec3 viewPosition){
+	glm::ivec2 viewChunk = glm::floor(glm::vec2(viewPosition.x, viewPosition.z) / float(CHUNK_WIDTH - 1));
+	if(drawOrderDirty || viewChunk != drawOrderOrigin)
+		sortDrawOrder(viewChunk);
+}
 
-	// If there are chunks which need their data generated... generate one
-	if(!generationQueue.empty()){
-		auto& nextGeneration = generationQueue.top();
-		generationQueue.pop();
-		if(nextGeneration.first->state != Chunk::GenerateState::Freed){ // Ignore anything that has already been freed
+// Function which sorts the chunks by their distance from the chunk the view is in
+void VoxelWorld::sortDrawOrder(glm::ivec2 viewChunk){
+	std::vector<std::pair<int, Chunk*>> sorted;
+	sorted.reserve(chunks.size());
+	for(auto& [coordinates, chunk]: chunks){
+		glm::ivec2 offset = coordinates - viewChunk;
+		sorted.emplace_back(offset.x * offset.x + offset.y * offset.y, chunk.get());
+	}
+	std::sort(sorted.begin(), sorted.end(), [](auto& a, auto& b){ return a.first < b.first; });
 
-			nextGeneration.first->generateVoxels(args, nextGeneration.second.x, nextGeneration.second.y);
+	drawOrder.clear();
+	for(auto& [distance, chunk]: sorted)
+		drawOrder.push_back(chunk);
+	drawOrderOrigin = viewChunk;
+	drawOrderDirty = false;
+}
 
-			if(nextGeneration.first->state != Chunk::GenerateState::Freed){ // Ignore anything that has already been freed
-				nextGeneration.first->state = Chunk::GenerateState::Generated;
+// Function which draws every tree in the finalized chunks (front to back, along with the chunks)
+void VoxelWorld::renderTrees(Shader* boundShader){
+	for(Chunk* chunk: drawOrder){
+		if(chunk->state != Chunk::GenerateState::Finalized) continue;
 
-				// Add this chunk to the meshing queue
-				meshingQueue->push(nextGeneration.first);
-			}
+		for(auto& tree: chunk->trees){
+			auto& model = treeModels[tree.model];
+			model->setModel(glm::rotate(glm::translate(glm::mat4(1), tree.position), tree.rotation, glm::vec3(0, 1, 0)));
+			model->update(0); // Make sure any submeshes follow
+			model->render(boundShader);
 		}
 	}
+}
 
-	// If there are meshed chunks which need to be uploaded to the gpu... upload them
-	while(!uploadQueue.empty()){
-		auto nextMesh = uploadQueue.front();
-		uploadQueue.pop();
-		if(nextMesh->state == Chunk::GenerateState::Freed) continue; // Ignore anything that has already been freed
-
-		// Upload the model to the gpu
-		nextMesh->finalizeModel(); // TODO: Do we need to clear the current model?
-		nextMesh->loadTextureFile(args, args.getResourcePath() + "textures/invalid.png");
-
-		// if(nextMesh->getChildren().size() > 0) {
-		// 	Object::ptr firstChild = nextMesh->getChildren().front();
-		// 	firstChild->loadTextureFile(args, args.getResourcePath() + "textures/texturemap.png");
-		// 	for(auto& child : nextMesh->getChildren()) {
-		// 		child->linkTexture(firstChild);
-		// 	}
-		// }
-
-		if(nextMesh->state == Chunk::GenerateState::Freed) continue; // Ignore anything that has already been freed
-		nextMesh->state = Chunk::GenerateState::Finalized;
+// Function which submits every tree in the finalized chunks (each tree's model matrix is captured by the queue, so the models can be reused)
+void VoxelWorld::submitTrees(RenderQueue& queue){
+	for(Chunk* chunk: drawOrder){
+		if(chunk->state != Chunk::GenerateState::Finalized) continue;
+
+		for(auto& tree: chunk->trees){
+			auto& model = treeModels[tree.model];
+			model->setModel(glm::rotate(glm::translate(glm::mat4(1), tree.position), tree.rotation, glm::vec3(0, 1, 0)));
+			model->update(0); // Make sure any submeshes follow
+			model->submit(queue);
+		}
 	}
 }
 
-void VoxelWorld::render(Shader* boundShader){
-    for(auto& row: chunks){
-        for(auto& chunk: row){
-            chunk->render(boundShader);
-        }
-    }
+// Function which gives the trees near dynamic bodies colliders (and removes the colliders from trees which are no longer near any)
+void VoxelWorld::updateTreeProxies(){
+	// Find where the dynamic bodies are
+	std::vector<glm::vec3> bodies;
+	{
+		auto world = Physics::getSingleton().getWorld().read_lock();
+		auto& objects = world->getCollisionObjectArray();
+		for(int i = 0; i < objects.size(); i++)
+			if(!objects[i]->isStaticOrKinematicObject())
+				bodies.push_back(toGLM(objects[i]->getWorldTransform().getOrigin()));
+	}
+
+	for(auto& [cell, proxy]: treeProxies)
+		proxy.used = false;
+
+	auto world = Physics::getSingleton().getWorld().write_lock();
+
+	// Create colliders for the trees near each body (the proxy distance is less than a chunk, so only the neighboring chunks need to be checked)
+	for(glm::vec3 body: bodies){
+		glm::ivec2 bodyChunk = glm::floor(glm::vec2(body.x, body.z) / float(CHUNK_WIDTH - 1));
+		for(int x = -1; x <= 1; x++)
+			for(int z = -1; z <= 1; z++){
+				auto found = chunks.find(bodyChunk + glm::ivec2(x, z));
+				if(found == chunks.end() || found->second->state != Chunk::GenerateState::Finalized) continue;
+
+				for(auto& tree: found->second->trees){
+					if(glm::length2(glm::vec2(tree.position.x - body.x, tree.position.z - body.z)) > TREE_PROXY_DISTANCE * TREE_PROXY_DISTANCE) continue;
+
+					// Trees are never closer than the minimum distance, so the cell a tree is in identifies it
+					auto& proxy = treeProxies[glm::ivec2(glm::floor(glm::vec2(tree.position.x, tree.position.z)))];
+					proxy.used = true;
+					if(proxy.body && proxy.position == tree.position) continue;
+
+					// Edits place trees again, so a tree may have moved since its collider was made (trees which are gone lose theirs below)
+					if(proxy.body) world->removeRigidBody(proxy.body.get());
+					proxy.position = tree.position;
+					proxy.body = std::make_unique<btRigidBody>(0, nullptr, &treeProxyShape);
+					proxy.body->setWorldTransform(btTransform(btQuaternion::getIdentity(), toBullet(tree.position + glm::vec3(0, TREE_TRUNK_HEIGHT / 2.0, 0))));
+					world->addRigidBody(proxy.body.get(), CollisionGroups::CG_VEGETATION, CollisionGroups::CG_ALL);
+				}
+			}
+	}
+
+	// Remove the colliders which are no longer near any body
+	for(auto it = treeProxies.begin(); it != treeProxies.end(); )
+		if(!it->second.used){
+			world->removeRigidBody(it->second.body.get());
+			it = treeProxies.erase(it);
+		} else it++;
 }
 
 
-void VoxelWorld::stepPlayerPosX(){
-	auto chunks = generateChunksX(args, X(playerChunk) + WORLD_RADIUS, Z(playerChunk) - WORLD_RADIUS);
-	for(int z = 0; z < chunks.size(); z++){
-		auto& chunk = chunks[z];
-		chunk->setPosition({(CHUNK_WIDTH - 1) * (X(playerChunk) + WORLD_RADIUS), -CHUNK_HEIGHT / 2, (CHUNK_WIDTH - 1) * (z + Z(playerChunk) - WORLD_RADIUS)});
+void VoxelWorld::stepPlayerPosX(){ stepPlayer({1, 0}); }
+void VoxelWorld::stepPlayerNegX(){ stepPlayer({-1, 0}); }
+void VoxelWorld::stepPlayerPosZ(){ stepPlayer({0, 1}); }
+void VoxelWorld::stepPlayerNegZ(){ stepPlayer({0, -1}); }
+
+// Function which moves the player by the given number of chunks
+void VoxelWorld::stepPlayer(glm::ivec2 step){
+	playerChunk += step;
+	scheduler.setFocus(playerChunk + focusLead);
+	updateLoadedChunks();
+}
+
+// Function which tells the world how the player is moving and looking (in world space), chunks in the cone ahead of them are prefetched and prioritized
+void VoxelWorld::setPlayerMotion(glm::vec3 velocity, glm::vec3 lookDirection){
+	glm::vec2 look = {lookDirection.x, lookDirection.z};
+	this->lookDirection = glm::length2(look) > 0 ? glm::normalize(look) : glm::vec2(0);
+	if(!prefetching) return;
+
+	glm::vec2 travel = {velocity.x, velocity.z};
+	float speed = glm::length(travel);
+
+	glm::vec2 direction = {0, 0};
+	glm::ivec2 lead = {0, 0};
+	if(speed > PREFETCH_MIN_SPEED){
+		// Blend the direction of travel with where the camera is looking, and snap it to one of a few directions
+		glm::vec2 blended = travel / speed + this->lookDirection * float(PREFETCH_LOOK_WEIGHT);
+		if(glm::length2(blended) > 0){
+			float step = glm::two_pi<float>() / PREFETCH_DIRECTIONS;
+			float angle = std::round(std::atan2(Z(blended), X(blended)) / step) * step;
+			direction = {std::cos(angle), std::sin(angle)};
+
+			// Lead the scheduler's focus by however far the player will travel in the lookahead (but never past the prefetched rows)
+			float distance = std::min<float>(speed * PREFETCH_LOOKAHEAD / (CHUNK_WIDTH - 1), PREFETCH_ROWS);
+			lead = glm::ivec2(glm::round(direction * distance));
+		}
 	}
 
-	// Resort generation queue so generation happens around the player
-	std::sort(generationQueue.getContainer().begin(), generationQueue.getContainer().end(), generationQueue.getCompare());
+	// Chunks ahead are now closer to the focus than chunks behind, so they are worked on first
+	if(lead != focusLead){
+		focusLead = lead;
+		scheduler.setFocus(playerChunk + focusLead);
+	}
 
-	AddPosX(chunks);
-	X(playerChunk)++;
+	// Request the chunks in the new cone (and free the ones which were only loaded for the old one)
+	if(direction != travelDirection){
+		travelDirection = direction;
+		updateLoadedChunks();
+	}
 }
 
-void VoxelWorld::stepPlayerNegX(){
-	X(playerChunk)--;
+// Functions which enable or disable the velocity aware prefetching
+void VoxelWorld::setPrefetching(bool prefetching){
+	this->prefetching = prefetching;
+	if(prefetching) return;
 
-	auto chunks = generateChunksX(args, X(playerChunk) - WORLD_RADIUS, Z(playerChunk) - WORLD_RADIUS);
-	for(int z = 0; z < chunks.size(); z++){
-		auto& chunk = chunks[z];
-		chunk->setPosition({(CHUNK_WIDTH - 1) * (X(playerChunk) - WORLD_RADIUS), -CHUNK_HEIGHT / 2, (CHUNK_WIDTH - 1) * (z + Z(playerChunk) - WORLD_RADIUS)});
-	}
+	travelDirection = {0, 0};
+	focusLead = {0, 0};
+	scheduler.setFocus(playerChunk);
+	updateLoadedChunks();
+}
 
-	// Resort generation queue so generation happens around the player
-	std::sort(generationQueue.getContainer().begin(), generationQueue.getContainer().end(), generationQueue.getCompare());
+// Function which checks if an offset from the player's chunk is inside of the prefetch cone
+bool VoxelWorld::inPrefetchCone(glm::ivec2 offset) const {
+	if(travelDirection == glm::vec2(0)) return false;
 
-	AddNegX(chunks);
+	float distance = glm::length(glm::vec2(offset));
+	if(distance == 0 || distance > radius + PREFETCH_ROWS) return false;
+	return glm::dot(glm::vec2(offset) / distance, travelDirection) >= PREFETCH_CONE_COS;
 }
 
-void VoxelWorld::stepPlayerPosZ(){
-	auto chunks = generateChunksZ(args, X(playerChunk) - WORLD_RADIUS, Z(playerChunk) + WORLD_RADIUS);
-	for(int x = 0; x < chunks.size(); x++){
-		auto& chunk = chunks[x];
-		chunk->setPosition({(CHUNK_WIDTH - 1) * (x + X(playerChunk) - WORLD_RADIUS), -CHUNK_HEIGHT / 2, (CHUNK_WIDTH - 1) * (Z(playerChunk) + WORLD_RADIUS)});
-	}
+// Function which counts the visible chunks which haven't finished generating
+void VoxelWorld::countPopIns(){
+	for(auto& [coordinates, chunk]: chunks){
+		if(chunk->poppedIn || chunk->state == Chunk::GenerateState::Finalized) continue;
 
-	// Resort generation queue so generation happens around the player
-	std::sort(generationQueue.getContainer().begin(), generationQueue.getContainer().end(), generationQueue.getCompare());
+		// A chunk is visible if it is inside the render distance and in front of the camera
+		glm::vec2 offset = glm::vec2(coordinates - playerChunk);
+		if(glm::length2(offset) > radius * radius || glm::dot(offset, lookDirection) < 0) continue;
 
-	AddPosZ(chunks);
-	Z(playerChunk)++;
+		chunk->poppedIn = true;
+		popInCount++;
+	}
 }
 
-void VoxelWorld::stepPlayerNegZ(){
-	Z(playerChunk)--;
+// Functions which change how many chunks are loaded around the player, only the chunks entering or leaving the radius are touched
+void VoxelWorld::setRadius(int radius){
+	radius = std::clamp(radius, MIN_WORLD_RADIUS, MAX_WORLD_RADIUS);
+	if(radius == this->radius) return;
 
-	auto chunks = generateChunksZ(args, X(playerChunk) - WORLD_RADIUS, Z(playerChunk) - WORLD_RADIUS);
-	for(int x = 0; x < chunks.size(); x++){
-		auto& chunk = chunks[x];
-		chunk->setPosition({(CHUNK_WIDTH - 1) * (x + X(playerChunk) - WORLD_RADIUS), -CHUNK_HEIGHT / 2, (CHUNK_WIDTH - 1) * (Z(playerChunk) - WORLD_RADIUS)});
-	}
+	this->radius = radius;
+	scheduler.setRadius(radius + PREFETCH_ROWS * 2);
+	updateLoadedChunks();
+}
 
-	// Resort generation queue so generation happens around the player
-	std::sort(generationQueue.getContainer().begin(), generationQueue.getContainer().end(), generationQueue.getCompare());
+// Finalizer function which ensures that chunks are marked as freed when they are unloaded
+void finalizeChunk(Chunk::ptr& chunk){
+	chunk->state = Chunk::GenerateState::Freed;
+	// std::cout << "Freed chunk at " << glm::to_string(chunk->getPosition()) << std::endl;
+	chunk = nullptr;
+}
 
-	AddNegZ(chunks);
+// Function which frees the chunks outside of the square around the player (and the prefetch cone) and requests the chunks inside of them which aren't loaded
+// NOTE: Stepping the player only adds and frees one row of chunks, and changing the radius only adds or frees the rings between the two radii
+void VoxelWorld::updateLoadedChunks(){
+	auto outsideSquare = [this](glm::ivec2 offset){ return std::max(std::abs(X(offset)), std::abs(Z(offset))) > radius; };
+
+	// Forget the write backs which have finished
+	for(auto it = writeBacks.begin(); it != writeBacks.end(); )
+		if(it->second.task->isFinished()) it = writeBacks.erase(it);
+		else it++;
+
+	// Free the chunks which are now outside of the square (and not being prefetched), writing back the ones which have been edited
+	for(auto it = chunks.begin(); it != chunks.end(); )
+		if(glm::ivec2 offset = it->first - playerChunk; outsideSquare(offset) && !inPrefetchCone(offset)){
+			if(it->second->hasUnsavedEdits()){
+				auto writeBack = scheduler.schedule(TaskScheduler::Affinity::Worker, [this, chunk = it->second, chunkCoordinates = it->first](){
+					saveEdits(chunkCoordinates, *chunk);
+				}, it->first);
+				writeBacks[it->first] = {it->second, writeBack};
+			}
+			finalizeChunk(it->second);
+			it = chunks.erase(it);
+			drawOrderDirty = true;
+		} else it++;
+
+	// Request the chunks which are now inside of it
+	for(int x = X(playerChunk) - radius; x <= X(playerChunk) + radius; x++)
+		for(int z = Z(playerChunk) - radius; z <= Z(playerChunk) + radius; z++)
+			if(chunks.find({x, z}) == chunks.end())
+				loadChunk({x, z});
+
+	// Prefetch the chunks past the edge of the square in the direction the player is traveling
+	if(travelDirection == glm::vec2(0)) return;
+	for(int x = -radius - PREFETCH_ROWS; x <= radius + PREFETCH_ROWS; x++)
+		for(int z = -radius - PREFETCH_ROWS; z <= radius + PREFETCH_ROWS; z++)
+			if(glm::ivec2 offset = {x, z}; outsideSquare(offset) && inPrefetchCone(offset) && chunks.find(playerChunk + offset) == chunks.end())
+				loadChunk(playerChunk + offset);
+}
+
+// Function which creates a chunk and schedules it to be generated
+void VoxelWorld::loadChunk(glm::ivec2 chunkCoordinates){
+	// The chunk is almost entirely its voxels, so it is charged to them
+	Chunk::ptr chunk;
+	{
+		MemoryTracker::Scope tag(MemoryTracker::Voxels);
+		chunk = std::make_shared<Chunk>();
+	}
+	chunk->setPosition({(CHUNK_WIDTH - 1) * X(chunkCoordinates), -CHUNK_HEIGHT / 2, (CHUNK_WIDTH - 1) * Z(chunkCoordinates)});
+	chunks.emplace(chunkCoordinates, chunk);
+	drawOrderDirty = true;
+	scheduleChunk(chunk, chunkCoordinates);
 }
 
 
@@ -221,15 +483,11 @@ Chunk::ptr VoxelWorld::getChunk(glm::ivec2 worldPos){
 	glm::ivec2 chunkPos = worldPos / (CHUNK_WIDTH - 1);	// Convert from world space to chunk space
 	if(X(worldPos) < 0) X(chunkPos)--;
 	if(Z(worldPos) < 0) Z(chunkPos)--;
-	chunkPos -= playerChunk;				// Make chunk position relative to the player's position
-
-	// If the requested chunk is currently outside of the loaded radius, return nullptr
-	if(glm::length2(glm::vec2(chunkPos)) > WORLD_RADIUS * WORLD_RADIUS)
-		return nullptr;
 
-	chunkPos = glm::ivec2(WORLD_RADIUS) - chunkPos;	// Normalize the coordinates into array indices
-
-	return chunks[X(chunkPos)][Z(chunkPos)];
+	// Any chunk which is loaded (the square around the player, or the prefetch cone) can be returned
+	auto found = chunks.find(chunkPos);
+	if(found == chunks.end()) return nullptr;
+	return found->second;
 }
 
 template<typename T, size_t size>
@@ -296,55 +554,47 @@ float VoxelWorld::getWorldHeight(glm::ivec2 worldPos){
 	return result->point.y;
 }
 
-
-// NOTE: Expects the last element of the array to be null
-void VoxelWorld::AddPosX(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks) {
-    for(int i = 0; i < chunks.size(); i++)
-        this->chunks[i].emplace_back(chunks[i]);
-}
-
-// NOTE: Expects the last element of the array to be null
-void VoxelWorld::AddNegX(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks) {
-    for(int i = 0; i < chunks.size(); i++)
-        this->chunks[i].emplace_front(chunks[i]);
+// Function which bilinearly samples a chunk's heightmap at a world position inside of the chunk
+static float sampleHeightmap(const Chunk::Heightmap& heights, glm::vec2 chunkPos, glm::vec2 worldPos){
+	// Chunks share their border columns, so the four columns around the position always belong to the same chunk
+	glm::vec2 local = worldPos - chunkPos * float(CHUNK_WIDTH - 1);
+	int x = std::min<int>(local.x, CHUNK_WIDTH - 2), z = std::min<int>(local.y, CHUNK_WIDTH - 2);
+	glm::vec2 t = local - glm::vec2(x, z);
+	return glm::mix(glm::mix(heights[x][z], heights[x + 1][z], t.x), glm::mix(heights[x][z + 1], heights[x + 1][z + 1], t.x), t.y);
 }
 
-std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1> VoxelWorld::generateChunksX(const Arguments& args, size_t X, size_t startZ) {
-    std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1> out;
-    for(int i = 0; i < WORLD_RADIUS * 2 + 1; i++){ // one less, we don't generate the null chunk
-        out[i] = std::make_shared<Chunk>();
-		generationQueue.emplace(out[i], glm::ivec2{X, startZ + i});
-	    // out[i]->generateVoxels(args, X, startZ + i);
-    }
+float VoxelWorld::getTerrainHeight(glm::vec2 worldPos) const {
+	glm::vec2 chunkPos = glm::floor(worldPos / float(CHUNK_WIDTH - 1));
+	auto found = chunks.find(glm::ivec2(chunkPos));
+	if(found == chunks.end() || found->second->state != Chunk::GenerateState::Finalized) return NAN;
 
-    return out;
+	return sampleHeightmap(found->second->heightmap, chunkPos, worldPos);
 }
 
+void VoxelWorld::snapshotTerrain(glm::ivec2 min, glm::ivec2 max, TerrainSnapshot& snapshot) const {
+	snapshot.heightmaps.clear();
+	auto copy = [&](glm::ivec2 coordinates, const Chunk::ptr& chunk){
+		if(chunk && chunk->state == Chunk::GenerateState::Finalized)
+			snapshot.heightmaps.emplace(coordinates, chunk->heightmap);
+	};
 
-// Finalizer function which ensures that all of the chunks are marked as freed when they are cycled out of the buffer
-void finalizeChunk(Chunk::ptr& chunk){
-	chunk->state = Chunk::GenerateState::Freed;
-	// std::cout << "Freed chunk at " << glm::to_string(chunk->getPosition()) << std::endl;
-	chunk = nullptr;
+	// Look up every chunk in the area, unless it covers more chunks than are loaded
+	glm::ivec2 area = max - min + 1;
+	if(X(area) > 0 && Z(area) > 0 && size_t(X(area)) * Z(area) <= chunks.size()){
+		for(int x = X(min); x <= X(max); x++)
+			for(int z = Z(min); z <= Z(max); z++)
+				if(auto found = chunks.find({x, z}); found != chunks.end())
+					copy(found->first, found->second);
+	} else for(auto& [coordinates, chunk]: chunks)
+		if(glm::all(glm::greaterThanEqual(coordinates, min)) && glm::all(glm::lessThanEqual(coordinates, max)))
+			copy(coordinates, chunk);
 }
 
-// NOTE: Expects the last element of the array to be null
-void VoxelWorld::AddPosZ(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks) {
-    this->chunks.emplace_back(chunks, finalizeChunk);
-}
+float VoxelWorld::TerrainSnapshot::getHeight(glm::vec2 worldPos) const {
+	glm::vec2 chunkPos = glm::floor(worldPos / float(CHUNK_WIDTH - 1));
+	auto found = heightmaps.find(glm::ivec2(chunkPos));
+	if(found == heightmaps.end()) return NAN;
 
-// NOTE: Expects the last element of the array to be null
-void VoxelWorld::AddNegZ(const std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1>& chunks) {
-    this->chunks.emplace_front(chunks, finalizeChunk);
+	return sampleHeightmap(found->second, chunkPos, worldPos);
 }
 
-std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1> VoxelWorld::generateChunksZ(const Arguments& args, size_t startX, size_t Z) {
-    std::array<Chunk::ptr, WORLD_RADIUS * 2 + 1> out;
-    for(int i = WORLD_RADIUS * 2; 0 <= i ; i--){ // one less, we don't generate the null chunk
-        out[i] = std::make_shared<Chunk>();
-		generationQueue.emplace(out[i], glm::ivec2{startX + i, Z});
-	    // out[i]->generateVoxels(args, startX + i, Z);
-    }
-
-    return out;
-}
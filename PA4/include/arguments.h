@@ -12,6 +12,9 @@ private:
 
 	std::string showcaseModelPath;
 
+	// Model to benchmark the OBJ parsers with (instead of running the program)
+	std::string benchmarkModelPath;
+
 	// Variable tracking whether or not we can continue
 	bool canContinue = true;
 public:
@@ -23,6 +26,7 @@ public:
 	std::string getFragmentFilePath() const { return fragmentFilePath; }
 
 	std::string getShowcaseModelPath() const { return showcaseModelPath; }
+	std::string getBenchmarkModelPath() const { return benchmarkModelPath; }
 
 	bool getCanContinue() const { return canContinue; }
 };
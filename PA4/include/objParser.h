@@ -0,0 +1,23 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <string>
+#include <vector>
+#include "graphics_headers.h"
+
+// Files are split into chunks of at least this many bytes, each parsed on a thread of its own (so small files are parsed on one thread)
+#define OBJ_PARSER_MIN_CHUNK_SIZE (1 << 20)
+// How many times the benchmark loads the file with each parser
+#define OBJ_BENCHMARK_RUNS 3
+
+// Parses the vertex positions (and optional vertex colors) and triangles of an OBJ file. The file is memory mapped and split at line
+// boundaries into chunks which are parsed in parallel, then merged (fixing up relative indices) into the vertices and 0 based indices
+bool ParseOBJFile(const std::string& path, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, glm::mat4 onImportTransformation = glm::mat4(1));
+
+// The original line by line parser (kept as a reference for the benchmark)
+bool ParseOBJFileStream(const std::string& path, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, glm::mat4 onImportTransformation = glm::mat4(1));
+
+// Loads the file with both parsers, printing how long each took and whether they agree
+void BenchmarkOBJParsers(const std::string& path);
+
+#endif /* OBJ_PARSER_H */
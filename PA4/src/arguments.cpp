@@ -25,6 +25,7 @@ Arguments::Arguments(int argc, char **argv){
 
 			std::cout << "Optional" << std::endl;
 			std::cout << "\t--resource-path <path> - Sets the resource directory, the directory" << std::endl << "\t\twhere all of the program's resources can be found. [default=../]" << std::endl;
+			std::cout << "\t--benchmark-obj <file> - Times loading the obj model with the line by line" << std::endl << "\t\tand memory mapped parsers instead of running" << std::endl;
 
 			std::cout << std::string(60, '-') << std::endl;
 			std::cout << "Keys" << std::endl;
@@ -81,8 +82,18 @@ Arguments::Arguments(int argc, char **argv){
 			i++;
 			resourcePath = argv[i];
 		}
+
+		// If the argument starts with "--benchmark-obj"
+		else if(arg.substr(0, 15) == "--benchmark-obj" && i + 1 < argc){
+			i++;
+			benchmarkModelPath = argv[i];
+		}
 	}
 
+	// Benchmarking doesn't need any shaders
+	if(!benchmarkModelPath.empty())
+		return;
+
 	// State that we can't continue if either the vertex or fragment shader isn't specified
 	canContinue = !vertexFilePath.empty() && !fragmentFilePath.empty() && !vertexFilePath.empty();
 
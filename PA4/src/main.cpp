@@ -2,11 +2,16 @@
 
 #include "engine.h"
 #include "arguments.h"
+#include "objParser.h"
 
 
 int main(int argc, char **argv) {
 	// Parse the command line arguments
 	Arguments args(argc, argv);
+	if(!args.getBenchmarkModelPath().empty()) {
+		BenchmarkOBJParsers(args.getBenchmarkModelPath());
+		return 0;
+	}
 	if(!args.getCanContinue()) return 1;
 
 	// Start an engine and run it then cleanup after
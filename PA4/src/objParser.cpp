@@ -0,0 +1,370 @@
+#include "objParser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	// Read only view of a whole file, mapped into memory (unmapped when destroyed)
+	struct MappedFile {
+		const char* data = nullptr;
+		size_t size = 0;
+		bool valid = false;
+
+		MappedFile(const std::string& path) {
+			int file = open(path.c_str(), O_RDONLY);
+			if(file < 0) return;
+
+			struct stat info;
+			if(fstat(file, &info) == 0) {
+				size = info.st_size;
+				// Mapping an empty file fails, but there is nothing to parse anyway
+				if(size == 0) valid = true;
+				else {
+					void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+					if(mapped != MAP_FAILED) {
+						// Every chunk is read from start to finish, so have the kernel start reading it all in now
+						madvise(mapped, size, MADV_WILLNEED);
+						data = (const char*) mapped;
+						valid = true;
+					}
+				}
+			}
+			close(file);
+		}
+		~MappedFile() { if(data) munmap((void*) data, size); }
+	};
+
+	// What is parsed out of a section of the file
+	struct Chunk {
+		const char* begin;
+		const char* end;
+
+		std::vector<Vertex> vertices;
+		// Indices are relative to the start of the chunk, the listed ones (written as negative indices) are also relative to the chunk's vertices
+		std::vector<unsigned int> indices;
+		std::vector<size_t> chunkRelative;
+		// The first line which couldn't be parsed (empty if there were none)
+		std::string error;
+	};
+
+	inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+	inline const char* skipSpace(const char* p, const char* end) {
+		while(p < end && isSpace(*p)) p++;
+		return p;
+	}
+
+	// Returns the position of the end of the line (the newline, or the end of the chunk)
+	inline const char* lineEnd(const char* p, const char* end) {
+		const char* newline = (const char*) memchr(p, '\n', end - p);
+		return newline ? newline : end;
+	}
+
+	// Reads a (possibly signed) integer, advancing past it
+	bool scanInt(const char*& p, const char* end, long& out) {
+		bool negative = false;
+		if(p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+		const char* digits = p;
+		long value = 0;
+		while(p < end && *p >= '0' && *p <= '9')
+			value = value * 10 + (*p++ - '0');
+		if(p == digits) return false;
+
+		out = negative ? -value : value;
+		return true;
+	}
+
+	// Reads a decimal float (with an optional exponent), advancing past it
+	bool scanFloat(const char*& p, const char* end, float& out) {
+		// Exact powers of ten (every power up to 22 can be represented by a double)
+		static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+		bool negative = false;
+		if(p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+		// Collect up to 19 significant digits into an integer (the rest only shift the exponent)
+		uint64_t mantissa = 0;
+		int exponent = 0, digits = 0, significant = 0;
+		for(; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+			if(significant < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if(mantissa) significant++;
+			} else exponent++;
+		if(p < end && *p == '.')
+			for(p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+				if(significant < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					if(mantissa) significant++;
+					exponent--;
+				}
+		if(!digits) return false;
+
+		if(p < end && (*p == 'e' || *p == 'E')) {
+			const char* start = p++;
+			long e;
+			if(scanInt(p, end, e)) exponent += e;
+			else p = start;
+		}
+
+		double value = mantissa;
+		if(exponent >= 0) value *= exponent <= 22 ? powers[exponent] : std::pow(10.0, exponent);
+		else value /= exponent >= -22 ? powers[-exponent] : std::pow(10.0, -exponent);
+
+		out = negative ? -value : value;
+		return true;
+	}
+
+	void parseChunk(Chunk& chunk, const glm::mat4& onImportTransformation) {
+		for(const char* p = chunk.begin; p < chunk.end; ) {
+			const char* line = skipSpace(p, chunk.end);
+			const char* end = lineEnd(line, chunk.end);
+			p = end + 1;
+
+			// Anything other than vertices and faces (including comments and empty lines) is ignored
+			if(end - line < 2 || !isSpace(line[1])) continue;
+			const char* s = line + 2;
+
+			// Parse the vertecies
+			if(line[0] == 'v') {
+				glm::vec3 pos;
+				if(!scanFloat(s = skipSpace(s, end), end, pos.x) || !scanFloat(s = skipSpace(s, end), end, pos.y) || !scanFloat(s = skipSpace(s, end), end, pos.z)) {
+					if(chunk.error.empty()) chunk.error = "Model vertex `" + std::string(line, end) + "` is missing its position!";
+					continue;
+				}
+
+				// Apply the import transformation to the position
+				pos = glm::vec3(onImportTransformation * glm::vec4(pos, 1));
+
+				// Parse the vertex color (may not be present, the missing components are zero)
+				glm::vec3 color(0);
+				for(int i = 0; i < 3 && scanFloat(s = skipSpace(s, end), end, color[i]); i++);
+
+				chunk.vertices.emplace_back(pos, color);
+
+			// Parse the indecies
+			} else if(line[0] == 'f') {
+				// We are assuming three indecies per face
+				for(int i = 0; i < 3; i++) {
+					long vert;
+					s = skipSpace(s, end);
+					// If we don't have at least three vertecies there is a problem with the file
+					if(s == end || !scanInt(s, end, vert) || vert == 0) {
+						if(chunk.error.empty()) chunk.error = "Model face `" + std::string(line, end) + "` contains too few vertecies!";
+						break;
+					}
+					// Skip the texture and normal
+					while(s < end && !isSpace(*s)) s++;
+
+					// If the vertex is negative... then it is based on the end of the vertex array instead of the beginning (-1 is the last vertex)
+					if(vert < 0) {
+						chunk.chunkRelative.push_back(chunk.indices.size());
+						vert += chunk.vertices.size() + 1;
+					}
+					// The index works at a 0th index
+					chunk.indices.push_back(vert - 1);
+				}
+
+				// If we have more than 3 vertecies there is a problem with file
+				if(skipSpace(s, end) != end && chunk.error.empty())
+					chunk.error = "Model face `" + std::string(line, end) + "` contains too many vertecies!";
+			}
+		}
+	}
+}
+
+bool ParseOBJFile(const std::string& path, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, glm::mat4 onImportTransformation) {
+	MappedFile file(path);
+	if(!file.valid) {
+		std::cerr << "Model `" << path << "` not found!" << std::endl;
+		return false; // If the file doesn't exist then there is an issue
+	}
+
+	// Split the file into a chunk per thread (as long as the chunks are big enough to be worth it), moving each split to the start of a line
+	size_t chunkCount = std::clamp<size_t>(file.size / OBJ_PARSER_MIN_CHUNK_SIZE, 1, std::max(std::thread::hardware_concurrency(), 1u));
+	std::vector<Chunk> chunks(chunkCount);
+	const char* fileEnd = file.data + file.size;
+	for(size_t i = 0; i < chunkCount; i++) {
+		chunks[i].begin = i ? chunks[i - 1].end : file.data;
+		chunks[i].end = i + 1 < chunkCount ? std::max(chunks[i].begin, file.data + file.size * (i + 1) / chunkCount) : fileEnd;
+		if(chunks[i].end < fileEnd) chunks[i].end = std::min(lineEnd(chunks[i].end, fileEnd) + 1, fileEnd);
+	}
+
+	// Parse every chunk (the first on this thread)
+	std::vector<std::thread> threads;
+	for(size_t i = 1; i < chunkCount; i++)
+		threads.emplace_back(parseChunk, std::ref(chunks[i]), std::cref(onImportTransformation));
+	parseChunk(chunks[0], onImportTransformation);
+	for(std::thread& thread: threads)
+		thread.join();
+
+	for(Chunk& chunk: chunks)
+		if(!chunk.error.empty()) {
+			std::cerr << chunk.error << std::endl;
+			return false;
+		}
+
+	// Merge the chunks, offsetting the relative indices by the vertices which came before their chunk
+	size_t vertexCount = vertices.size(), indexCount = indices.size();
+	for(Chunk& chunk: chunks) {
+		vertexCount += chunk.vertices.size();
+		indexCount += chunk.indices.size();
+	}
+	vertices.reserve(vertexCount);
+	indices.reserve(indexCount);
+
+	for(Chunk& chunk: chunks) {
+		for(size_t i: chunk.chunkRelative)
+			chunk.indices[i] += vertices.size();
+
+		vertices.insert(vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+		indices.insert(indices.end(), chunk.indices.begin(), chunk.indices.end());
+	}
+
+	return true;
+}
+
+bool ParseOBJFileStream(const std::string& path, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, glm::mat4 onImportTransformation) {
+	std::ifstream objFile(path);
+	if(!objFile){
+		std::cerr << "Model `" << path << "` not found!" << std::endl;
+		return false; // If the file doesn't exist then there is an issue
+	}
+
+	size_t firstIndex = indices.size();
+	std::string line;
+	while(objFile){
+		std::getline(objFile, line);
+		size_t lineStart = line.find_first_not_of(" \t\n\r");
+
+		// Variable unessicary characters can be read into
+		char trash;
+
+		// Ignore empty lines
+		if(line.empty())
+			continue;
+
+		// Ignore comment lines
+		if(line[lineStart] == '#')
+			continue;
+
+		// Parse the vertecies
+		if(line.substr(lineStart, lineStart + 2) == "v "){
+			std::stringstream s(line.substr(lineStart + 1));
+
+			// Parse the position
+			glm::vec3 pos;
+			s >> pos.x >> pos.y >> pos.z;
+
+			// Apply the import transformation to the position
+			glm::vec4 _pos;
+			_pos.x = pos.x; _pos.y = pos.y; _pos.z = pos.z; _pos.w = 1; // _pos = pos
+			_pos = onImportTransformation * _pos;
+			pos.x = _pos.x; pos.y = _pos.y; pos.z = _pos.z; // pos = _pos
+
+			// Parse the vertex color (may not be present so check that we are still good after each read, the missing components are zero)
+			glm::vec3 color(0);
+			if(s) s >> color.r;
+			if(s) s >> color.g;
+			if(s) s >> color.b;
+
+			vertices.emplace_back(pos, color);
+		}
+
+		// Parse the indecies
+		if(line.substr(lineStart, lineStart + 2) == "f "){
+			std::stringstream s(line.substr(lineStart + 1));
+
+			std::string part;
+			// We are assuming three indecies per face
+			for(int i = 0; i < 3; i++){
+				if(s) s >> part;
+				else {  // If we don't have at least three vertecies there is a problem with the file
+					std::cerr << "Model face `" << line << "` contains too few vertecies!" << std::endl;
+					return false;
+				}
+				std::stringstream partStream(part);
+
+				int vert, texture, normal;
+
+				partStream >> vert; // Vertex isn't optional
+				// Optional texture
+				if(partStream) partStream >> trash; // remove /
+				if(partStream) {
+					partStream >> trash;
+					// If there is a number in the middle, read it into texture
+					if(isdigit(trash) || trash == '-'){
+						partStream.putback(trash);
+						partStream >> texture;
+					// Otherwise there is no texture (vert//normal)
+					} else
+						partStream.putback(trash);
+				}
+				// Optional normal
+				if(partStream) partStream >> trash; // Remove /
+				if(partStream) partStream >> normal;
+
+				// If the vertex is negative... then it is based on the end of the vertex array instead of the beginning (-1 is the last vertex)
+				if(vert < 0) vert = vertices.size() + vert + 1;
+				// Same thing for texture and normal
+
+				indices.push_back(vert);
+			}
+
+			if(s) s >> part;
+			if(s) {	// If we have more than 3 vertecies there is a problem with file
+				std::cerr << "Model face `" << line << "` contains too many vertecies!" << std::endl;
+				return false;
+			}
+		}
+	}
+
+	// The index works at a 0th index
+	for(size_t i = firstIndex; i < indices.size(); i++)
+		indices[i] = indices[i] - 1;
+
+	return true;
+}
+
+void BenchmarkOBJParsers(const std::string& path) {
+	using Parser = bool (*)(const std::string&, std::vector<Vertex>&, std::vector<unsigned int>&, glm::mat4);
+
+	// Loads the file a few times, keeping the result of the last load and returning the fastest time
+	auto time = [&path](Parser parser, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) -> double {
+		double best = INFINITY;
+		for(int run = 0; run < OBJ_BENCHMARK_RUNS; run++) {
+			vertices.clear();
+			indices.clear();
+			auto start = std::chrono::steady_clock::now();
+			if(!parser(path, vertices, indices, glm::mat4(1))) return NAN;
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	};
+
+	std::vector<Vertex> streamVertices, mappedVertices;
+	std::vector<unsigned int> streamIndices, mappedIndices;
+	double streamTime = time(ParseOBJFileStream, streamVertices, streamIndices);
+	double mappedTime = time(ParseOBJFile, mappedVertices, mappedIndices);
+
+	// The parsers round decimals slightly differently, so positions only need to agree to within a tiny fraction
+	bool same = streamIndices == mappedIndices && streamVertices.size() == mappedVertices.size();
+	for(size_t i = 0; same && i < streamVertices.size(); i++)
+		same = glm::all(glm::lessThanEqual(glm::abs(streamVertices[i].vertex - mappedVertices[i].vertex), glm::abs(streamVertices[i].vertex) * 1e-6f + 1e-30f))
+			&& glm::all(glm::lessThanEqual(glm::abs(streamVertices[i].color - mappedVertices[i].color), glm::abs(streamVertices[i].color) * 1e-6f + 1e-30f));
+
+	std::cout << "Loaded `" << path << "` (" << mappedVertices.size() << " vertices, " << mappedIndices.size() / 3 << " faces), fastest of " << OBJ_BENCHMARK_RUNS << " runs:" << std::endl
+		<< "\tLine by line: " << streamTime << "ms" << std::endl
+		<< "\tMemory mapped (" << std::max(std::thread::hardware_concurrency(), 1u) << " threads): " << mappedTime << "ms" << std::endl
+		<< "\tResults " << (same ? "match" : "DIFFER") << std::endl;
+}
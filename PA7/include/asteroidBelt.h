@@ -0,0 +1,113 @@
+#ifndef ASTEROID_BELT_H
+#define ASTEROID_BELT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "object.h"
+
+// Bodies are solved on up to one thread per core, each thread solving at least this many bodies
+#define ASTEROID_MIN_BODIES_PER_THREAD 16384
+// Newton iterations per frame (they start from the previous frame's solution, so a couple is plenty)
+#define ASTEROID_KEPLER_ITERATIONS 2
+// Orbits are kept below this eccentricity (which keeps the solver and the scaled distances accurate)
+#define ASTEROID_MAX_ECCENTRICITY 0.5
+// Bodies covering more than this many pixels are drawn as meshes instead of imposters...
+#define ASTEROID_MESH_LOD_PIXELS 8
+// ... up to this many of them (the rest stay imposters)
+#define ASTEROID_MAX_MESH_BODIES 4096
+// Kilometers in an astronomical unit
+#define ASTEROID_AU_KM 149597870.7
+
+class Camera;
+class Shader;
+
+// Object representing a belt of small bodies (asteroids, kuiper belt objects...) generated from distributions of orbital elements.
+// The elements are stored as one array per element, every body's position is found by solving Kepler's equation in vectorized
+// loops split across threads, and the bodies are drawn as point imposters (or instanced meshes when they are close to the camera)
+class AsteroidBelt: public Object {
+public:
+	AsteroidBelt();
+	~AsteroidBelt();
+	// Generates the bodies, must be called after the below variables have been set
+	bool Initialize(const Arguments& args, Camera* camera);
+	void Update(unsigned int dt) override;
+	// Belts use their own shaders, so they are drawn with RenderBodies after the rest of the scene instead
+	void Render(GLint modelMatrix) override;
+	void RenderBodies();
+
+	// Statistics about the last update
+	size_t getMeshBodies() const { return meshInstances.size(); }
+	size_t getThreads() const { return threads; }
+	float getSolveTime() const { return solveTime; }
+
+	// Name of the belt
+	std::string name = "Belt";
+	// Number of bodies in the belt
+	size_t count = 10000;
+	// Seed of the random distributions (the same seed always generates the same belt)
+	unsigned int seed = 0;
+	// Range of the semi-major axes (uniform)
+	glm::vec2 semiMajorAxis = glm::vec2(3e8, 5e8);
+	// Mean and standard deviation of the eccentricities (normal)
+	glm::vec2 eccentricity = glm::vec2(.1, .05);
+	// Mean and standard deviation of the inclinations in degrees (normal)
+	glm::vec2 inclination = glm::vec2(0, 5);
+	// Range of the body radii (log uniform, so small bodies are far more common than large ones)
+	glm::vec2 radius = glm::vec2(1, 500);
+	// Semi-major axes which bodies are kept out of (the center and half width of each gap)
+	std::vector<glm::vec2> gaps;
+	// Mass of the body being orbited in solar masses (determines the orbit periods)
+	float centralMass = 1;
+	// Scene units per kilometer of body radius
+	float displayScale = .0005;
+	// Color of the bodies
+	glm::vec3 color = glm::vec3(.6, .55, .5);
+	// Number of pixels a body must cover to be drawn as a mesh
+	float meshLODPixels = ASTEROID_MESH_LOD_PIXELS;
+
+protected:
+	// An instance of the mesh, the seed gives each body its own shape and spin
+	struct MeshInstance {
+		glm::vec4 positionRadius;
+		float seed;
+	};
+
+	// Creates the lumpy icosphere the meshes are drawn with
+	void GenerateMesh();
+	// Solves the positions of a range of bodies, then picks the ones close enough to be drawn as meshes
+	void SolveRange(size_t thread, size_t begin, size_t end, float seconds, glm::vec3 eye);
+	template<bool Scaled>
+	void SolveOrbits(size_t begin, size_t end, float seconds);
+
+protected:
+	// Orbital elements, one array per element so the solver streams through each one
+	std::vector<float> meanAnomaly, eccentricAnomaly, meanMotion, eccentricities, minorAxisRatio, semiMajorAxes, scaledSemiMajorAxes;
+	// Orientation of each orbit, P points at the periapsis and Q a quarter orbit ahead of it
+	std::vector<float> px, py, pz, qx, qy, qz;
+	// Display radius of each body
+	std::vector<float> radii;
+	// Solved positions (every x, then every y, then every z, then the radius negated if the body is drawn as a mesh), uploaded as is
+	std::vector<float> positions;
+	GLuint positionsVB;
+
+	// Bodies to draw as meshes (found per thread, then gathered into the instances)
+	std::vector<std::vector<uint32_t>> nearBodies;
+	std::vector<MeshInstance> meshInstances;
+	GLuint instancesVB;
+
+	// Simulated time in seconds (spins the meshes)
+	float time = 0;
+	// Bodies whose radius over distance from the camera is above this ratio are drawn as meshes (found while rendering, none until then)
+	float meshLODRatio = INFINITY;
+	size_t threads = 1;
+	float solveTime = 0;
+
+	Camera* camera;
+	Shader* imposterShader = nullptr;
+	Shader* meshShader = nullptr;
+	GLint imposterProjectionMatrix, imposterViewMatrix, imposterModelMatrix, imposterPointScale, imposterColor;
+	GLint meshProjectionMatrix, meshViewMatrix, meshModelMatrix, meshTime, meshColor;
+};
+
+#endif /* end of include guard: ASTEROID_BELT_H */
@@ -15,6 +15,7 @@ using namespace std;
 // Forward declarations
 class Engine;
 class Celestial;
+class AsteroidBelt;
 class Skybox;
 class Camera;
 
@@ -32,6 +33,7 @@ public:
 	void Render();
 
 	GUI* getGUI() const { return m_gui; }
+	const vector<AsteroidBelt*>& getBelts() const { return belts; }
 	Celestial* getNextCelestial() { celestialIndex++; if (celestialIndex >= celestials.size()) celestialIndex = 0; return celestials[celestialIndex]; }
 
 private:
@@ -52,6 +54,9 @@ private:
 	vector<Celestial*> celestials;
 	int celestialIndex = 0;
 
+	// Belts of small bodies (owned by the scene tree, drawn after it)
+	vector<AsteroidBelt*> belts;
+
 };
 
 #endif /* GRAPHICS_H */
@@ -0,0 +1,16 @@
+#version 330
+
+// Load the normal and direction of the sun from the vertex file
+smooth in vec3 normal;
+smooth in vec3 sunDirection;
+// Color of the bodies
+uniform vec3 color;
+
+// We output a vec4 color
+out vec4 frag_color;
+
+void main(void) {
+  // Light the body from the sun
+  float light = 0.15 + 0.85 * max(dot(normalize(normal), normalize(sunDirection)), 0.0);
+  frag_color = vec4(color * light, 1.0);
+}
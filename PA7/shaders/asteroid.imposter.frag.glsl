@@ -0,0 +1,22 @@
+#version 330
+
+// Load the direction of the sun and the body's coverage from the vertex file
+in vec3 sunDirection;
+in float coverage;
+// Color of the bodies
+uniform vec3 color;
+
+// We output a vec4 color
+out vec4 frag_color;
+
+void main(void) {
+  // Treat the point as a sphere facing the camera, discarding the corners
+  vec2 p = gl_PointCoord * 2.0 - 1.0;
+  float d = dot(p, p);
+  if (d > 1.0) discard;
+  vec3 normal = vec3(p.x, -p.y, sqrt(1.0 - d));
+
+  // Light the sphere from the sun
+  float light = 0.15 + 0.85 * max(dot(normal, normalize(sunDirection)), 0.0);
+  frag_color = vec4(color * light * coverage, 1.0);
+}
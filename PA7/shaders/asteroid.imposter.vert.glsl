@@ -0,0 +1,39 @@
+#version 330
+
+// Load the position and radius of each body from the CPU (each is its own array)
+layout (location = 0) in float x;
+layout (location = 1) in float y;
+layout (location = 2) in float z;
+// A negative radius means the body is drawn as a mesh instead
+layout (location = 3) in float radius;
+// Load the MVP matricies from the CPU
+uniform mat4 projectionMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 modelMatrix;
+// Pixels covered by a unit radius at a distance of 1
+uniform float pointScale;
+
+// We output the direction of the sun (in view space) and how much of a pixel the body covers
+out vec3 sunDirection;
+out float coverage;
+
+void main(void) {
+  // Bodies drawn as meshes are moved outside of the screen
+  if (radius < 0) {
+    gl_Position = vec4(2, 2, 2, 1);
+    gl_PointSize = 1;
+    return;
+  }
+
+  vec4 world = modelMatrix * vec4(x, y, z, 1.0);
+  vec4 view = viewMatrix * world;
+  gl_Position = projectionMatrix * view;
+
+  // Size the point to cover the body, bodies smaller than a pixel are drawn as a dimmed pixel instead
+  float size = radius * pointScale / max(-view.z, 0.0001);
+  gl_PointSize = max(size, 1.0);
+  coverage = clamp(size, 0.2, 1.0);
+
+  // The sun is at the origin of the scene
+  sunDirection = mat3(viewMatrix) * -world.xyz;
+}
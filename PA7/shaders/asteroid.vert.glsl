@@ -0,0 +1,44 @@
+#version 330
+
+// Load the position and normal of the mesh from the CPU
+layout (location = 0) in vec3 v_position;
+layout (location = 1) in vec3 v_normal;
+// Load the position, radius, and seed of each instance
+layout (location = 3) in vec4 instance;
+layout (location = 4) in float seed;
+// Load the MVP matricies from the CPU
+uniform mat4 projectionMatrix;
+uniform mat4 viewMatrix;
+uniform mat4 modelMatrix;
+// Simulated time in seconds
+uniform float time;
+
+// We output the normal and direction of the sun
+smooth out vec3 normal;
+smooth out vec3 sunDirection;
+
+// Pseudo random numbers in [0, 1) from the seed
+vec3 random3(float s) {
+  return fract(sin(vec3(s * 12.9898, s * 78.233, s * 37.719)) * 43758.5453);
+}
+
+// Rotation about an axis
+mat3 rotation(vec3 axis, float angle) {
+  float s = sin(angle), c = cos(angle);
+  mat3 skew = mat3(0, axis.z, -axis.y, -axis.z, 0, axis.x, axis.y, -axis.x, 0);
+  return mat3(c) + s * skew + (1.0 - c) * outerProduct(axis, axis);
+}
+
+void main(void) {
+  // Each body is stretched differently and spins about its own axis
+  vec3 stretch = 0.6 + 0.8 * random3(seed);
+  vec3 axis = normalize(random3(seed + 1.0) * 2.0 - 1.0);
+  mat3 spin = rotation(axis, seed + time * (0.5 + random3(seed + 2.0).x));
+
+  vec4 world = modelMatrix * vec4(instance.xyz + spin * (v_position * stretch) * instance.w, 1.0);
+  gl_Position = projectionMatrix * viewMatrix * world;
+
+  // The sun is at the origin of the scene
+  normal = mat3(modelMatrix) * (spin * (v_normal / stretch));
+  sunDirection = -world.xyz;
+}
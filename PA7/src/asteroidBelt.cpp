@@ -0,0 +1,460 @@
+#include "asteroidBelt.h"
+
+#include "camera.h"
+#include "shader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#define TWO_PI 6.28318530717958647692f
+#define INV_TWO_PI 0.15915494309189533577f
+
+// Sine and cosine which (unlike std::sin and std::cos) the compiler can vectorize, accurate to about 1e-7 for |x| < 2pi
+static inline void FastSinCos(float x, float& s, float& c) {
+	// Reduce to [-pi, pi], then fold into [-pi/2, pi/2] (the folds are arithmetic rather than branches so the loops stay vectorizable)
+	float r = x - TWO_PI * (float) (int) (x * INV_TWO_PI + std::copysign(.5f, x));
+	float back = std::fabs(r) > glm::half_pi<float>();
+	r += back * (std::copysign(glm::pi<float>(), r) - 2 * r);
+
+	// Taylor series (plenty accurate over a quarter turn)
+	float r2 = r * r;
+	s = r * (1 + r2 * (-1.f / 6 + r2 * (1.f / 120 + r2 * (-1.f / 5040 + r2 * (1.f / 362880 + r2 * (-1.f / 39916800))))));
+	c = (1 - 2 * back) * (1 + r2 * (-.5f + r2 * (1.f / 24 + r2 * (-1.f / 720 + r2 * (1.f / 40320 + r2 * (-1.f / 3628800 + r2 * (1.f / 479001600)))))));
+}
+
+// Vectorizable log2 of values near 1 (accurate to about 1e-6 over [.5, 1.5])
+static inline float FastLog2NearOne(float x) {
+	float t = (x - 1) / (x + 1), t2 = t * t;
+	return 2.88539008f /* 2 / ln(2) */ * t * (1 + t2 * (1.f / 3 + t2 * (1.f / 5 + t2 * (1.f / 7 + t2 * (1.f / 9)))));
+}
+
+// Threads which every belt's bodies are solved on, started once and kept for the life of the program (starting threads every frame costs more
+// than solving a small belt). Run calls a function once per part on the waiting threads, the calling thread solves part 0 itself
+class SolverPool {
+public:
+	SolverPool() {
+		for(unsigned int i = 1; i < std::max(std::thread::hardware_concurrency(), 1u); i++)
+			workers.emplace_back(&SolverPool::Work, this, (size_t) i);
+	}
+	~SolverPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for(std::thread& worker: workers)
+			worker.join();
+	}
+
+	// Number of parts the work can be split into
+	size_t size() const { return workers.size() + 1; }
+
+	// Calls the function with every part below the count (which must be at most size), returning once they have all finished
+	void Run(size_t parts, const std::function<void(size_t)>& function) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &function;
+			jobParts = parts;
+			remaining = parts - 1;
+			generation++;
+		}
+		if(parts > 1) wake.notify_all();
+		function(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this] { return remaining == 0; });
+		job = nullptr;
+	}
+
+	static SolverPool& get() {
+		static SolverPool pool;
+		return pool;
+	}
+
+protected:
+	void Work(size_t part) {
+		size_t seen = 0;
+		std::unique_lock<std::mutex> lock(mutex);
+		while(true) {
+			wake.wait(lock, [&] { return stopping || generation != seen; });
+			if(stopping) return;
+			seen = generation;
+			if(part >= jobParts) continue;
+
+			// Run our part without holding the lock
+			const std::function<void(size_t)>* function = job;
+			lock.unlock();
+			(*function)(part);
+			lock.lock();
+			if(--remaining == 0) finished.notify_one();
+		}
+	}
+
+protected:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake, finished;
+	const std::function<void(size_t)>* job = nullptr;
+	size_t jobParts = 0, remaining = 0, generation = 0;
+	bool stopping = false;
+};
+
+// Loads a vertex and fragment shader into a program
+static Shader* LoadShaders(const Arguments& args, const std::string& vertexPath, const std::string& fragmentPath, bool& success) {
+	Shader* shader = new Shader();
+	success &= shader->Initialize();
+	success &= shader->AddShader(GL_VERTEX_SHADER, vertexPath, args);
+	success &= shader->AddShader(GL_FRAGMENT_SHADER, fragmentPath, args);
+	success &= shader->Finalize();
+	return shader;
+}
+
+AsteroidBelt::AsteroidBelt() {
+	// Create the buffers for the positions and mesh instances
+	glGenBuffers(1, &positionsVB);
+	glGenBuffers(1, &instancesVB);
+}
+
+AsteroidBelt::~AsteroidBelt() {
+	glDeleteBuffers(1, &positionsVB);
+	glDeleteBuffers(1, &instancesVB);
+	delete imposterShader;
+	delete meshShader;
+}
+
+bool AsteroidBelt::Initialize(const Arguments& args, Camera* camera) {
+	bool success = true;
+	this->camera = camera;
+
+	// Make room for every body
+	for(auto element: {&meanAnomaly, &eccentricAnomaly, &meanMotion, &eccentricities, &minorAxisRatio, &semiMajorAxes, &scaledSemiMajorAxes, &px, &py, &pz, &qx, &qy, &qz, &radii})
+		element->resize(count);
+	positions.resize(4 * count);
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> uniform(0, 1);
+	std::normal_distribution<float> eccentricityDistribution(eccentricity.x, eccentricity.y);
+	std::normal_distribution<float> inclinationDistribution(inclination.x, inclination.y);
+
+	for(size_t i = 0; i < count; i++) {
+		// Pick a semi-major axis outside of the gaps (giving up after a few tries, so gaps covering the whole belt can't hang us)
+		float a;
+		for(int attempt = 0; attempt < 16; attempt++) {
+			a = glm::mix(semiMajorAxis.x, semiMajorAxis.y, uniform(generator));
+			if(std::none_of(gaps.begin(), gaps.end(), [a](glm::vec2 gap) { return std::abs(a - gap.x) < gap.y; }))
+				break;
+		}
+		float e = glm::clamp(eccentricityDistribution(generator), 0.f, (float) ASTEROID_MAX_ECCENTRICITY);
+		float inclinationAngle = glm::radians(inclinationDistribution(generator));
+		float ascendingNode = uniform(generator) * TWO_PI;
+		float periapsisArgument = uniform(generator) * TWO_PI;
+
+		// The period comes from Kepler's third law (in years), a year takes a minute at a time scale of 1 (like the celestials)
+		double period = std::sqrt(std::pow(a / ASTEROID_AU_KM, 3) / centralMass);
+		meanMotion[i] = TWO_PI / (period * 60);
+		eccentricities[i] = e;
+		minorAxisRatio[i] = std::sqrt(1 - e * e);
+		// Distances are in the same units as Celestial::scaledOrbitDistance
+		semiMajorAxes[i] = a / 100000;
+		scaledSemiMajorAxes[i] = (std::log2(a) - 20) * 20;
+
+		// Orient the orbit (the orbital plane is xz, so the usual z axis is y here)
+		float cosNode = std::cos(ascendingNode), sinNode = std::sin(ascendingNode);
+		float cosPeriapsis = std::cos(periapsisArgument), sinPeriapsis = std::sin(periapsisArgument);
+		float cosInclination = std::cos(inclinationAngle), sinInclination = std::sin(inclinationAngle);
+		px[i] = cosNode * cosPeriapsis - sinNode * sinPeriapsis * cosInclination;
+		py[i] = sinPeriapsis * sinInclination;
+		pz[i] = sinNode * cosPeriapsis + cosNode * sinPeriapsis * cosInclination;
+		qx[i] = -cosNode * sinPeriapsis - sinNode * cosPeriapsis * cosInclination;
+		qy[i] = cosPeriapsis * sinInclination;
+		qz[i] = -sinNode * sinPeriapsis + cosNode * cosPeriapsis * cosInclination;
+
+		// Start somewhere random along the orbit, solving Kepler's equation precisely once (every frame after starts from this solution)
+		float M = uniform(generator) * TWO_PI, E = M;
+		for(int iteration = 0; iteration < 16; iteration++)
+			E -= (E - e * std::sin(E) - M) / (1 - e * std::cos(E));
+		meanAnomaly[i] = M;
+		eccentricAnomaly[i] = E;
+
+		radii[i] = std::exp(glm::mix(std::log(radius.x), std::log(radius.y), uniform(generator))) * displayScale;
+	}
+
+	// Create the mesh used for nearby bodies
+	GenerateMesh();
+
+	// Create the shaders (imposters for most bodies, instanced meshes for the nearby ones)
+	imposterShader = LoadShaders(args, "asteroid.imposter.vert.glsl", "asteroid.imposter.frag.glsl", success);
+	meshShader = LoadShaders(args, "asteroid.vert.glsl", "asteroid.frag.glsl", success);
+	if(!success) {
+		std::cerr << "Failed to create the shaders for belt `" << name << "`" << std::endl;
+		return false;
+	}
+
+	// Find the uniforms in the shaders
+	imposterProjectionMatrix = imposterShader->GetUniformLocation("projectionMatrix");
+	imposterViewMatrix = imposterShader->GetUniformLocation("viewMatrix");
+	imposterModelMatrix = imposterShader->GetUniformLocation("modelMatrix");
+	imposterPointScale = imposterShader->GetUniformLocation("pointScale");
+	imposterColor = imposterShader->GetUniformLocation("color");
+	meshProjectionMatrix = meshShader->GetUniformLocation("projectionMatrix");
+	meshViewMatrix = meshShader->GetUniformLocation("viewMatrix");
+	meshModelMatrix = meshShader->GetUniformLocation("modelMatrix");
+	meshTime = meshShader->GetUniformLocation("time");
+	meshColor = meshShader->GetUniformLocation("color");
+
+	return success;
+}
+
+void AsteroidBelt::GenerateMesh() {
+	// Start with an icosahedron
+	const float t = (1 + std::sqrt(5.f)) / 2;
+	std::vector<glm::vec3> points {
+		{-1, t, 0}, {1, t, 0}, {-1, -t, 0}, {1, -t, 0},
+		{0, -1, t}, {0, 1, t}, {0, -1, -t}, {0, 1, -t},
+		{t, 0, -1}, {t, 0, 1}, {-t, 0, -1}, {-t, 0, 1}
+	};
+	std::vector<glm::uvec3> faces {
+		{0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+		{1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+		{3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+		{4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+	};
+
+	// Split every face into four (sharing the new midpoints between faces)
+	std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints;
+	auto midpoint = [&](unsigned int a, unsigned int b) {
+		auto key = std::minmax(a, b);
+		auto found = midpoints.find(key);
+		if(found != midpoints.end()) return found->second;
+
+		points.push_back((points[a] + points[b]) / 2.f);
+		return midpoints[key] = points.size() - 1;
+	};
+	std::vector<glm::uvec3> split;
+	for(glm::uvec3 face: faces) {
+		unsigned int ab = midpoint(face.x, face.y), bc = midpoint(face.y, face.z), ca = midpoint(face.z, face.x);
+		split.insert(split.end(), { {face.x, ab, ca}, {face.y, bc, ab}, {face.z, ca, bc}, {ab, bc, ca} });
+	}
+
+	// Push every point onto a lumpy unit sphere
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> lumpiness(.75, 1);
+	for(glm::vec3& point: points)
+		point = glm::normalize(point) * lumpiness(generator);
+
+	// Flat shaded triangles (the normal is stored in the color)
+	for(glm::uvec3 face: split) {
+		glm::vec3 normal = glm::normalize(glm::cross(points[face.y] - points[face.x], points[face.z] - points[face.x]));
+		for(int corner = 0; corner < 3; corner++) {
+			Indices.push_back(Vertices.size());
+			Vertices.emplace_back(points[face[corner]], normal, glm::vec2(0));
+		}
+	}
+
+	// Upload the mesh to the GPU
+	FinalizeModel();
+}
+
+void AsteroidBelt::Update(unsigned int dt) {
+	// The belt is centered on the body it orbits
+	setModelRelativeToParent(glm::mat4(1));
+
+	float seconds = dt * milliToSec * globalTimeScale;
+	time += seconds;
+	// Find the camera in the belt's space
+	glm::vec3 eye = glm::vec3(glm::inverse(GetModel()) * glm::inverse(camera->GetView())[3]);
+
+	auto start = std::chrono::steady_clock::now();
+
+	// Split the bodies between the solver threads (this thread solving the first range, small belts are solved on this thread alone)
+	SolverPool& pool = SolverPool::get();
+	threads = std::clamp<size_t>(count / ASTEROID_MIN_BODIES_PER_THREAD, 1, pool.size());
+	if(nearBodies.size() < threads) nearBodies.resize(threads);
+	size_t perThread = (count + threads - 1) / threads;
+	if(threads == 1) SolveRange(0, 0, count, seconds, eye);
+	else pool.Run(threads, [&](size_t thread) {
+		SolveRange(thread, std::min(count, thread * perThread), std::min(count, (thread + 1) * perThread), seconds, eye);
+	});
+
+	// Gather the bodies to draw as meshes, any past the limit go back to being imposters
+	meshInstances.clear();
+	for(size_t thread = 0; thread < threads; thread++)
+		for(uint32_t body: nearBodies[thread])
+			if(meshInstances.size() < ASTEROID_MAX_MESH_BODIES)
+				meshInstances.push_back({ glm::vec4(positions[body], positions[count + body], positions[2 * count + body], radii[body]), (float) body });
+			else positions[3 * count + body] = radii[body];
+
+	solveTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	Object::Update(dt);
+}
+
+void AsteroidBelt::SolveRange(size_t thread, size_t begin, size_t end, float seconds, glm::vec3 eye) {
+	if(globalShouldScale) SolveOrbits<true>(begin, end, seconds);
+	else SolveOrbits<false>(begin, end, seconds);
+
+	// Bodies which cover enough of the screen are drawn as meshes, which is marked by negating their radius
+	const float* x = positions.data();
+	const float* y = positions.data() + count;
+	const float* z = positions.data() + 2 * count;
+	const float* r = radii.data();
+	float* signedRadius = positions.data() + 3 * count;
+	float ratio2 = meshLODRatio * meshLODRatio;
+#pragma GCC ivdep
+	for(size_t i = begin; i < end; i++) {
+		float dx = x[i] - eye.x, dy = y[i] - eye.y, dz = z[i] - eye.z;
+		float near = r[i] * r[i] > ratio2 * (dx * dx + dy * dy + dz * dz);
+		signedRadius[i] = r[i] * (1 - 2 * near);
+	}
+
+	nearBodies[thread].clear();
+	for(size_t i = begin; i < end; i++)
+		if(signedRadius[i] < 0)
+			nearBodies[thread].push_back(i);
+}
+
+// Advances every body in the range along its orbit, and finds its position. The loop has no branches or library calls so the compiler
+// can vectorize it, and each body's solution starts from the last frame's, so it converges in a couple of Newton iterations
+template<bool Scaled>
+void AsteroidBelt::SolveOrbits(size_t begin, size_t end, float seconds) {
+	float* M = meanAnomaly.data();
+	float* E = eccentricAnomaly.data();
+	const float* n = meanMotion.data();
+	const float* e = eccentricities.data();
+	const float* ratio = minorAxisRatio.data();
+	const float* a = Scaled ? scaledSemiMajorAxes.data() : semiMajorAxes.data();
+	const float* Px = px.data();
+	const float* Py = py.data();
+	const float* Pz = pz.data();
+	const float* Qx = qx.data();
+	const float* Qy = qy.data();
+	const float* Qz = qz.data();
+	float* x = positions.data();
+	float* y = positions.data() + count;
+	float* z = positions.data() + 2 * count;
+
+	// The arrays never overlap (which the compiler can't prove on its own)
+#pragma GCC ivdep
+	for(size_t i = begin; i < end; i++) {
+		// Advance the mean anomaly, wrapping both anomalies by the same number of turns
+		float m = M[i] + n[i] * seconds;
+		float turns = (float) (int) (m * INV_TWO_PI);
+		m -= TWO_PI * turns;
+		float anomaly = E[i] - TWO_PI * turns;
+
+		// Solve Kepler's equation (M = E - e sin E) with Newton's method, rotating the sine and cosine by each (small) step rather than recomputing them
+		float s, c;
+		FastSinCos(anomaly, s, c);
+#pragma GCC unroll 4
+		for(int iteration = 0; iteration < ASTEROID_KEPLER_ITERATIONS; iteration++) {
+			float step = (m - anomaly + e[i] * s) / (1 - e[i] * c);
+			anomaly += step;
+			float step2 = step * step, stepSin = step * (1 - step2 * (1.f / 6)), stepCos = 1 - step2 * (.5f - step2 * (1.f / 24));
+			float rotatedSin = s * stepCos + c * stepSin;
+			c = c * stepCos - s * stepSin;
+			s = rotatedSin;
+		}
+		M[i] = m;
+		E[i] = anomaly;
+
+		// Distance from the focus (as a fraction of the semi-major axis), scaled like Celestial::scaledOrbitDistance when needed
+		float q = 1 - e[i] * c;
+		float distance = Scaled ? a[i] + 20 * FastLog2NearOne(q) : a[i] * q;
+		// Position within the orbital plane, then in the belt
+		float u = (c - e[i]) / q * distance, v = ratio[i] * s / q * distance;
+		x[i] = Px[i] * u + Qx[i] * v;
+		y[i] = Py[i] * u + Qy[i] * v;
+		z[i] = Pz[i] * u + Qz[i] * v;
+	}
+}
+
+void AsteroidBelt::Render(GLint modelMatrix) {
+	// Pass along to children.
+	for(Object* child: children)
+		child->Render(modelMatrix);
+}
+
+void AsteroidBelt::RenderBodies() {
+	if(count == 0) return;
+
+	// Find how many pixels a unit radius covers at a distance of 1, bodies covering enough pixels become meshes in the next update
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glm::mat4 projection = camera->GetProjection(), view = camera->GetView();
+	float pointScale = projection[1][1] * viewport[3] / 2;
+	meshLODRatio = meshLODPixels / pointScale;
+
+	// Upload the positions (orphaning last frame's buffer so we don't wait for it to finish drawing)
+	glBindBuffer(GL_ARRAY_BUFFER, positionsVB);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * positions.size(), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * positions.size(), positions.data());
+
+	// Draw every body as an imposter (the shader drops the ones drawn as meshes)
+	imposterShader->Enable();
+	glUniformMatrix4fv(imposterProjectionMatrix, 1, GL_FALSE, glm::value_ptr(projection));
+	glUniformMatrix4fv(imposterViewMatrix, 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(imposterModelMatrix, 1, GL_FALSE, glm::value_ptr(GetModel()));
+	glUniform1f(imposterPointScale, pointScale);
+	glUniform3fv(imposterColor, 1, glm::value_ptr(color));
+
+	// The x, y, z, and radius arrays are each their own attribute
+	for(GLuint attribute = 0; attribute < 4; attribute++) {
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribPointer(attribute, 1, GL_FLOAT, GL_FALSE, sizeof(float), (void*) (sizeof(float) * count * attribute));
+	}
+
+	glEnable(GL_PROGRAM_POINT_SIZE);
+	glDrawArrays(GL_POINTS, 0, count);
+	glDisable(GL_PROGRAM_POINT_SIZE);
+
+	for(GLuint attribute = 0; attribute < 4; attribute++)
+		glDisableVertexAttribArray(attribute);
+
+	if(meshInstances.empty()) return;
+
+	// Draw the nearby bodies as instances of the mesh
+	meshShader->Enable();
+	glUniformMatrix4fv(meshProjectionMatrix, 1, GL_FALSE, glm::value_ptr(projection));
+	glUniformMatrix4fv(meshViewMatrix, 1, GL_FALSE, glm::value_ptr(view));
+	glUniformMatrix4fv(meshModelMatrix, 1, GL_FALSE, glm::value_ptr(GetModel()));
+	glUniform1f(meshTime, time);
+	glUniform3fv(meshColor, 1, glm::value_ptr(color));
+
+	// Specify where in the vertex buffer we can find the position and normal
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glBindBuffer(GL_ARRAY_BUFFER, VB);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex,color));
+
+	// Upload the instances and specify that they advance once per instance
+	glEnableVertexAttribArray(3);
+	glEnableVertexAttribArray(4);
+	glBindBuffer(GL_ARRAY_BUFFER, instancesVB);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(MeshInstance) * meshInstances.size(), meshInstances.data(), GL_STREAM_DRAW);
+	glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (void*)offsetof(MeshInstance,positionRadius));
+	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (void*)offsetof(MeshInstance,seed));
+	glVertexAttribDivisor(3, 1);
+	glVertexAttribDivisor(4, 1);
+
+	// Draw with backface culling (putting back whatever culling state the scene was using)
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IB);
+	GLboolean culling = glIsEnabled(GL_CULL_FACE);
+	glEnable(GL_CULL_FACE);
+	glDrawElementsInstanced(GL_TRIANGLES, Indices.size(), GL_UNSIGNED_INT, 0, meshInstances.size());
+	if(!culling) glDisable(GL_CULL_FACE);
+
+	// Reset the divisors (the other objects share our vertex array) and disable the attributes
+	glVertexAttribDivisor(3, 0);
+	glVertexAttribDivisor(4, 0);
+	glDisableVertexAttribArray(0);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(3);
+	glDisableVertexAttribArray(4);
+}
@@ -4,6 +4,7 @@
 
 #include "celestial.h"
 #include "rings.h"
+#include "asteroidBelt.h"
 #include "skybox.h"
 #include <fstream>
 
@@ -205,6 +206,30 @@ Celestial* Graphics::CelestialFromJson(const Arguments& args, json j, uint depth
 		ring->Initialize(args, args.getResourcePath() + texturePath);
 	}
 
+	// Create any belts of small bodies orbiting the celestial
+	for (auto b: j["Belts"]) {
+		// Create a child belt and set the distributions its bodies are generated from
+		AsteroidBelt* belt = (AsteroidBelt*) celestial->addChild(new AsteroidBelt());
+		belt->name = b.value("Name", "Belt");
+		belt->count = b.value("Count", 10000);
+		belt->seed = b.value("Seed", 0);
+		belt->semiMajorAxis = jsonToVec2(b["Semi-Major Axis (km)"], belt->semiMajorAxis);
+		belt->eccentricity = jsonToVec2(b["Eccentricity"], belt->eccentricity);
+		belt->inclination = jsonToVec2(b["Inclination (deg)"], belt->inclination);
+		belt->radius = jsonToVec2(b["Radius (km)"], belt->radius);
+		for (auto gap: b["Gaps (km)"])
+			belt->gaps.push_back(jsonToVec2(gap));
+		belt->centralMass = jsonToFloat(b["Central Mass (Solar Masses)"], 1);
+		belt->displayScale = jsonToFloat(b["Display Scale"], belt->displayScale);
+		belt->color = jsonToVec3(b["Color"], belt->color);
+		belt->meshLODPixels = jsonToFloat(b["Mesh LOD (px)"], belt->meshLODPixels);
+
+		// Generate the bodies
+		if(!belt->Initialize(args, m_camera))
+			std::cerr << "Failed to initialize belt `" << belt->name << "`" << std::endl;
+		belts.push_back(belt);
+	}
+
 	// Recursively initialize the celestial's children
 	for (auto child: j["Children"])
 		celestial->addChild(CelestialFromJson(args, child, depth + 1));
@@ -241,6 +266,10 @@ void Graphics::Render() {
 	// Render the object
 	sceneRoot->Render(m_modelMatrix);
 
+	// Render the belts (they use their own shaders)
+	for(AsteroidBelt* belt: belts)
+		belt->RenderBodies();
+
 	// Render the GUI
 	m_gui->Render();
 
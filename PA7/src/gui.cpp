@@ -5,6 +5,7 @@
 #include "imgui_impl_opengl3.h"
 #include "engine.h"
 #include "celestial.h"
+#include "asteroidBelt.h"
 
 // Provide a backing for the globalTimeScale global variable
 float globalTimeScale = 1;
@@ -75,6 +76,10 @@ void GUI::Render(){
 			if (ImGui::MenuItem((globalShouldScale ? "Use Actual Data" : "Use Scaled Data")))
 				globalShouldScale = !globalShouldScale;
 
+			// Statistics about the belts of small bodies
+			for(AsteroidBelt* belt: graphics->getBelts())
+				ImGui::Text("%s: %zu bodies (%zu as meshes), solved in %.2fms on %zu threads", belt->name.c_str(), belt->count, belt->getMeshBodies(), belt->getSolveTime(), belt->getThreads());
+
 			ImGui::EndMenu();
 		}
 
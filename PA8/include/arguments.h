@@ -16,6 +16,9 @@ private:
 
 	json config;
 
+	// Whether the models should be cooked instead of running the program
+	bool cook = false;
+
 	// Variable tracking whether or not we can continue
 	bool canContinue = true;
 public:
@@ -29,6 +32,7 @@ public:
 	std::string getFragmentFilePath() const { return fragmentFilePath; }
 
 	json getConfig() const { return config; }
+	bool getCook() const { return cook; }
 
 	bool getCanContinue() const { return canContinue; }
 };
@@ -27,6 +27,7 @@ Arguments::Arguments(int argc, char **argv){
 			
 			std::cout << "Optional" << std::endl;
 			std::cout << "\t--resource-path <path> - Sets the resource directory, the directory" << std::endl << "\t\twhere all of the program's resources can be found. [default=../]" << std::endl;
+			std::cout << "\t--cook - Cooks every model into the binary format loaded in their place," << std::endl << "\t\tand compares loading them to importing them (instead of running)" << std::endl;
 
 			std::cout << std::string(60, '-') << std::endl;
 			std::cout << "Keys" << std::endl;
@@ -83,6 +84,10 @@ Arguments::Arguments(int argc, char **argv){
 			i++;
 			resourcePath = argv[i];
 		}
+
+		// If the argument is "--cook"
+		else if(arg == "--cook")
+			cook = true;
 	}
 
 	// Make sure the config file exists and parse it
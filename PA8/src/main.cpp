@@ -2,6 +2,7 @@
 
 #include "engine.h"
 #include "arguments.h"
+#include "mesh_blob.h"
 
 
 int main(int argc, char **argv) {
@@ -9,6 +10,10 @@ int main(int argc, char **argv) {
 	Arguments args(argc, argv);
 	if(!args.getCanContinue()) return 1;
 
+	// Cook the models (no window is needed for that) instead of starting the engine
+	if(args.getCook())
+		return MeshBlob::cookAll(args) ? 0 : 3;
+
 	// Start an engine
 	Engine *engine = new Engine("React Physics", 1000, 1000);
 	if(!engine->Initialize(args)) {
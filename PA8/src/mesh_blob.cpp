@@ -0,0 +1,348 @@
+#include "mesh_blob.h"
+#include "arguments.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+// Memory mapping
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+// Magic number at the start of every cooked model
+static const char BLOB_MAGIC[4] = {'M', 'E', 'S', 'H'};
+
+// Rounds an offset up to the start of the next section
+static size_t align(size_t offset) { return (offset + MESH_BLOB_ALIGNMENT - 1) / MESH_BLOB_ALIGNMENT * MESH_BLOB_ALIGNMENT; }
+
+// Asks the kernel to drop a file from the page cache, so the next read of it comes from the disk (only a hint, it does nothing where unsupported)
+static void evict(const std::string& path) {
+#ifdef POSIX_FADV_DONTNEED
+	int file = ::open(path.c_str(), O_RDONLY);
+	if(file < 0) return;
+	posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+	::close(file);
+#endif
+}
+
+MeshBlob::~MeshBlob() {
+	if(data) munmap((void*) data, size);
+}
+
+MeshBlob::ptr MeshBlob::open(const Arguments& args, const std::string& modelPath) {
+	// Models which are currently mapped (so every object using a model shares one mapping)
+	static std::mutex mutex;
+	static std::unordered_map<std::string, std::weak_ptr<const MeshBlob>> mapped;
+
+	std::string path = cookedPath(args, modelPath);
+	std::scoped_lock lock(mutex);
+	if(auto found = mapped.find(path); found != mapped.end())
+		if(ptr blob = found->second.lock())
+			return blob;
+
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if(!statSource(modelPath, sourceSize, sourceTime))
+		return nullptr;
+
+	ptr blob = map(path, sourceSize, sourceTime);
+	if(!blob) {
+		if(std::filesystem::exists(path))
+			std::cerr << "Cooked model `" << path << "` is out of date, importing `" << modelPath << "` instead (cook the models again to fix this)" << std::endl;
+		return nullptr;
+	}
+
+	mapped[path] = blob;
+	return blob;
+}
+
+std::unique_ptr<MeshBlob> MeshBlob::map(const std::string& path, uint64_t sourceSize, int64_t sourceTime) {
+	int file = ::open(path.c_str(), O_RDONLY);
+	if(file < 0) return nullptr;
+
+	struct stat info;
+	void* mapping = MAP_FAILED;
+	if(fstat(file, &info) == 0 && (size_t) info.st_size >= sizeof(Header))
+		mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file); // The mapping keeps the file open
+	if(mapping == MAP_FAILED) return nullptr;
+
+	std::unique_ptr<MeshBlob> blob(new MeshBlob());
+	blob->data = (const uint8_t*) mapping;
+	blob->size = info.st_size;
+	blob->header = (const Header*) blob->data;
+
+	// Make sure the model was cooked by this version, from the current version of the model
+	const Header& header = *blob->header;
+	if(std::memcmp(header.magic, BLOB_MAGIC, sizeof(BLOB_MAGIC)) != 0 || header.version != MESH_BLOB_VERSION || header.vertexSize != sizeof(Vertex)
+			|| header.sourceSize != sourceSize || header.sourceTime != sourceTime)
+		return nullptr;
+
+	// Make sure every section is inside of the file (so a truncated file is never read past its end)
+	auto inside = [&blob](uint64_t offset, uint64_t bytes) { return offset <= blob->size && bytes <= blob->size - offset; };
+	if(!inside(0, sizeof(Header) + (uint64_t) header.submeshCount * sizeof(Submesh))) return nullptr;
+	blob->submeshes = (const Submesh*) (blob->data + sizeof(Header));
+
+	for(size_t i = 0; i < header.submeshCount; i++) {
+		const Submesh& submesh = blob->submeshes[i];
+		if(!inside(submesh.vertexOffset, (uint64_t) submesh.vertexCount * sizeof(Vertex)) || !inside(submesh.indexOffset, (uint64_t) submesh.indexCount * sizeof(unsigned int))
+				|| !inside(submesh.textureOffset, submesh.textureLength))
+			return nullptr;
+	}
+
+	// Everything is about to be uploaded, so start reading it all in now
+	posix_madvise(mapping, blob->size, POSIX_MADV_WILLNEED);
+	return blob;
+}
+
+bool MeshBlob::statSource(const std::string& modelPath, uint64_t& size, int64_t& time) {
+	std::error_code error;
+	size = std::filesystem::file_size(modelPath, error);
+	if(error) return false;
+	time = std::filesystem::last_write_time(modelPath, error).time_since_epoch().count();
+	return !error;
+}
+
+std::string MeshBlob::cookedPath(const Arguments& args, const std::string& modelPath) {
+	// Models in different directories can share a name, so the name is followed by a hash (FNV-1a) of the model's full path
+	std::string fullPath = std::filesystem::absolute(modelPath).lexically_normal().string();
+	uint64_t hash = 0xcbf29ce484222325;
+	for(char c: fullPath) {
+		hash ^= (uint8_t) c;
+		hash *= 0x100000001b3;
+	}
+
+	std::stringstream path;
+	path << args.getResourcePath() << "cache/meshes/" << std::filesystem::path(modelPath).filename().string() << "."
+		<< std::hex << std::setw(16) << std::setfill('0') << hash << ".mesh";
+	return path.str();
+}
+
+void MeshBlob::convert(const aiMesh* mesh, glm::mat4 transformation, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+	vertices.reserve(vertices.size() + mesh->mNumVertices);
+	indices.reserve(indices.size() + mesh->mNumFaces * 3);
+
+	// For each vertex...
+	for(int vert = 0; vert < mesh->mNumVertices; vert++){
+
+		// Extract the position
+		auto _pos = mesh->mVertices[vert];
+		// Apply an input transformation (defaults to the identity matrix)
+		glm::vec4 pos(_pos.x, _pos.y, _pos.z, 1);
+		pos = transformation * pos;
+
+		// Extract the (first) vertex color if it exists
+		glm::vec3 color(1, 1, 1); // White by default
+		if(mesh->HasVertexColors(0)){
+			auto col = mesh->mColors[0][vert];
+			color = glm::vec3(col.r, col.g, col.b);
+		}
+
+		// Extract the (first) texture coordinates if they exist
+		glm::vec2 uv(0, 0); // 0,0 by default
+		if(mesh->HasTextureCoords(0)){
+			auto tex = mesh->mTextureCoords[0][vert];
+			uv = glm::vec2(tex.x, tex.y);
+		}
+
+		// Add the vertex to the list of vertecies
+		vertices.emplace_back(/*position*/ glm::vec3(pos.x, pos.y, pos.z), color, uv);
+	}
+
+	// For each face...
+	for(int face = 0; face < mesh->mNumFaces; face++)
+		// For each index in the face (3 in the triangles)
+		for(int index = 0; index < 3; index++)
+			// Add the index to the list of indices
+			indices.push_back(mesh->mFaces[face].mIndices[index]);
+}
+
+std::string MeshBlob::diffuseTexture(const aiScene* scene, const aiMesh* mesh) {
+	// Meshes using the default material (index 0) don't have a texture
+	if(mesh->mMaterialIndex == 0) return "";
+
+	// Extract the path to the diffuse texture from the material
+	aiString path;
+	scene->mMaterials[mesh->mMaterialIndex]->GetTexture(aiTextureType_DIFFUSE, 0, &path);
+	return std::string(path.C_Str());
+}
+
+bool MeshBlob::cook(const Arguments& args, const std::string& modelPath) {
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if(!statSource(modelPath, sourceSize, sourceTime)) {
+		std::cerr << "Failed to find model `" << modelPath << "`" << std::endl;
+		return false;
+	}
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(modelPath, aiProcess_Triangulate);
+	if(scene == nullptr) {
+		std::cerr << "Failed to import model `" << modelPath << "`: ";
+		std::cerr << importer.GetErrorString() << std::endl;
+		return false;
+	}
+
+	// Convert every mesh
+	std::vector<std::vector<Vertex>> vertices(scene->mNumMeshes);
+	std::vector<std::vector<unsigned int>> indices(scene->mNumMeshes);
+	std::vector<std::string> textures(scene->mNumMeshes);
+	for(size_t i = 0; i < scene->mNumMeshes; i++) {
+		convert(scene->mMeshes[i], glm::mat4(1), vertices[i], indices[i]);
+		textures[i] = diffuseTexture(scene, scene->mMeshes[i]);
+	}
+
+	// Lay out the file
+	Header header = {};
+	std::memcpy(header.magic, BLOB_MAGIC, sizeof(BLOB_MAGIC));
+	header.version = MESH_BLOB_VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.submeshCount = vertices.size();
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+
+	size_t offset = sizeof(Header) + header.submeshCount * sizeof(Submesh);
+	auto place = [&offset](size_t bytes) { offset = align(offset); size_t start = offset; offset += bytes; return start; };
+
+	glm::vec3 boundsMin(INFINITY), boundsMax(-INFINITY);
+	std::vector<Submesh> submeshTable(header.submeshCount);
+	for(size_t i = 0; i < submeshTable.size(); i++) {
+		glm::vec3 submeshMin(INFINITY), submeshMax(-INFINITY);
+		for(const Vertex& vertex: vertices[i]) {
+			submeshMin = glm::min(submeshMin, vertex.vertex);
+			submeshMax = glm::max(submeshMax, vertex.vertex);
+		}
+		if(vertices[i].empty()) submeshMin = submeshMax = glm::vec3(0);
+		boundsMin = glm::min(boundsMin, submeshMin);
+		boundsMax = glm::max(boundsMax, submeshMax);
+
+		Submesh& submesh = submeshTable[i];
+		submesh.vertexCount = vertices[i].size();
+		submesh.indexCount = indices[i].size();
+		submesh.textureLength = textures[i].size();
+		submesh.vertexOffset = place(submesh.vertexCount * sizeof(Vertex));
+		submesh.indexOffset = place(submesh.indexCount * sizeof(unsigned int));
+		submesh.textureOffset = place(submesh.textureLength);
+		std::memcpy(submesh.boundsMin, glm::value_ptr(submeshMin), sizeof(submesh.boundsMin));
+		std::memcpy(submesh.boundsMax, glm::value_ptr(submeshMax), sizeof(submesh.boundsMax));
+	}
+	if(submeshTable.empty()) boundsMin = boundsMax = glm::vec3(0);
+	std::memcpy(header.boundsMin, glm::value_ptr(boundsMin), sizeof(header.boundsMin));
+	std::memcpy(header.boundsMax, glm::value_ptr(boundsMax), sizeof(header.boundsMax));
+
+	// Fill in the file
+	std::vector<uint8_t> file(offset, 0);
+	std::memcpy(file.data(), &header, sizeof(header));
+	std::memcpy(file.data() + sizeof(Header), submeshTable.data(), submeshTable.size() * sizeof(Submesh));
+	for(size_t i = 0; i < submeshTable.size(); i++) {
+		std::memcpy(file.data() + submeshTable[i].vertexOffset, vertices[i].data(), vertices[i].size() * sizeof(Vertex));
+		std::memcpy(file.data() + submeshTable[i].indexOffset, indices[i].data(), indices[i].size() * sizeof(unsigned int));
+		std::memcpy(file.data() + submeshTable[i].textureOffset, textures[i].data(), textures[i].size());
+	}
+
+	// Write to a temporary file and then move it into place so a half written file is never mapped
+	std::string path = cookedPath(args, modelPath), temporaryPath = path + ".tmp";
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+	{
+		std::ofstream fout(temporaryPath, std::ios::binary | std::ios::trunc);
+		fout.write((const char*) file.data(), file.size());
+		if(!fout) {
+			std::cerr << "Failed to write cooked model `" << temporaryPath << "`" << std::endl;
+			return false;
+		}
+	}
+	std::filesystem::rename(temporaryPath, path, error);
+	return !error;
+}
+
+bool MeshBlob::cookAll(const Arguments& args) {
+	using clock = std::chrono::steady_clock;
+	auto milliseconds = [](clock::duration elapsed) { return std::chrono::duration<double, std::milli>(elapsed).count(); };
+
+	std::vector<std::string> models;
+	std::error_code error;
+	for(auto& entry: std::filesystem::directory_iterator(args.getResourcePath() + "models/", error))
+		if(entry.is_regular_file() && entry.path().extension() == ".obj")
+			models.push_back(entry.path().string());
+	std::sort(models.begin(), models.end());
+	if(error || models.empty()) {
+		std::cerr << "Failed to find any models to cook in `" << args.getResourcePath() << "models/`" << std::endl;
+		return false;
+	}
+
+	bool success = true;
+	for(auto& model: models) {
+		auto start = clock::now();
+		bool cooked = cook(args, model);
+		success &= cooked;
+		if(cooked) std::cout << "Cooked `" << model << "` in " << milliseconds(clock::now() - start) << "ms" << std::endl;
+	}
+
+	// Compare loading each model from a cold cache (the model is dropped from the page cache before every load) by importing it and by mapping its cooked version
+	std::cout << "Cold load benchmark (" << MESH_BLOB_BENCHMARK_LOADS << " loads of each model):" << std::endl;
+	double importTotal = 0, mapTotal = 0;
+	for(auto& model: models) {
+		std::string path = cookedPath(args, model);
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		if(!statSource(model, sourceSize, sourceTime))
+			continue;
+
+		double importTime = 0, mapTime = 0;
+		size_t checksum = 0;
+		for(size_t load = 0; load < MESH_BLOB_BENCHMARK_LOADS; load++) {
+			// Importing: parsing the model and converting it into vertices (everything LoadModelFile does before uploading)
+			evict(model);
+			auto start = clock::now();
+			{
+				Assimp::Importer importer;
+				const aiScene* scene = importer.ReadFile(model, aiProcess_Triangulate);
+				std::vector<Vertex> vertices;
+				std::vector<unsigned int> indices;
+				for(size_t i = 0; scene && i < scene->mNumMeshes; i++) {
+					vertices.clear();
+					indices.clear();
+					convert(scene->mMeshes[i], glm::mat4(1), vertices, indices);
+					checksum += vertices.size() + indices.size();
+				}
+			}
+			importTime += milliseconds(clock::now() - start);
+
+			// Mapping: every byte which would be uploaded is read so that the whole file has to come in off the disk
+			evict(path);
+			start = clock::now();
+			if(auto blob = map(path, sourceSize, sourceTime))
+				for(size_t i = 0; i < blob->getSubmeshCount(); i++) {
+					const uint8_t* bytes = (const uint8_t*) blob->getVertices(i);
+					for(size_t b = 0; b < blob->getVertexCount(i) * sizeof(Vertex); b += 64)
+						checksum += bytes[b];
+					bytes = (const uint8_t*) blob->getIndices(i);
+					for(size_t b = 0; b < blob->getIndexCount(i) * sizeof(unsigned int); b += 64)
+						checksum += bytes[b];
+				}
+			mapTime += milliseconds(clock::now() - start);
+		}
+
+		importTime /= MESH_BLOB_BENCHMARK_LOADS;
+		mapTime /= MESH_BLOB_BENCHMARK_LOADS;
+		importTotal += importTime;
+		mapTotal += mapTime;
+		std::cout << "\t" << std::filesystem::path(model).filename().string() << ": " << importTime << "ms imported, " << mapTime << "ms cooked (checksum " << checksum << ")" << std::endl;
+	}
+	std::cout << "\tTotal: " << importTotal << "ms imported, " << mapTotal << "ms cooked (" << importTotal / std::max(mapTotal, 1e-6) << "x faster)" << std::endl;
+
+	return success;
+}
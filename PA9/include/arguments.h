@@ -18,6 +18,9 @@ private:
 
 	json config;
 
+	// Whether the models should be cooked instead of running the program
+	bool cook = false;
+
 	// Variable tracking whether or not we can continue
 	bool canContinue = true;
 public:
@@ -33,6 +36,7 @@ public:
 	std::string getPerVertexFragmentFilePath() const { return perVertexFragmentFilePath; }
 
 	json getConfig() const { return config; }
+	bool getCook() const { return cook; }
 
 	bool getCanContinue() const { return canContinue; }
 };
@@ -0,0 +1,89 @@
+#ifndef MESH_BLOB_H
+#define MESH_BLOB_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "graphics_headers.h"
+
+// The bump in this number invalidates every cooked model (they fall back to being imported until they are cooked again)
+#define MESH_BLOB_VERSION 1
+// Every section of a cooked model starts on a multiple of this many bytes
+#define MESH_BLOB_ALIGNMENT 16
+// How many times the load benchmark (run when cooking) loads each model
+#define MESH_BLOB_BENCHMARK_LOADS 8
+
+class Arguments;
+struct aiScene;
+struct aiMesh;
+
+// A model cooked into the layout it is drawn with: the vertices (interleaved exactly as they are uploaded), indices, bounds, and
+// diffuse texture of every submesh. Cooked models are memory mapped, so loading one is just handing pointers into the mapping to
+// OpenGL and ReactPhysics (pages are only read from disk as they are touched)
+// NOTE: Convex hulls aren't cooked, QuickHull builds them from the mapped vertices quickly enough
+class MeshBlob {
+public:
+	using ptr = std::shared_ptr<const MeshBlob>;
+
+	// Layout of the file: the header, the submesh table, then every section it points to
+	struct Header {
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexSize; // sizeof(Vertex) when it was cooked (a change to the vertex layout invalidates it)
+		uint32_t submeshCount;
+		uint64_t sourceSize; // Size and modification time of the model it was cooked from (a change to either invalidates it)
+		int64_t sourceTime;
+		float boundsMin[3], boundsMax[3];
+	};
+	struct Submesh {
+		uint64_t vertexOffset, indexOffset, textureOffset;
+		uint32_t vertexCount, indexCount, textureLength;
+		float boundsMin[3], boundsMax[3];
+	};
+
+public:
+	~MeshBlob();
+
+	// Maps the cooked version of a model, returning nullptr if the model hasn't been cooked (or has changed since it was).
+	// Models which are already mapped are shared rather than mapped again
+	static ptr open(const Arguments& args, const std::string& modelPath);
+	// Imports a model and cooks it
+	static bool cook(const Arguments& args, const std::string& modelPath);
+	// Cooks every model in the resource directory, then compares loading them to importing them (printed to the console)
+	static bool cookAll(const Arguments& args);
+	// Where the cooked version of a model lives
+	static std::string cookedPath(const Arguments& args, const std::string& modelPath);
+
+	// Converts an imported mesh into the vertices and indices which are drawn (shared by cooking and importing, so the two always match)
+	static void convert(const aiMesh* mesh, glm::mat4 transformation, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+	// Path to the diffuse texture of an imported mesh's material (empty if it doesn't have one)
+	static std::string diffuseTexture(const aiScene* scene, const aiMesh* mesh);
+
+	size_t getSubmeshCount() const { return header->submeshCount; }
+	const Vertex* getVertices(size_t submesh) const { return (const Vertex*) (data + submeshes[submesh].vertexOffset); }
+	size_t getVertexCount(size_t submesh) const { return submeshes[submesh].vertexCount; }
+	const unsigned int* getIndices(size_t submesh) const { return (const unsigned int*) (data + submeshes[submesh].indexOffset); }
+	size_t getIndexCount(size_t submesh) const { return submeshes[submesh].indexCount; }
+	std::string getTexture(size_t submesh) const { return std::string((const char*) (data + submeshes[submesh].textureOffset), submeshes[submesh].textureLength); }
+	glm::vec3 getBoundsMin() const { return glm::make_vec3(header->boundsMin); }
+	glm::vec3 getBoundsMax() const { return glm::make_vec3(header->boundsMax); }
+
+protected:
+	MeshBlob() = default;
+	MeshBlob(const MeshBlob&) = delete;
+
+	// Maps a cooked model, making sure it is complete and was cooked (by this version) from a source of the given size and time
+	static std::unique_ptr<MeshBlob> map(const std::string& path, uint64_t sourceSize, int64_t sourceTime);
+	// Finds the size and modification time of a model
+	static bool statSource(const std::string& modelPath, uint64_t& size, int64_t& time);
+
+protected:
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	const Header* header = nullptr;
+	const Submesh* submeshes = nullptr;
+};
+
+#endif // MESH_BLOB_H